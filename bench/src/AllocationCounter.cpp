@@ -0,0 +1,66 @@
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+    #include <malloc.h>
+#endif
+
+namespace {
+    std::atomic<size_t> s_Allocations{0};
+    std::atomic<size_t> s_Bytes{0};
+
+    void* allocate(size_t size) {
+        s_Allocations.fetch_add(1, std::memory_order_relaxed);
+        s_Bytes.fetch_add(size, std::memory_order_relaxed);
+        void* memory = std::malloc(size != 0 ? size : 1);
+        if (!memory) throw std::bad_alloc();
+        return memory;
+    }
+
+    void* allocateAligned(size_t size, std::align_val_t alignment) {
+        s_Allocations.fetch_add(1, std::memory_order_relaxed);
+        s_Bytes.fetch_add(size, std::memory_order_relaxed);
+        const size_t align = static_cast<size_t>(alignment);
+#ifdef _WIN32
+        void* memory = _aligned_malloc(size != 0 ? size : 1, align);
+#else
+        // aligned_alloc wants the size to be a multiple of the alignment
+        void* memory = std::aligned_alloc(align, ((size != 0 ? size : 1) + align - 1) / align * align);
+#endif
+        if (!memory) throw std::bad_alloc();
+        return memory;
+    }
+
+    void releaseAligned(void* memory) {
+#ifdef _WIN32
+        _aligned_free(memory);
+#else
+        std::free(memory);
+#endif
+    }
+}
+
+size_t getAllocationCount() {
+    return s_Allocations.load(std::memory_order_relaxed);
+}
+
+size_t getAllocatedBytes() {
+    return s_Bytes.load(std::memory_order_relaxed);
+}
+
+void* operator new(size_t size) { return allocate(size); }
+void* operator new[](size_t size) { return allocate(size); }
+void* operator new(size_t size, std::align_val_t alignment) { return allocateAligned(size, alignment); }
+void* operator new[](size_t size, std::align_val_t alignment) { return allocateAligned(size, alignment); }
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, size_t) noexcept { std::free(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { releaseAligned(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { releaseAligned(memory); }
+void operator delete(void* memory, size_t, std::align_val_t) noexcept { releaseAligned(memory); }
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept { releaseAligned(memory); }
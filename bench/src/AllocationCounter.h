@@ -0,0 +1,8 @@
+#pragma once
+
+#include <cstddef>
+
+// Every operator new in the bench executable goes through a counting replacement, so a run can
+// report how much the simulation allocates per tick. Counts are process wide and never reset.
+size_t getAllocationCount();
+size_t getAllocatedBytes();
@@ -0,0 +1,103 @@
+#include "Scenarios.h"
+
+#include <cstring>
+
+namespace {
+    MaterialID findID(const MaterialTable& materials, const char* name) {
+        MaterialID material = 0;
+        materials.findMaterial(name, material);
+        return material;
+    }
+
+    void createChunks(World& world, int width, int height) {
+        for (int cy = 0; cy < height / CHUNK_SIZE; cy++) {
+            for (int cx = 0; cx < width / CHUNK_SIZE; cx++) world.getOrCreateChunk(cx, cy);
+        }
+    }
+
+    void fill(Simulation& simulation, MaterialID material, int x0, int y0, int x1, int y1) {
+        for (int y = y0; y < y1; y++) {
+            for (int x = x0; x < x1; x++) simulation.paint(x, y, material);
+        }
+    }
+
+    // a tall block of sand collapsing into a pile
+    void buildSandAvalanche(World& world, Simulation& simulation, const MaterialTable& materials) {
+        createChunks(world, 512, 512);
+        fill(simulation, findID(materials, "stone"), 0, 0, 512, 8);
+        fill(simulation, findID(materials, "sand"), 192, 8, 320, 504);
+    }
+
+    // water over the top three quarters pouring down between stone pillars
+    void buildWaterMap(World& world, Simulation& simulation, const MaterialTable& materials) {
+        createChunks(world, 512, 512);
+        const MaterialID stone = findID(materials, "stone");
+        fill(simulation, stone, 0, 0, 512, 8);
+        for (int x = 32; x < 512; x += 64) fill(simulation, stone, x, 8, x + 8, 128);
+        fill(simulation, findID(materials, "water"), 0, 128, 512, 512);
+    }
+
+    // a lava pool running into a water pool, both boil and freeze where they touch
+    void buildLavaWater(World& world, Simulation& simulation, const MaterialTable& materials) {
+        createChunks(world, 512, 256);
+        fill(simulation, findID(materials, "stone"), 0, 0, 512, 8);
+        fill(simulation, findID(materials, "lava"), 0, 8, 256, 128);
+        fill(simulation, findID(materials, "water"), 256, 8, 512, 128);
+    }
+
+    // a wood block lit along its bottom edge
+    void buildFireWood(World& world, Simulation& simulation, const MaterialTable& materials) {
+        createChunks(world, 512, 512);
+        fill(simulation, findID(materials, "stone"), 0, 0, 512, 8);
+        fill(simulation, findID(materials, "wood"), 64, 9, 448, 320);
+        fill(simulation, findID(materials, "fire"), 64, 8, 448, 9);
+    }
+
+    // a stone deck on three wood pillars lit halfway up, the deck comes down whole once they burn through
+    void buildCollapse(World& world, Simulation& simulation, const MaterialTable& materials) {
+        createChunks(world, 512, 512);
+        const MaterialID stone = findID(materials, "stone");
+        const MaterialID wood = findID(materials, "wood");
+        const MaterialID fire = findID(materials, "fire");
+        fill(simulation, stone, 0, 0, 512, 8);
+        for (int x : {64, 240, 432}) {
+            fill(simulation, wood, x, 8, x + 16, 200);
+            fill(simulation, fire, x - 2, 100, x, 104);
+        }
+        fill(simulation, stone, 32, 200, 480, 216);
+        fill(simulation, stone, 200, 216, 312, 260);
+    }
+
+    // the lower half of a chamber full of steam rising through a grate, the air is hot enough that
+    // none of it condenses so only gas moves
+    void buildSteamMap(World& world, Simulation& simulation, const MaterialTable& materials) {
+        createChunks(world, 512, 512);
+        for (Chunk* chunk : world.getChunks()) chunk->clear(0, 120.0f);
+        const MaterialID stone = findID(materials, "stone");
+        fill(simulation, stone, 0, 0, 512, 8);
+        for (int x = 0; x < 512; x += 32) fill(simulation, stone, x, 256, x + 16, 264);
+        fill(simulation, findID(materials, "steam"), 0, 8, 512, 256);
+    }
+
+    const std::vector<Scenario> SCENARIOS = {
+        {"sand_avalanche", "128x496 sand column collapsing onto a floor", 512, 512, buildSandAvalanche},
+        {"water_map", "512x384 of water pouring between pillars", 512, 512, buildWaterMap},
+        {"lava_water", "lava and water pools meeting head on", 512, 256, buildLavaWater},
+        {"fire_wood", "fire spreading up through a 384x311 wood block", 512, 512, buildFireWood},
+        {"collapse", "a stone deck falling once its burning pillars give way", 512, 512, buildCollapse, true},
+        {"generated", "2048x2048 of terrain, strata and caves generated from the seed", 2048, 2048, nullptr, false, true},
+        {"steam_map", "512x248 of steam rising through a grate in a hot chamber, moved as cells", 512, 512, buildSteamMap},
+        {"steam_map_field", "steam_map with the steam in a GasField", 512, 512, buildSteamMap, false, false, true}
+    };
+}
+
+const std::vector<Scenario>& getScenarios() {
+    return SCENARIOS;
+}
+
+const Scenario* findScenario(const char* name) {
+    for (const Scenario& scenario : SCENARIOS) {
+        if (std::strcmp(scenario.name, name) == 0) return &scenario;
+    }
+    return nullptr;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vector>
+
+#include <MaterialTable.h>
+#include <Simulation.h>
+#include <World.h>
+
+// A fixed starting world. Everything random comes from the simulation seed, so a scenario run
+// with the same seed and tick count always ends in the same state whatever the thread count.
+struct Scenario {
+    const char* name;
+    const char* description;
+    int width;  // cells, whole chunks
+    int height;
+    void (*build)(World& world, Simulation& simulation, const MaterialTable& materials); // nullptr when generated
+    bool debris = false;    // runs a DebrisTracker over the lower left of the world
+    bool generated = false; // filled by a WorldGenerator seeded with the bench seed instead of built
+    bool gasField = false;  // field gases move in a GasField instead of as cells
+};
+
+const std::vector<Scenario>& getScenarios();
+const Scenario* findScenario(const char* name);
@@ -0,0 +1,590 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Buffer.h>
+#include <DebrisTracker.h>
+#include <GasField.h>
+#include <GlStub.h>
+#include <HeatKernel.h>
+#include <MaterialTable.h>
+#include <Profiler.h>
+#include <RegionStats.h>
+#include <Simulation.h>
+#include <ThreadPool.h>
+#include <World.h>
+#include <WorldGenerator.h>
+
+#include <spdlog/spdlog.h>
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
+
+#include "AllocationCounter.h"
+#include "Scenarios.h"
+
+#ifdef _WIN32
+    #include <windows.h>
+    #include <psapi.h>
+#else
+    #include <sys/resource.h>
+#endif
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    struct BenchConfig {
+        uint64_t ticks = 500;
+        uint64_t warmupTicks = 10; // allocating is allowed for these, not after
+        unsigned int threads = 1;
+        uint32_t seed = 1;
+        int kernelSteps = 2000;
+        bool kernels = true;
+        int uploadFrames = 300;
+        bool uploads = true;
+        bool regionQueries = true;
+        bool scaling = true;
+        const char* scalingScenario = "water_map";
+        std::string materialsPath = "res/materials.txt";
+        std::string outputPath;
+        std::string profilePath; // Chrome trace of the whole run, empty to leave the profiler off
+        std::vector<const Scenario*> scenarios;
+    };
+
+    // process wide high water mark, so it only ever grows from one scenario to the next
+    size_t getPeakRSS() {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters;
+        if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+        return counters.PeakWorkingSetSize;
+#else
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    #ifdef __APPLE__
+        return (size_t)usage.ru_maxrss;
+    #else
+        return (size_t)usage.ru_maxrss * 1024;
+    #endif
+#endif
+    }
+
+    // cells the next step() will visit: the dirty rectangle of every awake chunk
+    uint64_t countActiveCells(const World& world) {
+        uint64_t cells = 0;
+        for (const Chunk* chunk : world.getChunks()) {
+            if (!chunk->isAwake()) continue;
+            cells += (uint64_t)(chunk->getDirtyMaxX() - chunk->getDirtyMinX()) * (chunk->getDirtyMaxY() - chunk->getDirtyMinY());
+        }
+        return cells;
+    }
+
+    // FNV-1a over every material plane, equal checksums mean equal worlds
+    uint64_t checksum(const World& world) {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for (const Chunk* chunk : world.getChunks()) {
+            const uint8_t* bytes = reinterpret_cast<const uint8_t*>(chunk->getMaterials());
+            for (size_t i = 0; i < CHUNK_CELLS * sizeof(MaterialID); i++) hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    // the default window, in cells
+    constexpr int QUERY_SIZE = 900;
+
+    struct RegionScan {
+        uint64_t count;
+        float hottest;
+    };
+
+    // what RegionStats answers, read cell by cell through the World
+    RegionScan scanRegion(const World& world, int x0, int y0, int x1, int y1, MaterialID material) {
+        RegionScan scan{0, -std::numeric_limits<float>::infinity()};
+        for (int y = y0; y < y1; y++) {
+            for (int x = x0; x < x1; x++) {
+                const Chunk* chunk = world.getChunkAt(x, y);
+                if (!chunk) continue;
+                const int local = Chunk::index(World::toLocalCoord(x), World::toLocalCoord(y));
+                scan.count += chunk->getMaterials()[local] == material;
+                scan.hottest = std::max(scan.hottest, chunk->getTemperatures()[local]);
+            }
+        }
+        return scan;
+    }
+
+    double secondsSince(Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    // Fills the world as the scenario says. Returns the chunks generated, 0 for built scenarios.
+    size_t buildWorld(const Scenario& scenario, World& world, Simulation& simulation, const MaterialTable& materials, uint32_t seed, ThreadPool* pool) {
+        size_t chunks = 0;
+        if (scenario.generated) {
+            WorldGenerator generator(materials, seed);
+            chunks = generator.generate(world, pool, 0, 0, scenario.width / CHUNK_SIZE - 1, scenario.height / CHUNK_SIZE - 1,
+                scenario.width / 2, scenario.height / 2);
+        } else {
+            scenario.build(world, simulation, materials);
+        }
+        world.swapDirtyRects();
+        return chunks;
+    }
+
+    // failed is set when the scenario allocated after its warm-up ticks, the debris grid did more
+    // work than the cells that changed call for or a region query was wrong
+    std::string runScenario(const BenchConfig& config, const Scenario& scenario, const MaterialTable& materials, ThreadPool* pool, bool& failed) {
+        // startup runs from here to the end of the first tick, what a player waits for the first frame
+        const Clock::time_point startup = Clock::now();
+        World world;
+        Simulation simulation(world, materials, config.seed, pool);
+
+        std::string generatorReport;
+        const Clock::time_point generateStart = Clock::now();
+        const size_t chunks = buildWorld(scenario, world, simulation, materials, config.seed, pool);
+        if (scenario.generated) {
+            const double seconds = secondsSince(generateStart);
+            generatorReport = fmt::format("\"chunks_generated\": {}, \"generate_seconds\": {:.6f}, \"chunks_generated_per_sec\": {:.1f}, ",
+                chunks, seconds, chunks / seconds);
+        }
+
+        DebrisTracker debris(world, materials);
+        if (scenario.debris) {
+            debris.setRegion(0, 0);
+            simulation.setDebrisTracker(&debris);
+        }
+        GasField gas(world, materials, config.seed, pool);
+        if (scenario.gasField) simulation.setGasField(&gas);
+        // updated by hand after each step rather than attached, so the tick times leave it out
+        RegionStats regions(world, materials, pool);
+
+        // screen-sized queries between ticks, shifted every tick so their edges cut chunks and
+        // blocks in different places
+        const int queryWidth = std::min(QUERY_SIZE, scenario.width);
+        const int queryHeight = std::min(QUERY_SIZE, scenario.height);
+        RegionSummary summary;
+        MaterialID queryMaterial = 1;
+        int queryX0 = 0;
+        int queryY0 = 0;
+        uint64_t queryCells = 0;
+        size_t regionChunks = 0;
+        size_t regionBlocks = 0;
+        Clock::duration regionUpdate{0};
+        Clock::duration summariseTime{0};
+        Clock::duration countTime{0};
+        Clock::duration hottestTime{0};
+
+        // ticks where the debris grid did more rebuilding than cells changed, see below
+        uint64_t debrisOverworkTicks = 0;
+
+        uint64_t activeCells = 0;
+        size_t maxAwake = 0;
+        Clock::duration elapsed{0};
+        const size_t allocations = getAllocationCount();
+        const size_t allocatedBytes = getAllocatedBytes();
+        // the warm-up fills the arenas and pools, after it the scenario should not allocate at all
+        // however long it runs
+        const uint64_t steadyTick = std::min(config.warmupTicks, config.ticks);
+        size_t steadyAllocations = allocations;
+        double startupSeconds = 0.0;
+
+        for (uint64_t tick = 0; tick < config.ticks; tick++) {
+            if (tick == steadyTick) steadyAllocations = getAllocationCount();
+            activeCells += countActiveCells(world);
+            maxAwake = std::max(maxAwake, world.getAwakeChunkCount());
+
+            const DebrisStats debrisBefore = debris.getStats();
+            const Clock::time_point start = Clock::now();
+            simulation.step();
+            elapsed += Clock::now() - start;
+            if (tick == 0) startupSeconds = secondsSince(startup);
+
+            // the grid is rebuilt a cluster at a time, once per cluster holding a changed cell, so a
+            // tick never rebuilds more clusters than cells changed rigidity, detached or landed
+            const DebrisStats& debrisAfter = debris.getStats();
+            const size_t changed = debrisAfter.cellsChanged + debrisAfter.cellsDetached + debrisAfter.cellsLanded
+                - debrisBefore.cellsChanged - debrisBefore.cellsDetached - debrisBefore.cellsLanded;
+            if (debrisAfter.clustersRebuilt - debrisBefore.clustersRebuilt > changed) debrisOverworkTicks++;
+
+            if (config.regionQueries) {
+                const Clock::time_point updateStart = Clock::now();
+                regions.update();
+                regionUpdate += Clock::now() - updateStart;
+                regionChunks += regions.getUpdatedChunks();
+                regionBlocks += regions.getCountedBlocks();
+
+                queryX0 = (scenario.width - queryWidth) / 2 + (int)(tick % CHUNK_SIZE) - CHUNK_SIZE / 2;
+                queryY0 = (scenario.height - queryHeight) / 2 + (int)(tick * 7 % CHUNK_SIZE) - CHUNK_SIZE / 2;
+                const int x1 = queryX0 + queryWidth;
+                const int y1 = queryY0 + queryHeight;
+
+                const Clock::time_point summariseStart = Clock::now();
+                regions.summarise(queryX0, queryY0, x1, y1, summary);
+                summariseTime += Clock::now() - summariseStart;
+                queryCells += summary.cells;
+
+                // the most common material other than empty space
+                queryMaterial = 1;
+                for (size_t m = 2; m < summary.counts.size(); m++) {
+                    if (summary.counts[m] > summary.counts[queryMaterial]) queryMaterial = (MaterialID)m;
+                }
+                const Clock::time_point countStart = Clock::now();
+                regions.countMaterial(queryX0, queryY0, x1, y1, queryMaterial);
+                countTime += Clock::now() - countStart;
+
+                int hotX, hotY;
+                float hottest;
+                const Clock::time_point hottestStart = Clock::now();
+                regions.findHottest(queryX0, queryY0, x1, y1, hotX, hotY, hottest);
+                hottestTime += Clock::now() - hottestStart;
+            }
+        }
+
+        // a run no longer than the warm-up has no steady state to check
+        steadyAllocations = config.ticks > steadyTick ? getAllocationCount() - steadyAllocations : 0;
+        if (steadyAllocations != 0) {
+            spdlog::error("{}: {} allocations in the steady state", scenario.name, steadyAllocations);
+            failed = true;
+        }
+
+        const double seconds = std::chrono::duration<double>(elapsed).count();
+        const double ticks = (double)config.ticks;
+        const FrameArenaStats arena = simulation.getFrameArenaStats();
+        const SlabPoolStats cellPool = world.getCellPool().getStats();
+        spdlog::info("{}: {} ticks in {:.3f} s", scenario.name, config.ticks, seconds);
+
+        std::string debrisReport;
+        if (scenario.debris) {
+            const DebrisStats& stats = debris.getStats();
+            if (debrisOverworkTicks != 0) {
+                spdlog::error("{}: the debris grid rebuilt more clusters than cells changed on {} ticks", scenario.name, debrisOverworkTicks);
+                failed = true;
+            }
+            debrisReport = fmt::format("\"debris_cells_scanned_per_tick\": {:.1f}, \"debris_cells_changed\": {}, \"debris_bodies_detached\": {}, "
+                "\"debris_cells_detached\": {}, \"debris_bodies_landed\": {}, \"debris_cells_landed\": {}, \"debris_cells_moved\": {}, "
+                "\"debris_clusters_rebuilt\": {}, ",
+                stats.cellsScanned / ticks, stats.cellsChanged, stats.bodiesDetached, stats.cellsDetached, stats.bodiesLanded, stats.cellsLanded,
+                stats.cellsMoved, stats.clustersRebuilt);
+        }
+        std::string gasReport;
+        if (scenario.gasField) {
+            const GasStats stats = gas.getStats();
+            double amount = 0.0;
+            for (int s = 0; s < gas.getSpeciesCount(); s++) amount += gas.getTotalAmount(s);
+            gasReport = fmt::format("\"gas_chunks_stepped\": {}, \"gas_cells_absorbed\": {}, \"gas_cells_emitted\": {}, \"gas_amount\": {:.1f}, ",
+                stats.chunksStepped, stats.cellsAbsorbed, stats.cellsEmitted, amount);
+        }
+
+        std::string regionReport;
+        if (config.regionQueries) {
+            // the last tick's queries again, against a read of every cell
+            const int x1 = queryX0 + queryWidth;
+            const int y1 = queryY0 + queryHeight;
+            const Clock::time_point scanStart = Clock::now();
+            const RegionScan scan = scanRegion(world, queryX0, queryY0, x1, y1, queryMaterial);
+            const double scanSeconds = secondsSince(scanStart);
+            int hotX, hotY;
+            float hottest = 0.0f;
+            const bool found = regions.findHottest(queryX0, queryY0, x1, y1, hotX, hotY, hottest);
+            if (scan.count != regions.countMaterial(queryX0, queryY0, x1, y1, queryMaterial) || (found && scan.hottest != hottest)) {
+                spdlog::error("{}: region queries don't match a scan of the cells", scenario.name);
+                failed = true;
+            }
+
+            const auto micros = [ticks](Clock::duration total) { return std::chrono::duration<double>(total).count() * 1e6 / ticks; };
+            regionReport = fmt::format("\"region_update_ms_per_tick\": {:.4f}, \"region_chunks_updated_per_tick\": {:.1f}, "
+                "\"region_blocks_counted_per_tick\": {:.1f}, \"region_query_cells\": {:.0f}, \"region_summarise_us\": {:.2f}, "
+                "\"region_count_us\": {:.2f}, \"region_hottest_us\": {:.2f}, \"region_scan_us\": {:.2f}, ",
+                micros(regionUpdate) / 1e3, regionChunks / ticks, regionBlocks / ticks, queryCells / ticks,
+                micros(summariseTime), micros(countTime), micros(hottestTime), scanSeconds * 1e6);
+        }
+
+        return fmt::format(
+            "    {{\"name\": \"{}\", \"width\": {}, \"height\": {}, \"chunks\": {}, \"ticks\": {}, \"startup_seconds\": {:.6f}, {}\"seconds\": {:.6f}, "
+            "\"ticks_per_sec\": {:.3f}, \"active_cells_per_tick\": {:.1f}, \"ns_per_active_cell\": {:.3f}, "
+            "\"max_awake_chunks\": {}, \"final_awake_chunks\": {}, \"allocations_per_tick\": {:.3f}, \"allocated_bytes_per_tick\": {:.1f}, "
+            "\"steady_state_allocations\": {}, \"arena_bytes_per_tick\": {:.1f}, \"arena_peak_bytes\": {}, \"arena_block_allocations\": {}, "
+            "\"cell_pool_slabs\": {}, {}{}{}\"peak_rss_bytes\": {}, \"checksum\": \"{:016x}\"}}",
+            scenario.name, scenario.width, scenario.height, world.getChunkCount(), config.ticks, startupSeconds, generatorReport, seconds,
+            ticks / seconds, activeCells / ticks, activeCells != 0 ? seconds * 1e9 / activeCells : 0.0,
+            maxAwake, world.getAwakeChunkCount(), (getAllocationCount() - allocations) / ticks, (getAllocatedBytes() - allocatedBytes) / ticks,
+            steadyAllocations, arena.bytesAllocated / ticks, arena.peakBytes, arena.blockAllocations,
+            cellPool.slabAllocations, debrisReport, gasReport, regionReport, getPeakRSS(), checksum(world));
+    }
+
+    // one chunk diffused over and over per instruction set, every cell near a threshold so the
+    // flagging path is exercised too
+    std::string runHeatKernels(const BenchConfig& config, const MaterialTable& materials) {
+        std::unique_ptr<ChunkCells> cells(new ChunkCells);
+        float halo[EdgeCount][CHUNK_SIZE];
+        for (int i = 0; i < CHUNK_SIZE; i++) {
+            halo[EdgeLeft][i] = 900.0f;
+            halo[EdgeRight][i] = 20.0f;
+            halo[EdgeDown][i] = 1300.0f;
+            halo[EdgeUp][i] = -10.0f;
+        }
+        const HeatHalo heatHalo{halo[EdgeLeft], halo[EdgeRight], halo[EdgeDown], halo[EdgeUp]};
+
+        std::string results;
+        for (int isa = 0; isa < HeatKernelISACount; isa++) {
+            if (!HeatKernel::isSupported((HeatKernelISA)isa)) continue;
+            const HeatKernel kernel((HeatKernelISA)isa);
+
+            for (int i = 0; i < CHUNK_CELLS; i++) {
+                cells->material[i] = (MaterialID)(i % materials.getCount());
+                cells->temperature[i] = (float)(i % 97) * 10.0f;
+                cells->flags[i] = 0;
+            }
+
+            const Clock::time_point start = Clock::now();
+            for (int step = 0; step < config.kernelSteps; step++) {
+                kernel.step(cells->temperature, cells->material, cells->flags, heatHalo,
+                    materials.getUpperThresholds(), materials.getLowerThresholds(), 0.2f);
+            }
+            const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+            if (!results.empty()) results += ",\n";
+            results += fmt::format("    {{\"isa\": \"{}\", \"steps\": {}, \"seconds\": {:.6f}, \"mcells_per_sec\": {:.1f}}}",
+                HeatKernel::getISAName((HeatKernelISA)isa), config.kernelSteps, seconds, (double)config.kernelSteps * CHUNK_CELLS / seconds / 1e6);
+        }
+        return results;
+    }
+
+    // vertices per frame in the upload benchmark, 1 MiB of Color data
+    constexpr GLuint UPLOAD_VERTICES = 1 << 16;
+
+    // the frame's particle data, written straight into wherever the path wants it
+    void fillVertices(float* out, int frame) {
+        for (GLuint i = 0; i < UPLOAD_VERTICES * 4; i++) out[i] = (float)((i + frame) & 1023);
+    }
+
+    // Per frame vertex uploads through the stream ring (written in place, and staged through
+    // pushToBuffer), against a full glBufferData and a glBufferSubData of the whole range. The GL
+    // calls go to GlStub's host memory, so this times what the engine does on the CPU for each
+    // path (copies, fences, bookkeeping), not a driver.
+    std::string runUploads(const BenchConfig& config) {
+        GlStub::install();
+        const double frameBytes = UPLOAD_VERTICES * 4 * sizeof(GLfloat);
+        std::vector<float> scratch(UPLOAD_VERTICES * 4);
+
+        std::string results;
+        const auto report = [&](const char* path, Clock::time_point start, size_t uploads) {
+            const double seconds = secondsSince(start);
+            if (!results.empty()) results += ",\n";
+            results += fmt::format("    {{\"path\": \"{}\", \"seconds\": {:.6f}, \"mb_per_sec\": {:.1f}, \"gl_uploads_per_frame\": {:.2f}}}",
+                path, seconds, frameBytes * config.uploadFrames / seconds / 1e6, (double)uploads / config.uploadFrames);
+        };
+
+        {
+            VertexDataBuffer<Color, Draw, Stream> buffer;
+            buffer.reserveStream(UPLOAD_VERTICES);
+            const Clock::time_point start = Clock::now();
+            for (int frame = 0; frame < config.uploadFrames; frame++) {
+                fillVertices(buffer.beginStreamWrite(), frame);
+                buffer.fenceStream();
+            }
+            report("stream_ring", start, 0);
+        }
+        {
+            VertexDataBuffer<Color, Draw, Stream> buffer;
+            buffer.reserveStream(UPLOAD_VERTICES);
+            for (GLuint i = 0; i < UPLOAD_VERTICES; i++) buffer.pushVertex(0.0f, 0.0f, 0.0f, 0.0f);
+            const Clock::time_point start = Clock::now();
+            for (int frame = 0; frame < config.uploadFrames; frame++) {
+                fillVertices(scratch.data(), frame);
+                buffer.editValues(0, UPLOAD_VERTICES * 4, scratch.data());
+                buffer.pushToBuffer(true);
+                buffer.fenceStream();
+            }
+            report("stream_staged", start, 0);
+        }
+        {
+            VertexDataBuffer<Color, Draw, Dynamic> buffer;
+            size_t uploads = 0;
+            const Clock::time_point start = Clock::now();
+            for (int frame = 0; frame < config.uploadFrames; frame++) {
+                fillVertices(scratch.data(), frame);
+                buffer.clear();
+                for (GLuint i = 0; i < UPLOAD_VERTICES; i++) buffer.pushVertex(&scratch[i * 4]);
+                buffer.pushToBuffer(true);
+                uploads += GlStub::getUploads().size();
+                GlStub::clearUploads();
+            }
+            report("buffer_data", start, uploads);
+        }
+        {
+            VertexDataBuffer<Color, Draw, Dynamic> buffer;
+            for (GLuint i = 0; i < UPLOAD_VERTICES; i++) buffer.pushVertex(0.0f, 0.0f, 0.0f, 0.0f);
+            buffer.pushToBuffer(true);
+            GlStub::clearUploads();
+            size_t uploads = 0;
+            const Clock::time_point start = Clock::now();
+            for (int frame = 0; frame < config.uploadFrames; frame++) {
+                fillVertices(scratch.data(), frame);
+                buffer.editValues(0, UPLOAD_VERTICES * 4, scratch.data());
+                buffer.pushToBuffer(true);
+                uploads += GlStub::getUploads().size();
+                GlStub::clearUploads();
+            }
+            report("buffer_sub_data", start, uploads);
+        }
+        GlStub::reset();
+        return results;
+    }
+
+    // The same scenario on pools of 1, 2, 4 and 8 threads, with every chunk kept awake so the whole
+    // map is simulated each tick however much of it has settled. Every run must end in the same
+    // world, so the checksums double as a determinism check; failed is set when they don't.
+    std::string runScaling(const BenchConfig& config, const Scenario& scenario, const MaterialTable& materials, bool& failed) {
+        static constexpr unsigned THREAD_COUNTS[] = {1, 2, 4, 8};
+
+        std::string results;
+        double baseline = 0.0;
+        uint64_t baselineChecksum = 0;
+        for (unsigned threads : THREAD_COUNTS) {
+            std::unique_ptr<ThreadPool> pool;
+            if (threads > 1) pool.reset(new ThreadPool(threads));
+
+            World world;
+            Simulation simulation(world, materials, config.seed, pool.get());
+            buildWorld(scenario, world, simulation, materials, config.seed, pool.get());
+            DebrisTracker debris(world, materials);
+            if (scenario.debris) {
+                debris.setRegion(0, 0);
+                simulation.setDebrisTracker(&debris);
+            }
+            GasField gas(world, materials, config.seed, pool.get());
+            if (scenario.gasField) simulation.setGasField(&gas);
+
+            uint64_t awakeChunks = 0;
+            const Clock::time_point start = Clock::now();
+            for (uint64_t tick = 0; tick < config.ticks; tick++) {
+                awakeChunks += world.getAwakeChunkCount();
+                for (Chunk* chunk : world.getChunks()) chunk->markAllDirty();
+                simulation.step();
+            }
+            const double ticksPerSecond = config.ticks / secondsSince(start);
+            const double awakeFraction = (double)awakeChunks / ((double)config.ticks * world.getChunkCount());
+
+            const uint64_t hash = checksum(world);
+            if (threads == 1) {
+                baseline = ticksPerSecond;
+                baselineChecksum = hash;
+            } else if (hash != baselineChecksum) {
+                spdlog::error("{} ends in a different world on {} threads than on one", scenario.name, threads);
+                failed = true;
+            }
+
+            if (!results.empty()) results += ",\n";
+            results += fmt::format("    {{\"threads\": {}, \"ticks_per_sec\": {:.3f}, \"speedup\": {:.3f}, \"awake_fraction\": {:.3f}, \"checksum\": \"{:016x}\"}}",
+                threads, ticksPerSecond, ticksPerSecond / baseline, awakeFraction, hash);
+        }
+        return results;
+    }
+
+    void printUsage() {
+        std::fprintf(stderr, "Bench [--ticks N] [--warmup N] [--threads N] [--seed N] [--scenario NAME]... [--kernel-steps N] [--no-kernels]\n"
+            "      [--upload-frames N] [--no-uploads] [--no-region-queries] [--no-scaling] [--scaling-scenario NAME] [--materials PATH] [--output PATH] [--profile PATH] [--list]\n");
+    }
+}
+
+int main(int argc, char** argv) {
+    // stdout carries the JSON report, logging goes to stderr
+    spdlog::set_default_logger(spdlog::stderr_color_mt("bench"));
+
+    BenchConfig config;
+    for (int i = 1; i < argc; i++) {
+        const bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--ticks") == 0 && hasValue) config.ticks = std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--warmup") == 0 && hasValue) config.warmupTicks = std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--threads") == 0 && hasValue) config.threads = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--seed") == 0 && hasValue) config.seed = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--kernel-steps") == 0 && hasValue) config.kernelSteps = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--no-kernels") == 0) config.kernels = false;
+        else if (std::strcmp(argv[i], "--upload-frames") == 0 && hasValue) config.uploadFrames = std::max(std::atoi(argv[++i]), 1);
+        else if (std::strcmp(argv[i], "--no-uploads") == 0) config.uploads = false;
+        else if (std::strcmp(argv[i], "--no-region-queries") == 0) config.regionQueries = false;
+        else if (std::strcmp(argv[i], "--no-scaling") == 0) config.scaling = false;
+        else if (std::strcmp(argv[i], "--scaling-scenario") == 0 && hasValue) config.scalingScenario = argv[++i];
+        else if (std::strcmp(argv[i], "--materials") == 0 && hasValue) config.materialsPath = argv[++i];
+        else if (std::strcmp(argv[i], "--output") == 0 && hasValue) config.outputPath = argv[++i];
+        else if (std::strcmp(argv[i], "--profile") == 0 && hasValue) config.profilePath = argv[++i];
+        else if (std::strcmp(argv[i], "--scenario") == 0 && hasValue) {
+            const Scenario* scenario = findScenario(argv[++i]);
+            if (!scenario) {
+                spdlog::error("Unknown scenario {}, see --list", argv[i]);
+                return 1;
+            }
+            config.scenarios.push_back(scenario);
+        } else if (std::strcmp(argv[i], "--list") == 0) {
+            for (const Scenario& scenario : getScenarios()) std::printf("%-16s %s\n", scenario.name, scenario.description);
+            return 0;
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+    if (config.ticks == 0) config.ticks = 1;
+    if (config.scenarios.empty()) {
+        for (const Scenario& scenario : getScenarios()) config.scenarios.push_back(&scenario);
+    }
+
+    const Scenario* scalingScenario = findScenario(config.scalingScenario);
+    if (config.scaling && !scalingScenario) {
+        spdlog::error("Unknown scenario {}, see --list", config.scalingScenario);
+        return 1;
+    }
+
+    MaterialTable materials;
+    if (!materials.loadFromFile(config.materialsPath)) return 1;
+
+    const bool profiling = !config.profilePath.empty();
+    Profiler::setEnabled(profiling);
+    PROFILE_THREAD("bench");
+    const Clock::time_point start = Clock::now();
+
+    std::unique_ptr<ThreadPool> pool;
+    if (config.threads > 1) pool.reset(new ThreadPool(config.threads));
+
+    std::string report = fmt::format("{{\n  \"seed\": {},\n  \"threads\": {},\n  \"ticks\": {},\n  \"warmup_ticks\": {},\n  \"heat_kernel\": \"{}\",\n  \"scenarios\": [\n",
+        config.seed, std::max(config.threads, 1u), config.ticks, config.warmupTicks, HeatKernel::getISAName(HeatKernel::detectISA()));
+    bool failed = false;
+    for (size_t i = 0; i < config.scenarios.size(); i++) {
+        report += runScenario(config, *config.scenarios[i], materials, pool.get(), failed);
+        report += i + 1 < config.scenarios.size() ? ",\n" : "\n";
+    }
+    report += "  ]";
+    if (profiling) {
+        Profiler::setEnabled(false);
+        Profiler::logSummary(secondsSince(start));
+        Profiler::writeChromeTrace(config.profilePath);
+        report += fmt::format(",\n  \"profile_events\": {}", Profiler::getEventCount());
+    }
+    if (config.kernels) report += ",\n  \"heat_kernels\": [\n" + runHeatKernels(config, materials) + "\n  ]";
+    if (config.uploads) {
+        report += fmt::format(",\n  \"buffer_uploads\": {{\"gl\": \"host memory stub\", \"vertices\": {}, \"frames\": {}, \"results\": [\n{}\n  ]}}",
+            UPLOAD_VERTICES, config.uploadFrames, runUploads(config));
+    }
+    if (config.scaling) {
+        report += fmt::format(",\n  \"thread_scaling\": {{\"scenario\": \"{}\", \"hardware_threads\": {}, \"results\": [\n{}\n  ]}}",
+            scalingScenario->name, std::thread::hardware_concurrency(), runScaling(config, *scalingScenario, materials, failed));
+    }
+    report += fmt::format(",\n  \"peak_rss_bytes\": {}\n}}\n", getPeakRSS());
+
+    if (config.outputPath.empty()) {
+        std::fputs(report.c_str(), stdout);
+    } else {
+        FILE* file = std::fopen(config.outputPath.c_str(), "w");
+        if (!file) {
+            spdlog::error("Could not open {} for writing", config.outputPath);
+            return 1;
+        }
+        std::fputs(report.c_str(), file);
+        std::fclose(file);
+    }
+    return failed ? 1 : 0;
+}
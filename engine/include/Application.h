@@ -1,6 +1,162 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "ChunkDelta.h"
+#include "ChunkRenderer.h"
+#include "DebrisTracker.h"
+#include "DebugHud.h"
+#include "GasField.h"
+#include "MaterialTable.h"
+#include "RegionStats.h"
+#include "Replay.h"
+#include "Simulation.h"
+#include "TextOverlay.h"
+#include "ThreadPool.h"
+#include "TripleBuffer.h"
+#include "World.h"
+#include "WorldGenerator.h"
+#include "WorldSnapshot.h"
+
+struct GLFWwindow;
+
+struct ApplicationConfig {
+	std::string title = "Chemmodities";
+	int windowWidth = 900;
+	int windowHeight = 900;
+
+	bool headless = false;  // no window or renderer, ticks run back to back as fast as possible
+	bool visible = true;    // false renders into a hidden window without vsync, for measuring frame times
+
+	double tickRate = 60.0;   // simulation ticks per second, ignored when headless
+	uint64_t maxTicks = 0;    // stop after this many ticks, 0 runs until the window is closed
+	unsigned int threads = 0; // simulation threads, 0 for one per hardware thread
+	uint32_t seed = 1;
+
+	std::string materialsPath = "res/materials.txt";
+
+	// world area covered by the default view, in cells
+	int worldWidth = 2048;
+	int worldHeight = 2048;
+
+	// fill the world from the seed instead of leaving it to the caller, streamed in around the view
+	bool generateWorld = false;
+	WorldGeneratorSettings generator;
+
+	bool debris = true; // unsupported solids fall as bodies, tracked over a window centred on the bottom of the world
+	bool gasField = true; // field gases (steam, smoke) move in a coarse GasField instead of as cells
+	bool regionStats = false; // keep per-chunk material counts and temperature ranges for region queries
+
+	bool profile = false;                  // record PROFILE_SCOPEs from the start, F10 toggles it while running
+	double profileSummaryInterval = 5.0;   // seconds between p50/p99 summaries in the log while profiling, 0 for none
+	std::string profileTracePath = "profile.json"; // Chrome trace written on F9, and on exit while profiling
+
+	std::string recordPath;  // record the run's settings and input events here for a replay, empty for none
+	// play a recording back instead of building a scene: runs headless, with the seed, world size,
+	// generateWorld, debris and gasField of the recording, and checks every tick against it
+	std::string replayPath;
+	std::string deltaPath;   // per-tick chunk deltas to this file, or to a local socket as "unix:<path>"
+
+	ChunkRenderMode renderMode = RenderTexture;
+	bool textures = true;          // draw the material textures from one atlas, colours only when false
+	bool compressTextures = false; // BC3 atlas, when the driver has S3TC
+	std::string textureCachePath = "atlas.cache"; // packed atlas reused while the textures don't change, empty for none
+	size_t uploadBudget = ChunkRenderer::DEFAULT_UPLOAD_BUDGET;
+
+	bool hud = true;            // debug text over the world, F3 toggles it
+	std::string hudFontPath;    // TrueType font for the HUD, empty for the built-in one
+	float hudFontSize = 16.0f;  // pixels, for a TrueType font
+	bool hudTimings = true;     // false leaves wall-clock times off the HUD, so its image only depends on the run
+	std::string hudImagePath;   // headless: the world and HUD as they end up, written here as a PNG
+};
+
+// Owns the world and runs it. The simulation ticks at a fixed rate on its own thread, one tick
+// ahead of the renderer: after every tick it captures a WorldSnapshot and hands it over through
+// a lock-free triple buffer, so the main thread only ever draws finished ticks and a slow frame
+// never holds up the simulation (nor a slow tick the frame).
 class Application {
+private:
+	static constexpr int MAX_CATCH_UP_TICKS = 5;
+	// generated before the first tick, nearest the centre of the view; the rest follows in
+	// GENERATE_CHUNKS_PER_TICK batches so the first frame never waits for the whole view
+	static constexpr size_t GENERATE_CHUNKS_AT_START = 64;
+	static constexpr size_t GENERATE_CHUNKS_PER_TICK = 32;
+
+	ApplicationConfig m_Config;
+
+	MaterialTable m_Materials;
+	World m_World;
+	std::unique_ptr<ThreadPool> m_Pool;
+	std::unique_ptr<Simulation> m_Simulation;
+	std::unique_ptr<DebrisTracker> m_Debris;
+	std::unique_ptr<GasField> m_Gas;
+	std::unique_ptr<RegionStats> m_Regions;
+	std::unique_ptr<WorldGenerator> m_Generator;
+
+	// the encoder runs when recording, replaying or streaming deltas, its frame hash checks replays
+	std::unique_ptr<ChunkDeltaEncoder> m_Encoder;
+	std::unique_ptr<DeltaStream> m_Deltas;
+	std::unique_ptr<ReplayRecorder> m_Recorder;
+	std::unique_ptr<ReplayPlayer> m_Player;
+
+	TripleBuffer<WorldSnapshot> m_Snapshots;
+	std::atomic<bool> m_Running{false};
+
+	// written by the simulation thread after every tick, for the HUD
+	std::atomic<uint64_t> m_TickNanoseconds{0};
+	std::atomic<size_t> m_AwakeChunks{0};
+
+	std::unique_ptr<DebugHud> m_Hud;
+	TextOverlay m_Text;
+
+	GLFWwindow* m_Window = nullptr;
+	std::chrono::steady_clock::time_point m_LastProfileSummary;
+
+	bool createWindow();
+	void destroyWindow();
+
+	size_t generateView(size_t maxChunks);
+	bool beginTick();
+	void endTick();
+	void simulate();
+	void reportProfile(bool final);
+	void buildHud(const WorldSnapshot& snapshot, double frameSeconds);
+	bool writeHudImage();
+	int runHeadless();
+	int runWindowed();
 public:
-	Application();
-};
\ No newline at end of file
+	Application(const ApplicationConfig& config = ApplicationConfig());
+	~Application();
+
+	Application(const Application&) = delete;
+	Application& operator=(const Application&) = delete;
+
+	// Loads the materials and sets up the simulation. Fill the world after this and before run(),
+	// unless it is generated.
+	bool init();
+
+	// Runs until the window is closed or maxTicks ticks have run, returns the process exit code.
+	int run();
+	// Asks run() to return, safe to call from any thread.
+	inline void stop() { m_Running.store(false, std::memory_order_relaxed); }
+
+	inline const ApplicationConfig& getConfig() const { return m_Config; }
+	inline const MaterialTable& getMaterials() const { return m_Materials; }
+	inline World& getWorld() { return m_World; }
+	inline Simulation& getSimulation() { return *m_Simulation; }
+	// nullptr unless generateWorld is set
+	inline WorldGenerator* getGenerator() { return m_Generator.get(); }
+	// nullptr when debris is turned off
+	inline DebrisTracker* getDebrisTracker() { return m_Debris.get(); }
+	// nullptr when the gas field is turned off
+	inline GasField* getGasField() { return m_Gas.get(); }
+	// nullptr unless regionStats is set; queries belong on the simulation thread, between ticks
+	inline RegionStats* getRegionStats() { return m_Regions.get(); }
+	// the world is then filled from the recording, the caller leaves it alone
+	inline bool isReplaying() const { return m_Player != nullptr; }
+};
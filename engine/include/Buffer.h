@@ -0,0 +1,874 @@
+#pragma once
+#include <type_traits>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+
+#include <glad/glad.h>
+#include <spdlog/spdlog.h>
+
+#include "Profiler.h"
+
+// Buffer tracing (binds, dirty marks, upload sizes) is a compile time switch, it is far too chatty to
+// leave in the per-edit paths. Defaults to on in debug builds and compiles to nothing with NDEBUG;
+// define BUFFER_TRACE_ENABLED to 0 or 1 to override. Output goes to spdlog at trace level.
+#ifndef BUFFER_TRACE_ENABLED
+    #ifdef NDEBUG
+        #define BUFFER_TRACE_ENABLED 0
+    #else
+        #define BUFFER_TRACE_ENABLED 1
+    #endif
+#endif
+
+#if BUFFER_TRACE_ENABLED
+    #define BUFFER_TRACE(...) spdlog::trace(__VA_ARGS__)
+#else
+    #define BUFFER_TRACE(...) ((void)0)
+#endif
+
+// the message arguments are only evaluated and formatted once the condition has failed
+#define BUFFER_ASSERT(condition, ...) \
+    do { \
+        if (!(condition)) { \
+            spdlog::critical("Buffer assertion '{}' failed: {}", #condition, fmt::format(__VA_ARGS__)); \
+            std::abort(); \
+        } \
+    } while (false)
+
+
+enum VertexDataType {
+    Position = 3, Color = 4, Texture = 2, Normal = 3, Custom = 1
+};
+
+enum VertBufTargetAction {
+    Draw = 0x0, Copy = 0x2, Read = 0x1
+};
+
+enum VertBufIOMode {
+    Static = 0x4, Dynamic = 0x8, Stream = 0x0
+};
+
+enum PrimitiveType {
+    Points = 1,
+    Lines = 2,
+    Triangles = 3,
+    Other = 0
+};
+
+unsigned int formMode(VertBufTargetAction action, VertBufIOMode iomode);
+
+struct BufferUploadStats {
+    size_t uploads = 0;       // glBufferData + glBufferSubData calls
+    size_t bytesUploaded = 0;
+    size_t bytesChanged = 0;  // bytes actually edited, uploaded minus this is what merging cost
+};
+
+// Sorted set of disjoint dirty [start, end) element ranges. Ranges stay exact while edits come in,
+// flush() then joins ranges separated by at most the merge gap, so scattered edits turn into a few
+// uploads without re-sending everything between the two ends of the buffer.
+class DirtyRangeSet {
+public:
+    struct Range {
+        size_t start;
+        size_t end;
+    };
+private:
+    std::vector<Range> m_Ranges;
+    size_t m_MergeGap = 64;
+public:
+    void add(size_t start, size_t end);
+    void clear();
+
+    inline bool empty() const { return m_Ranges.empty(); }
+    size_t getDirtyCount() const;
+
+    inline void setMergeGap(size_t elements) { m_MergeGap = elements; }
+    inline size_t getMergeGap() const { return m_MergeGap; }
+    inline const std::vector<Range>& getRanges() const { return m_Ranges; }
+
+    // calls upload(start, end) once per merged range and clears the set
+    template<typename F> void flush(F&& upload) {
+        size_t i = 0;
+        while (i < m_Ranges.size()) {
+            Range merged = m_Ranges[i++];
+            while (i < m_Ranges.size() && m_Ranges[i].start - merged.end <= m_MergeGap) merged.end = m_Ranges[i++].end;
+            upload(merged.start, merged.end);
+        }
+        m_Ranges.clear();
+    }
+};
+
+template <PrimitiveType T>
+class IndexBuffer;
+
+
+template<VertexDataType T,VertBufTargetAction A,VertBufIOMode IO>
+class VertexDataBuffer {
+private:
+    GLuint m_BufferID;
+    const GLuint m_Elements;
+    std::vector<float> m_BufferData;
+
+    DirtyRangeSet m_DirtyRanges;
+    BufferUploadStats m_Stats;
+
+
+    bool m_Dirty = true;
+    bool m_NeedsResize = true;
+
+    // Stream mode (IO == Stream) keeps the data in a ring of STREAM_SEGMENTS persistently mapped
+    // regions instead of a glBufferData store. The CPU fills one region while the GPU still reads
+    // the others, and a fence per region stops it from writing over data a draw hasn't consumed.
+    static constexpr unsigned int STREAM_SEGMENTS = 3;
+
+    float* m_StreamMemory = nullptr;
+    size_t m_SegmentCapacity = 0; // in floats
+    unsigned int m_Segment = 0;
+    GLsync m_StreamFences[STREAM_SEGMENTS] = {};
+
+    // the width of every type but Custom is known at compile time, so a wrong-arity push is a compile error
+    template<GLuint N> void checkArity() {
+        static_assert(T == VertexDataType::Custom || static_cast<GLuint>(T) == N, "Wrong number of values for this vertex data type");
+        if constexpr (T == VertexDataType::Custom) {
+            BUFFER_ASSERT(m_Elements == N, "Buffer doesn't support {}-element vertex data. Size: {}", N, m_Elements);
+        }
+    }
+public:
+
+    VertexDataBuffer();
+    VertexDataBuffer(const GLuint elements);
+    ~VertexDataBuffer();
+
+    VertexDataBuffer(const VertexDataBuffer&) = delete;
+    VertexDataBuffer& operator=(const VertexDataBuffer&) = delete;
+
+    void init();
+    void pushToBuffer(bool unbindAfter);
+
+    void markDirty();
+    bool isDirty();
+
+    inline void setMergeGap(size_t elements) { m_DirtyRanges.setMergeGap(elements); };
+    inline const BufferUploadStats& getUploadStats() { return m_Stats; };
+    inline void resetUploadStats() { m_Stats = BufferUploadStats(); };
+
+    constexpr GLuint getElementsPerVertex();
+    GLuint getVertexCount();
+
+    GLuint getElementCount();
+    void clear();
+
+    void pushVertex(float x, float y, float z, float w);
+    void pushVertex(float x, float y, float z);
+    void pushVertex(float x, float y);
+    void pushVertex(float x);
+    void pushVertex(float* vert);
+
+    void editVertex(unsigned int id, float x, float y, float z, float w);
+    void editVertex(unsigned int id, float x, float y, float z);
+    void editVertex(unsigned int id, float x, float y);
+    void editVertex(unsigned int id, float x);
+    
+    void editValue(unsigned int id, float value);
+    void editValues(unsigned int start, unsigned int end, float* values);
+
+    void bind();
+    void unbind();
+
+    // Stream mode only. reserveStream replaces the buffer object (immutable storage can't be
+    // resized), so attach the buffer to a vertex array after reserving. pushToBuffer never
+    // reserves by itself, it logs an error and drops data that doesn't fit a segment.
+    void reserveStream(GLuint vertices);
+    // Waits until the GPU is done with the current segment and returns it for writing.
+    float* beginStreamWrite();
+    // First vertex of the current segment, pass to glDrawArrays.
+    GLint getStreamFirstVertex();
+    // Call after the draw that reads the current segment, moves on to the next one.
+    void fenceStream();
+
+    constexpr GLenum getMode()  { return 0x88E0 + static_cast<int>(A) + static_cast<int>(IO); };
+    
+};
+
+// Attribute layout of an interleaved vertex, e.g. VertexLayout<Position, Color, Texture> is
+// x y z r g b a u v per vertex. Stride and offsets are worked out at compile time.
+template<VertexDataType... Attrs>
+struct VertexLayout {
+    static_assert(sizeof...(Attrs) > 0, "A vertex layout needs at least one attribute");
+
+    static constexpr GLuint ATTRIBUTE_COUNT = sizeof...(Attrs);
+    static constexpr GLuint SIZES[ATTRIBUTE_COUNT] = { static_cast<GLuint>(Attrs)... };
+    static constexpr GLuint FLOATS_PER_VERTEX = (static_cast<GLuint>(Attrs) + ...);
+    static constexpr GLuint STRIDE = FLOATS_PER_VERTEX * sizeof(GLfloat);
+
+    static constexpr GLuint getSize(GLuint attribute) { return SIZES[attribute]; }
+    // in floats, multiply by sizeof(GLfloat) for the byte offset
+    static constexpr GLuint getOffset(GLuint attribute) {
+        GLuint offset = 0;
+        for (GLuint i = 0; i < attribute; i++) offset += SIZES[i];
+        return offset;
+    }
+};
+
+// One buffer holding every attribute of a mesh, laid out by a VertexLayout. Attach it to a vertex
+// array with VertexArray::attachLayout, which binds it once for all of its attributes.
+template<typename Layout, VertBufTargetAction A, VertBufIOMode IO>
+class InterleavedBuffer {
+private:
+    GLuint m_BufferID;
+    std::vector<float> m_BufferData;
+
+    DirtyRangeSet m_DirtyRanges;
+    BufferUploadStats m_Stats;
+
+    bool m_Dirty = true;
+    bool m_NeedsResize = true;
+public:
+    static constexpr GLuint FLOATS_PER_VERTEX = Layout::FLOATS_PER_VERTEX;
+
+    InterleavedBuffer();
+    ~InterleavedBuffer();
+
+    InterleavedBuffer(const InterleavedBuffer&) = delete;
+    InterleavedBuffer& operator=(const InterleavedBuffer&) = delete;
+
+    void pushToBuffer();
+
+    inline void markDirty() { m_Dirty = true; };
+    inline bool isDirty() { return m_Dirty; };
+
+    inline void setMergeGap(size_t elements) { m_DirtyRanges.setMergeGap(elements); };
+    inline const BufferUploadStats& getUploadStats() { return m_Stats; };
+    inline void resetUploadStats() { m_Stats = BufferUploadStats(); };
+
+    inline GLuint getBufferID() { return m_BufferID; };
+    inline GLuint getVertexCount() { return (GLuint)(m_BufferData.size() / FLOATS_PER_VERTEX); };
+    inline void reserve(GLuint vertices) { m_BufferData.reserve(vertices * FLOATS_PER_VERTEX); };
+    void clear();
+
+    // every attribute of the vertex in layout order
+    template<typename... V> void pushVertex(V... values);
+    template<typename... V> void editVertex(GLuint id, V... values);
+    // just one attribute of an existing vertex
+    template<GLuint Attribute, typename... V> void editAttribute(GLuint id, V... values);
+
+    constexpr GLenum getMode()  { return 0x88E0 + static_cast<int>(A) + static_cast<int>(IO); };
+};
+
+template <PrimitiveType P>
+class VertexArray {
+private:
+    GLuint m_VertexArrayID;
+    IndexBuffer<P>* m_IndexBuffer;
+public:
+    
+    VertexArray();
+    ~VertexArray();
+
+    VertexArray(const VertexArray&) = delete;
+    VertexArray& operator=(const VertexArray&) = delete;
+
+    template<VertexDataType T,VertBufTargetAction A,VertBufIOMode IO> void attachBuffer(VertexDataBuffer<T,A,IO>* buffer, unsigned int index) {
+        bind();
+        buffer->bind();
+        glVertexAttribPointer(index,buffer->getElementsPerVertex(),GL_FLOAT,GL_FALSE,buffer->getElementsPerVertex() * sizeof(GLfloat),NULL);
+        unbind();
+        buffer->unbind();
+    };
+
+    // Sets up every attribute of the layout, starting at attribute index firstAttribute, all read
+    // from one vertex buffer binding point. Direct state access, nothing is bound.
+    template<typename Layout,VertBufTargetAction A,VertBufIOMode IO> void attachLayout(InterleavedBuffer<Layout,A,IO>* buffer, GLuint firstAttribute = 0, GLuint binding = 0) {
+        glVertexArrayVertexBuffer(m_VertexArrayID, binding, buffer->getBufferID(), 0, Layout::STRIDE);
+        for (GLuint i = 0; i < Layout::ATTRIBUTE_COUNT; i++) {
+            glEnableVertexArrayAttrib(m_VertexArrayID, firstAttribute + i);
+            glVertexArrayAttribFormat(m_VertexArrayID, firstAttribute + i, Layout::getSize(i), GL_FLOAT, GL_FALSE, Layout::getOffset(i) * sizeof(GLfloat));
+            glVertexArrayAttribBinding(m_VertexArrayID, firstAttribute + i, binding);
+        }
+    };
+
+    void enableAttribute(unsigned int index);
+    // attributes attached with attachBuffer use their own index as the binding point
+    void setAttributeDivisor(unsigned int index, unsigned int divisor);
+    void bind();
+    void unbind();
+
+    void bindElementArray(IndexBuffer<P>* buffer);
+};
+
+template <PrimitiveType T>
+class IndexBuffer {
+private:
+    GLuint m_IndexBufferID;
+    std::vector<unsigned int> m_BufferData;
+
+    bool m_Dirty = true;
+    bool m_NeedsResize = true;
+
+    DirtyRangeSet m_DirtyRanges;
+    BufferUploadStats m_Stats;
+
+    const unsigned int m_PrimitiveSize; // 0 for infinite
+    const unsigned int m_Mode;
+
+    friend void VertexArray<T>::bindElementArray(IndexBuffer<T>*);
+public:
+
+    IndexBuffer(const unsigned int primitiveSize,  unsigned int mode);
+    IndexBuffer(const unsigned int mode);
+    ~IndexBuffer();
+
+    IndexBuffer(const IndexBuffer&) = delete;
+    IndexBuffer& operator=(const IndexBuffer&) = delete;
+
+    void init();
+    void pushToBuffer(bool unbindAfter);
+
+    void markDirty();
+    bool isDirty();
+
+    inline void setMergeGap(size_t elements) { m_DirtyRanges.setMergeGap(elements); };
+    inline const BufferUploadStats& getUploadStats() { return m_Stats; };
+    inline void resetUploadStats() { m_Stats = BufferUploadStats(); };
+
+    void bind();
+    void unbind();
+
+    constexpr unsigned int getPrimitiveSize(); 
+
+    void pushIndex(unsigned int ind);
+
+    void editIndex(unsigned int where, unsigned int new_index);
+
+    void pushPrimitive(unsigned int* inds);
+    void editPrimitive(unsigned int where, unsigned int* new_prim);
+
+    void pushIndicies(unsigned int* inds, unsigned int count);
+
+    void removeIndex(unsigned int where);
+    void removePrimitive(unsigned int where);
+
+    inline size_t getSize() { return m_BufferData.size(); };
+};
+
+/* BEGIN TEMPLATE IMPLEMENTATION*/
+
+template<VertexDataType T,VertBufTargetAction A,VertBufIOMode IO>
+VertexDataBuffer<T,A,IO>::VertexDataBuffer() : m_Elements{static_cast<int>(T)} {
+    BUFFER_TRACE("vertex buffer created, {} elements per vertex", static_cast<int>(T));
+    init();
+} 
+
+template<VertexDataType T,VertBufTargetAction A,VertBufIOMode IO>
+VertexDataBuffer<T,A,IO>::VertexDataBuffer(const GLuint elements) : m_Elements{elements} {
+    static_assert(T == VertexDataType::Custom, "Custom vertex sized require VertexDataType::Custom");
+    init();
+}
+
+template<VertexDataType T,VertBufTargetAction A,VertBufIOMode IO>
+VertexDataBuffer<T,A,IO>::~VertexDataBuffer() {
+    for (GLsync fence : m_StreamFences) {
+        if (fence) glDeleteSync(fence);
+    }
+    if (m_StreamMemory) glUnmapNamedBuffer(m_BufferID);
+    glDeleteBuffers(1, &m_BufferID);
+}
+
+template<VertexDataType T,VertBufTargetAction A,VertBufIOMode IO>
+void VertexDataBuffer<T,A,IO>::init() {
+    glGenBuffers(1, &m_BufferID);
+    bind();
+    pushToBuffer(true);
+}
+
+template<VertexDataType T,VertBufTargetAction A,VertBufIOMode IO>
+void VertexDataBuffer<T,A,IO>::pushToBuffer(bool unbindAfter) {
+    if constexpr (IO == VertBufIOMode::Stream) {
+        // the vector is only a staging copy here, beginStreamWrite() skips it entirely
+        if (isDirty() && !m_BufferData.empty()) {
+            PROFILE_SCOPE("VertexDataBuffer flush");
+            // growing would replace the buffer object behind every vertex array it's attached to
+            if (m_BufferData.size() > m_SegmentCapacity) {
+                spdlog::error("Stream buffer {} holds {} vertices per segment, dropped {}. Call reserveStream and attach it again",
+                    m_BufferID, m_SegmentCapacity / getElementsPerVertex(), getVertexCount());
+            } else {
+                std::copy(m_BufferData.begin(), m_BufferData.end(), beginStreamWrite());
+            }
+        }
+        m_Dirty = false;
+        return;
+    }
+
+    if (isDirty()) {
+        PROFILE_SCOPE("VertexDataBuffer flush");
+        bind();
+        if (m_NeedsResize) {
+            BUFFER_TRACE("vertex buffer {} full upload, {} bytes", m_BufferID, m_BufferData.size() * sizeof(GLfloat));
+            glBufferData(GL_ARRAY_BUFFER,m_BufferData.size() * sizeof(GLfloat), m_BufferData.data(),getMode());
+            m_Stats.uploads++;
+            m_Stats.bytesUploaded += m_BufferData.size() * sizeof(GLfloat);
+            m_Stats.bytesChanged += m_BufferData.size() * sizeof(GLfloat);
+            m_DirtyRanges.clear();
+            m_NeedsResize = false;
+        } else {
+            m_Stats.bytesChanged += m_DirtyRanges.getDirtyCount() * sizeof(GLfloat);
+            m_DirtyRanges.flush([this](size_t start, size_t end) {
+                end = std::min(end, m_BufferData.size());
+                if (start >= end) return;
+                BUFFER_TRACE("vertex buffer {} sub upload, offset {} size {}", m_BufferID, start * sizeof(GLfloat), (end - start) * sizeof(GLfloat));
+                glBufferSubData(GL_ARRAY_BUFFER, start * sizeof(GLfloat), (end - start) * sizeof(GLfloat), (const void*)(m_BufferData.data() + start));
+                m_Stats.uploads++;
+                m_Stats.bytesUploaded += (end - start) * sizeof(GLfloat);
+            });
+        }
+        if (unbindAfter) unbind();
+
+        m_Dirty = false;
+    }
+}
+
+template<VertexDataType T,VertBufTargetAction A,VertBufIOMode IO>
+void VertexDataBuffer<T,A,IO>::markDirty() {
+    m_Dirty = true;
+}
+
+template<VertexDataType T,VertBufTargetAction A,VertBufIOMode IO>
+bool VertexDataBuffer<T,A,IO>::isDirty() {
+    return m_Dirty;
+}
+
+template<VertexDataType T,VertBufTargetAction A,VertBufIOMode IO>
+constexpr GLuint VertexDataBuffer<T,A,IO>::getElementsPerVertex() {
+    return m_Elements;
+}
+
+template<VertexDataType T,VertBufTargetAction A,VertBufIOMode IO>
+GLuint VertexDataBuffer<T,A,IO>::getVertexCount() {
+    return getElementCount() / getElementsPerVertex();
+}
+
+template<VertexDataType T,VertBufTargetAction A,VertBufIOMode IO>
+GLuint VertexDataBuffer<T,A,IO>::getElementCount() {
+    return (GLuint)(m_BufferData.size());
+}
+
+template<VertexDataType T,VertBufTargetAction A,VertBufIOMode IO>
+void VertexDataBuffer<T,A,IO>::clear() {
+    m_BufferData.clear();
+    m_DirtyRanges.clear();
+    m_NeedsResize = true;
+    markDirty();
+}
+
+template<VertexDataType T,VertBufTargetAction A,VertBufIOMode IO>
+void VertexDataBuffer<T,A,IO>::pushVertex(float x, float y, float z, float w) {
+    checkArity<4>();
+    m_NeedsResize = true;
+    markDirty();
+    m_BufferData.push_back(x);
+    m_BufferData.push_back(y);
+    m_BufferData.push_back(z);
+    m_BufferData.push_back(w);
+
+}
+
+template<VertexDataType T,VertBufTargetAction A,VertBufIOMode IO>
+void VertexDataBuffer<T,A,IO>::pushVertex(float x, float y, float z) {
+    checkArity<3>();
+    m_NeedsResize = true;
+    markDirty();
+    m_BufferData.push_back(x);
+    m_BufferData.push_back(y);
+    m_BufferData.push_back(z);
+
+}
+
+template<VertexDataType T,VertBufTargetAction A,VertBufIOMode IO>
+void VertexDataBuffer<T,A,IO>::pushVertex(float x, float y) {
+    checkArity<2>();
+    m_NeedsResize = true;
+    markDirty();
+    m_BufferData.push_back(x);
+    m_BufferData.push_back(y);
+}
+
+template<VertexDataType T,VertBufTargetAction A,VertBufIOMode IO>
+void VertexDataBuffer<T,A,IO>::pushVertex(float x) {
+    checkArity<1>();
+    m_NeedsResize = true;
+    markDirty();
+    m_BufferData.push_back(x);
+}
+
+template<VertexDataType T,VertBufTargetAction A,VertBufIOMode IO>
+void VertexDataBuffer<T,A,IO>::pushVertex(float* vert) {
+    BUFFER_ASSERT(vert != nullptr, "Can't push null vertex data to buffer");
+    m_NeedsResize = true;
+    markDirty();
+
+    for (unsigned int i = 0 ; i < m_Elements ; i++) {
+        m_BufferData.push_back(vert[i]);
+    }
+}
+
+template<VertexDataType T,VertBufTargetAction A,VertBufIOMode IO>
+void VertexDataBuffer<T,A,IO>::editVertex(unsigned int id, float x, float y, float z, float w) {
+    checkArity<4>();
+    m_DirtyRanges.add(id*4, id*4 + 4);
+    markDirty();
+
+    m_BufferData[id*4] = x;
+    m_BufferData[id*4+1] = y;
+    m_BufferData[id*4+2] = z;
+    m_BufferData[id*4+3] = w;
+}
+
+template<VertexDataType T,VertBufTargetAction A,VertBufIOMode IO>
+void VertexDataBuffer<T,A,IO>::editVertex(unsigned int id, float x, float y, float z) {
+    checkArity<3>();
+
+    m_DirtyRanges.add(id*3, id*3 + 3);
+    markDirty();
+
+    m_BufferData[id*3] = x;
+    m_BufferData[id*3+1] = y;
+    m_BufferData[id*3+2] = z;
+}
+
+template<VertexDataType T,VertBufTargetAction A,VertBufIOMode IO>
+void VertexDataBuffer<T,A,IO>::editVertex(unsigned int id, float x, float y) {
+    checkArity<2>();
+    m_DirtyRanges.add(id*2, id*2 + 2);
+    markDirty();
+
+    m_BufferData[id*2] = x;
+    m_BufferData[id*2+1] = y;
+}
+
+template<VertexDataType T,VertBufTargetAction A,VertBufIOMode IO>
+void VertexDataBuffer<T,A,IO>::editVertex(unsigned int id, float x) {
+    checkArity<1>();
+
+    m_DirtyRanges.add(id, id + 1);
+    markDirty();
+
+    m_BufferData[id] = x;
+}
+
+template<VertexDataType T,VertBufTargetAction A,VertBufIOMode IO>
+void VertexDataBuffer<T,A,IO>::editValue(unsigned int id, float value) {
+    m_DirtyRanges.add(id, id + 1);
+    markDirty();
+
+    m_BufferData[id] = value;
+}
+
+// end exlusive
+template<VertexDataType T,VertBufTargetAction A,VertBufIOMode IO>
+void VertexDataBuffer<T,A,IO>::editValues(unsigned int start, unsigned int end, float* values) {
+    markDirty();
+
+    if (values == nullptr) {
+        m_NeedsResize = true; // erasing shifts everything after it
+        m_BufferData.erase(m_BufferData.begin() + start, m_BufferData.begin() + end);
+        return;
+    }
+
+    if (end - start == 0) {
+        return; 
+    }
+
+    m_DirtyRanges.add(start, end);
+    if (end - start == 1) { 
+        m_BufferData[start] = values[0]; // only one value
+    } else {
+        std::copy(values, values + (end-start), m_BufferData.begin() + start);
+    }
+}
+
+template<VertexDataType T,VertBufTargetAction A,VertBufIOMode IO>
+void VertexDataBuffer<T,A,IO>::bind() {
+    glBindBuffer(GL_ARRAY_BUFFER,m_BufferID);
+}
+
+template<VertexDataType T,VertBufTargetAction A,VertBufIOMode IO>
+void VertexDataBuffer<T,A,IO>::unbind() {
+    glBindBuffer(GL_ARRAY_BUFFER,0);
+}
+
+template<VertexDataType T,VertBufTargetAction A,VertBufIOMode IO>
+void VertexDataBuffer<T,A,IO>::reserveStream(GLuint vertices) {
+    static_assert(IO == VertBufIOMode::Stream, "reserveStream requires VertBufIOMode::Stream");
+
+    for (GLsync& fence : m_StreamFences) {
+        if (fence) {
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+    if (m_StreamMemory) {
+        glUnmapNamedBuffer(m_BufferID);
+        glDeleteBuffers(1, &m_BufferID);
+        glCreateBuffers(1, &m_BufferID);
+    }
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    m_SegmentCapacity = (size_t)vertices * getElementsPerVertex();
+    const GLsizeiptr bytes = m_SegmentCapacity * STREAM_SEGMENTS * sizeof(GLfloat);
+
+    glNamedBufferStorage(m_BufferID, bytes, nullptr, flags);
+    m_StreamMemory = (float*)glMapNamedBufferRange(m_BufferID, 0, bytes, flags);
+    m_Segment = 0;
+}
+
+template<VertexDataType T,VertBufTargetAction A,VertBufIOMode IO>
+float* VertexDataBuffer<T,A,IO>::beginStreamWrite() {
+    static_assert(IO == VertBufIOMode::Stream, "beginStreamWrite requires VertBufIOMode::Stream");
+
+    GLsync& fence = m_StreamFences[m_Segment];
+    if (fence) {
+        // normally already signalled, the ring is three frames deep
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {}
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+    return m_StreamMemory + m_Segment * m_SegmentCapacity;
+}
+
+template<VertexDataType T,VertBufTargetAction A,VertBufIOMode IO>
+GLint VertexDataBuffer<T,A,IO>::getStreamFirstVertex() {
+    return (GLint)(m_Segment * m_SegmentCapacity / getElementsPerVertex());
+}
+
+template<VertexDataType T,VertBufTargetAction A,VertBufIOMode IO>
+void VertexDataBuffer<T,A,IO>::fenceStream() {
+    m_StreamFences[m_Segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_Segment = (m_Segment + 1) % STREAM_SEGMENTS;
+}
+
+
+template<typename Layout, VertBufTargetAction A, VertBufIOMode IO>
+InterleavedBuffer<Layout,A,IO>::InterleavedBuffer() {
+    glCreateBuffers(1, &m_BufferID);
+}
+
+template<typename Layout, VertBufTargetAction A, VertBufIOMode IO>
+InterleavedBuffer<Layout,A,IO>::~InterleavedBuffer() {
+    glDeleteBuffers(1, &m_BufferID);
+}
+
+template<typename Layout, VertBufTargetAction A, VertBufIOMode IO>
+void InterleavedBuffer<Layout,A,IO>::clear() {
+    m_BufferData.clear();
+    m_DirtyRanges.clear();
+    m_NeedsResize = true;
+    markDirty();
+}
+
+template<typename Layout, VertBufTargetAction A, VertBufIOMode IO>
+void InterleavedBuffer<Layout,A,IO>::pushToBuffer() {
+    if (!isDirty()) return;
+    PROFILE_SCOPE("InterleavedBuffer flush");
+
+    if (m_NeedsResize) {
+        BUFFER_TRACE("interleaved buffer {} full upload, {} bytes", m_BufferID, m_BufferData.size() * sizeof(GLfloat));
+        glNamedBufferData(m_BufferID, m_BufferData.size() * sizeof(GLfloat), m_BufferData.data(), getMode());
+        m_Stats.uploads++;
+        m_Stats.bytesUploaded += m_BufferData.size() * sizeof(GLfloat);
+        m_Stats.bytesChanged += m_BufferData.size() * sizeof(GLfloat);
+        m_DirtyRanges.clear();
+        m_NeedsResize = false;
+    } else {
+        m_Stats.bytesChanged += m_DirtyRanges.getDirtyCount() * sizeof(GLfloat);
+        m_DirtyRanges.flush([this](size_t start, size_t end) {
+            end = std::min(end, m_BufferData.size());
+            if (start >= end) return;
+            BUFFER_TRACE("interleaved buffer {} sub upload, offset {} size {}", m_BufferID, start * sizeof(GLfloat), (end - start) * sizeof(GLfloat));
+            glNamedBufferSubData(m_BufferID, start * sizeof(GLfloat), (end - start) * sizeof(GLfloat), (const void*)(m_BufferData.data() + start));
+            m_Stats.uploads++;
+            m_Stats.bytesUploaded += (end - start) * sizeof(GLfloat);
+        });
+    }
+
+    m_Dirty = false;
+}
+
+template<typename Layout, VertBufTargetAction A, VertBufIOMode IO>
+template<typename... V>
+void InterleavedBuffer<Layout,A,IO>::pushVertex(V... values) {
+    static_assert(sizeof...(V) == FLOATS_PER_VERTEX, "pushVertex needs exactly one value per float of the vertex layout");
+    m_NeedsResize = true;
+    markDirty();
+    (m_BufferData.push_back(static_cast<float>(values)), ...);
+}
+
+template<typename Layout, VertBufTargetAction A, VertBufIOMode IO>
+template<typename... V>
+void InterleavedBuffer<Layout,A,IO>::editVertex(GLuint id, V... values) {
+    static_assert(sizeof...(V) == FLOATS_PER_VERTEX, "editVertex needs exactly one value per float of the vertex layout");
+    const size_t start = (size_t)id * FLOATS_PER_VERTEX;
+    m_DirtyRanges.add(start, start + FLOATS_PER_VERTEX);
+    markDirty();
+
+    float* out = m_BufferData.data() + start;
+    ((*out++ = static_cast<float>(values)), ...);
+}
+
+template<typename Layout, VertBufTargetAction A, VertBufIOMode IO>
+template<GLuint Attribute, typename... V>
+void InterleavedBuffer<Layout,A,IO>::editAttribute(GLuint id, V... values) {
+    static_assert(Attribute < Layout::ATTRIBUTE_COUNT, "Attribute index is outside the vertex layout");
+    static_assert(sizeof...(V) == Layout::getSize(Attribute), "editAttribute needs exactly one value per float of the attribute");
+    const size_t start = (size_t)id * FLOATS_PER_VERTEX + Layout::getOffset(Attribute);
+    m_DirtyRanges.add(start, start + sizeof...(V));
+    markDirty();
+
+    float* out = m_BufferData.data() + start;
+    ((*out++ = static_cast<float>(values)), ...);
+}
+
+template <PrimitiveType P> VertexArray<P>::VertexArray() {
+    glCreateVertexArrays(1,&m_VertexArrayID);
+}
+
+template <PrimitiveType P> VertexArray<P>::~VertexArray() {
+    glDeleteVertexArrays(1,&m_VertexArrayID);
+}
+
+template <PrimitiveType P> void VertexArray<P>::enableAttribute(unsigned int index) {
+    glEnableVertexArrayAttrib(m_VertexArrayID, index);
+}
+
+template <PrimitiveType P> void VertexArray<P>::setAttributeDivisor(unsigned int index, unsigned int divisor) {
+    glVertexArrayBindingDivisor(m_VertexArrayID, index, divisor);
+}
+
+template <PrimitiveType P> void VertexArray<P>::bind() {
+    glBindVertexArray(m_VertexArrayID);
+}
+
+template <PrimitiveType P> void VertexArray<P>::unbind() {
+    glBindVertexArray(0);
+}
+
+template <PrimitiveType P> void VertexArray<P>::bindElementArray(IndexBuffer<P>* buffer) {
+    glVertexArrayElementBuffer(m_VertexArrayID, buffer->m_IndexBufferID);
+}
+
+template <PrimitiveType T> IndexBuffer<T>::IndexBuffer(const unsigned int primitiveSize,  unsigned int mode) : m_PrimitiveSize{primitiveSize}, m_Mode{mode} {
+    static_assert(T == PrimitiveType::Other, "Advanced primitive types need PrimitiveType::Other");
+    init();
+};
+template <PrimitiveType T> IndexBuffer<T>::IndexBuffer(const unsigned int mode) : m_PrimitiveSize{static_cast<int>(T)}, m_Mode{mode} { init(); };
+
+template <PrimitiveType T> IndexBuffer<T>::~IndexBuffer() {
+    glDeleteBuffers(1, &m_IndexBufferID);
+}
+
+
+template <PrimitiveType T> void IndexBuffer<T>::init() {
+    glGenBuffers(1,&m_IndexBufferID);
+    bind();
+    pushToBuffer(true);
+}
+
+template<PrimitiveType T>
+void IndexBuffer<T>::pushToBuffer(bool unbindAfter) {
+    if (isDirty()) {
+        PROFILE_SCOPE("IndexBuffer flush");
+        bind();
+        if (m_NeedsResize) {
+            BUFFER_TRACE("index buffer {} full upload, {} bytes", m_IndexBufferID, m_BufferData.size() * sizeof(GLuint));
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER,m_BufferData.size() * sizeof(GLuint), m_BufferData.data(),m_Mode);
+            m_Stats.uploads++;
+            m_Stats.bytesUploaded += m_BufferData.size() * sizeof(GLuint);
+            m_Stats.bytesChanged += m_BufferData.size() * sizeof(GLuint);
+            m_DirtyRanges.clear();
+            m_NeedsResize = false;
+        } else {
+            m_Stats.bytesChanged += m_DirtyRanges.getDirtyCount() * sizeof(GLuint);
+            m_DirtyRanges.flush([this](size_t start, size_t end) {
+                end = std::min(end, m_BufferData.size());
+                if (start >= end) return;
+                BUFFER_TRACE("index buffer {} sub upload, offset {} size {}", m_IndexBufferID, start * sizeof(GLuint), (end - start) * sizeof(GLuint));
+                glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, start * sizeof(GLuint), (end - start) * sizeof(GLuint), (const void*)(m_BufferData.data() + start));
+                m_Stats.uploads++;
+                m_Stats.bytesUploaded += (end - start) * sizeof(GLuint);
+            });
+        }
+        if (unbindAfter) unbind();
+
+        m_Dirty = false;
+    }
+}
+
+
+template<PrimitiveType T>
+void IndexBuffer<T>::markDirty() {
+    m_Dirty = true;
+}
+
+template<PrimitiveType T>
+bool IndexBuffer<T>::isDirty() {
+    return m_Dirty;
+}
+
+template <PrimitiveType T> void IndexBuffer<T>::bind() {
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IndexBufferID);
+}
+
+template <PrimitiveType T> void IndexBuffer<T>::unbind() {
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+template <PrimitiveType T> constexpr unsigned int IndexBuffer<T>::getPrimitiveSize() {
+    return m_PrimitiveSize;
+} 
+template <PrimitiveType T> void IndexBuffer<T>::pushIndex(unsigned int ind) {
+    m_NeedsResize = true;
+    markDirty();
+    m_BufferData.push_back(ind);
+}
+
+template <PrimitiveType T> void IndexBuffer<T>::editIndex(unsigned int where, unsigned int new_index) {
+    m_DirtyRanges.add(where, where + 1);
+    markDirty();
+    m_BufferData.at(where) = new_index;
+}
+
+template <PrimitiveType T> void IndexBuffer<T>::pushPrimitive(unsigned int* inds) {
+    m_NeedsResize = true;
+    markDirty();
+    for (size_t p = 0; p < getPrimitiveSize() ; p++) {
+        m_BufferData.push_back(inds[p]);
+    }
+}
+
+template <PrimitiveType T> void IndexBuffer<T>::editPrimitive(unsigned int where, unsigned int* new_prim) {
+    m_DirtyRanges.add(where, where + getPrimitiveSize());
+    markDirty();
+    for (size_t p = 0; p < getPrimitiveSize() ; p++) {
+        m_BufferData.at(where + p) = new_prim[p];
+    }
+}
+
+template <PrimitiveType T> void IndexBuffer<T>::pushIndicies(unsigned int* inds, unsigned int count) {
+    m_NeedsResize = true;
+    markDirty();
+    for (size_t i = 0; i < count ; i++) {
+        m_BufferData.push_back(inds[i]);
+    }
+}
+
+template <PrimitiveType T> void IndexBuffer<T>::removeIndex(unsigned int where) {
+    m_NeedsResize = true;
+    markDirty();
+    m_BufferData.erase(m_BufferData.begin() + where);
+}
+
+template <PrimitiveType T> void IndexBuffer<T>::removePrimitive(unsigned int where) {
+    m_NeedsResize = true;
+    markDirty();
+    m_BufferData.erase(m_BufferData.begin() + where * m_PrimitiveSize, m_BufferData.begin() + where * m_PrimitiveSize + m_PrimitiveSize);
+}
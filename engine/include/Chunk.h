@@ -0,0 +1,210 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+#include "SlabPool.h"
+
+typedef uint16_t MaterialID;
+
+constexpr int CHUNK_SIZE_LOG2 = 6;
+constexpr int CHUNK_SIZE = 1 << CHUNK_SIZE_LOG2;
+constexpr int CHUNK_CELLS = CHUNK_SIZE * CHUNK_SIZE;
+
+constexpr float AMBIENT_TEMPERATURE = 20.0f;
+
+// coarse gas field, one gas cell covers GAS_SCALE x GAS_SCALE cells (see GasField)
+constexpr int GAS_SCALE_LOG2 = 3;
+constexpr int GAS_SCALE = 1 << GAS_SCALE_LOG2;
+constexpr int GAS_SIZE = CHUNK_SIZE / GAS_SCALE;
+constexpr int GAS_CELLS = GAS_SIZE * GAS_SIZE;
+constexpr int GAS_SPECIES = 4; // field gas materials a world can hold at once
+
+enum CellFlag : uint8_t {
+	CellUpdated = 0x1,  // moved during the tick whose parity is stored in CellParity
+	CellParity = 0x2,
+	CellStatic = 0x4,   // anchored terrain, never moved by the simulation
+	CellBurning = 0x8,
+	CellPhaseChange = 0x10,
+	CellDebris = 0x20   // part of a DebrisTracker body, moved by it instead of the cell update
+};
+
+enum ChunkEdge {
+	EdgeLeft = 0,  // x = 0 column
+	EdgeRight,     // x = CHUNK_SIZE - 1 column
+	EdgeDown,      // y = 0 row
+	EdgeUp,        // y = CHUNK_SIZE - 1 row
+	EdgeCount
+};
+
+enum ChunkNeighbour {
+	NeighbourLeft = 0,
+	NeighbourRight,
+	NeighbourDown,
+	NeighbourUp,
+	NeighbourDownLeft,
+	NeighbourDownRight,
+	NeighbourUpLeft,
+	NeighbourUpRight,
+	NeighbourCount
+};
+
+// Structure-of-arrays cell storage. Every plane is row-major (index = y * CHUNK_SIZE + x)
+// and cache line aligned so update loops stream through one plane at a time.
+struct ChunkCells {
+	alignas(64) MaterialID material[CHUNK_CELLS];
+	alignas(64) float temperature[CHUNK_CELLS];
+	alignas(64) int8_t velocityX[CHUNK_CELLS];
+	alignas(64) int8_t velocityY[CHUNK_CELLS];
+	alignas(64) uint8_t flags[CHUNK_CELLS];
+
+	// copy of the border temperatures taken before a heat step, read by the neighbours
+	alignas(64) float heatEdges[EdgeCount][CHUNK_SIZE];
+
+	// Gas field, double buffered: a step reads one copy of every chunk and writes the other.
+	// Amounts are in cells' worth, so a gas cell full of one gas holds GAS_SCALE * GAS_SCALE.
+	alignas(64) float gas[2][GAS_SPECIES][GAS_CELLS];
+	alignas(64) float gasTemperature[2][GAS_CELLS];
+	// per gas cell, as of the last gas step: empty cells under it, and their mean temperature
+	alignas(64) uint8_t gasCapacity[GAS_CELLS];
+	alignas(64) float gasAmbient[GAS_CELLS];
+};
+
+class Chunk {
+private:
+	const int m_ChunkX;
+	const int m_ChunkY;
+
+	// cell storage comes from the World's pool, so chunks streaming in and out reuse it
+	SlabPool& m_CellPool;
+	ChunkCells* const m_Cells;
+
+	Chunk* m_Neighbours[NeighbourCount] = {};
+
+	// Dirty rectangles in local cell coordinates, [min, max) on each axis and empty when min >= max
+	// (same convention as the DirtyRangeSet ranges in Buffer.h). m_Dirty* is the area updated
+	// this tick, m_Next* collects every write made during the tick and becomes m_Dirty* on swap.
+	// m_Next* is atomic because the two chunks on either side of a chunk can both write into it
+	// during the same checkerboard pass.
+	int m_DirtyMinX = 0;
+	int m_DirtyMinY = 0;
+	int m_DirtyMaxX = CHUNK_SIZE;
+	int m_DirtyMaxY = CHUNK_SIZE;
+
+	std::atomic<int> m_NextMinX{CHUNK_SIZE};
+	std::atomic<int> m_NextMinY{CHUNK_SIZE};
+	std::atomic<int> m_NextMaxX{0};
+	std::atomic<int> m_NextMaxY{0};
+
+	// Heat keeps diffusing in chunks that are otherwise asleep, so it has its own activity flag.
+	bool m_ThermalActive = true;
+	std::atomic<bool> m_ThermalNext{false};
+	bool m_InHeatPass = false;
+
+	// bumped by every swapDirty() that ends a tick with writes in it, renderers compare it
+	// against the revision they last uploaded
+	uint32_t m_Revision = 1;
+	// set by the World, tells a chunk apart from an earlier one created at the same position
+	uint32_t m_Serial = 0;
+
+	// which copy of the gas planes is current, whether any gas is in them, and whether the
+	// field changed this tick (it bumps the revision without waking the cell update)
+	uint8_t m_GasPlane = 0;
+	bool m_HasGas = false;
+	bool m_GasChanged = false;
+	uint64_t m_GasStep = 0; // last GasField step the chunk took part in
+
+	void expandNext(int minX, int minY, int maxX, int maxY);
+
+	friend class World;
+public:
+	Chunk(int chunkX, int chunkY, SlabPool& cellPool);
+	~Chunk();
+
+	Chunk(const Chunk&) = delete;
+	Chunk& operator=(const Chunk&) = delete;
+
+	void clear(MaterialID material, float temperature);
+
+	static constexpr int index(int x, int y) { return (y << CHUNK_SIZE_LOG2) | x; }
+	static constexpr bool inBounds(int x, int y) { return (unsigned)x < (unsigned)CHUNK_SIZE && (unsigned)y < (unsigned)CHUNK_SIZE; }
+
+	inline int getChunkX() const { return m_ChunkX; }
+	inline int getChunkY() const { return m_ChunkY; }
+
+	// Chunks sharing a pass are never adjacent, so they can be updated in parallel as long
+	// as no update reaches more than CHUNK_SIZE / 2 cells outside its own chunk.
+	inline int getCheckerboardPass() const { return (m_ChunkX & 1) | ((m_ChunkY & 1) << 1); }
+
+	inline Chunk* getNeighbour(ChunkNeighbour n) const { return m_Neighbours[n]; }
+	Chunk* getNeighbour(int dx, int dy);
+
+	// Marks a cell and its 8 surrounding cells for update next tick, waking neighbouring
+	// chunks when the cell sits on the border.
+	void markDirty(int x, int y);
+	void markRowsDirty(int minY, int maxY);
+	void markAllDirty();
+
+	// Promotes the writes collected this tick to the update area of the next one, and the
+	// heat wake-ups to the thermal flag. Returns whether the chunk is still awake.
+	bool swapDirty();
+
+	inline bool isThermallyActive() const { return m_ThermalActive; }
+	inline void wakeThermal() { m_ThermalNext.store(true, std::memory_order_relaxed); }
+
+	// Snapshots the border temperatures into the edge cache and marks the chunk as taking part
+	// in the current heat step, until endHeatPass().
+	void beginHeatPass();
+	void endHeatPass();
+	inline bool inHeatPass() const { return m_InHeatPass; }
+	inline const float* getHeatEdge(ChunkEdge edge) const { return m_Cells->heatEdges[edge]; }
+	void copyHeatEdge(ChunkEdge edge, float* out) const;
+
+	// current gas planes, and the ones the running gas step writes into
+	inline float* getGas(int species) { return m_Cells->gas[m_GasPlane][species]; }
+	inline const float* getGas(int species) const { return m_Cells->gas[m_GasPlane][species]; }
+	inline float* getGasTemperatures() { return m_Cells->gasTemperature[m_GasPlane]; }
+	inline const float* getGasTemperatures() const { return m_Cells->gasTemperature[m_GasPlane]; }
+	inline float* getNextGas(int species) { return m_Cells->gas[m_GasPlane ^ 1][species]; }
+	inline float* getNextGasTemperatures() { return m_Cells->gasTemperature[m_GasPlane ^ 1]; }
+	inline uint8_t* getGasCapacities() { return m_Cells->gasCapacity; }
+	inline const uint8_t* getGasCapacities() const { return m_Cells->gasCapacity; }
+	inline float* getGasAmbient() { return m_Cells->gasAmbient; }
+	inline void flipGas() { m_GasPlane ^= 1; }
+
+	inline bool hasGas() const { return m_HasGas; }
+	inline void setHasGas(bool hasGas) { m_HasGas = hasGas; }
+	inline void touchGas() { m_GasChanged = true; }
+	inline uint64_t getGasStep() const { return m_GasStep; }
+	inline void setGasStep(uint64_t step) { m_GasStep = step; }
+
+	inline bool isAwake() const { return m_DirtyMinX < m_DirtyMaxX && m_DirtyMinY < m_DirtyMaxY; }
+	inline int getDirtyMinX() const { return m_DirtyMinX; }
+	inline int getDirtyMinY() const { return m_DirtyMinY; }
+	inline int getDirtyMaxX() const { return m_DirtyMaxX; }
+	inline int getDirtyMaxY() const { return m_DirtyMaxY; }
+	inline uint32_t getRevision() const { return m_Revision; }
+	inline uint32_t getSerial() const { return m_Serial; }
+
+	inline MaterialID* getMaterials() { return m_Cells->material; }
+	inline float* getTemperatures() { return m_Cells->temperature; }
+	inline int8_t* getVelocitiesX() { return m_Cells->velocityX; }
+	inline int8_t* getVelocitiesY() { return m_Cells->velocityY; }
+	inline uint8_t* getFlags() { return m_Cells->flags; }
+
+	inline const MaterialID* getMaterials() const { return m_Cells->material; }
+	inline const float* getTemperatures() const { return m_Cells->temperature; }
+	inline const int8_t* getVelocitiesX() const { return m_Cells->velocityX; }
+	inline const int8_t* getVelocitiesY() const { return m_Cells->velocityY; }
+	inline const uint8_t* getFlags() const { return m_Cells->flags; }
+
+	inline MaterialID getMaterial(int x, int y) const { return m_Cells->material[index(x, y)]; }
+	inline float getTemperature(int x, int y) const { return m_Cells->temperature[index(x, y)]; }
+	inline uint8_t getCellFlags(int x, int y) const { return m_Cells->flags[index(x, y)]; }
+
+	void setMaterial(int x, int y, MaterialID material);
+	void setTemperature(int x, int y, float temperature);
+
+	static constexpr size_t getCellMemory() { return sizeof(ChunkCells); }
+};
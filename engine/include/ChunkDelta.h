@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Chunk.h"
+#include "World.h"
+
+struct DeltaStats {
+	uint64_t frames;
+	uint64_t chunksEncoded;   // chunks in all frames so far
+	uint64_t bytes;           // all frames so far, headers included
+	size_t lastFrameBytes;
+	size_t maxFrameBytes;
+};
+
+// Per-tick world deltas. A frame holds every chunk whose state changed since the previous frame,
+// each as the XOR of its state against the state sent last, run-length encoded: unchanged bytes
+// XOR to zero and collapse into runs, so a chunk where a few cells moved costs a few dozen bytes.
+//
+//   frame    magic "CHDF", frame size, tick, chunk count, removed count, then the chunks,
+//            then the removed chunks
+//   chunk    chunk x, chunk y, encoded size, flags, then (zero run, literal count, literal
+//            bytes) triples covering STATE_SIZE bytes, counts as LEB128 varints
+//   removed  chunk x, chunk y
+//
+// A chunk's state is its cell planes followed by its current gas planes, stored as they sit in
+// memory. Which chunks get compared comes from the chunks' own change tracking rather than a
+// scan of the world: a chunk is encoded when its revision or serial moved, or when it was awake
+// or thermally active for the tick (the cell update and heat step change cells without always
+// bumping the revision). A chunk removed from the world gets a removed record and is dropped on
+// both sides; one that is new, came back or follows a reset() is sent whole, flagged
+// DeltaChunkWhole, as the XOR against an empty state.
+enum DeltaChunkFlag : uint32_t {
+	DeltaChunkWhole = 0x1  // the decoder's reference starts over from an empty state
+};
+
+class ChunkDeltaEncoder {
+private:
+	struct Reference {
+		int32_t chunkX;
+		int32_t chunkY;
+		uint32_t serial;
+		uint32_t revision;
+		bool active;     // awake or thermally active at the last frame, so it runs this tick
+		bool whole;      // state was cleared by reset(), send the chunk whole
+		uint64_t frame;  // last frame the chunk was in the world
+		std::vector<uint8_t> state;
+	};
+
+	std::unordered_map<uint64_t, Reference> m_References;
+	std::vector<uint8_t> m_State; // scratch for the chunk being encoded
+	std::vector<uint8_t> m_Frame;
+	uint64_t m_FrameHash = 0;
+	DeltaStats m_Stats = {};
+public:
+	static constexpr size_t STATE_SIZE = CHUNK_CELLS * (sizeof(MaterialID) + sizeof(float) + 3) + (GAS_SPECIES + 1) * GAS_CELLS * sizeof(float);
+
+	ChunkDeltaEncoder();
+
+	ChunkDeltaEncoder(const ChunkDeltaEncoder&) = delete;
+	ChunkDeltaEncoder& operator=(const ChunkDeltaEncoder&) = delete;
+
+	// Serialises a chunk's state into out, which must hold STATE_SIZE bytes.
+	static void readState(const Chunk& chunk, uint8_t* out);
+	// Writes a state back into a chunk and wakes it, so it is redrawn and simulated from there.
+	static void writeState(const uint8_t* state, Chunk& chunk);
+
+	// Encodes the chunks that changed since the last call. Call once a tick, between steps.
+	// The frame stays valid until the next call.
+	const std::vector<uint8_t>& encode(const World& world, uint64_t tick);
+
+	// Forgets every reference's state, the next frame holds the whole world.
+	void reset();
+
+	// FNV-1a of the last frame, equal for two runs exactly as long as their worlds are
+	inline uint64_t getFrameHash() const { return m_FrameHash; }
+	inline const std::vector<uint8_t>& getFrame() const { return m_Frame; }
+	inline const DeltaStats& getStats() const { return m_Stats; }
+};
+
+// Applies frames from a ChunkDeltaEncoder to another World, which then mirrors the source. The
+// mirror is for viewers and checks: the chunks' dirty rectangles and random streams are not
+// part of the frames, so simulating on from a mirror drifts away from the source.
+class ChunkDeltaDecoder {
+private:
+	std::unordered_map<uint64_t, std::vector<uint8_t>> m_References;
+	uint64_t m_Tick = 0;
+public:
+	ChunkDeltaDecoder();
+
+	ChunkDeltaDecoder(const ChunkDeltaDecoder&) = delete;
+	ChunkDeltaDecoder& operator=(const ChunkDeltaDecoder&) = delete;
+
+	// Applies one whole frame, creating chunks the world lacks and removing the ones the source
+	// removed. False, with the problem logged, when the frame is malformed; the world may then be
+	// partly updated.
+	bool apply(World& world, const uint8_t* frame, size_t size);
+
+	// Size of the frame at the start of data, 0 while fewer than its header's bytes are there.
+	static size_t getFrameSize(const uint8_t* data, size_t size);
+
+	inline uint64_t getTick() const { return m_Tick; }
+};
+
+// Where frames go: a file, or a local (Unix domain) socket another process listens on.
+// Writes block, so a slow reader slows the simulation down rather than losing frames.
+class DeltaStream {
+private:
+	std::FILE* m_File = nullptr;
+	int m_Socket = -1;
+	uint64_t m_BytesWritten = 0;
+public:
+	DeltaStream();
+	~DeltaStream();
+
+	DeltaStream(const DeltaStream&) = delete;
+	DeltaStream& operator=(const DeltaStream&) = delete;
+
+	// "unix:<path>" connects to a socket, anything else is a file that is created or truncated
+	bool open(const std::string& target);
+	void close();
+	inline bool isOpen() const { return m_File != nullptr || m_Socket >= 0; }
+
+	// false, and the stream closed, when the write failed
+	bool write(const std::vector<uint8_t>& frame);
+
+	inline uint64_t getBytesWritten() const { return m_BytesWritten; }
+};
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "Buffer.h"
+#include "GasField.h"
+#include "GpuProfiler.h"
+#include "MaterialTable.h"
+#include "TextureAtlas.h"
+#include "WorldSnapshot.h"
+
+enum ChunkRenderMode {
+	RenderTexture = 0,  // one R16UI texture layer of material ids per chunk, coloured in the fragment shader, plus its gas field
+	RenderPoints        // one point sprite per cell with its material id as a vertex attribute, no gas field
+};
+
+struct RenderView {
+	float left;    // world cell coordinates of the lower left corner
+	float bottom;
+	float width;   // in cells
+	float height;
+	int viewportWidth;   // in pixels
+	int viewportHeight;
+};
+
+struct ChunkRenderStats {
+	size_t chunksDrawn;
+	size_t chunksUploaded;
+	size_t chunksDeferred;  // changed and visible, but over the upload budget; retried next frame
+	size_t bytesUploaded;
+};
+
+// Draws the chunks of a WorldSnapshot that fall inside a view. Every visible chunk owns a slot in GPU
+// memory (a texture layer or a run of CHUNK_CELLS points) which is only re-uploaded when the
+// chunk's revision changed since the last upload. Uploads are capped by a per-frame byte budget;
+// the chunks that have been waiting longest go first and the rest keep showing their previous
+// contents until a later frame gets to them.
+//
+// Needs a current OpenGL 4.5 context for its whole lifetime.
+class ChunkRenderer {
+private:
+	struct Slot {
+		uint32_t serial;
+		uint32_t index;
+		uint32_t revision;   // chunk revision last uploaded, 0 when nothing has been uploaded
+		uint64_t lastSeen;   // frame the chunk was last visible
+		uint64_t staleSince; // last frame the slot was up to date
+	};
+
+	struct VisibleChunk {
+		const ChunkSnapshot* chunk;
+		Slot* slot;
+	};
+
+	typedef VertexLayout<Texture, Custom> PointLayout; // cell x, cell y, material id
+
+	static constexpr uint64_t EVICT_FRAMES = 120;
+
+	const MaterialTable& m_Materials;
+	ChunkRenderMode m_Mode;
+
+	size_t m_UploadBudget = DEFAULT_UPLOAD_BUDGET;
+	uint64_t m_Frame = 0;
+	ChunkRenderStats m_Stats = {};
+	GpuProfiler* m_GpuProfiler = nullptr;
+
+	std::unordered_map<uint64_t, Slot> m_Slots;
+	std::vector<uint32_t> m_FreeSlots;
+	uint32_t m_SlotCapacity = 0;
+	uint32_t m_TextureLayers = 0;
+
+	GLuint m_PaletteTexture = 0;
+	GLuint m_AtlasTexture = 0;
+	GLuint m_RegionTexture = 0;
+	GLuint m_MaterialTexture = 0;
+	GLuint m_GasTexture = 0;
+	GLuint m_TextureProgram = 0;
+	GLuint m_PointProgram = 0;
+	GLint m_TextureViewLocation = -1;
+	GLint m_PointViewLocation = -1;
+	GLint m_PointSizeLocation = -1;
+	GLint m_GasSpeciesLocation = -1;
+
+	// texture mode, one instance (chunk x, chunk y, layer) per visible chunk
+	VertexArray<Triangles> m_TextureVAO;
+	VertexDataBuffer<Position, Draw, Dynamic> m_Instances;
+
+	VertexArray<Points> m_PointVAO;
+	InterleavedBuffer<PointLayout, Draw, Dynamic> m_Points;
+
+	std::vector<VisibleChunk> m_Visible;
+	std::vector<VisibleChunk> m_Stale;
+	std::vector<GLint> m_DrawFirst;
+	std::vector<GLsizei> m_DrawCount;
+
+	Slot& acquireSlot(const ChunkSnapshot* chunk);
+	void growSlots();
+	void evictSlots();
+	void ensureStorage();
+	void invalidateSlots();
+
+	size_t getChunkUploadSize() const;
+	void uploadChunk(const ChunkSnapshot* chunk, const Slot& slot);
+
+	void drawTextures(const RenderView& view);
+	void drawPoints(const RenderView& view);
+public:
+	static constexpr size_t DEFAULT_UPLOAD_BUDGET = 4 * 1024 * 1024;
+	static constexpr uint32_t INITIAL_SLOTS = 64;
+
+	ChunkRenderer(const MaterialTable& materials, ChunkRenderMode mode = RenderTexture);
+	~ChunkRenderer();
+
+	ChunkRenderer(const ChunkRenderer&) = delete;
+	ChunkRenderer& operator=(const ChunkRenderer&) = delete;
+
+	// false when a shader failed to compile, the errors have been logged
+	inline bool isValid() const { return m_TextureProgram != 0 && m_PointProgram != 0; }
+
+	// Switching mode re-uploads every chunk, spread over frames by the budget.
+	void setMode(ChunkRenderMode mode);
+	inline ChunkRenderMode getMode() const { return m_Mode; }
+
+	// At least one changed chunk is uploaded per frame whatever the budget, so 0 means one chunk a frame.
+	inline void setUploadBudget(size_t bytes) { m_UploadBudget = bytes; }
+	inline size_t getUploadBudget() const { return m_UploadBudget; }
+
+	// Materials with a region in the atlas are drawn with their texture, tiled in world cells, the
+	// rest with their colour. Takes effect on the next frame without re-uploading any chunk; the
+	// atlas can be dropped once this returns.
+	void setAtlas(const TextureAtlas& atlas);
+
+	// Colours the gas field of the snapshots with the field's species; without it every species
+	// draws as material 0, which is transparent.
+	void setGasField(const GasField& gas);
+
+	// times uploads and draws on the GPU, nullptr for none
+	inline void setGpuProfiler(GpuProfiler* profiler) { m_GpuProfiler = profiler; }
+
+	void render(const WorldSnapshot& world, const RenderView& view);
+
+	inline const ChunkRenderStats& getStats() const { return m_Stats; }
+	inline size_t getSlotCount() const { return m_Slots.size(); }
+};
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Chunk.h"
+#include "MaterialTable.h"
+#include "World.h"
+
+struct st_stbcc_grid; // stbcc_grid
+
+struct DebrisStats {
+	size_t cellsScanned;    // dirty cells compared against the grid
+	size_t cellsChanged;    // cells whose rigidity changed
+	size_t bodiesDetached;
+	size_t cellsDetached;
+	size_t bodiesLanded;    // bodies that came to rest on supported rigid cells and rejoined the world
+	size_t cellsLanded;
+	size_t cellsMoved;
+	size_t clustersRebuilt; // grid clusters rebuilt for the cells above, at most one per cell
+};
+
+// Finds rigid cells (solid materials and anchored terrain) that lost their support and lets
+// each such island fall as one body.
+//
+// Connectivity of the rigid cells in a GRID_SIZE square window of the world lives in an
+// stb_connected_components grid. Every tick only the dirty rectangles of awake chunks are
+// compared against it, and each cluster holding a cell that changed is rebuilt once, so an
+// unchanged world costs nothing however much solid it holds. A component counts as supported
+// when it holds a CellStatic cell or reaches the edge of the window, which acts as the ground
+// (whatever lies past it can't be seen, so is assumed to hold things up). For every cluster of
+// the grid one anchor cell is kept per local clump that has one; a component is supported
+// exactly when one of those anchors carries its id.
+//
+// A detached island is flagged CellDebris, taken out of the grid and moved column by column:
+// the body falls as far as its lowest cells allow (through empty space, gases and liquids,
+// which are pushed up over it) and speeds up like a falling cell does. Once it lands on
+// supported rigid cells right below it, it becomes part of the world again without going
+// through the detach checks, since it can only be held up (apart from around cells that stopped
+// being rigid on the way down, which may have split it). A body resting on powder, another body
+// or rigid cells that are themselves loose stays a body and falls again when what holds it up
+// moves away. Cells that stop being rigid while part of a body (wood burning, say) keep moving
+// with it until it lands.
+class DebrisTracker {
+private:
+	// one vertical run of body cells, [bottom, top] inclusive, in world coordinates
+	struct Run {
+		int x;
+		int bottom;
+		int top;
+	};
+
+	// runs [firstRun, firstRun + runCount) of m_Runs, sorted by x, then bottom up
+	struct Body {
+		size_t firstRun;
+		size_t runCount;
+		size_t cells;
+		int speed;
+	};
+
+	World& m_World;
+	const MaterialTable& m_Materials;
+
+	std::unique_ptr<unsigned char[]> m_GridMemory;
+	st_stbcc_grid* m_Grid = nullptr;
+	int m_OriginX = 0;
+	int m_OriginY = 0;
+	std::vector<unsigned char> m_Map; // the window as setRegion hands it to stbcc
+
+	// per cluster, grid index of one anchor cell per local clump that holds one
+	std::vector<std::vector<uint32_t>> m_Anchors;
+	// clusters with cells the grid doesn't match the world in yet
+	std::vector<uint32_t> m_DirtyClusters;
+	std::vector<uint8_t> m_ClusterDirty;
+	bool m_SupportedValid = false; // m_Supported is up to date with the grid
+
+	// scratch, kept to reuse the memory
+	std::vector<uint32_t> m_Candidates;
+	std::vector<uint32_t> m_Supported;
+	std::vector<uint32_t> m_Checked;
+	std::vector<uint32_t> m_Stack;
+	std::vector<uint32_t> m_Island;
+	std::vector<uint32_t> m_Detached;
+	std::vector<uint8_t> m_Visited;
+
+	std::vector<Body> m_Bodies;
+	std::vector<Run> m_Runs; // of every body back to back, so landing and detaching reuse one buffer
+	DebrisStats m_Stats = {};
+
+	bool isRigid(const Chunk* chunk, int index) const;
+	bool isDisplaceable(int x, int y) const;
+
+	inline bool inGrid(int gx, int gy) const { return (unsigned)gx < (unsigned)GRID_SIZE && (unsigned)gy < (unsigned)GRID_SIZE; }
+	bool isOpen(int gx, int gy) const;
+
+	void markCluster(int gx, int gy);
+	// rebuilds every marked cluster from the world, then its anchors
+	void syncClusters();
+	void rebuildAnchors(int cluster);
+	void collectSupported();
+
+	void scanChanges();
+	void detachIslands();
+	bool floodIsland(uint32_t start);
+	void createBody();
+
+	int fallDistance(const Body& body, int speed) const;
+	void moveBody(Body& body, int distance);
+	bool hasGround(const Body& body);
+	void landBody(const Body& body);
+	// drops the body and its runs, the last body takes its place
+	void removeBody(size_t i);
+	void moveBodies();
+public:
+	// fixed by STBCC_GRID_COUNT_*_LOG2 in vendor/stb/src/stb_connected_components.c
+	static constexpr int GRID_SIZE_LOG2 = 10;
+	static constexpr int GRID_SIZE = 1 << GRID_SIZE_LOG2;
+	static constexpr int GRID_CHUNKS = GRID_SIZE / CHUNK_SIZE;
+	// stbcc's own default of sqrt(GRID_SIZE) cells per cluster side, always inside one chunk
+	static constexpr int CLUSTER_SIZE_LOG2 = GRID_SIZE_LOG2 / 2;
+	static constexpr int CLUSTER_SIZE = 1 << CLUSTER_SIZE_LOG2;
+	static constexpr int CLUSTER_COUNT = GRID_SIZE / CLUSTER_SIZE;
+	// a checkerboard of single cells
+	static constexpr int MAX_CLUMPS_PER_CLUSTER = CLUSTER_SIZE * CLUSTER_SIZE / 2;
+
+	static constexpr size_t MAX_BODY_CELLS = 1 << 16; // larger islands are left standing
+
+	DebrisTracker(World& world, const MaterialTable& materials);
+	~DebrisTracker();
+
+	DebrisTracker(const DebrisTracker&) = delete;
+	DebrisTracker& operator=(const DebrisTracker&) = delete;
+
+	// Places the tracked window with its lower left corner at the given chunk and builds the
+	// grid from the world, a full scan of the window; do it again when the view moves far.
+	void setRegion(int originChunkX, int originChunkY);
+	inline bool hasRegion() const { return m_Grid != nullptr; }
+	inline int getOriginX() const { return m_OriginX; }
+	inline int getOriginY() const { return m_OriginY; }
+
+	// Called by the Simulation at the start of every tick, single threaded.
+	void update();
+
+	// world coordinates, false for anything outside the window or not rigid
+	bool isConnected(int x1, int y1, int x2, int y2) const;
+	bool isSupported(int x, int y);
+
+	inline size_t getBodyCount() const { return m_Bodies.size(); }
+	inline const DebrisStats& getStats() const { return m_Stats; }
+	inline void resetStats() { m_Stats = DebrisStats{}; }
+};
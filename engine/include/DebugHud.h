@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "MaterialTable.h"
+#include "TextOverlay.h"
+#include "WorldSnapshot.h"
+
+struct HudStats {
+	uint64_t tick;
+	double tickSeconds;   // simulation time of a tick, negative to leave it off
+	double frameSeconds;  // negative to leave it off
+	size_t awakeChunks;
+	size_t chunkCount;
+};
+
+// The debug text drawn over the world: tick and frame times, chunk counts, and the materials
+// with the most cells in the world.
+//
+// Populations are counted from WorldSnapshots. Each chunk's counts are kept by serial with the
+// revision they were counted at, so an update only recounts the chunks that changed since, and
+// a settled world costs a lookup per chunk.
+class DebugHud {
+private:
+	struct ChunkCounts {
+		uint32_t revision;
+		uint64_t seen; // update that last saw the chunk
+		std::vector<uint32_t> counts;
+	};
+
+	const MaterialTable& m_Materials;
+	std::unordered_map<uint32_t, ChunkCounts> m_Chunks;
+	std::vector<uint64_t> m_Population;
+	std::vector<uint32_t> m_Histograms; // scratch for the chunk being counted
+	std::vector<MaterialID> m_Order;     // scratch for the most common materials
+	uint64_t m_Updates = 0;
+	size_t m_Recounted = 0;
+public:
+	static constexpr int MATERIAL_LINES = 8;
+	static constexpr float MARGIN = 8.0f;
+
+	DebugHud(const MaterialTable& materials);
+
+	DebugHud(const DebugHud&) = delete;
+	DebugHud& operator=(const DebugHud&) = delete;
+
+	// Brings the populations up to date with a snapshot of the whole world.
+	void countPopulations(const WorldSnapshot& snapshot);
+
+	// Adds the HUD to the overlay's current frame, and sets its colours 0 to MATERIAL_LINES + 1.
+	void build(TextOverlay& overlay, const HudStats& stats);
+
+	inline uint64_t getPopulation(MaterialID material) const { return m_Population[material]; }
+	// chunks recounted by the last countPopulations()
+	inline size_t getRecountedChunks() const { return m_Recounted; }
+};
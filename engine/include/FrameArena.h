@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+struct FrameArenaStats {
+	size_t allocations;      // allocate() calls since the stats were last reset
+	size_t bytesAllocated;
+	size_t peakBytes;        // most bytes handed out between two reset()s
+	size_t blockAllocations; // times the arena itself went to the heap
+};
+
+// Bump allocator for data that lives for one tick. allocate() moves a pointer along the current
+// block and reset() rewinds it, nothing is freed one by one and nothing is destructed, so only
+// trivially destructible types belong in here. A tick that outgrows the block chains another
+// one; the next reset() swaps the chain for a single block big enough for all of it, so after
+// a couple of ticks at a steady load the arena stops touching the heap altogether.
+// One arena per thread, it is not thread-safe.
+class FrameArena {
+private:
+	struct Block {
+		std::unique_ptr<uint8_t[]> data;
+		size_t size;
+	};
+
+	std::vector<Block> m_Blocks;
+	size_t m_Block = 0;  // block being bumped through
+	size_t m_Offset = 0; // into m_Blocks[m_Block]
+	size_t m_Used = 0;   // bytes handed out since reset(), across blocks
+
+	size_t m_Allocations = 0;
+	size_t m_BytesAllocated = 0;
+	size_t m_PeakBytes = 0;
+	size_t m_BlockAllocations = 0;
+
+	void addBlock(size_t size);
+public:
+	static constexpr size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+	explicit FrameArena(size_t blockSize = DEFAULT_BLOCK_SIZE);
+
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+	// uninitialised room for count objects of T
+	template<typename T> T* allocateArray(size_t count) {
+		static_assert(std::is_trivially_destructible<T>::value, "FrameArena never runs destructors");
+		return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+	}
+
+	// Everything allocated since the last reset() is invalid afterwards.
+	void reset();
+
+	FrameArenaStats getStats() const;
+	void resetStats();
+
+	inline size_t getUsed() const { return m_Used; }
+	size_t getCapacity() const;
+};
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Chunk.h"
+#include "MaterialTable.h"
+#include "ThreadPool.h"
+#include "World.h"
+
+struct GasStats {
+	size_t chunksStepped;  // chunks the last step ran over
+	size_t cellsAbsorbed;  // cells taken into the field since the last reset
+	size_t cellsEmitted;   // cells put back, condensed, decayed or reacted into something else
+};
+
+// Gases that spread over large areas (materials marked `field`) don't move cell by cell. The
+// cell update takes them out of the grid and into a coarse field kept per chunk: a GAS_SIZE
+// square of gas cells, each covering GAS_SCALE x GAS_SCALE cells and holding an amount of every
+// species (in cells' worth) and one temperature. A chunk full of steam costs 64 gas cells a
+// tick instead of 4096 moving ones.
+//
+// Every tick, over the chunks holding gas and their neighbours:
+//
+//   1. Each gas cell counts the empty cells under it (its capacity) and their mean temperature,
+//      only where the chunk changed. The gas relaxes towards that temperature, as fast as the
+//      gas cell is empty, so a thick cloud only cools at its edges. Then it goes through
+//      the MaterialTable like a cell would: decay, phase changes and reactions with one random
+//      cell under it. Products that are cells are put back into empty cells under the gas cell,
+//      products that are field gases stay in the field.
+//   2. Transport, in gather form so chunks run in parallel: every gas cell reads its own and
+//      its neighbours' amounts from the current planes and writes its next amount. Gas diffuses
+//      towards equal concentration (amount over capacity) and rises into the room above. Each
+//      face's flux is the same expression seen from both sides, so no gas is made or lost, and
+//      a cell with no capacity only ever pushes gas out. Unloaded chunks are walls.
+//
+// The field is not saved by WorldFile; gas in it is lost with the chunk.
+class GasField {
+private:
+	World& m_World;
+	const MaterialTable& m_Materials;
+	ThreadPool* m_Pool;
+	const uint32_t m_Seed;
+
+	MaterialID m_SpeciesMaterial[GAS_SPECIES] = {};
+	int m_SpeciesCount = 0;
+	std::vector<int8_t> m_SpeciesOf; // per MaterialID, -1 for materials that stay cells
+
+	uint64_t m_Step = 0;
+	std::vector<Chunk*> m_Chunks;     // taking part in the running step
+	std::vector<uint8_t> m_Recount;   // per entry of m_Chunks, whether its capacities may be stale
+
+	float m_Diffusion = 0.15f;
+	float m_Rise = 0.3f;
+	float m_Cooling = 0.02f;
+
+	size_t m_ChunksStepped = 0;
+	std::atomic<size_t> m_Absorbed{0};
+	std::atomic<size_t> m_Emitted{0};
+
+	template<typename F> void forEachChunk(F&& fn) {
+		if (m_Pool) {
+			m_Pool->parallelFor(m_Chunks.size(), fn);
+		} else {
+			for (size_t i = 0; i < m_Chunks.size(); i++) fn(i);
+		}
+	}
+
+	void addChunk(Chunk* chunk);
+	uint32_t chunkSeed(const Chunk* chunk) const;
+
+	void countCapacity(Chunk* chunk) const;
+	void reactChunk(Chunk* chunk);
+	void transportChunk(Chunk* chunk);
+
+	// turns share of amount, a species' amount in a gas cell, into material
+	void convert(Chunk* chunk, int cell, float& amount, float share, MaterialID material, float temperature, uint32_t& random);
+	bool emit(Chunk* chunk, int cell, MaterialID material, float temperature, uint32_t& random);
+	void setCell(Chunk* chunk, int index, MaterialID material, float temperature);
+public:
+	// a gas cell's capacity when none of the cells under it are filled
+	static constexpr int GAS_CELL_AREA = GAS_SCALE * GAS_SCALE;
+	// amounts below this are dropped, so a thinning cloud ends instead of spreading forever
+	static constexpr float MIN_AMOUNT = 1e-3f;
+
+	// pool may be nullptr to step everything on the calling thread
+	GasField(World& world, const MaterialTable& materials, uint32_t seed, ThreadPool* pool = nullptr);
+
+	GasField(const GasField&) = delete;
+	GasField& operator=(const GasField&) = delete;
+
+	// species index of a material, -1 when it isn't a field gas
+	inline int getSpecies(MaterialID m) const { return m_SpeciesOf[m]; }
+	inline int getSpeciesCount() const { return m_SpeciesCount; }
+	inline MaterialID getSpeciesMaterial(int species) const { return m_SpeciesMaterial[species]; }
+
+	// Adds a cell's worth of gas at a local cell of the chunk. The caller empties the cell and
+	// gives it the returned temperature, the air's around it, since the heat went with the gas.
+	// Only the thread updating the chunk may call it.
+	float absorb(Chunk& chunk, int x, int y, int species, float temperature);
+
+	// Called by the Simulation once a tick, between the heat step and the cell update.
+	void step();
+
+	// diffusion and rise are fractions of a gas cell's amount moved per tick, 4 * diffusion + rise
+	// must stay at or below 1 or amounts go negative
+	inline void setDiffusion(float rate) { m_Diffusion = rate; }
+	inline void setRise(float rate) { m_Rise = rate; }
+	// fraction of the difference to the surrounding air's temperature lost per tick by a gas cell
+	// that is all air, a full one keeps its heat
+	inline void setCooling(float rate) { m_Cooling = rate; }
+
+	// summed over every chunk, slow
+	double getTotalAmount(int species) const;
+
+	inline GasStats getStats() const { return GasStats{m_ChunksStepped, m_Absorbed.load(std::memory_order_relaxed), m_Emitted.load(std::memory_order_relaxed)}; }
+	inline void resetStats() {
+		m_Absorbed.store(0, std::memory_order_relaxed);
+		m_Emitted.store(0, std::memory_order_relaxed);
+	}
+};
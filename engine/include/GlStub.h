@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+
+// Host memory stand-ins for the GL calls the buffer classes make, so Buffer.h runs without a
+// context: the tests check what a buffer uploads and the bench times the CPU side of each upload
+// path. install() points glad's function table at them. Buffers are byte vectors, fences are
+// always signalled and the vertex array calls only hand out names. Single threaded, like a context.
+class GlStub {
+public:
+	struct Upload {
+		GLenum target;  // GL_ARRAY_BUFFER or GL_ELEMENT_ARRAY_BUFFER, 0 for the direct state access calls
+		GLuint buffer;
+		size_t offset;  // in bytes
+		size_t size;
+		bool whole;     // glBufferData rather than glBufferSubData
+	};
+
+	static void install();
+	// forgets every buffer and recorded upload, names start over at 1
+	static void reset();
+
+	// every glBufferData and glBufferSubData (and their named versions) since the last clearUploads()
+	static const std::vector<Upload>& getUploads();
+	static void clearUploads();
+
+	// the buffer's store, nullptr once it was deleted
+	static const std::vector<uint8_t>* getBufferData(GLuint buffer);
+	static size_t getLiveBufferCount();
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "Profiler.h"
+
+#if PROFILER_ENABLED
+	// profiler may be nullptr, the scope does nothing then
+	#define PROFILE_GPU_SCOPE(profiler, name) GpuProfileScope PROFILE_CONCAT(gpuProfileScope, __LINE__)(profiler, name)
+#else
+	#define PROFILE_GPU_SCOPE(profiler, name) ((void)0)
+#endif
+
+// Times GPU work with GL_TIME_ELAPSED queries and reports it to the Profiler on a "GPU" track.
+// A query is only read back FRAMES_IN_FLIGHT frames after it was issued, and skipped if the GPU
+// still hasn't finished it then, so timing never stalls the pipeline. Time elapsed queries can't
+// nest, so neither can GPU scopes. The spans sit at the CPU time their commands were issued,
+// only their lengths are measured on the GPU.
+//
+// Needs a current OpenGL 4.5 context for its whole lifetime.
+class GpuProfiler {
+private:
+	static constexpr unsigned FRAMES_IN_FLIGHT = 4;
+
+	struct Query {
+		GLuint id;
+		const char* name;
+		uint64_t issued; // Profiler::now() at begin()
+	};
+
+	// the queries of one frame, reused every FRAMES_IN_FLIGHT frames
+	struct Frame {
+		std::vector<Query> queries;
+		size_t used = 0;
+	};
+
+	Frame m_Frames[FRAMES_IN_FLIGHT];
+	uint64_t m_Frame = 0;
+	ProfileTrack* m_Track;
+	bool m_Open = false;
+	size_t m_Dropped = 0;
+
+	void collect(Frame& frame);
+public:
+	GpuProfiler();
+	~GpuProfiler();
+
+	GpuProfiler(const GpuProfiler&) = delete;
+	GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+	// Call once per frame before any scope; reports the queries issued FRAMES_IN_FLIGHT frames ago.
+	void beginFrame();
+
+	// false, and nothing to end(), when the Profiler is off or a query is already open
+	bool begin(const char* name);
+	void end();
+
+	// queries the GPU had not finished by the time they were read
+	inline size_t getDroppedCount() const { return m_Dropped; }
+};
+
+class GpuProfileScope {
+private:
+	GpuProfiler* m_Profiler;
+	bool m_Open;
+public:
+	inline GpuProfileScope(GpuProfiler* profiler, const char* name) : m_Profiler{profiler}, m_Open{profiler && profiler->begin(name)} {}
+	inline ~GpuProfileScope() {
+		if (m_Open) m_Profiler->end();
+	}
+
+	GpuProfileScope(const GpuProfileScope&) = delete;
+	GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Chunk.h"
+
+enum HeatKernelISA {
+	HeatKernelScalar = 0,
+	HeatKernelSSE2,
+	HeatKernelAVX2,
+	HeatKernelISACount
+};
+
+// Temperatures just across each border of a chunk, CHUNK_SIZE values each.
+// left/right are indexed by y, down/up by x.
+struct HeatHalo {
+	const float* left;
+	const float* right;
+	const float* down;
+	const float* up;
+};
+
+struct HeatStepResult {
+	float maxDelta;  // largest temperature change of any cell
+	int flagged;     // cells that crossed a phase-change threshold
+	int minRow;      // rows [minRow, maxRow) hold every flagged cell
+	int maxRow;
+};
+
+// One explicit heat diffusion step over a chunk's temperature plane:
+//
+//   t' = t + rate * ((left + right) + (down + up) - 4t)
+//
+// run in place. The same pass flags (CellPhaseChange) every cell whose new temperature is at or
+// beyond its material's upper or lower threshold. The SSE2 and AVX2 paths evaluate exactly the
+// scalar expression in the same order, so all three give bit-identical planes; this file is
+// built with floating point contraction disabled to keep it that way.
+class HeatKernel {
+private:
+	HeatKernelISA m_ISA;
+public:
+	HeatKernel();
+	explicit HeatKernel(HeatKernelISA isa);
+
+	static HeatKernelISA detectISA();
+	static bool isSupported(HeatKernelISA isa);
+	static const char* getISAName(HeatKernelISA isa);
+
+	inline HeatKernelISA getISA() const { return m_ISA; }
+
+	HeatStepResult step(float* temperature, const MaterialID* material, uint8_t* flags, const HeatHalo& halo,
+		const float* upperThreshold, const float* lowerThreshold, float rate) const;
+};
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+
+enum MaterialPhase : uint8_t {
+	PhaseEmpty = 0,
+	PhaseGas,
+	PhaseLiquid,
+	PhasePowder,
+	PhaseSolid
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Chunk.h"
+#include "Material.h"
+
+struct Reaction {
+	MaterialID productA;
+	MaterialID productB;
+	uint16_t chance; // per contact per tick out of 65535, 0 when the pair does not react
+	uint16_t reserved;
+};
+
+// Material properties and the pairwise reaction matrix, loaded from a text file at startup and
+// flattened into one cache-aligned block of per-property arrays. Everything the cell update needs
+// is a single indexed load by MaterialID; names are only used while loading.
+//
+// File format, tokenised with stb_c_lexer:
+//
+//   material <name> { <property> <value...>; ... }
+//   reaction <a> + <b> -> <product a> + <product b> [chance];
+//
+// Material ids follow definition order and id 0 must be an empty material.
+class MaterialTable {
+private:
+	size_t m_Count = 0;
+
+	void* m_Block = nullptr;
+	size_t m_BlockSize = 0;
+
+	MaterialPhase* m_Phase = nullptr;
+	float* m_Density = nullptr;
+	float* m_Flammability = nullptr;
+	float* m_SpawnTemperature = nullptr;
+	uint8_t* m_HasSpawnTemperature = nullptr;
+
+	// a cell changes material once its temperature rises to >= the upper threshold
+	// or falls to <= the lower one, both are the nearest of the thresholds below
+	float* m_UpperThreshold = nullptr;
+	float* m_LowerThreshold = nullptr;
+
+	float* m_MeltPoint = nullptr;
+	float* m_BoilPoint = nullptr;
+	float* m_IgnitePoint = nullptr;
+	float* m_FreezePoint = nullptr;
+	float* m_CondensePoint = nullptr;
+
+	MaterialID* m_MeltsTo = nullptr;
+	MaterialID* m_BoilsTo = nullptr;
+	MaterialID* m_BurnsTo = nullptr;
+	MaterialID* m_FreezesTo = nullptr;
+	MaterialID* m_CondensesTo = nullptr;
+	MaterialID* m_DecaysTo = nullptr;
+	uint16_t* m_DecayChance = nullptr;
+	uint8_t* m_FieldGas = nullptr;
+
+	uint32_t* m_Color = nullptr;
+
+	Reaction* m_Reactions = nullptr;
+
+	std::vector<std::string> m_Names;
+	std::vector<std::string> m_Textures;
+
+	void release();
+	void allocate(size_t count);
+
+	friend class MaterialParser;
+public:
+	MaterialTable();
+	~MaterialTable();
+
+	MaterialTable(const MaterialTable&) = delete;
+	MaterialTable& operator=(const MaterialTable&) = delete;
+
+	bool loadFromFile(const std::string& path);
+	bool loadFromString(const std::string& source, const std::string& name);
+
+	inline size_t getCount() const { return m_Count; }
+	inline size_t getMemoryUsage() const { return m_BlockSize; }
+
+	inline MaterialPhase getPhase(MaterialID m) const { return m_Phase[m]; }
+	inline float getDensity(MaterialID m) const { return m_Density[m]; }
+	inline float getFlammability(MaterialID m) const { return m_Flammability[m]; }
+	inline bool hasSpawnTemperature(MaterialID m) const { return m_HasSpawnTemperature[m] != 0; }
+	inline float getSpawnTemperature(MaterialID m) const { return m_SpawnTemperature[m]; }
+	inline float getUpperThreshold(MaterialID m) const { return m_UpperThreshold[m]; }
+	inline float getLowerThreshold(MaterialID m) const { return m_LowerThreshold[m]; }
+	inline MaterialID getDecaysTo(MaterialID m) const { return m_DecaysTo[m]; }
+	inline uint16_t getDecayChance(MaterialID m) const { return m_DecayChance[m]; }
+	// lives in the coarse GasField rather than as cells, when the simulation has one
+	inline bool isFieldGas(MaterialID m) const { return m_FieldGas[m] != 0; }
+	inline uint32_t getColor(MaterialID m) const { return m_Color[m]; }
+
+	inline const Reaction& getReaction(MaterialID a, MaterialID b) const { return m_Reactions[a * m_Count + b]; }
+
+	// raw planes for vectorised kernels
+	inline const MaterialPhase* getPhases() const { return m_Phase; }
+	inline const float* getDensities() const { return m_Density; }
+	inline const float* getUpperThresholds() const { return m_UpperThreshold; }
+	inline const float* getLowerThresholds() const { return m_LowerThreshold; }
+	inline const uint32_t* getColors() const { return m_Color; }
+
+	// Material a cell of `material` at `temperature` turns into, or `material` itself.
+	// `roll` is a uniform 16 bit random number used for ignition.
+	MaterialID getPhaseChange(MaterialID material, float temperature, uint16_t roll) const;
+
+	const std::string& getName(MaterialID m) const;
+	// image file drawn over cells of the material, relative to the material file; empty for none
+	const std::string& getTexture(MaterialID m) const;
+	// slow, for tools and setup code only
+	bool findMaterial(const std::string& name, MaterialID& out) const;
+};
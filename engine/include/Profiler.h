@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Scoped timers are a compile time switch like BUFFER_TRACE: on by default, and with
+// PROFILER_ENABLED defined to 0 every PROFILE_* macro compiles to nothing. When compiled in they
+// still only record while Profiler::setEnabled(true), a relaxed load per scope otherwise.
+#ifndef PROFILER_ENABLED
+	#define PROFILER_ENABLED 1
+#endif
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#if PROFILER_ENABLED
+	// name must be a string literal (or otherwise live forever), only the pointer is stored
+	#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+	#define PROFILE_FUNCTION() PROFILE_SCOPE(__func__)
+	#define PROFILE_THREAD(name) Profiler::setThreadName(name)
+#else
+	#define PROFILE_SCOPE(name) ((void)0)
+	#define PROFILE_FUNCTION() ((void)0)
+	#define PROFILE_THREAD(name) ((void)0)
+#endif
+
+struct ProfileTrack;
+
+// Process wide collector of timed scopes. Every thread records into a ring buffer of its own,
+// created the first time it records and never locked afterwards: the owning thread writes the
+// event and then publishes it by bumping the ring's head. Readers (the trace dump, the summary)
+// copy from behind the head and drop whatever the writer may have lapped in the meantime, so
+// reading never holds up a recording thread. Old events are overwritten once a ring is full.
+class Profiler {
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	static constexpr size_t RING_CAPACITY = 1 << 16; // events per thread, a power of two
+
+	static inline bool isEnabled() { return s_Enabled.load(std::memory_order_relaxed); }
+	static void setEnabled(bool enabled);
+
+	// nanoseconds since the profiler's epoch, the time base of every event
+	static inline uint64_t now() { return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - s_Epoch).count(); }
+
+	// Names the calling thread's track in the trace.
+	static void setThreadName(const std::string& name);
+
+	// A track that is not a thread, e.g. the GPU. Lives until the process ends; only one thread
+	// may record into it.
+	static ProfileTrack* createTrack(const std::string& name);
+
+	static void record(const char* name, uint64_t start, uint64_t end);
+	static void record(ProfileTrack* track, const char* name, uint64_t start, uint64_t end);
+
+	// Writes every event still in the rings as Chrome trace JSON (chrome://tracing, Perfetto).
+	static bool writeChromeTrace(const std::string& path);
+
+	// Logs p50, p99 and the worst duration of every scope that ended in the last windowSeconds.
+	static void logSummary(double windowSeconds);
+
+	// events recorded since startup, including overwritten ones
+	static size_t getEventCount();
+private:
+	static std::atomic<bool> s_Enabled;
+	static const Clock::time_point s_Epoch;
+};
+
+class ProfileScope {
+private:
+	const char* m_Name;
+	uint64_t m_Start;
+public:
+	inline explicit ProfileScope(const char* name) : m_Name{name}, m_Start{Profiler::isEnabled() ? Profiler::now() : UINT64_MAX} {}
+	inline ~ProfileScope() {
+		if (m_Start != UINT64_MAX) Profiler::record(m_Name, m_Start, Profiler::now());
+	}
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+};
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "Chunk.h"
+#include "MaterialTable.h"
+#include "ThreadPool.h"
+#include "World.h"
+
+struct RegionSummary {
+	uint64_t cells;               // loaded cells in the rectangle, unloaded area is left out
+	float minTemperature;         // both 0 when no cell is loaded
+	float maxTemperature;
+	double temperatureSum;
+	std::vector<uint64_t> counts; // cells per MaterialID
+
+	inline double getMeanTemperature() const { return cells != 0 ? temperatureSum / cells : 0.0; }
+};
+
+// Material counts and temperature ranges kept per chunk, so questions about a rectangle of the
+// world ("how much lava is in here", "where is the hottest cell") cost a few lookups per chunk
+// instead of a read of every cell in it.
+//
+// Every chunk is split into BLOCK_SIZE square blocks, the gas field's grid, and holds for each
+// block and for the chunk as a whole a count per material and the min, max and sum of the
+// temperatures. A query takes the chunks it covers whole from the chunk totals and the blocks it
+// covers whole from the block ones; only the blocks cut by the rectangle's edges are read cell
+// by cell, so a screen-sized query reads about its perimeter in cells.
+//
+// The Simulation calls update() at the end of every tick. It goes by the chunks' own change
+// tracking, like the ChunkDeltaEncoder: the blocks under a chunk's dirty rectangle are recounted
+// when its revision moved, every block's temperatures are redone when the chunk took part in the
+// heat step, and a chunk that is new or came back under a new serial is counted whole. A settled
+// world costs a lookup per chunk.
+//
+// Queries see the world as of the last update, so they must not run during a step. Writes made
+// between two steps (e.g. paint()) show up after the next one; chunks made since the last update
+// are read cell by cell. Rectangles are in world cells, [x0, x1) by [y0, y1).
+class RegionStats {
+private:
+	static constexpr int BLOCK_SIZE_LOG2 = GAS_SCALE_LOG2;
+	static constexpr int BLOCK_SIZE = 1 << BLOCK_SIZE_LOG2;
+	static constexpr int BLOCKS_PER_SIDE = CHUNK_SIZE / BLOCK_SIZE;
+	static constexpr int BLOCK_COUNT = BLOCKS_PER_SIDE * BLOCKS_PER_SIDE;
+
+	struct Entry {
+		uint32_t serial;
+		uint32_t revision;
+		bool active;   // awake or thermally active at the last update, so it ran this tick
+		uint64_t seen; // update that last saw the chunk
+
+		float minTemperature;
+		float maxTemperature;
+		double temperatureSum;
+		std::vector<uint16_t> counts;     // per material
+		std::vector<uint8_t> blockCounts; // per block, then per material
+		float blockMin[BLOCK_COUNT];
+		float blockMax[BLOCK_COUNT];
+		float blockSum[BLOCK_COUNT];
+	};
+
+	// blocks to redo in one chunk, [min, max) in blocks on each axis
+	struct Job {
+		const Chunk* chunk;
+		Entry* entry;
+		int materialMinX, materialMinY, materialMaxX, materialMaxY;
+		int heatMinX, heatMinY, heatMaxX, heatMaxY;
+	};
+
+	const World& m_World;
+	const size_t m_MaterialCount;
+	ThreadPool* m_Pool;
+
+	std::unordered_map<uint64_t, Entry> m_Entries;
+	std::vector<Job> m_Jobs;
+	uint64_t m_Updates = 0;
+	size_t m_UpdatedChunks = 0;
+	size_t m_CountedBlocks = 0;
+
+	void runJob(const Job& job) const;
+	// the chunk's entry if it is up to date with the chunk, nullptr to read the cells
+	const Entry* findEntry(const Chunk* chunk) const;
+
+	// Calls visitor.chunk(chunk, entry) for every chunk the rectangle covers whole,
+	// visitor.block(chunk, entry, block) for every block it covers whole in the others, and
+	// visitor.cells(chunk, x0, y0, x1, y1) with local cell bounds for whatever is left.
+	template<typename V> void visit(int x0, int y0, int x1, int y1, V& visitor) const;
+public:
+	// pool may be nullptr to update everything on the calling thread
+	RegionStats(const World& world, const MaterialTable& materials, ThreadPool* pool = nullptr);
+
+	RegionStats(const RegionStats&) = delete;
+	RegionStats& operator=(const RegionStats&) = delete;
+
+	// Brings every chunk's aggregates up to date. Called by the Simulation once a tick, after
+	// the dirty rectangles were swapped.
+	void update();
+
+	// Material counts and temperatures over the rectangle. out's counts are reused.
+	void summarise(int x0, int y0, int x1, int y1, RegionSummary& out) const;
+	uint64_t countMaterial(int x0, int y0, int x1, int y1, MaterialID material) const;
+	// The hottest loaded cell in the rectangle, false when none is loaded. Ties always go to the same cell.
+	bool findHottest(int x0, int y0, int x1, int y1, int& x, int& y, float& temperature) const;
+
+	// chunks and blocks the last update() redid
+	inline size_t getUpdatedChunks() const { return m_UpdatedChunks; }
+	inline size_t getCountedBlocks() const { return m_CountedBlocks; }
+	inline size_t getEntryCount() const { return m_Entries.size(); }
+};
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+class Simulation;
+class World;
+
+enum ReplayFlag : uint32_t {
+	ReplayGenerated = 0x1,  // the world came from the WorldGenerator
+	ReplayDebris = 0x2,     // a DebrisTracker ran
+	ReplayGasField = 0x4    // field gases ran in a GasField
+};
+
+// What a run was started with. A replay only reproduces a run started the same way, so the
+// player hands this back for the caller to set up its simulation from.
+struct ReplaySettings {
+	uint32_t seed;
+	uint32_t flags;          // ReplayFlag bits
+	int32_t worldWidth;      // cells, the area a generated world covers
+	int32_t worldHeight;
+	uint64_t materialsHash;  // of the material file's bytes, see hashMaterialFile()
+};
+
+enum ReplayEventType : uint32_t {
+	ReplayPaint = 0, // Simulation::paint(x, y, value)
+	ReplayChunk = 1  // World::getOrCreateChunk(x, y), for chunks made without painting
+};
+
+struct ReplayEvent {
+	uint32_t type;   // ReplayEventType
+	int32_t x;
+	int32_t y;
+	uint32_t value;
+};
+
+// Records a run as its settings plus the input events of every tick, enough for a ReplayPlayer
+// to run it again bit for bit, whatever the thread count.
+//
+//   header   magic "CHRP", version, ReplaySettings
+//   ticks    per tick: tick, check hash, event count, then the events
+//
+// Events reach the recorder through the Simulation (see Simulation::setRecorder), stamped with
+// the tick they were made before. The check hash is whatever the caller passes to endTick(),
+// normally ChunkDeltaEncoder::getFrameHash(), and lets a replay find the first tick it went out
+// of step on.
+class ReplayRecorder {
+private:
+	std::FILE* m_File = nullptr;
+	std::vector<ReplayEvent> m_Events; // since the last endTick()
+	uint64_t m_Ticks = 0;
+	uint64_t m_EventCount = 0;
+public:
+	static constexpr uint32_t VERSION = 1;
+
+	ReplayRecorder();
+	~ReplayRecorder();
+
+	ReplayRecorder(const ReplayRecorder&) = delete;
+	ReplayRecorder& operator=(const ReplayRecorder&) = delete;
+
+	bool open(const std::string& path, const ReplaySettings& settings);
+	void close();
+	inline bool isOpen() const { return m_File != nullptr; }
+
+	inline void record(const ReplayEvent& event) { m_Events.push_back(event); }
+	// Records every chunk the world has, ahead of the events so far and in the order the world
+	// made them. Call once before the first tick, after the caller has set the world up.
+	void recordWorld(const World& world);
+	// Writes the tick that just ran with the events made before it.
+	void endTick(uint64_t tick, uint64_t checkHash);
+
+	inline uint64_t getTickCount() const { return m_Ticks; }
+	inline uint64_t getEventCount() const { return m_EventCount; }
+
+	// FNV-1a of a file's bytes, 0 when it can't be read
+	static uint64_t hashMaterialFile(const std::string& path);
+};
+
+// Plays a recording back into a Simulation set up from getSettings(). The whole file is read up
+// front; recordings are small next to the runs they describe.
+class ReplayPlayer {
+private:
+	struct TickRecord {
+		uint64_t tick;
+		uint64_t checkHash;
+		uint32_t eventCount;
+		uint32_t reserved;
+	};
+
+	std::vector<uint8_t> m_Data;
+	ReplaySettings m_Settings = {};
+	size_t m_At = 0;          // next tick record
+	size_t m_Applied = 0;     // tick record whose events were applied last, 0 for none
+	uint64_t m_LastTick = 0;  // of the recording
+	bool m_HasTicks = false;
+	bool m_Desynced = false;
+	uint64_t m_DesyncTick = 0;
+	uint64_t m_Checked = 0;
+
+	bool readRecord(TickRecord& record, size_t at) const;
+public:
+	ReplayPlayer();
+
+	ReplayPlayer(const ReplayPlayer&) = delete;
+	ReplayPlayer& operator=(const ReplayPlayer&) = delete;
+
+	bool open(const std::string& path);
+	inline bool isOpen() const { return !m_Data.empty(); }
+	inline const ReplaySettings& getSettings() const { return m_Settings; }
+
+	// Applies the events recorded before `tick`, once however often it's called for the tick.
+	// False once the recording has no more ticks.
+	bool beginTick(uint64_t tick, Simulation& simulation);
+	// Compares the hash of the tick that just ran with the recorded one. Only the first
+	// mismatch is logged; a hash of 0 on either side isn't checked.
+	bool endTick(uint64_t tick, uint64_t checkHash);
+
+	inline bool isDesynced() const { return m_Desynced; }
+	inline uint64_t getDesyncTick() const { return m_DesyncTick; }
+	inline uint64_t getCheckedTickCount() const { return m_Checked; }
+	inline uint64_t getLastTick() const { return m_LastTick; }
+};
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "FrameArena.h"
+#include "HeatKernel.h"
+#include "MaterialTable.h"
+#include "ThreadPool.h"
+#include "World.h"
+
+class DebrisTracker;
+class GasField;
+class RegionStats;
+class ReplayRecorder;
+
+// Falling-sand cell update. Only the dirty rectangle of awake chunks is visited,
+// so a settled map costs next to nothing per tick. Movement, reactions and decay are
+// all driven by lookups into the MaterialTable.
+//
+// Every tick starts with a heat diffusion step over each chunk that is awake or still
+// thermally active, which also flags cells that crossed a phase-change threshold; the
+// cell update then turns flagged cells into their new material.
+//
+// With a GasField attached, field gases leave the grid the first time the cell update meets
+// them and are moved by the field's own step, which runs right after the heat step.
+//
+// A tick runs as four checkerboard passes over the chunks (see Chunk::getCheckerboardPass),
+// each pass spread across the thread pool. Every chunk draws its random numbers from a
+// generator seeded by (seed, tick, chunk position), so the result for a given seed is the
+// same whatever the thread count.
+//
+// Everything a tick needs only for that tick (the chunk lists, and scratch data of the update
+// itself) comes from per-thread frame arenas that are rewound at the start of the next tick,
+// so a steady-state tick does no heap allocation.
+class Simulation {
+private:
+	World& m_World;
+	const MaterialTable& m_Materials;
+	ThreadPool* m_Pool;
+	DebrisTracker* m_Debris = nullptr;
+	GasField* m_Gas = nullptr;
+	ReplayRecorder* m_Recorder = nullptr;
+	RegionStats* m_RegionStats = nullptr;
+
+	uint64_t m_Tick = 0;
+	const uint32_t m_Seed;
+
+	// one per pool thread
+	std::vector<std::unique_ptr<FrameArena>> m_Arenas;
+
+	struct ChunkList {
+		Chunk** chunks;
+		size_t count;
+	};
+
+	// in m_Arenas[0], valid for the current tick
+	ChunkList m_Passes[4] = {};
+	ChunkList m_HeatChunks = {};
+
+	HeatKernel m_Heat;
+	float m_HeatRate = 0.2f;
+
+	template<typename F> void forEachChunk(const ChunkList& list, F&& fn) {
+		if (m_Pool) {
+			m_Pool->parallelFor(list.count, [&list, &fn](size_t i) { fn(list.chunks[i]); });
+		} else {
+			for (size_t i = 0; i < list.count; i++) fn(list.chunks[i]);
+		}
+	}
+
+	struct CellRef {
+		Chunk* chunk;
+		int x;
+		int y;
+		int index;
+	};
+
+	static bool resolve(Chunk* chunk, int x, int y, CellRef& out);
+
+	static uint32_t nextRandom(uint32_t& state);
+	uint32_t chunkSeed(const Chunk* chunk) const;
+
+	void stepHeat();
+	void diffuseChunk(Chunk* chunk);
+	void updateChunk(Chunk* chunk);
+
+	bool canDisplace(float density, const CellRef& target) const;
+	bool fall(const CellRef& cell, float density, int direction);
+	bool slide(const CellRef& cell, float density, int dy, int reach, uint32_t& random);
+	bool react(const CellRef& cell, MaterialID material, uint32_t& random);
+	void swapCells(const CellRef& a, const CellRef& b);
+	void replaceCell(const CellRef& cell, MaterialID material);
+public:
+	static constexpr int MAX_FALL_SPEED = 8; // cells per tick, must stay below CHUNK_SIZE / 2
+	static constexpr float THERMAL_EPSILON = 0.01f; // chunks whose cells all change less than this stop diffusing
+
+	// pool may be nullptr to update everything on the calling thread
+	Simulation(World& world, const MaterialTable& materials, uint32_t seed, ThreadPool* pool = nullptr);
+
+	void step();
+
+	// Places a material at a world position, starting it at the material's spawn temperature.
+	void paint(int x, int y, MaterialID material);
+
+	// Runs the tracker at the start of every tick, nullptr turns debris off. Not owned.
+	inline void setDebrisTracker(DebrisTracker* debris) { m_Debris = debris; }
+	inline DebrisTracker* getDebrisTracker() const { return m_Debris; }
+
+	// Field gases go into the field instead of moving as cells, nullptr keeps them cells. Not owned.
+	inline void setGasField(GasField* gas) { m_Gas = gas; }
+	inline GasField* getGasField() const { return m_Gas; }
+
+	// Every paint() from here on is recorded as an input event, nullptr stops recording. Not owned.
+	inline void setRecorder(ReplayRecorder* recorder) { m_Recorder = recorder; }
+	inline ReplayRecorder* getRecorder() const { return m_Recorder; }
+
+	// Brought up to date at the end of every tick, nullptr stops updating it. Not owned.
+	inline void setRegionStats(RegionStats* stats) { m_RegionStats = stats; }
+	inline RegionStats* getRegionStats() const { return m_RegionStats; }
+
+	// must stay below 0.25 for the explicit diffusion step to be stable
+	inline void setHeatRate(float rate) { m_HeatRate = rate; }
+	inline void setHeatKernel(const HeatKernel& kernel) { m_Heat = kernel; }
+	inline const HeatKernel& getHeatKernel() const { return m_Heat; }
+
+	// Scratch memory of the calling thread for the tick being run, gone at the next step().
+	FrameArena& getFrameArena();
+	// summed over every thread's arena
+	FrameArenaStats getFrameArenaStats() const;
+	void resetFrameArenaStats();
+
+	inline uint64_t getTick() const { return m_Tick; }
+	inline uint32_t getSeed() const { return m_Seed; }
+	inline World& getWorld() { return m_World; }
+	inline const MaterialTable& getMaterials() const { return m_Materials; }
+};
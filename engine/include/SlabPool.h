@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+struct SlabPoolStats {
+	size_t allocations;     // allocate() calls
+	size_t frees;           // release() calls
+	size_t slabAllocations; // times the pool itself went to the heap
+	size_t inUse;
+	size_t peakInUse;
+	size_t capacity;        // objects the slabs allocated so far can hold
+};
+
+// Fixed-size object pool. Memory comes from the heap a slab of objectsPerSlab objects at a
+// time and released objects go on a free list for the next allocate(), so once the pool has
+// grown to the working set, objects come and go without touching the heap. Slabs are only
+// given back when the pool is destroyed. Not thread-safe.
+class SlabPool {
+private:
+	struct FreeObject {
+		FreeObject* next;
+	};
+
+	const size_t m_Alignment;
+	const size_t m_ObjectSize; // rounded up so every object in a slab stays aligned
+	const size_t m_ObjectsPerSlab;
+
+	std::vector<void*> m_Slabs;
+	FreeObject* m_Free = nullptr;
+
+	size_t m_Allocations = 0;
+	size_t m_Frees = 0;
+	size_t m_InUse = 0;
+	size_t m_PeakInUse = 0;
+
+	void grow();
+public:
+	SlabPool(size_t objectSize, size_t alignment, size_t objectsPerSlab);
+	~SlabPool();
+
+	SlabPool(const SlabPool&) = delete;
+	SlabPool& operator=(const SlabPool&) = delete;
+
+	// uninitialised memory for one object, aligned as asked for at construction
+	void* allocate();
+	void release(void* object);
+
+	// grows the pool until it can hand out count objects without going to the heap
+	void reserve(size_t count);
+
+	SlabPoolStats getStats() const;
+
+	inline size_t getObjectSize() const { return m_ObjectSize; }
+	inline size_t getInUse() const { return m_InUse; }
+	inline size_t getCapacity() const { return m_Slabs.size() * m_ObjectsPerSlab; }
+	inline size_t getMemoryUsage() const { return getCapacity() * m_ObjectSize; }
+};
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct TextStats {
+	size_t quads;          // glyphs in the last frame
+	size_t layoutHits;     // strings of the last frame found laid out already
+	size_t layoutMisses;   // strings of the last frame laid out anew
+	size_t cachedLayouts;
+};
+
+// Screen text for debug overlays, batched so a whole frame of it is one quad list.
+//
+// Glyphs 32 to 126 are baked once into an 8-bit coverage atlas: rasterised from a TrueType font
+// with stb_truetype, or, without a font, taken from the segments of stb_easy_font scaled up by a
+// whole number, which needs no file and draws the same everywhere. A string is laid out the first
+// time it's added and the quads kept, relative to its origin, until it goes unused for
+// EVICT_FRAMES frames, so a HUD redrawing mostly the same lines costs a copy per line.
+//
+// Every quad is axis-aligned and one atlas texel per pixel, which lets the TextRenderer draw it
+// with texelFetch and rasterise() draw exactly the same quads on the CPU, for images written
+// without a display. A vertex is x, y, u, v: x and y in pixels from the top left of the screen,
+// u and v in atlas texels, with the colour index folded into v as v + color * getColorStride().
+class TextOverlay {
+private:
+	struct Glyph {
+		uint16_t x;        // top left in the atlas
+		uint16_t y;
+		uint16_t width;
+		uint16_t height;
+		int16_t offsetX;   // of the top left corner from the pen, which sits at the top of the line
+		int16_t offsetY;
+		float advance;
+	};
+
+	struct Layout {
+		std::vector<float> vertices; // as in a frame, at the origin and colour 0
+		float width;
+		uint64_t lastUsed;
+	};
+
+	static constexpr int FIRST_CHAR = 32;
+	static constexpr int GLYPH_COUNT = 95;
+	static constexpr int MAX_ATLAS_SIZE = 2048;
+	static constexpr uint64_t EVICT_FRAMES = 120;
+
+	std::vector<uint8_t> m_Atlas; // rows top to bottom
+	int m_AtlasWidth = 0;
+	int m_AtlasHeight = 0;
+	Glyph m_Glyphs[GLYPH_COUNT] = {};
+	int m_LineHeight = 0;
+
+	std::vector<uint32_t> m_Colors;
+
+	std::unordered_map<std::string, Layout> m_Layouts;
+	std::vector<float> m_Vertices;
+	std::vector<float> m_Previous;
+	uint64_t m_Frame = 0;
+	uint64_t m_Generation = 0;
+	TextStats m_Stats = {};
+
+	bool bakeTrueType(const std::string& path, float pixelHeight);
+	bool bakeBuiltin(int scale);
+	const Layout& layout(const std::string& text);
+public:
+	static constexpr int MAX_COLORS = 16;
+	static constexpr int VERTEX_FLOATS = 4;
+
+	TextOverlay();
+
+	TextOverlay(const TextOverlay&) = delete;
+	TextOverlay& operator=(const TextOverlay&) = delete;
+
+	// Bakes the atlas from a TrueType font at pixelHeight, or from the built-in font at a whole
+	// multiple of its 12 pixel lines when fontPath is empty. A font that can't be read or baked is
+	// logged and the built-in one used instead. Drops every cached layout.
+	void load(const std::string& fontPath, float pixelHeight, int builtinScale = 2);
+
+	// 0xRRGGBBAA like material colours, colour 0 is opaque white until set
+	void setColor(int index, uint32_t color);
+	inline uint32_t getColor(int index) const { return m_Colors[index]; }
+
+	// A frame is everything added between begin() and end().
+	void begin();
+	// x, y is the top left of the first line in pixels, '\n' starts a new line.
+	void addText(float x, float y, const std::string& text, int color = 0);
+	void end();
+
+	// width of the widest line in pixels
+	float measure(const std::string& text);
+	inline int getLineHeight() const { return m_LineHeight; }
+
+	inline const std::vector<float>& getVertices() const { return m_Vertices; }
+	inline size_t getQuadCount() const { return m_Vertices.size() / (4 * VERTEX_FLOATS); }
+	// changes only when a frame came out different from the one before, so the GPU copy of the
+	// quads is only replaced then
+	inline uint64_t getGeneration() const { return m_Generation; }
+
+	inline const uint8_t* getAtlas() const { return m_Atlas.data(); }
+	inline int getAtlasWidth() const { return m_AtlasWidth; }
+	inline int getAtlasHeight() const { return m_AtlasHeight; }
+	// more than any v of a glyph, so the colour is floor(v / stride) at every corner
+	inline int getColorStride() const { return m_AtlasHeight * 2; }
+
+	// Blends the last frame into an RGBA8 image with rows top to bottom.
+	void rasterise(uint8_t* rgba, int width, int height) const;
+	// Writes an RGBA8 image, rows top to bottom, as a PNG. False, logged, when it can't.
+	static bool writePng(const std::string& path, const uint8_t* rgba, int width, int height);
+
+	inline const TextStats& getStats() const { return m_Stats; }
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Buffer.h"
+#include "TextOverlay.h"
+
+// Draws the last frame of a TextOverlay over whatever is on screen, with one indexed draw call.
+// The quads are copied into the vertex buffer only when the overlay's generation moved, and the
+// index buffer only ever grows, since every quad takes the same six indices from its first vertex.
+//
+// Needs a current OpenGL 4.5 context for its whole lifetime.
+class TextRenderer {
+private:
+	GLuint m_Program = 0;
+	GLuint m_AtlasTexture = 0;
+	GLint m_ScreenLocation = -1;
+	GLint m_ColorStrideLocation = -1;
+	GLint m_ColorsLocation = -1;
+
+	VertexArray<Triangles> m_VAO;
+	VertexDataBuffer<Custom, Draw, Dynamic> m_Vertices;
+	IndexBuffer<Triangles> m_Indices;
+
+	uint64_t m_Generation = UINT64_MAX;
+	size_t m_Quads = 0;
+	size_t m_IndexedQuads = 0;
+	size_t m_BytesUploaded = 0;
+public:
+	TextRenderer();
+	~TextRenderer();
+
+	TextRenderer(const TextRenderer&) = delete;
+	TextRenderer& operator=(const TextRenderer&) = delete;
+
+	// false when a shader failed to compile, the errors have been logged
+	inline bool isValid() const { return m_Program != 0; }
+
+	// Uploads the overlay's glyph atlas; call again after every TextOverlay::load().
+	void setAtlas(const TextOverlay& overlay);
+
+	void render(const TextOverlay& overlay, int viewportWidth, int viewportHeight);
+
+	// vertex and index bytes sent since the renderer was made
+	inline size_t getBytesUploaded() const { return m_BytesUploaded; }
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MaterialTable.h"
+#include "ThreadPool.h"
+
+enum AtlasFormat : uint32_t {
+	AtlasRGBA8 = 0, // 4 bytes per pixel
+	AtlasBC3        // DXT5, 16 bytes per 4x4 block of pixels
+};
+
+struct AtlasRegion {
+	uint16_t x;      // lower left corner in the atlas, in pixels
+	uint16_t y;
+	uint16_t width;  // 0 for a material without a texture
+	uint16_t height;
+};
+
+struct AtlasSettings {
+	bool compress = false;  // BC3 blocks instead of RGBA8, a quarter of the memory
+	int maxSize = 4096;     // the atlas grows in powers of two up to this many pixels a side
+	std::string cachePath;  // where the packed atlas is cached between runs, empty for no cache
+};
+
+// Every material texture packed into one image, so all materials draw with a single bound texture.
+//
+// Building reads the image files the materials name and hashes their bytes. If the cache file
+// was written from the same bytes and settings it is loaded as is and nothing gets decoded;
+// otherwise the images are decoded with stb_image across the ThreadPool, packed with
+// stb_rect_pack, optionally compressed with stb_dxt and the result written to the cache.
+//
+// Rows run bottom to top like OpenGL textures (and world y), and every region starts on a
+// multiple of 4 pixels so no compressed block mixes two textures. Regions are meant to be
+// sampled with texelFetch and wrapped by hand, nothing is padded against filtering.
+class TextureAtlas {
+private:
+	struct Source {
+		std::string path;
+		std::vector<uint8_t> bytes;
+		uint8_t* pixels;  // stbi_load result, rows top to bottom
+		int width;
+		int height;
+		int packedWidth;  // rounded up to whole blocks
+		int packedHeight;
+		int x;
+		int y;
+	};
+
+	int m_Width = 0;
+	int m_Height = 0;
+	AtlasFormat m_Format = AtlasRGBA8;
+	std::vector<uint8_t> m_Pixels;
+	std::vector<AtlasRegion> m_Regions; // one per MaterialID
+	size_t m_TextureCount = 0;
+	bool m_FromCache = false;
+	double m_BuildSeconds = 0.0;
+
+	bool pack(std::vector<Source>& sources, int maxSize);
+	void compress(ThreadPool* pool);
+	bool loadCache(const std::string& path, uint64_t key);
+	bool saveCache(const std::string& path, uint64_t key) const;
+public:
+	static constexpr uint32_t VERSION = 1;
+	static constexpr int BLOCK_SIZE = 4;
+
+	TextureAtlas();
+	~TextureAtlas();
+
+	TextureAtlas(const TextureAtlas&) = delete;
+	TextureAtlas& operator=(const TextureAtlas&) = delete;
+
+	// Texture paths are relative to directory. A texture that can't be read or decoded is logged
+	// and its material left without one; false only when the textures don't fit in maxSize.
+	bool build(const MaterialTable& materials, const std::string& directory, ThreadPool* pool, const AtlasSettings& settings = AtlasSettings());
+	void clear();
+
+	// true when no material has a texture
+	inline bool isEmpty() const { return m_TextureCount == 0; }
+	inline int getWidth() const { return m_Width; }
+	inline int getHeight() const { return m_Height; }
+	inline AtlasFormat getFormat() const { return m_Format; }
+	inline const uint8_t* getPixels() const { return m_Pixels.data(); }
+	inline size_t getByteSize() const { return m_Pixels.size(); }
+
+	inline const AtlasRegion* getRegions() const { return m_Regions.data(); }
+	inline size_t getRegionCount() const { return m_Regions.size(); }
+	inline const AtlasRegion& getRegion(MaterialID m) const { return m_Regions[m]; }
+
+	inline size_t getTextureCount() const { return m_TextureCount; }
+	inline bool isFromCache() const { return m_FromCache; }
+	inline double getBuildSeconds() const { return m_BuildSeconds; }
+};
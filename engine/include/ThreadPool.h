@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Work-stealing pool. Every worker owns a queue it pops from the back of, idle workers
+// steal from the front of the others. The thread calling parallelFor() takes part in the
+// work through queue 0, so a pool of N threads starts N - 1 workers.
+class ThreadPool {
+private:
+	struct Task {
+		void (*run)(void* context, size_t begin, size_t end);
+		void* context;
+		size_t begin;
+		size_t end;
+		std::atomic<size_t>* remaining; // nullptr for fire-and-forget tasks
+	};
+
+	// ring buffer that only grows, so a steady stream of tasks never touches the heap
+	struct WorkQueue {
+		std::mutex mutex;
+		std::vector<Task> tasks;
+		size_t head = 0;
+		size_t count = 0;
+
+		void pushBack(const Task& task);
+		bool popBack(Task& out);
+		bool popFront(Task& out);
+	};
+
+	std::vector<std::unique_ptr<WorkQueue>> m_Queues;
+	std::vector<std::thread> m_Threads;
+
+	// Pushing and popping only touch the atomics; the mutex is taken by workers going to sleep,
+	// and by a push only when m_Sleepers says someone is asleep. Both counters are sequentially
+	// consistent, so a worker that saw no queued task is always seen as a sleeper by the push
+	// that comes after.
+	std::mutex m_SleepMutex;
+	std::condition_variable m_WakeCondition;
+	std::atomic<size_t> m_Queued{0};
+	std::atomic<unsigned> m_Sleepers{0};
+	bool m_Stopping = false;
+
+	std::atomic<size_t> m_Unfinished{0};
+	std::atomic<unsigned> m_NextQueue{0};
+
+	void workerLoop(unsigned index);
+	unsigned currentQueue() const;
+	void push(unsigned queue, const Task& task);
+	void wake(bool all);
+	bool tryRunTask(unsigned self);
+	void runTask(const Task& task);
+
+	void dispatch(size_t count, void (*run)(void*, size_t, size_t), void* context);
+public:
+	explicit ThreadPool(unsigned threads = std::thread::hardware_concurrency());
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Queues a task and returns immediately.
+	void submit(std::function<void()> task);
+
+	// Runs body(i) for every i in [0, count) across the pool and returns once all are done.
+	template<typename F> void parallelFor(size_t count, F&& body) {
+		typedef std::remove_reference_t<F> Body;
+		dispatch(count, [](void* context, size_t begin, size_t end) {
+			Body& fn = *static_cast<Body*>(context);
+			for (size_t i = begin; i < end; i++) fn(i);
+		}, const_cast<void*>(static_cast<const void*>(&body)));
+	}
+
+	// Blocks, helping out with queued work, until every submitted task has finished.
+	void waitIdle();
+
+	inline unsigned getThreadCount() const { return (unsigned)m_Queues.size(); }
+	// index in [0, getThreadCount()) of the pool thread calling, threads outside the pool get 0
+	inline unsigned getCurrentThread() const { return currentQueue(); }
+};
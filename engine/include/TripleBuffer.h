@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free handoff of the latest value from one writer thread to one reader thread.
+// The writer fills getWriteBuffer() and publish()es it, the reader acquire()s the newest
+// published buffer and reads it through getReadBuffer() until its next acquire(). Neither
+// side ever waits; a buffer published twice before the reader looks is simply skipped.
+template<typename T>
+class TripleBuffer {
+private:
+	static constexpr uint8_t INDEX_MASK = 0x3;
+	static constexpr uint8_t FRESH = 0x4; // the shared buffer was published and not acquired yet
+
+	T m_Buffers[3];
+
+	// alignas keeps the shared index away from the writer's and reader's own indices
+	alignas(64) std::atomic<uint8_t> m_Shared{1};
+	alignas(64) uint8_t m_Write = 0;
+	alignas(64) uint8_t m_Read = 2;
+public:
+	TripleBuffer() = default;
+
+	TripleBuffer(const TripleBuffer&) = delete;
+	TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+	// writer side
+	inline T& getWriteBuffer() { return m_Buffers[m_Write]; }
+	inline void publish() {
+		m_Write = m_Shared.exchange(m_Write | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+	}
+
+	// reader side, returns false and keeps the current buffer when nothing new was published
+	inline bool acquire() {
+		if ((m_Shared.load(std::memory_order_relaxed) & FRESH) == 0) return false;
+		m_Read = m_Shared.exchange(m_Read, std::memory_order_acq_rel) & INDEX_MASK;
+		return true;
+	}
+	inline const T& getReadBuffer() const { return m_Buffers[m_Read]; }
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "Chunk.h"
+#include "SlabPool.h"
+
+// Fills in chunks the World creates, e.g. from a save file. Called once per new chunk, after it
+// has been linked to its neighbours; returns false to leave the chunk empty.
+class ChunkLoader {
+public:
+	virtual ~ChunkLoader() {}
+	virtual bool loadChunk(Chunk& chunk) = 0;
+};
+
+// Sparse grid of fixed-size chunks. Only chunks that have been created take memory,
+// so a huge map costs as much as the area that is actually in use.
+class World {
+private:
+	static constexpr size_t CHUNKS_PER_SLAB = 16;
+
+	// declared before the chunks so it outlives them
+	SlabPool m_CellPool{sizeof(ChunkCells), alignof(ChunkCells), CHUNKS_PER_SLAB};
+
+	std::unordered_map<uint64_t, std::unique_ptr<Chunk>> m_Chunks;
+	std::vector<Chunk*> m_ChunkList;
+
+	size_t m_AwakeChunks = 0;
+	uint32_t m_NextSerial = 1;
+
+	ChunkLoader* m_Loader = nullptr;
+
+	void linkNeighbours(Chunk* chunk);
+	void unlinkNeighbours(Chunk* chunk);
+public:
+	World();
+	~World();
+
+	World(const World&) = delete;
+	World& operator=(const World&) = delete;
+
+	static constexpr uint64_t chunkKey(int chunkX, int chunkY) { return (uint64_t)(uint32_t)chunkX << 32 | (uint32_t)chunkY; }
+	static constexpr int toChunkCoord(int worldCoord) { return worldCoord >> CHUNK_SIZE_LOG2; }
+	static constexpr int toLocalCoord(int worldCoord) { return worldCoord & (CHUNK_SIZE - 1); }
+
+	// the loader must outlive the world or be unset first, nullptr creates empty chunks
+	inline void setChunkLoader(ChunkLoader* loader) { m_Loader = loader; }
+	inline ChunkLoader* getChunkLoader() const { return m_Loader; }
+
+	Chunk* getChunk(int chunkX, int chunkY) const;
+	// creates missing chunks through the chunk loader, if one is set
+	Chunk* getOrCreateChunk(int chunkX, int chunkY);
+	void removeChunk(int chunkX, int chunkY);
+	void clear();
+
+	inline Chunk* getChunkAt(int x, int y) const { return getChunk(toChunkCoord(x), toChunkCoord(y)); }
+
+	// world space cell access, missing chunks read as empty (material 0) at AMBIENT_TEMPERATURE
+	MaterialID getMaterial(int x, int y) const;
+	float getTemperature(int x, int y) const;
+	void setMaterial(int x, int y, MaterialID material);
+	void setTemperature(int x, int y, float temperature);
+
+	// Ends a tick: every chunk's collected writes become its update area and sleeping
+	// chunks are counted. Returns the number of chunks that are awake for the next tick.
+	size_t swapDirtyRects();
+
+	inline const std::vector<Chunk*>& getChunks() const { return m_ChunkList; }
+	inline size_t getChunkCount() const { return m_ChunkList.size(); }
+	inline size_t getAwakeChunkCount() const { return m_AwakeChunks; }
+	inline size_t getSleepingChunkCount() const { return m_ChunkList.size() - m_AwakeChunks; }
+	// counts the whole cell pool, including the storage of removed chunks kept for reuse
+	size_t getMemoryUsage() const;
+	inline const SlabPool& getCellPool() const { return m_CellPool; }
+	// pre-allocates cell storage for this many chunks, e.g. the ones a view can show at once
+	inline void reserveChunks(size_t count) { m_CellPool.reserve(count); }
+};
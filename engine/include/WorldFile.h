@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Chunk.h"
+#include "World.h"
+
+// Chunk-addressable save file.
+//
+//   header    magic "CHMW", version, CHUNK_SIZE, chunk count
+//   index     one entry per chunk sorted by World::chunkKey: key, offset, size
+//   chunks    per chunk the material, temperature and static-flag planes, each either
+//             run-length encoded or (materials only) bit-packed against a small palette,
+//             whichever is smaller
+//
+// A loaded file is memory-mapped and nothing is read up front: looking a chunk up is a binary
+// search over the mapped index and a chunk is only decoded when the World creates it, so opening
+// a huge world costs the same as a small one and only the pages of chunks in use are ever read.
+// Integers are stored little-endian as they sit in memory.
+class WorldFile : public ChunkLoader {
+private:
+	struct IndexEntry {
+		uint64_t key;
+		uint64_t offset;
+		uint32_t size;
+		uint32_t reserved;
+	};
+
+	// What a chunk looked like when it was last checked against the file, to tell whether it
+	// can be dropped again. The revision also moves when the chunk is merely woken (by a
+	// neighbour loading, or cells moving near its border), so it only says when to look again.
+	struct LoadedChunk {
+		uint32_t serial;
+		uint32_t revision;
+		bool changed;  // its cells differed from the file at that revision
+	};
+
+	std::string m_Path;
+	const uint8_t* m_Data = nullptr;
+	size_t m_Size = 0;
+#ifdef _WIN32
+	void* m_FileHandle = nullptr;
+	void* m_MappingHandle = nullptr;
+#endif
+
+	const IndexEntry* m_Index = nullptr;
+	uint32_t m_ChunkCount = 0;
+
+	std::unordered_map<uint64_t, LoadedChunk> m_Loaded;
+
+	// the stored chunk decoded by matchesFile()
+	std::vector<MaterialID> m_FileMaterials;
+	std::vector<float> m_FileTemperatures;
+	std::vector<uint8_t> m_FileFlags;
+
+	const IndexEntry* find(uint64_t key) const;
+	bool decode(const IndexEntry& entry, MaterialID* materials, float* temperatures, uint8_t* flags) const;
+	// whether saving the chunk would store what the file already holds for it
+	bool matchesFile(const IndexEntry& entry, const Chunk& chunk);
+public:
+	static constexpr uint32_t VERSION = 1;
+
+	WorldFile();
+	~WorldFile();
+
+	WorldFile(const WorldFile&) = delete;
+	WorldFile& operator=(const WorldFile&) = delete;
+
+	// Writes every chunk of the world. When source is given, the chunks it holds that are not
+	// loaded in the world are copied over still compressed, so a streamed world saves whole.
+	// The file is written next to path and renamed over it once complete.
+	static bool save(const World& world, const std::string& path, const WorldFile* source = nullptr);
+
+	bool open(const std::string& path);
+	void close();
+	inline bool isOpen() const { return m_Data != nullptr; }
+	inline const std::string& getPath() const { return m_Path; }
+
+	inline size_t getChunkCount() const { return m_ChunkCount; }
+	inline size_t getLoadedCount() const { return m_Loaded.size(); }
+	inline size_t getFileSize() const { return m_Size; }
+	bool contains(int chunkX, int chunkY) const;
+
+	// ChunkLoader, decodes the chunk if the file has it
+	bool loadChunk(Chunk& chunk) override;
+
+	// Creates every stored chunk inside the (inclusive) chunk rectangle that the world does not
+	// have yet, returns how many were loaded. Call as the view moves.
+	size_t loadRegion(World& world, int minChunkX, int minChunkY, int maxChunkX, int maxChunkY);
+
+	// Removes chunks outside the rectangle that came from this file, have settled and whose cells
+	// are what the file holds, they read back from the file when needed. Chunks that changed stay
+	// until saved.
+	size_t unloadOutside(World& world, int minChunkX, int minChunkY, int maxChunkX, int maxChunkY);
+};
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Chunk.h"
+#include "MaterialTable.h"
+#include "ThreadPool.h"
+#include "World.h"
+
+struct stbhw_tileset;
+
+struct WorldGeneratorSettings {
+	int surfaceHeight = 1536;    // average height of the ground, in cells
+	int surfaceAmplitude = 192;  // how far hills and valleys reach above and below it
+	int soilDepth = 24;          // sand over the stone, thinner on hills and thicker in valleys
+	int bedrockHeight = 12;      // anchored stone at the bottom of the world
+	int caveDepth = 64;          // caves stay this far below the surface
+	int lavaHeight = 192;        // caves below this fill with lava
+	float caveOpenness = 0.4f;   // 0 closes every cave, 1 carves out most of the underground
+};
+
+// Fills chunks from a seed: perlin terrain, sand over stone with sediment bands and oil and water
+// pockets in it, and caves laid out by herringbone Wang tiles, lava-filled near the bottom.
+//
+// Every chunk is a pure function of the seed and its position, so chunks can be generated in any
+// order, on any thread, and always come out the same. The only shared state is the cave layout,
+// made one CAVE_REGION_SIZE square at a time with stb_herringbone_wang_tile (single threaded, the
+// library keeps its state in globals) before the chunks that need it are filled in parallel.
+// Caves close up towards the edges of a region, as neighbouring layouts don't line up.
+//
+// As a ChunkLoader it fills chunks the World creates one by one; generate() instead creates a
+// whole area at once across a ThreadPool, nearest to a focus point first.
+class WorldGenerator : public ChunkLoader {
+private:
+	struct Area {
+		int minChunkX, minChunkY, maxChunkX, maxChunkY;
+		int focusX, focusY;
+	};
+
+	struct PendingChunk {
+		Chunk* chunk;
+		const uint8_t* caves;
+	};
+
+	const MaterialTable& m_Materials;
+	uint32_t m_Seed;
+	WorldGeneratorSettings m_Settings;
+
+	MaterialID m_Stone = 0;
+	MaterialID m_Sand = 0;
+	MaterialID m_Water = 0;
+	MaterialID m_Lava = 0;
+	MaterialID m_Oil = 0;
+	bool m_Valid = false;
+
+	std::unique_ptr<stbhw_tileset> m_Tileset;
+	// cave openness per cell (0-255) of every region laid out so far
+	std::unordered_map<uint64_t, std::unique_ptr<uint8_t[]>> m_Caves;
+	std::vector<uint8_t> m_CaveImage;
+
+	// chunks of the last area asked for, nearest to its focus first
+	Area m_OrderArea = {};
+	std::vector<std::pair<int, int>> m_Order;
+	std::vector<PendingChunk> m_Pending;
+
+	size_t m_ChunksGenerated = 0;
+
+	void buildTileset();
+	const uint8_t* getCaves(int regionX, int regionY);
+	inline const uint8_t* getChunkCaves(int chunkX, int chunkY) {
+		return getCaves(chunkX >> (CAVE_REGION_SIZE_LOG2 - CHUNK_SIZE_LOG2), chunkY >> (CAVE_REGION_SIZE_LOG2 - CHUNK_SIZE_LOG2));
+	}
+
+	// writes every plane of the chunk and nothing else, safe to run on many chunks at once
+	void fillChunk(Chunk& chunk, const uint8_t* caves) const;
+	static void wakeChunk(Chunk& chunk);
+public:
+	static constexpr int CAVE_REGION_SIZE_LOG2 = 10;
+	static constexpr int CAVE_REGION_SIZE = 1 << CAVE_REGION_SIZE_LOG2;
+	static constexpr int CAVE_TILE_SIZE = 48; // short side of a Wang tile, in cells
+
+	WorldGenerator(const MaterialTable& materials, uint32_t seed, const WorldGeneratorSettings& settings = WorldGeneratorSettings());
+	~WorldGenerator();
+
+	WorldGenerator(const WorldGenerator&) = delete;
+	WorldGenerator& operator=(const WorldGenerator&) = delete;
+
+	// false when the materials have no stone to build from
+	inline bool isValid() const { return m_Valid; }
+	inline uint32_t getSeed() const { return m_Seed; }
+	inline const WorldGeneratorSettings& getSettings() const { return m_Settings; }
+
+	// ChunkLoader, generates the chunk on the calling thread
+	bool loadChunk(Chunk& chunk) override;
+
+	// Creates and generates up to maxChunks of the chunks missing from the (inclusive) chunk
+	// rectangle, the ones closest to the focus cell first, in parallel on the pool if there is
+	// one. Returns how many were generated; call every tick with a small budget to stream the
+	// world in around the camera.
+	size_t generate(World& world, ThreadPool* pool, int minChunkX, int minChunkY, int maxChunkX, int maxChunkY,
+		int focusX, int focusY, size_t maxChunks = SIZE_MAX);
+
+	inline size_t getChunksGenerated() const { return m_ChunksGenerated; }
+	inline size_t getCaveRegionCount() const { return m_Caves.size(); }
+};
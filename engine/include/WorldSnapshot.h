@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "Chunk.h"
+#include "World.h"
+
+// Copy of the part of a chunk the renderer needs, as it was at the end of a tick.
+struct ChunkSnapshot {
+	int chunkX;
+	int chunkY;
+	uint32_t serial;
+	uint32_t revision;
+	uint64_t captured; // capture() call that last saw the chunk
+
+	alignas(64) MaterialID materials[CHUNK_CELLS];
+	// per gas cell, how full of each GasField species it is, 255 for a cell's worth in every cell
+	alignas(64) uint8_t gas[GAS_CELLS][GAS_SPECIES];
+
+	inline int getChunkX() const { return chunkX; }
+	inline int getChunkY() const { return chunkY; }
+	inline uint32_t getSerial() const { return serial; }
+	inline uint32_t getRevision() const { return revision; }
+	inline const MaterialID* getMaterials() const { return materials; }
+	inline const uint8_t* getGas() const { return &gas[0][0]; }
+};
+
+// Immutable view of a World handed from the simulation thread to the render thread. A snapshot
+// is refreshed in place: capture() only copies chunks whose revision moved since this snapshot
+// last saw them, so keeping several snapshots in rotation costs one copy per changed chunk each.
+class WorldSnapshot {
+private:
+	std::unordered_map<uint64_t, std::unique_ptr<ChunkSnapshot>> m_Chunks;
+	std::vector<const ChunkSnapshot*> m_ChunkList;
+
+	uint64_t m_Tick = 0;
+	uint64_t m_Captures = 0;
+public:
+	WorldSnapshot();
+
+	WorldSnapshot(const WorldSnapshot&) = delete;
+	WorldSnapshot& operator=(const WorldSnapshot&) = delete;
+
+	// Brings the snapshot up to date with the world and returns the number of chunks copied.
+	// Must not run at the same time as a Simulation::step() on the same world.
+	size_t capture(const World& world, uint64_t tick);
+
+	inline uint64_t getTick() const { return m_Tick; }
+	inline const std::vector<const ChunkSnapshot*>& getChunks() const { return m_ChunkList; }
+	inline size_t getChunkCount() const { return m_ChunkList.size(); }
+};
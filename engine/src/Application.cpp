@@ -1,8 +1,459 @@
 #include "Application.h"
 
-#include <iostream>
-#include <glm/vec3.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
 
-Application::Application() {
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <spdlog/spdlog.h>
 
-}
\ No newline at end of file
+#include "GpuProfiler.h"
+#include "Profiler.h"
+#include "TextRenderer.h"
+#include "TextureAtlas.h"
+
+namespace {
+	typedef std::chrono::steady_clock Clock;
+
+	double secondsSince(Clock::time_point start) {
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	std::string directoryOf(const std::string& path) {
+		const size_t slash = path.find_last_of("/\\");
+		return slash == std::string::npos ? std::string() : path.substr(0, slash);
+	}
+
+	// The snapshot as the texture renderer draws it, less the textures and gas field, into an
+	// RGBA8 image with rows top to bottom. Each chunk fills the pixels whose centres it covers.
+	void drawSnapshot(const WorldSnapshot& snapshot, const MaterialTable& materials, const RenderView& view, uint8_t* rgba) {
+		const float scaleX = view.viewportWidth / view.width;
+		const float scaleY = view.viewportHeight / view.height;
+		for (const ChunkSnapshot* chunk : snapshot.getChunks()) {
+			const float left = chunk->getChunkX() * CHUNK_SIZE - view.left;
+			const float bottom = chunk->getChunkY() * CHUNK_SIZE - view.bottom;
+			const int x0 = std::max((int)std::ceil(left * scaleX - 0.5f), 0);
+			const int x1 = std::min((int)std::ceil((left + CHUNK_SIZE) * scaleX - 0.5f), view.viewportWidth);
+			const int y0 = std::max((int)std::ceil(bottom * scaleY - 0.5f), 0);
+			const int y1 = std::min((int)std::ceil((bottom + CHUNK_SIZE) * scaleY - 0.5f), view.viewportHeight);
+			for (int py = y0; py < y1; py++) {
+				const int cy = std::min((int)((py + 0.5f) / scaleY - bottom), CHUNK_SIZE - 1);
+				uint8_t* row = rgba + (size_t)(view.viewportHeight - 1 - py) * view.viewportWidth * 4;
+				for (int px = x0; px < x1; px++) {
+					const int cx = std::min((int)((px + 0.5f) / scaleX - left), CHUNK_SIZE - 1);
+					const uint32_t color = materials.getColor(chunk->getMaterials()[cy * CHUNK_SIZE + cx]);
+					const uint32_t alpha = color & 0xff;
+					uint8_t* pixel = row + px * 4;
+					pixel[0] = (uint8_t)((color >> 24) * alpha / 255);
+					pixel[1] = (uint8_t)(((color >> 16) & 0xff) * alpha / 255);
+					pixel[2] = (uint8_t)(((color >> 8) & 0xff) * alpha / 255);
+					pixel[3] = 255;
+				}
+			}
+		}
+	}
+}
+
+Application::Application(const ApplicationConfig& config) : m_Config{config} {
+
+}
+
+Application::~Application() {
+	stop();
+	destroyWindow();
+}
+
+bool Application::init() {
+	Profiler::setEnabled(m_Config.profile);
+	PROFILE_THREAD("main");
+	if (!m_Config.replayPath.empty()) {
+		m_Player.reset(new ReplayPlayer());
+		if (!m_Player->open(m_Config.replayPath)) return false;
+		const ReplaySettings& settings = m_Player->getSettings();
+		m_Config.headless = true;
+		m_Config.seed = settings.seed;
+		m_Config.worldWidth = settings.worldWidth;
+		m_Config.worldHeight = settings.worldHeight;
+		m_Config.generateWorld = (settings.flags & ReplayGenerated) != 0;
+		m_Config.debris = (settings.flags & ReplayDebris) != 0;
+		m_Config.gasField = (settings.flags & ReplayGasField) != 0;
+		if (settings.materialsHash != ReplayRecorder::hashMaterialFile(m_Config.materialsPath)) {
+			spdlog::warn("{} changed since the recording was made, the replay will likely go out of step", m_Config.materialsPath);
+		}
+	}
+	if (!m_Materials.loadFromFile(m_Config.materialsPath)) return false;
+
+	const unsigned int threads = m_Config.threads != 0 ? m_Config.threads : std::max(std::thread::hardware_concurrency(), 1u);
+	if (threads > 1) m_Pool.reset(new ThreadPool(threads));
+	m_Simulation.reset(new Simulation(m_World, m_Materials, m_Config.seed, m_Pool.get()));
+	if (m_Config.generateWorld) {
+		m_Generator.reset(new WorldGenerator(m_Materials, m_Config.seed, m_Config.generator));
+		if (!m_Generator->isValid()) return false;
+		m_World.setChunkLoader(m_Generator.get());
+	}
+	if (m_Config.debris) {
+		m_Debris.reset(new DebrisTracker(m_World, m_Materials));
+		m_Simulation->setDebrisTracker(m_Debris.get());
+	}
+	if (m_Config.gasField) {
+		m_Gas.reset(new GasField(m_World, m_Materials, m_Config.seed, m_Pool.get()));
+		m_Simulation->setGasField(m_Gas.get());
+	}
+	if (m_Config.regionStats) {
+		m_Regions.reset(new RegionStats(m_World, m_Materials, m_Pool.get()));
+		m_Simulation->setRegionStats(m_Regions.get());
+	}
+	if (!m_Config.recordPath.empty()) {
+		const uint32_t flags = (m_Config.generateWorld ? (uint32_t)ReplayGenerated : 0u) | (m_Config.debris ? (uint32_t)ReplayDebris : 0u) | (m_Config.gasField ? (uint32_t)ReplayGasField : 0u);
+		const ReplaySettings settings{m_Config.seed, flags, m_Config.worldWidth, m_Config.worldHeight, ReplayRecorder::hashMaterialFile(m_Config.materialsPath)};
+		m_Recorder.reset(new ReplayRecorder());
+		if (!m_Recorder->open(m_Config.recordPath, settings)) return false;
+		m_Simulation->setRecorder(m_Recorder.get());
+	}
+	if (!m_Config.deltaPath.empty()) {
+		m_Deltas.reset(new DeltaStream());
+		if (!m_Deltas->open(m_Config.deltaPath)) return false;
+	}
+	if (m_Recorder || m_Player || m_Deltas) m_Encoder.reset(new ChunkDeltaEncoder());
+	if (m_Config.hud && (!m_Config.headless || !m_Config.hudImagePath.empty())) {
+		m_Hud.reset(new DebugHud(m_Materials));
+		m_Text.load(m_Config.hudFontPath, m_Config.hudFontSize);
+	}
+
+	spdlog::info("Simulating on {} thread(s) with the {} heat kernel", threads, HeatKernel::getISAName(m_Simulation->getHeatKernel().getISA()));
+	return true;
+}
+
+int Application::run() {
+	if (!m_Simulation) {
+		spdlog::error("Application::run() called before a successful init()");
+		return -1;
+	}
+	// the scene the caller built, or the one the recording was made from, is in place before
+	// anything is generated
+	if (m_Recorder) m_Recorder->recordWorld(m_World);
+	if (m_Player) m_Player->beginTick(m_Simulation->getTick() + 1, *m_Simulation);
+	if (m_Generator) {
+		// a recorded run can't stream the view in over the first ticks, its replay generates it all up front
+		const Clock::time_point start = Clock::now();
+		const size_t generated = generateView(m_Config.headless || m_Recorder ? SIZE_MAX : GENERATE_CHUNKS_AT_START);
+		spdlog::info("Generated {} chunks in {:.3f} s", generated, secondsSince(start));
+	}
+	// the world is filled between init() and run(), so the grid is built from it only now
+	if (m_Debris && !m_Debris->hasRegion()) {
+		const int centre = World::toChunkCoord(m_Config.worldWidth / 2);
+		m_Debris->setRegion(centre - DebrisTracker::GRID_CHUNKS / 2, 0);
+	}
+	return m_Config.headless ? runHeadless() : runWindowed();
+}
+
+bool Application::createWindow() {
+	if (!glfwInit()) {
+		spdlog::error("Could not initialise GLFW");
+		return false;
+	}
+
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_VISIBLE, m_Config.visible ? GLFW_TRUE : GLFW_FALSE);
+
+	m_Window = glfwCreateWindow(m_Config.windowWidth, m_Config.windowHeight, m_Config.title.c_str(), NULL, NULL);
+	if (!m_Window) {
+		spdlog::error("Could not create a window with an OpenGL 4.5 context");
+		glfwTerminate();
+		return false;
+	}
+
+	glfwMakeContextCurrent(m_Window);
+	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+		spdlog::error("Could not load the OpenGL functions");
+		destroyWindow();
+		return false;
+	}
+	glfwSwapInterval(m_Config.visible ? 1 : 0);
+
+	spdlog::info("OpenGL {} on {}", (const char*)glGetString(GL_VERSION), (const char*)glGetString(GL_RENDERER));
+	return true;
+}
+
+void Application::destroyWindow() {
+	if (!m_Window) return;
+	glfwDestroyWindow(m_Window);
+	glfwTerminate();
+	m_Window = nullptr;
+}
+
+size_t Application::generateView(size_t maxChunks) {
+	const int maxChunkX = World::toChunkCoord(m_Config.worldWidth - 1);
+	const int maxChunkY = World::toChunkCoord(m_Config.worldHeight - 1);
+	return m_Generator->generate(m_World, m_Pool.get(), 0, 0, maxChunkX, maxChunkY, m_Config.worldWidth / 2, m_Config.worldHeight / 2, maxChunks);
+}
+
+bool Application::beginTick() {
+	return !m_Player || m_Player->beginTick(m_Simulation->getTick() + 1, *m_Simulation);
+}
+
+void Application::endTick() {
+	if (!m_Encoder) return;
+	const uint64_t tick = m_Simulation->getTick();
+	const std::vector<uint8_t>& frame = m_Encoder->encode(m_World, tick);
+	if (m_Deltas && m_Deltas->isOpen()) m_Deltas->write(frame);
+	if (m_Recorder) m_Recorder->endTick(tick, m_Encoder->getFrameHash());
+	if (m_Player) m_Player->endTick(tick, m_Encoder->getFrameHash());
+}
+
+void Application::reportProfile(bool final) {
+	if (!Profiler::isEnabled()) return;
+	const double interval = m_Config.profileSummaryInterval;
+	if (final) {
+		if (interval > 0.0) Profiler::logSummary(secondsSince(m_LastProfileSummary));
+		Profiler::writeChromeTrace(m_Config.profileTracePath);
+		return;
+	}
+	if (interval <= 0.0 || secondsSince(m_LastProfileSummary) < interval) return;
+	Profiler::logSummary(interval);
+	m_LastProfileSummary = Clock::now();
+}
+
+void Application::buildHud(const WorldSnapshot& snapshot, double frameSeconds) {
+	PROFILE_SCOPE("hud");
+	m_Hud->countPopulations(snapshot);
+	const HudStats stats{snapshot.getTick(), m_Config.hudTimings ? m_TickNanoseconds.load(std::memory_order_relaxed) * 1e-9 : -1.0,
+		m_Config.hudTimings ? frameSeconds : -1.0, m_AwakeChunks.load(std::memory_order_relaxed), snapshot.getChunkCount()};
+	m_Text.begin();
+	m_Hud->build(m_Text, stats);
+	m_Text.end();
+}
+
+bool Application::writeHudImage() {
+	WorldSnapshot& snapshot = m_Snapshots.getWriteBuffer();
+	snapshot.capture(m_World, m_Simulation->getTick());
+	buildHud(snapshot, -1.0);
+
+	const int width = m_Config.windowWidth;
+	const int height = m_Config.windowHeight;
+	std::vector<uint8_t> image((size_t)width * height * 4, 0);
+	for (size_t i = 3; i < image.size(); i += 4) image[i] = 255;
+	drawSnapshot(snapshot, m_Materials, RenderView{0.0f, 0.0f, (float)m_Config.worldWidth, (float)m_Config.worldHeight, width, height}, image.data());
+	m_Text.rasterise(image.data(), width, height);
+	if (!TextOverlay::writePng(m_Config.hudImagePath, image.data(), width, height)) return false;
+	spdlog::info("Wrote the HUD image to {}", m_Config.hudImagePath);
+	return true;
+}
+
+void Application::simulate() {
+	PROFILE_THREAD("simulation");
+	const Clock::duration tick = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / m_Config.tickRate));
+	Clock::time_point next = Clock::now();
+
+	while (m_Running.load(std::memory_order_relaxed)) {
+		if (m_Generator) generateView(GENERATE_CHUNKS_PER_TICK);
+		if (!beginTick()) {
+			stop();
+			break;
+		}
+		const Clock::time_point stepStart = Clock::now();
+		m_Simulation->step();
+		m_TickNanoseconds.store((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - stepStart).count(), std::memory_order_relaxed);
+		m_AwakeChunks.store(m_World.getAwakeChunkCount(), std::memory_order_relaxed);
+		endTick();
+		m_Snapshots.getWriteBuffer().capture(m_World, m_Simulation->getTick());
+		m_Snapshots.publish();
+
+		if (m_Config.maxTicks != 0 && m_Simulation->getTick() >= m_Config.maxTicks) {
+			stop();
+			break;
+		}
+
+		// a late tick runs straight away to catch up, unless the backlog has grown too long to
+		// ever make up, then it's dropped instead of spiralling
+		next += tick;
+		const Clock::time_point now = Clock::now();
+		if (now < next) {
+			std::this_thread::sleep_until(next);
+		} else if (now - next > tick * MAX_CATCH_UP_TICKS) {
+			next = now;
+		}
+	}
+}
+
+int Application::runHeadless() {
+	m_Running.store(true, std::memory_order_relaxed);
+
+	const uint64_t firstTick = m_Simulation->getTick();
+	const Clock::time_point start = Clock::now();
+	Clock::time_point report = start;
+	uint64_t reportTick = firstTick;
+	uint64_t reportBytes = 0;
+	m_LastProfileSummary = start;
+
+	while (m_Running.load(std::memory_order_relaxed)) {
+		if (!beginTick()) break;
+		m_Simulation->step();
+		endTick();
+		if (m_Config.maxTicks != 0 && m_Simulation->getTick() >= m_Config.maxTicks) break;
+		reportProfile(false);
+
+		if (secondsSince(report) >= 1.0) {
+			const uint64_t ticks = m_Simulation->getTick() - reportTick;
+			spdlog::info("{:.1f} ticks/s, {} of {} chunks awake", ticks / secondsSince(report), m_World.getAwakeChunkCount(), m_World.getChunkCount());
+			if (m_Encoder) {
+				spdlog::info("Deltas {:.2f} KiB/tick, {:.2f} KiB the last tick", (m_Encoder->getStats().bytes - reportBytes) / 1024.0 / ticks,
+					m_Encoder->getStats().lastFrameBytes / 1024.0);
+				reportBytes = m_Encoder->getStats().bytes;
+			}
+			report = Clock::now();
+			reportTick = m_Simulation->getTick();
+		}
+	}
+
+	const double seconds = secondsSince(start);
+	const uint64_t ticks = m_Simulation->getTick() - firstTick;
+	spdlog::info("Ran {} ticks in {:.3f} s, {:.1f} ticks/s", ticks, seconds, ticks / seconds);
+	if (m_Encoder && m_Encoder->getStats().frames > 0) {
+		const DeltaStats& stats = m_Encoder->getStats();
+		spdlog::info("Deltas {:.2f} KiB/tick on average, {:.2f} KiB at most, {:.1f} chunks/tick", stats.bytes / 1024.0 / stats.frames,
+			stats.maxFrameBytes / 1024.0, (double)stats.chunksEncoded / stats.frames);
+	}
+	if (m_Recorder) spdlog::info("Recorded {} ticks and {} events to {}", m_Recorder->getTickCount(), m_Recorder->getEventCount(), m_Config.recordPath);
+	if (m_Regions && ticks > 0) {
+		RegionSummary summary;
+		m_Regions->summarise(0, 0, m_Config.worldWidth, m_Config.worldHeight, summary);
+		int x, y;
+		float hottest;
+		if (m_Regions->findHottest(0, 0, m_Config.worldWidth, m_Config.worldHeight, x, y, hottest)) {
+			spdlog::info("{} of {} cells filled, {:.1f} degrees on average, hottest {:.1f} at ({}, {})", summary.cells - summary.counts[0],
+				summary.cells, summary.getMeanTemperature(), hottest, x, y);
+		}
+	}
+	reportProfile(true);
+
+	if (m_Hud) {
+		m_TickNanoseconds.store(ticks > 0 ? (uint64_t)(seconds * 1e9 / ticks) : 0, std::memory_order_relaxed);
+		m_AwakeChunks.store(m_World.getAwakeChunkCount(), std::memory_order_relaxed);
+		writeHudImage();
+	}
+
+	m_Running.store(false, std::memory_order_relaxed);
+	if (m_Player) {
+		if (m_Player->isDesynced()) {
+			spdlog::error("Replay went out of step on tick {} of {}", m_Player->getDesyncTick(), m_Player->getLastTick());
+			return 1;
+		}
+		spdlog::info("Replay matched the recording on all {} checked ticks", m_Player->getCheckedTickCount());
+	}
+	return 0;
+}
+
+int Application::runWindowed() {
+	if (!createWindow()) return -1;
+
+	{
+		ChunkRenderer renderer(m_Materials, m_Config.renderMode);
+		if (!renderer.isValid()) {
+			destroyWindow();
+			return -1;
+		}
+		renderer.setUploadBudget(m_Config.uploadBudget);
+		GpuProfiler gpuProfiler;
+		renderer.setGpuProfiler(&gpuProfiler);
+		if (m_Gas) renderer.setGasField(*m_Gas);
+		TextRenderer textRenderer;
+		textRenderer.setAtlas(m_Text);
+
+		// decoded on the pool before the simulation starts using it
+		if (m_Config.textures) {
+			AtlasSettings settings;
+			settings.compress = m_Config.compressTextures && GLAD_GL_EXT_texture_compression_s3tc;
+			settings.cachePath = m_Config.textureCachePath;
+			TextureAtlas atlas;
+			if (atlas.build(m_Materials, directoryOf(m_Config.materialsPath), m_Pool.get(), settings)) renderer.setAtlas(atlas);
+		}
+
+		// the simulation thread owns the world until it is joined
+		m_Running.store(true, std::memory_order_relaxed);
+		const uint64_t firstTick = m_Simulation->getTick();
+		std::thread simulation(&Application::simulate, this);
+
+		const Clock::time_point start = Clock::now();
+		uint64_t frames = 0;
+		double frameSeconds = 0.0;
+		double worstFrame = 0.0;
+		size_t bytesUploaded = 0;
+		bool dumpKeyDown = false;
+		bool toggleKeyDown = false;
+		bool hudKeyDown = false;
+		bool showHud = m_Hud != nullptr;
+		double lastFrame = 0.0;
+		m_LastProfileSummary = start;
+
+		while (m_Running.load(std::memory_order_relaxed) && !glfwWindowShouldClose(m_Window)) {
+			const Clock::time_point frameStart = Clock::now();
+			PROFILE_SCOPE("frame");
+			gpuProfiler.beginFrame();
+			glfwPollEvents();
+
+			// F9 dumps the trace, F10 turns profiling on and off, F3 the HUD
+			const bool dumpKey = glfwGetKey(m_Window, GLFW_KEY_F9) == GLFW_PRESS;
+			const bool toggleKey = glfwGetKey(m_Window, GLFW_KEY_F10) == GLFW_PRESS;
+			const bool hudKey = glfwGetKey(m_Window, GLFW_KEY_F3) == GLFW_PRESS;
+			if (hudKey && !hudKeyDown) showHud = !showHud && m_Hud;
+			if (dumpKey && !dumpKeyDown) Profiler::writeChromeTrace(m_Config.profileTracePath);
+			if (toggleKey && !toggleKeyDown) {
+				Profiler::setEnabled(!Profiler::isEnabled());
+				m_LastProfileSummary = Clock::now();
+				spdlog::info("Profiling {}", Profiler::isEnabled() ? "on" : "off");
+			}
+			dumpKeyDown = dumpKey;
+			toggleKeyDown = toggleKey;
+			hudKeyDown = hudKey;
+
+			int width, height;
+			glfwGetFramebufferSize(m_Window, &width, &height);
+			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT);
+
+			m_Snapshots.acquire();
+			const RenderView view{0.0f, 0.0f, (float)m_Config.worldWidth, (float)m_Config.worldHeight, width, height};
+			renderer.render(m_Snapshots.getReadBuffer(), view);
+			if (showHud) {
+				buildHud(m_Snapshots.getReadBuffer(), lastFrame);
+				PROFILE_GPU_SCOPE(&gpuProfiler, "hud");
+				textRenderer.render(m_Text, width, height);
+			}
+
+			{
+				PROFILE_SCOPE("swap buffers");
+				glfwSwapBuffers(m_Window);
+				// without vsync the swap returns before the GPU is done, so wait for it to time the whole frame
+				if (!m_Config.visible) glFinish();
+			}
+
+			const double frame = secondsSince(frameStart);
+			lastFrame = frame;
+			frames++;
+			frameSeconds += frame;
+			worstFrame = std::max(worstFrame, frame);
+			bytesUploaded += renderer.getStats().bytesUploaded;
+			reportProfile(false);
+		}
+
+		m_Running.store(false, std::memory_order_relaxed);
+		simulation.join();
+
+		const double seconds = secondsSince(start);
+		const uint64_t ticks = m_Simulation->getTick() - firstTick;
+		spdlog::info("Ran {} ticks in {:.3f} s, {:.1f} ticks/s", ticks, seconds, ticks / seconds);
+		if (frames > 0) {
+			spdlog::info("Drew {} frames, {:.3f} ms average, {:.3f} ms worst, {:.1f} KiB uploaded per frame",
+				frames, frameSeconds * 1000.0 / frames, worstFrame * 1000.0, bytesUploaded / 1024.0 / frames);
+		}
+		reportProfile(true);
+	}
+
+	destroyWindow();
+	return 0;
+}
@@ -0,0 +1,35 @@
+#include "Buffer.h"
+
+unsigned int formMode(VertBufTargetAction action, VertBufIOMode iomode) {
+    return 0x88E0 + static_cast<int>(action) + static_cast<int>(iomode);
+}
+
+void DirtyRangeSet::add(size_t start, size_t end) {
+    if (start >= end) return;
+
+    // first range that ends at or after start, anything before it cannot touch the new one
+    auto first = std::lower_bound(m_Ranges.begin(), m_Ranges.end(), start, [](const Range& r, size_t s) { return r.end < s; });
+    auto last = first;
+    while (last != m_Ranges.end() && last->start <= end) {
+        start = std::min(start, last->start);
+        end = std::max(end, last->end);
+        last++;
+    }
+
+    if (first == last) {
+        m_Ranges.insert(first, Range{start, end});
+    } else {
+        *first = Range{start, end};
+        m_Ranges.erase(first + 1, last);
+    }
+}
+
+void DirtyRangeSet::clear() {
+    m_Ranges.clear();
+}
+
+size_t DirtyRangeSet::getDirtyCount() const {
+    size_t count = 0;
+    for (const Range& r : m_Ranges) count += r.end - r.start;
+    return count;
+}
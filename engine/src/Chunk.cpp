@@ -0,0 +1,137 @@
+#include "Chunk.h"
+
+#include <algorithm>
+#include <new>
+
+namespace {
+	inline void atomicMin(std::atomic<int>& target, int value) {
+		int current = target.load(std::memory_order_relaxed);
+		while (value < current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+	}
+
+	inline void atomicMax(std::atomic<int>& target, int value) {
+		int current = target.load(std::memory_order_relaxed);
+		while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+	}
+}
+
+Chunk::Chunk(int chunkX, int chunkY, SlabPool& cellPool)
+	: m_ChunkX{chunkX}, m_ChunkY{chunkY}, m_CellPool{cellPool}, m_Cells{new (cellPool.allocate()) ChunkCells} {
+	clear(0, AMBIENT_TEMPERATURE);
+}
+
+Chunk::~Chunk() {
+	m_CellPool.release(m_Cells);
+}
+
+void Chunk::clear(MaterialID material, float temperature) {
+	std::fill_n(m_Cells->material, CHUNK_CELLS, material);
+	std::fill_n(m_Cells->temperature, CHUNK_CELLS, temperature);
+	std::fill_n(m_Cells->velocityX, CHUNK_CELLS, 0);
+	std::fill_n(m_Cells->velocityY, CHUNK_CELLS, 0);
+	std::fill_n(m_Cells->flags, CHUNK_CELLS, 0);
+	std::fill_n(&m_Cells->gas[0][0][0], 2 * GAS_SPECIES * GAS_CELLS, 0.0f);
+	std::fill_n(&m_Cells->gasTemperature[0][0], 2 * GAS_CELLS, temperature);
+	std::fill_n(m_Cells->gasCapacity, GAS_CELLS, 0);
+	std::fill_n(m_Cells->gasAmbient, GAS_CELLS, temperature);
+	m_HasGas = false;
+	m_GasChanged = false;
+	m_GasStep = 0;
+	markAllDirty();
+	wakeThermal();
+}
+
+void Chunk::setMaterial(int x, int y, MaterialID material) {
+	m_Cells->material[index(x, y)] = material;
+	markDirty(x, y);
+}
+
+void Chunk::setTemperature(int x, int y, float temperature) {
+	m_Cells->temperature[index(x, y)] = temperature;
+	markDirty(x, y);
+	wakeThermal();
+}
+
+Chunk* Chunk::getNeighbour(int dx, int dy) {
+	static constexpr int LOOKUP[3][3] = {
+		{NeighbourDownLeft, NeighbourDown, NeighbourDownRight},
+		{NeighbourLeft, -1, NeighbourRight},
+		{NeighbourUpLeft, NeighbourUp, NeighbourUpRight}
+	};
+	int n = LOOKUP[dy + 1][dx + 1];
+	return n < 0 ? this : m_Neighbours[n];
+}
+
+void Chunk::expandNext(int minX, int minY, int maxX, int maxY) {
+	atomicMin(m_NextMinX, std::max(minX, 0));
+	atomicMin(m_NextMinY, std::max(minY, 0));
+	atomicMax(m_NextMaxX, std::min(maxX, CHUNK_SIZE));
+	atomicMax(m_NextMaxY, std::min(maxY, CHUNK_SIZE));
+}
+
+void Chunk::markDirty(int x, int y) {
+	expandNext(x - 1, y - 1, x + 2, y + 2);
+
+	int dx = x == 0 ? -1 : (x == CHUNK_SIZE - 1 ? 1 : 0);
+	int dy = y == 0 ? -1 : (y == CHUNK_SIZE - 1 ? 1 : 0);
+	if (dx == 0 && dy == 0) return;
+
+	// the neighbour's cells touching (x, y) sit one step across the border
+	int nx = x + dx - dx * CHUNK_SIZE;
+	int ny = y + dy - dy * CHUNK_SIZE;
+
+	Chunk* neighbour;
+	if (dx != 0 && (neighbour = getNeighbour(dx, 0))) neighbour->expandNext(nx, y - 1, nx + 1, y + 2);
+	if (dy != 0 && (neighbour = getNeighbour(0, dy))) neighbour->expandNext(x - 1, ny, x + 2, ny + 1);
+	if (dx != 0 && dy != 0 && (neighbour = getNeighbour(dx, dy))) neighbour->expandNext(nx, ny, nx + 1, ny + 1);
+}
+
+void Chunk::markRowsDirty(int minY, int maxY) {
+	expandNext(0, minY, CHUNK_SIZE, maxY);
+}
+
+void Chunk::markAllDirty() {
+	expandNext(0, 0, CHUNK_SIZE, CHUNK_SIZE);
+}
+
+bool Chunk::swapDirty() {
+	m_DirtyMinX = m_NextMinX.exchange(CHUNK_SIZE, std::memory_order_relaxed);
+	m_DirtyMinY = m_NextMinY.exchange(CHUNK_SIZE, std::memory_order_relaxed);
+	m_DirtyMaxX = m_NextMaxX.exchange(0, std::memory_order_relaxed);
+	m_DirtyMaxY = m_NextMaxY.exchange(0, std::memory_order_relaxed);
+	m_ThermalActive = m_ThermalNext.exchange(false, std::memory_order_relaxed);
+
+	const bool awake = isAwake();
+	if (awake || m_GasChanged) m_Revision++;
+	m_GasChanged = false;
+	return awake;
+}
+
+void Chunk::copyHeatEdge(ChunkEdge edge, float* out) const {
+	const float* t = m_Cells->temperature;
+	switch (edge) {
+		case EdgeLeft:
+			for (int y = 0; y < CHUNK_SIZE; y++) out[y] = t[index(0, y)];
+			break;
+		case EdgeRight:
+			for (int y = 0; y < CHUNK_SIZE; y++) out[y] = t[index(CHUNK_SIZE - 1, y)];
+			break;
+		case EdgeDown:
+			std::copy_n(t, CHUNK_SIZE, out);
+			break;
+		case EdgeUp:
+			std::copy_n(t + index(0, CHUNK_SIZE - 1), CHUNK_SIZE, out);
+			break;
+		default:
+			break;
+	}
+}
+
+void Chunk::beginHeatPass() {
+	for (int edge = 0; edge < EdgeCount; edge++) copyHeatEdge((ChunkEdge)edge, m_Cells->heatEdges[edge]);
+	m_InHeatPass = true;
+}
+
+void Chunk::endHeatPass() {
+	m_InHeatPass = false;
+}
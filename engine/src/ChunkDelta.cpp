@@ -0,0 +1,382 @@
+#include "ChunkDelta.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#include <spdlog/spdlog.h>
+
+#include "Profiler.h"
+
+#ifndef _WIN32
+	#include <sys/socket.h>
+	#include <sys/un.h>
+	#include <unistd.h>
+#endif
+
+namespace {
+	struct FrameHeader {
+		char magic[4];
+		uint32_t size;  // whole frame, this header included
+		uint64_t tick;
+		uint32_t chunkCount;
+		uint32_t removedCount;
+	};
+
+	struct ChunkRecord {
+		int32_t chunkX;
+		int32_t chunkY;
+		uint32_t size;   // encoded bytes that follow
+		uint32_t flags;  // DeltaChunkFlag
+	};
+
+	struct RemovedRecord {
+		int32_t chunkX;
+		int32_t chunkY;
+	};
+
+	const char MAGIC[4] = {'C', 'H', 'D', 'F'};
+
+	// shorter zero runs stay inside a literal, a run costs at least two count bytes
+	constexpr size_t MIN_ZERO_RUN = 4;
+
+	template<typename T> void append(std::vector<uint8_t>& out, const T& value) {
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+		out.insert(out.end(), bytes, bytes + sizeof(T));
+	}
+
+	void appendVarint(std::vector<uint8_t>& out, size_t value) {
+		while (value >= 0x80) {
+			out.push_back((uint8_t)(value | 0x80));
+			value >>= 7;
+		}
+		out.push_back((uint8_t)value);
+	}
+
+	bool readVarint(const uint8_t* data, size_t size, size_t& at, size_t& out) {
+		out = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			if (at >= size) return false;
+			const uint8_t byte = data[at++];
+			out |= (size_t)(byte & 0x7F) << shift;
+			if (!(byte & 0x80)) return true;
+		}
+		return false;
+	}
+
+	// (zero run, literal count, literals) triples over a buffer of XORed bytes
+	void encodeRuns(const uint8_t* delta, size_t size, std::vector<uint8_t>& out) {
+		size_t i = 0;
+		while (i < size) {
+			const size_t zeroStart = i;
+			while (i < size && delta[i] == 0) i++;
+			const size_t literalStart = i;
+			size_t zeros = 0;
+			while (i < size && zeros < MIN_ZERO_RUN) {
+				zeros = delta[i] == 0 ? zeros + 1 : 0;
+				i++;
+			}
+			// the zeros that ended the literal start the next run
+			if (zeros == MIN_ZERO_RUN) i -= zeros;
+			appendVarint(out, literalStart - zeroStart);
+			appendVarint(out, i - literalStart);
+			out.insert(out.end(), delta + literalStart, delta + i);
+		}
+	}
+
+	// XORs the runs into state
+	bool decodeRuns(const uint8_t* data, size_t size, uint8_t* state, size_t stateSize) {
+		size_t at = 0;
+		size_t cell = 0;
+		while (cell < stateSize) {
+			size_t zeros, literals;
+			if (!readVarint(data, size, at, zeros) || !readVarint(data, size, at, literals)) return false;
+			if (zeros + literals == 0 || cell + zeros + literals > stateSize || at + literals > size) return false;
+			cell += zeros;
+			for (size_t i = 0; i < literals; i++) state[cell + i] ^= data[at + i];
+			cell += literals;
+			at += literals;
+		}
+		return at == size;
+	}
+
+	uint64_t hashBytes(const uint8_t* data, size_t size) {
+		uint64_t value = 0xcbf29ce484222325ull;
+		for (size_t i = 0; i < size; i++) value = (value ^ data[i]) * 0x100000001b3ull;
+		return value;
+	}
+
+	template<typename T> uint8_t* put(uint8_t* out, const T* plane, size_t count) {
+		std::memcpy(out, plane, count * sizeof(T));
+		return out + count * sizeof(T);
+	}
+
+	template<typename T> const uint8_t* take(const uint8_t* in, T* plane, size_t count) {
+		std::memcpy(plane, in, count * sizeof(T));
+		return in + count * sizeof(T);
+	}
+}
+
+ChunkDeltaEncoder::ChunkDeltaEncoder() : m_State(STATE_SIZE) {
+
+}
+
+void ChunkDeltaEncoder::readState(const Chunk& chunk, uint8_t* out) {
+	out = put(out, chunk.getMaterials(), CHUNK_CELLS);
+	out = put(out, chunk.getTemperatures(), CHUNK_CELLS);
+	out = put(out, chunk.getVelocitiesX(), CHUNK_CELLS);
+	out = put(out, chunk.getVelocitiesY(), CHUNK_CELLS);
+	out = put(out, chunk.getFlags(), CHUNK_CELLS);
+	for (int s = 0; s < GAS_SPECIES; s++) out = put(out, chunk.getGas(s), GAS_CELLS);
+	put(out, chunk.getGasTemperatures(), GAS_CELLS);
+}
+
+void ChunkDeltaEncoder::writeState(const uint8_t* state, Chunk& chunk) {
+	state = take(state, chunk.getMaterials(), CHUNK_CELLS);
+	state = take(state, chunk.getTemperatures(), CHUNK_CELLS);
+	state = take(state, chunk.getVelocitiesX(), CHUNK_CELLS);
+	state = take(state, chunk.getVelocitiesY(), CHUNK_CELLS);
+	state = take(state, chunk.getFlags(), CHUNK_CELLS);
+	bool gas = false;
+	for (int s = 0; s < GAS_SPECIES; s++) {
+		state = take(state, chunk.getGas(s), GAS_CELLS);
+		for (int g = 0; g < GAS_CELLS; g++) gas |= chunk.getGas(s)[g] > 0.0f;
+	}
+	take(state, chunk.getGasTemperatures(), GAS_CELLS);
+
+	chunk.setHasGas(gas);
+	chunk.touchGas();
+	chunk.markAllDirty();
+	chunk.wakeThermal();
+}
+
+const std::vector<uint8_t>& ChunkDeltaEncoder::encode(const World& world, uint64_t tick) {
+	PROFILE_SCOPE("ChunkDeltaEncoder::encode");
+	m_Stats.frames++;
+	m_Frame.clear();
+	append(m_Frame, FrameHeader{{MAGIC[0], MAGIC[1], MAGIC[2], MAGIC[3]}, 0, tick, 0, 0});
+
+	uint32_t chunkCount = 0;
+	for (const Chunk* chunk : world.getChunks()) {
+		const uint64_t key = World::chunkKey(chunk->getChunkX(), chunk->getChunkY());
+		auto found = m_References.find(key);
+		const bool known = found != m_References.end();
+		if (!known) {
+			const Reference fresh{chunk->getChunkX(), chunk->getChunkY(), 0, 0, false, true, 0, std::vector<uint8_t>(STATE_SIZE, 0)};
+			found = m_References.emplace(key, fresh).first;
+		}
+
+		Reference& reference = found->second;
+		const bool whole = reference.whole;
+		reference.frame = m_Stats.frames;
+		const bool changed = whole || reference.active || reference.serial != chunk->getSerial() || reference.revision != chunk->getRevision();
+		reference.serial = chunk->getSerial();
+		reference.revision = chunk->getRevision();
+		reference.active = chunk->isAwake() || chunk->isThermallyActive();
+		reference.whole = false;
+		if (!changed) continue;
+
+		// XOR against the last state sent, which becomes the current one
+		readState(*chunk, m_State.data());
+		bool any = false;
+		for (size_t i = 0; i < STATE_SIZE; i++) {
+			const uint8_t value = m_State[i];
+			m_State[i] ^= reference.state[i];
+			reference.state[i] = value;
+			any |= m_State[i] != 0;
+		}
+		// a whole chunk is sent even when empty, the decoder may still hold an older one
+		if (!any && !whole) continue;
+
+		const size_t record = m_Frame.size();
+		append(m_Frame, ChunkRecord{chunk->getChunkX(), chunk->getChunkY(), 0, whole ? (uint32_t)DeltaChunkWhole : 0u});
+		encodeRuns(m_State.data(), STATE_SIZE, m_Frame);
+		const uint32_t size = (uint32_t)(m_Frame.size() - record - sizeof(ChunkRecord));
+		std::memcpy(m_Frame.data() + record + offsetof(ChunkRecord, size), &size, sizeof(size));
+		chunkCount++;
+	}
+
+	// a chunk gone from the world is removed from the mirror too, and starts from nothing if it comes back
+	uint32_t removedCount = 0;
+	if (m_References.size() != world.getChunkCount()) {
+		for (auto it = m_References.begin(); it != m_References.end();) {
+			if (it->second.frame != m_Stats.frames) {
+				append(m_Frame, RemovedRecord{it->second.chunkX, it->second.chunkY});
+				removedCount++;
+				it = m_References.erase(it);
+			} else {
+				it++;
+			}
+		}
+	}
+
+	const uint32_t frameSize = (uint32_t)m_Frame.size();
+	std::memcpy(m_Frame.data() + offsetof(FrameHeader, size), &frameSize, sizeof(frameSize));
+	std::memcpy(m_Frame.data() + offsetof(FrameHeader, chunkCount), &chunkCount, sizeof(chunkCount));
+	std::memcpy(m_Frame.data() + offsetof(FrameHeader, removedCount), &removedCount, sizeof(removedCount));
+	m_FrameHash = hashBytes(m_Frame.data(), m_Frame.size());
+
+	m_Stats.chunksEncoded += chunkCount;
+	m_Stats.bytes += frameSize;
+	m_Stats.lastFrameBytes = frameSize;
+	m_Stats.maxFrameBytes = std::max(m_Stats.maxFrameBytes, (size_t)frameSize);
+	return m_Frame;
+}
+
+// the references stay, so chunks removed after a reset still get their removed records
+void ChunkDeltaEncoder::reset() {
+	for (auto& entry : m_References) {
+		Reference& reference = entry.second;
+		std::fill(reference.state.begin(), reference.state.end(), 0);
+		reference.whole = true;
+	}
+}
+
+ChunkDeltaDecoder::ChunkDeltaDecoder() {
+
+}
+
+size_t ChunkDeltaDecoder::getFrameSize(const uint8_t* data, size_t size) {
+	if (size < sizeof(FrameHeader)) return 0;
+	FrameHeader header;
+	std::memcpy(&header, data, sizeof(header));
+	return header.size;
+}
+
+bool ChunkDeltaDecoder::apply(World& world, const uint8_t* frame, size_t size) {
+	FrameHeader header;
+	if (size < sizeof(header)) {
+		spdlog::error("Chunk delta frame of {} bytes is too short", size);
+		return false;
+	}
+	std::memcpy(&header, frame, sizeof(header));
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.size != size) {
+		spdlog::error("Not a chunk delta frame, or not a whole one");
+		return false;
+	}
+	m_Tick = header.tick;
+
+	size_t at = sizeof(header);
+	for (uint32_t i = 0; i < header.chunkCount; i++) {
+		ChunkRecord record;
+		if (at + sizeof(record) > size) {
+			spdlog::error("Chunk delta frame for tick {} is cut short", header.tick);
+			return false;
+		}
+		std::memcpy(&record, frame + at, sizeof(record));
+		at += sizeof(record);
+		if (at + record.size > size) {
+			spdlog::error("Chunk delta frame for tick {} is cut short", header.tick);
+			return false;
+		}
+
+		std::vector<uint8_t>& reference = m_References[World::chunkKey(record.chunkX, record.chunkY)];
+		if (reference.empty()) {
+			reference.assign(ChunkDeltaEncoder::STATE_SIZE, 0);
+		} else if (record.flags & DeltaChunkWhole) {
+			std::fill(reference.begin(), reference.end(), 0);
+		}
+		if (!decodeRuns(frame + at, record.size, reference.data(), reference.size())) {
+			spdlog::error("Chunk ({}, {}) in the delta frame for tick {} is corrupt", record.chunkX, record.chunkY, header.tick);
+			return false;
+		}
+		at += record.size;
+
+		Chunk* chunk = world.getOrCreateChunk(record.chunkX, record.chunkY);
+		ChunkDeltaEncoder::writeState(reference.data(), *chunk);
+	}
+
+	if (at + (size_t)header.removedCount * sizeof(RemovedRecord) != size) {
+		spdlog::error("Chunk delta frame for tick {} doesn't end with its removed chunks", header.tick);
+		return false;
+	}
+	for (uint32_t i = 0; i < header.removedCount; i++) {
+		RemovedRecord record;
+		std::memcpy(&record, frame + at, sizeof(record));
+		at += sizeof(record);
+		m_References.erase(World::chunkKey(record.chunkX, record.chunkY));
+		world.removeChunk(record.chunkX, record.chunkY);
+	}
+	return true;
+}
+
+DeltaStream::DeltaStream() {
+
+}
+
+DeltaStream::~DeltaStream() {
+	close();
+}
+
+bool DeltaStream::open(const std::string& target) {
+	close();
+	m_BytesWritten = 0;
+
+	static const std::string SOCKET_PREFIX = "unix:";
+	if (target.compare(0, SOCKET_PREFIX.size(), SOCKET_PREFIX) != 0) {
+		m_File = std::fopen(target.c_str(), "wb");
+		if (!m_File) spdlog::error("Could not create the chunk delta file {}", target);
+		return m_File != nullptr;
+	}
+
+#ifdef _WIN32
+	spdlog::error("Chunk delta sockets are not supported on this platform");
+	return false;
+#else
+	const std::string path = target.substr(SOCKET_PREFIX.size());
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+		spdlog::error("Bad chunk delta socket path '{}'", path);
+		return false;
+	}
+	std::memcpy(address.sun_path, path.c_str(), path.size());
+
+	m_Socket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (m_Socket < 0 || connect(m_Socket, (const sockaddr*)&address, sizeof(address)) != 0) {
+		spdlog::error("Could not connect to the chunk delta socket {}", path);
+		close();
+		return false;
+	}
+	return true;
+#endif
+}
+
+void DeltaStream::close() {
+	if (m_File) std::fclose(m_File);
+	m_File = nullptr;
+#ifndef _WIN32
+	if (m_Socket >= 0) ::close(m_Socket);
+#endif
+	m_Socket = -1;
+}
+
+bool DeltaStream::write(const std::vector<uint8_t>& frame) {
+	if (m_File) {
+		if (std::fwrite(frame.data(), 1, frame.size(), m_File) == frame.size()) {
+			m_BytesWritten += frame.size();
+			return true;
+		}
+		spdlog::error("Could not write to the chunk delta file, stopping the stream");
+		close();
+		return false;
+	}
+
+#ifndef _WIN32
+	size_t sent = 0;
+	while (m_Socket >= 0 && sent < frame.size()) {
+		// MSG_NOSIGNAL, a reader that went away is an error here rather than a SIGPIPE
+		const ssize_t written = send(m_Socket, frame.data() + sent, frame.size() - sent, MSG_NOSIGNAL);
+		if (written <= 0) {
+			spdlog::warn("Chunk delta socket closed by the reader, stopping the stream");
+			close();
+			return false;
+		}
+		sent += (size_t)written;
+	}
+	m_BytesWritten += sent;
+	return sent == frame.size();
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,460 @@
+#include "ChunkRenderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+
+#include <spdlog/spdlog.h>
+
+namespace {
+	// prepended to every shader: a material's textured colour at a world cell, or its palette
+	// colour when it has no texture
+	const char* MATERIAL_COLOR_SOURCE = R"(
+		uniform sampler2D u_Palette;
+		uniform sampler2D u_Atlas;
+		uniform usampler2D u_Regions; // x, y, width, height in the atlas per material
+
+		vec4 materialColor(uint material, ivec2 cell) {
+			uvec4 region = texelFetch(u_Regions, ivec2(material, 0), 0);
+			if (region.z == 0u) return texelFetch(u_Palette, ivec2(material, 0), 0);
+			// integer % is undefined for negative cells
+			ivec2 texel = ivec2(mod(vec2(cell), vec2(region.zw)));
+			return texelFetch(u_Atlas, ivec2(region.xy) + texel, 0);
+		}
+	)";
+
+	const char* TEXTURE_VERTEX_SHADER = R"(
+		layout(location = 0) in vec3 a_Instance; // chunk x, chunk y, layer
+
+		uniform vec4 u_View; // left, bottom, 2 / width, 2 / height
+
+		out vec2 v_Cell;
+		flat out int v_Layer;
+		flat out ivec2 v_Origin;
+
+		void main() {
+			vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+			v_Cell = corner * CHUNK_SIZE;
+			v_Layer = int(a_Instance.z);
+			v_Origin = ivec2(a_Instance.xy) * CHUNK_SIZE;
+			gl_Position = vec4((a_Instance.xy * CHUNK_SIZE + v_Cell - u_View.xy) * u_View.zw - 1.0, 0.0, 1.0);
+		}
+	)";
+
+	const char* TEXTURE_FRAGMENT_SHADER = R"(
+		uniform usampler2DArray u_Materials;
+		uniform sampler2DArray u_Gas;        // how full of each species, one channel each, per gas cell
+		uniform uint u_GasSpecies[GAS_SPECIES]; // material of each channel
+
+		in vec2 v_Cell;
+		flat in int v_Layer;
+		flat in ivec2 v_Origin;
+
+		out vec4 o_Color;
+
+		void main() {
+			ivec2 cell = clamp(ivec2(v_Cell), ivec2(0), ivec2(CHUNK_SIZE - 1));
+			uint material = texelFetch(u_Materials, ivec3(cell, v_Layer), 0).r;
+			if (material != 0u) {
+				o_Color = materialColor(material, v_Origin + cell);
+				return;
+			}
+
+			// empty cells show the gas field, filtered between gas cells, each species in its colour
+			// as thick as the gas cell is full of it
+			vec4 density = texture(u_Gas, vec3(v_Cell / CHUNK_SIZE, v_Layer));
+			vec4 gas = vec4(0.0);
+			for (int i = 0; i < GAS_SPECIES; i++) {
+				vec4 color = texelFetch(u_Palette, ivec2(u_GasSpecies[i], 0), 0);
+				float cover = density[i] * color.a;
+				gas += vec4(color.rgb * cover, cover);
+			}
+			o_Color = gas.a > 0.0 ? vec4(gas.rgb / gas.a, min(gas.a, 1.0)) : vec4(0.0);
+		}
+	)";
+
+	const char* POINT_VERTEX_SHADER = R"(
+		layout(location = 0) in vec2 a_Cell;
+		layout(location = 1) in float a_Material;
+
+		uniform vec4 u_View;
+		uniform float u_PointSize;
+
+		out vec4 v_Color;
+
+		void main() {
+			uint material = uint(a_Material);
+			gl_PointSize = u_PointSize;
+			if (material == 0u) {
+				// empty cells are clipped before rasterisation
+				gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+				v_Color = vec4(0.0);
+				return;
+			}
+			v_Color = materialColor(material, ivec2(a_Cell));
+			gl_Position = vec4((a_Cell + 0.5 - u_View.xy) * u_View.zw - 1.0, 0.0, 1.0);
+		}
+	)";
+
+	const char* POINT_FRAGMENT_SHADER = R"(
+		in vec4 v_Color;
+		out vec4 o_Color;
+
+		void main() {
+			o_Color = v_Color;
+		}
+	)";
+
+	GLuint compileShader(GLenum type, const char* body) {
+		const std::string source = "#version 450 core\n#define CHUNK_SIZE " + std::to_string(CHUNK_SIZE) + "\n#define GAS_SPECIES " + std::to_string(GAS_SPECIES) + "\n"
+			+ MATERIAL_COLOR_SOURCE + body;
+		const char* text = source.c_str();
+
+		GLuint shader = glCreateShader(type);
+		glShaderSource(shader, 1, &text, nullptr);
+		glCompileShader(shader);
+
+		GLint ok = GL_FALSE;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+		if (!ok) {
+			char log[1024];
+			glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+			spdlog::error("Chunk renderer shader failed to compile: {}", log);
+			glDeleteShader(shader);
+			return 0;
+		}
+		return shader;
+	}
+
+	GLuint linkProgram(const char* vertexBody, const char* fragmentBody) {
+		GLuint vertex = compileShader(GL_VERTEX_SHADER, vertexBody);
+		GLuint fragment = compileShader(GL_FRAGMENT_SHADER, fragmentBody);
+		if (!vertex || !fragment) {
+			glDeleteShader(vertex);
+			glDeleteShader(fragment);
+			return 0;
+		}
+
+		GLuint program = glCreateProgram();
+		glAttachShader(program, vertex);
+		glAttachShader(program, fragment);
+		glLinkProgram(program);
+		glDeleteShader(vertex);
+		glDeleteShader(fragment);
+
+		GLint ok = GL_FALSE;
+		glGetProgramiv(program, GL_LINK_STATUS, &ok);
+		if (!ok) {
+			char log[1024];
+			glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+			spdlog::error("Chunk renderer program failed to link: {}", log);
+			glDeleteProgram(program);
+			return 0;
+		}
+		return program;
+	}
+}
+
+ChunkRenderer::ChunkRenderer(const MaterialTable& materials, ChunkRenderMode mode) : m_Materials{materials}, m_Mode{mode} {
+	m_TextureProgram = linkProgram(TEXTURE_VERTEX_SHADER, TEXTURE_FRAGMENT_SHADER);
+	m_PointProgram = linkProgram(POINT_VERTEX_SHADER, POINT_FRAGMENT_SHADER);
+
+	// palette unit 0, material ids unit 1, atlas unit 2, atlas regions unit 3, gas unit 4
+	for (GLuint program : {m_TextureProgram, m_PointProgram}) {
+		if (!program) continue;
+		glProgramUniform1i(program, glGetUniformLocation(program, "u_Palette"), 0);
+		glProgramUniform1i(program, glGetUniformLocation(program, "u_Atlas"), 2);
+		glProgramUniform1i(program, glGetUniformLocation(program, "u_Regions"), 3);
+	}
+	if (m_TextureProgram) {
+		m_TextureViewLocation = glGetUniformLocation(m_TextureProgram, "u_View");
+		glProgramUniform1i(m_TextureProgram, glGetUniformLocation(m_TextureProgram, "u_Materials"), 1);
+		glProgramUniform1i(m_TextureProgram, glGetUniformLocation(m_TextureProgram, "u_Gas"), 4);
+		m_GasSpeciesLocation = glGetUniformLocation(m_TextureProgram, "u_GasSpecies");
+	}
+	if (m_PointProgram) {
+		m_PointViewLocation = glGetUniformLocation(m_PointProgram, "u_View");
+		m_PointSizeLocation = glGetUniformLocation(m_PointProgram, "u_PointSize");
+	}
+
+	// colours are packed 0xRRGGBBAA
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_PaletteTexture);
+	glTextureStorage2D(m_PaletteTexture, 1, GL_RGBA8, (GLsizei)m_Materials.getCount(), 1);
+	glTextureSubImage2D(m_PaletteTexture, 0, 0, 0, (GLsizei)m_Materials.getCount(), 1, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8, m_Materials.getColors());
+	glTextureParameteri(m_PaletteTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(m_PaletteTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	// no regions until an atlas is set, every material draws its palette colour
+	const std::vector<uint16_t> regions(m_Materials.getCount() * 4, 0);
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_RegionTexture);
+	glTextureStorage2D(m_RegionTexture, 1, GL_RGBA16UI, (GLsizei)m_Materials.getCount(), 1);
+	glTextureSubImage2D(m_RegionTexture, 0, 0, 0, (GLsizei)m_Materials.getCount(), 1, GL_RGBA_INTEGER, GL_UNSIGNED_SHORT, regions.data());
+	glTextureParameteri(m_RegionTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(m_RegionTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	m_TextureVAO.attachBuffer(&m_Instances, 0);
+	m_TextureVAO.enableAttribute(0);
+	m_TextureVAO.setAttributeDivisor(0, 1);
+
+	m_PointVAO.attachLayout(&m_Points);
+
+	m_SlotCapacity = INITIAL_SLOTS;
+	for (uint32_t i = m_SlotCapacity; i-- > 0;) m_FreeSlots.push_back(i);
+}
+
+ChunkRenderer::~ChunkRenderer() {
+	glDeleteTextures(1, &m_PaletteTexture);
+	glDeleteTextures(1, &m_RegionTexture);
+	glDeleteTextures(1, &m_AtlasTexture);
+	glDeleteTextures(1, &m_MaterialTexture);
+	glDeleteTextures(1, &m_GasTexture);
+	glDeleteProgram(m_TextureProgram);
+	glDeleteProgram(m_PointProgram);
+}
+
+void ChunkRenderer::setMode(ChunkRenderMode mode) {
+	if (mode == m_Mode) return;
+	m_Mode = mode;
+	invalidateSlots();
+}
+
+void ChunkRenderer::setAtlas(const TextureAtlas& atlas) {
+	glDeleteTextures(1, &m_AtlasTexture);
+	m_AtlasTexture = 0;
+
+	std::vector<uint16_t> regions(m_Materials.getCount() * 4, 0);
+	if (!atlas.isEmpty() && atlas.getRegionCount() == m_Materials.getCount()) {
+		const GLsizei width = atlas.getWidth(), height = atlas.getHeight();
+		glCreateTextures(GL_TEXTURE_2D, 1, &m_AtlasTexture);
+		if (atlas.getFormat() == AtlasBC3) {
+			glTextureStorage2D(m_AtlasTexture, 1, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, width, height);
+			glCompressedTextureSubImage2D(m_AtlasTexture, 0, 0, 0, width, height, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, (GLsizei)atlas.getByteSize(), atlas.getPixels());
+		} else {
+			glTextureStorage2D(m_AtlasTexture, 1, GL_RGBA8, width, height);
+			glTextureSubImage2D(m_AtlasTexture, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, atlas.getPixels());
+		}
+		glTextureParameteri(m_AtlasTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureParameteri(m_AtlasTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		std::memcpy(regions.data(), atlas.getRegions(), atlas.getRegionCount() * sizeof(AtlasRegion));
+	}
+	glTextureSubImage2D(m_RegionTexture, 0, 0, 0, (GLsizei)m_Materials.getCount(), 1, GL_RGBA_INTEGER, GL_UNSIGNED_SHORT, regions.data());
+}
+
+void ChunkRenderer::setGasField(const GasField& gas) {
+	if (!m_TextureProgram) return;
+	GLuint species[GAS_SPECIES] = {};
+	for (int i = 0; i < gas.getSpeciesCount(); i++) species[i] = gas.getSpeciesMaterial(i);
+	glProgramUniform1uiv(m_TextureProgram, m_GasSpeciesLocation, GAS_SPECIES, species);
+}
+
+void ChunkRenderer::invalidateSlots() {
+	for (auto& entry : m_Slots) {
+		entry.second.revision = 0;
+		entry.second.staleSince = m_Frame;
+	}
+}
+
+ChunkRenderer::Slot& ChunkRenderer::acquireSlot(const ChunkSnapshot* chunk) {
+	const uint64_t key = World::chunkKey(chunk->getChunkX(), chunk->getChunkY());
+	auto found = m_Slots.find(key);
+	if (found != m_Slots.end()) return found->second;
+
+	if (m_FreeSlots.empty()) growSlots();
+	const uint32_t index = m_FreeSlots.back();
+	m_FreeSlots.pop_back();
+	return m_Slots.emplace(key, Slot{chunk->getSerial(), index, 0, m_Frame, m_Frame}).first->second;
+}
+
+void ChunkRenderer::growSlots() {
+	const uint32_t capacity = m_SlotCapacity * 2;
+	for (uint32_t i = capacity; i-- > m_SlotCapacity;) m_FreeSlots.push_back(i);
+	m_SlotCapacity = capacity;
+}
+
+void ChunkRenderer::evictSlots() {
+	for (auto it = m_Slots.begin(); it != m_Slots.end();) {
+		if (m_Frame - it->second.lastSeen > EVICT_FRAMES) {
+			m_FreeSlots.push_back(it->second.index);
+			it = m_Slots.erase(it);
+		} else {
+			it++;
+		}
+	}
+}
+
+// GPU storage only grows to the slot capacity of the mode in use.
+void ChunkRenderer::ensureStorage() {
+	if (m_Mode == RenderTexture && m_TextureLayers < m_SlotCapacity) {
+		GLuint texture;
+		glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &texture);
+		glTextureStorage3D(texture, 1, GL_R16UI, CHUNK_SIZE, CHUNK_SIZE, m_SlotCapacity);
+		glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		if (m_MaterialTexture) {
+			glCopyImageSubData(m_MaterialTexture, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0,
+				texture, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, CHUNK_SIZE, CHUNK_SIZE, m_TextureLayers);
+			glDeleteTextures(1, &m_MaterialTexture);
+		}
+		m_MaterialTexture = texture;
+
+		// linear, so clouds thin out smoothly instead of in GAS_SCALE blocks
+		glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &texture);
+		glTextureStorage3D(texture, 1, GL_RGBA8, GAS_SIZE, GAS_SIZE, m_SlotCapacity);
+		glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		if (m_GasTexture) {
+			glCopyImageSubData(m_GasTexture, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0,
+				texture, GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, GAS_SIZE, GAS_SIZE, m_TextureLayers);
+			glDeleteTextures(1, &m_GasTexture);
+		}
+		m_GasTexture = texture;
+		m_TextureLayers = m_SlotCapacity;
+	}
+
+	if (m_Mode == RenderPoints && m_Points.getVertexCount() < m_SlotCapacity * (GLuint)CHUNK_CELLS) {
+		// new slots start empty, material 0 is never drawn
+		m_Points.reserve(m_SlotCapacity * CHUNK_CELLS);
+		while (m_Points.getVertexCount() < m_SlotCapacity * (GLuint)CHUNK_CELLS) m_Points.pushVertex(0.0f, 0.0f, 0.0f);
+	}
+}
+
+size_t ChunkRenderer::getChunkUploadSize() const {
+	return m_Mode == RenderTexture ? CHUNK_CELLS * sizeof(MaterialID) + GAS_CELLS * GAS_SPECIES : CHUNK_CELLS * PointLayout::STRIDE;
+}
+
+void ChunkRenderer::uploadChunk(const ChunkSnapshot* chunk, const Slot& slot) {
+	const MaterialID* materials = chunk->getMaterials();
+
+	if (m_Mode == RenderTexture) {
+		glTextureSubImage3D(m_MaterialTexture, 0, 0, 0, slot.index, CHUNK_SIZE, CHUNK_SIZE, 1, GL_RED_INTEGER, GL_UNSIGNED_SHORT, materials);
+		glTextureSubImage3D(m_GasTexture, 0, 0, 0, slot.index, GAS_SIZE, GAS_SIZE, 1, GL_RGBA, GL_UNSIGNED_BYTE, chunk->getGas());
+		return;
+	}
+
+	// staged here, the whole slot goes up in one sub upload when the buffer is pushed
+	const float originX = (float)(chunk->getChunkX() * CHUNK_SIZE);
+	const float originY = (float)(chunk->getChunkY() * CHUNK_SIZE);
+	const GLuint first = slot.index * CHUNK_CELLS;
+	for (int y = 0; y < CHUNK_SIZE; y++) {
+		for (int x = 0; x < CHUNK_SIZE; x++) {
+			const int i = Chunk::index(x, y);
+			m_Points.editVertex(first + i, originX + x, originY + y, (float)materials[i]);
+		}
+	}
+}
+
+void ChunkRenderer::render(const WorldSnapshot& world, const RenderView& view) {
+	PROFILE_SCOPE("ChunkRenderer::render");
+	m_Frame++;
+	m_Stats = {};
+
+	if (m_Frame % EVICT_FRAMES == 0) evictSlots();
+
+	const int minX = (int)std::floor(view.left) >> CHUNK_SIZE_LOG2;
+	const int minY = (int)std::floor(view.bottom) >> CHUNK_SIZE_LOG2;
+	const int maxX = (int)std::floor(view.left + view.width) >> CHUNK_SIZE_LOG2;
+	const int maxY = (int)std::floor(view.bottom + view.height) >> CHUNK_SIZE_LOG2;
+
+	m_Visible.clear();
+	m_Stale.clear();
+	for (const ChunkSnapshot* chunk : world.getChunks()) {
+		if (chunk->getChunkX() < minX || chunk->getChunkX() > maxX || chunk->getChunkY() < minY || chunk->getChunkY() > maxY) continue;
+
+		Slot& slot = acquireSlot(chunk);
+		slot.lastSeen = m_Frame;
+		if (slot.serial != chunk->getSerial()) {
+			// the chunk was removed and another one created at the same position
+			slot.serial = chunk->getSerial();
+			slot.revision = 0;
+		}
+		if (slot.revision == chunk->getRevision()) {
+			slot.staleSince = m_Frame;
+		} else {
+			m_Stale.push_back({chunk, &slot});
+		}
+		m_Visible.push_back({chunk, &slot});
+	}
+	ensureStorage();
+
+	// longest waiting first, so a budget smaller than the changes still reaches every chunk
+	std::sort(m_Stale.begin(), m_Stale.end(), [](const VisibleChunk& a, const VisibleChunk& b) {
+		return a.slot->staleSince < b.slot->staleSince;
+	});
+
+	const size_t chunkBytes = getChunkUploadSize();
+	{
+		PROFILE_SCOPE("chunk uploads");
+		PROFILE_GPU_SCOPE(m_GpuProfiler, "chunk uploads");
+		for (const VisibleChunk& stale : m_Stale) {
+			if (m_Stats.chunksUploaded > 0 && m_Stats.bytesUploaded + chunkBytes > m_UploadBudget) {
+				m_Stats.chunksDeferred++;
+				continue;
+			}
+			uploadChunk(stale.chunk, *stale.slot);
+			stale.slot->revision = stale.chunk->getRevision();
+			m_Stats.chunksUploaded++;
+			m_Stats.bytesUploaded += chunkBytes;
+		}
+	}
+
+	PROFILE_SCOPE("draw");
+	PROFILE_GPU_SCOPE(m_GpuProfiler, "draw");
+	glViewport(0, 0, view.viewportWidth, view.viewportHeight);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glBindTextureUnit(0, m_PaletteTexture);
+	glBindTextureUnit(2, m_AtlasTexture);
+	glBindTextureUnit(3, m_RegionTexture);
+
+	if (m_Mode == RenderTexture) {
+		drawTextures(view);
+	} else {
+		drawPoints(view);
+	}
+}
+
+void ChunkRenderer::drawTextures(const RenderView& view) {
+	m_Instances.clear();
+	for (const VisibleChunk& visible : m_Visible) {
+		if (visible.slot->revision == 0) continue;
+		m_Instances.pushVertex((float)visible.chunk->getChunkX(), (float)visible.chunk->getChunkY(), (float)visible.slot->index);
+	}
+	m_Stats.chunksDrawn = m_Instances.getVertexCount();
+	if (m_Stats.chunksDrawn == 0) return;
+	m_Instances.pushToBuffer(true);
+
+	glUseProgram(m_TextureProgram);
+	glProgramUniform4f(m_TextureProgram, m_TextureViewLocation, view.left, view.bottom, 2.0f / view.width, 2.0f / view.height);
+	glBindTextureUnit(1, m_MaterialTexture);
+	glBindTextureUnit(4, m_GasTexture);
+
+	m_TextureVAO.bind();
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)m_Stats.chunksDrawn);
+	m_TextureVAO.unbind();
+}
+
+void ChunkRenderer::drawPoints(const RenderView& view) {
+	m_Points.pushToBuffer();
+
+	m_DrawFirst.clear();
+	m_DrawCount.clear();
+	for (const VisibleChunk& visible : m_Visible) {
+		if (visible.slot->revision == 0) continue;
+		m_DrawFirst.push_back((GLint)(visible.slot->index * CHUNK_CELLS));
+		m_DrawCount.push_back(CHUNK_CELLS);
+	}
+	m_Stats.chunksDrawn = m_DrawFirst.size();
+	if (m_Stats.chunksDrawn == 0) return;
+
+	glUseProgram(m_PointProgram);
+	glProgramUniform4f(m_PointProgram, m_PointViewLocation, view.left, view.bottom, 2.0f / view.width, 2.0f / view.height);
+	glProgramUniform1f(m_PointProgram, m_PointSizeLocation, std::max(1.0f, view.viewportHeight / view.height));
+	glEnable(GL_PROGRAM_POINT_SIZE);
+
+	m_PointVAO.bind();
+	glMultiDrawArrays(GL_POINTS, m_DrawFirst.data(), m_DrawCount.data(), (GLsizei)m_DrawFirst.size());
+	m_PointVAO.unbind();
+}
@@ -0,0 +1,527 @@
+#include "DebrisTracker.h"
+
+#include <algorithm>
+
+#include <stb_connected_components.h>
+
+#include "Simulation.h"
+
+// in vendor/stb/src/stb_connected_components.c, next to the stbcc internals it builds on
+extern "C" void stbcc_update_cluster(stbcc_grid* g, int cx, int cy, const unsigned char* solid);
+
+namespace {
+	constexpr uint32_t NO_ANCHOR = 0xFFFFFFFF;
+	constexpr uint32_t GRID_MASK = DebrisTracker::GRID_SIZE - 1;
+	constexpr int CLUSTER_CELLS = DebrisTracker::CLUSTER_SIZE * DebrisTracker::CLUSTER_SIZE;
+
+	constexpr int OFFSETS[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+
+	inline uint32_t gridIndex(int gx, int gy) {
+		return (uint32_t)gy << DebrisTracker::GRID_SIZE_LOG2 | (uint32_t)gx;
+	}
+
+	struct CellState {
+		MaterialID material;
+		float temperature;
+		int8_t velocityX;
+		int8_t velocityY;
+		uint8_t flags;
+	};
+
+	// world cell access for walking along a column, remembers the chunk it is in
+	class ColumnCursor {
+	private:
+		const World& m_World;
+		Chunk* m_Chunk = nullptr;
+		int m_ChunkX = 0;
+		int m_ChunkY = 0;
+	public:
+		ColumnCursor(const World& world) : m_World{world} {}
+
+		inline Chunk* locate(int x, int y, int& index) {
+			const int cx = World::toChunkCoord(x);
+			const int cy = World::toChunkCoord(y);
+			if (!m_Chunk || cx != m_ChunkX || cy != m_ChunkY) {
+				m_Chunk = m_World.getChunk(cx, cy);
+				m_ChunkX = cx;
+				m_ChunkY = cy;
+			}
+			index = Chunk::index(World::toLocalCoord(x), World::toLocalCoord(y));
+			return m_Chunk;
+		}
+
+		inline bool read(int x, int y, CellState& out) {
+			int i;
+			Chunk* chunk = locate(x, y, i);
+			if (!chunk) return false;
+			out = CellState{chunk->getMaterials()[i], chunk->getTemperatures()[i], chunk->getVelocitiesX()[i], chunk->getVelocitiesY()[i], chunk->getFlags()[i]};
+			return true;
+		}
+
+		inline void write(int x, int y, const CellState& cell) {
+			int i;
+			Chunk* chunk = locate(x, y, i);
+			if (!chunk) return;
+			chunk->getMaterials()[i] = cell.material;
+			chunk->getTemperatures()[i] = cell.temperature;
+			chunk->getVelocitiesX()[i] = cell.velocityX;
+			chunk->getVelocitiesY()[i] = cell.velocityY;
+			chunk->getFlags()[i] = cell.flags;
+			chunk->markDirty(World::toLocalCoord(x), World::toLocalCoord(y));
+		}
+	};
+}
+
+DebrisTracker::DebrisTracker(World& world, const MaterialTable& materials) : m_World{world}, m_Materials{materials} {
+
+}
+
+DebrisTracker::~DebrisTracker() {
+
+}
+
+bool DebrisTracker::isRigid(const Chunk* chunk, int index) const {
+	const uint8_t flags = chunk->getFlags()[index];
+	if (flags & CellDebris) return false;
+	if (flags & CellStatic) return true;
+	return m_Materials.getPhase(chunk->getMaterials()[index]) == PhaseSolid;
+}
+
+bool DebrisTracker::isDisplaceable(int x, int y) const {
+	const Chunk* chunk = m_World.getChunkAt(x, y);
+	if (!chunk) return false; // unloaded space behaves like a wall
+	const int i = Chunk::index(World::toLocalCoord(x), World::toLocalCoord(y));
+	if (chunk->getFlags()[i] & (CellStatic | CellDebris)) return false;
+	const MaterialPhase phase = m_Materials.getPhase(chunk->getMaterials()[i]);
+	return phase == PhaseEmpty || phase == PhaseGas || phase == PhaseLiquid;
+}
+
+bool DebrisTracker::isOpen(int gx, int gy) const {
+	return stbcc_query_grid_open(m_Grid, gx, gy) != 0;
+}
+
+void DebrisTracker::setRegion(int originChunkX, int originChunkY) {
+	if (!m_GridMemory) {
+		m_GridMemory.reset(new unsigned char[stbcc_grid_sizeof()]);
+		m_Grid = reinterpret_cast<stbcc_grid*>(m_GridMemory.get());
+		m_Anchors.resize(CLUSTER_COUNT * CLUSTER_COUNT);
+		m_ClusterDirty.assign(CLUSTER_COUNT * CLUSTER_COUNT, 0);
+		m_Visited.assign(GRID_SIZE * GRID_SIZE, 0);
+
+		// Sized up front so whenever the first collapse comes, the tick doesn't allocate: anchors
+		// for every clump there can be, and room for MAX_BODY_CELLS cells detaching and falling
+		// at once (a flood pushes at most four neighbours per cell, a landing body as many candidates).
+		for (std::vector<uint32_t>& anchors : m_Anchors) anchors.reserve(MAX_CLUMPS_PER_CLUSTER);
+		m_Supported.reserve(CLUSTER_COUNT * CLUSTER_COUNT * MAX_CLUMPS_PER_CLUSTER);
+		m_DirtyClusters.reserve(CLUSTER_COUNT * CLUSTER_COUNT);
+		m_Island.reserve(MAX_BODY_CELLS + 1);
+		m_Stack.reserve(4 * MAX_BODY_CELLS);
+		m_Detached.reserve(MAX_BODY_CELLS);
+		m_Candidates.reserve(4 * MAX_BODY_CELLS);
+		m_Checked.reserve(MAX_BODY_CELLS);
+		m_Runs.reserve(MAX_BODY_CELLS);
+		m_Bodies.reserve(MAX_BODY_CELLS);
+	}
+	m_OriginX = originChunkX * CHUNK_SIZE;
+	m_OriginY = originChunkY * CHUNK_SIZE;
+
+	// stbcc wants 0 for the cells it connects
+	m_Map.assign(GRID_SIZE * GRID_SIZE, 1);
+	for (int cy = 0; cy < GRID_CHUNKS; cy++) {
+		for (int cx = 0; cx < GRID_CHUNKS; cx++) {
+			const Chunk* chunk = m_World.getChunk(originChunkX + cx, originChunkY + cy);
+			if (!chunk) continue;
+			for (int y = 0; y < CHUNK_SIZE; y++) {
+				unsigned char* row = &m_Map[(cy * CHUNK_SIZE + y) * GRID_SIZE + cx * CHUNK_SIZE];
+				for (int x = 0; x < CHUNK_SIZE; x++) row[x] = isRigid(chunk, Chunk::index(x, y)) ? 0 : 1;
+			}
+		}
+	}
+	stbcc_init_grid(m_Grid, m_Map.data(), GRID_SIZE, GRID_SIZE);
+	m_SupportedValid = false;
+
+	for (int cluster = 0; cluster < CLUSTER_COUNT * CLUSTER_COUNT; cluster++) rebuildAnchors(cluster);
+	m_DirtyClusters.clear();
+	std::fill(m_ClusterDirty.begin(), m_ClusterDirty.end(), 0);
+
+	// whatever already floats falls on the first update
+	m_Candidates.clear();
+	for (uint32_t i = 0; i < (uint32_t)m_Map.size(); i++) {
+		if (m_Map[i] == 0) m_Candidates.push_back(i);
+	}
+}
+
+void DebrisTracker::markCluster(int gx, int gy) {
+	const uint32_t cluster = (uint32_t)(gy >> CLUSTER_SIZE_LOG2) * CLUSTER_COUNT + (uint32_t)(gx >> CLUSTER_SIZE_LOG2);
+	if (m_ClusterDirty[cluster]) return;
+	m_ClusterDirty[cluster] = 1;
+	m_DirtyClusters.push_back(cluster);
+}
+
+void DebrisTracker::syncClusters() {
+	if (m_DirtyClusters.empty()) return;
+
+	unsigned char solid[CLUSTER_CELLS];
+	stbcc_update_batch_begin(m_Grid);
+	for (uint32_t cluster : m_DirtyClusters) {
+		const int originX = (int)(cluster % CLUSTER_COUNT) * CLUSTER_SIZE;
+		const int originY = (int)(cluster / CLUSTER_COUNT) * CLUSTER_SIZE;
+		// clusters never straddle chunks
+		const Chunk* chunk = m_World.getChunkAt(m_OriginX + originX, m_OriginY + originY);
+		const int localX = World::toLocalCoord(m_OriginX + originX);
+		const int localY = World::toLocalCoord(m_OriginY + originY);
+		for (int y = 0; y < CLUSTER_SIZE; y++) {
+			for (int x = 0; x < CLUSTER_SIZE; x++) {
+				solid[y * CLUSTER_SIZE + x] = chunk && isRigid(chunk, Chunk::index(localX + x, localY + y)) ? 0 : 1;
+			}
+		}
+		stbcc_update_cluster(m_Grid, (int)(cluster % CLUSTER_COUNT), (int)(cluster / CLUSTER_COUNT), solid);
+		m_Stats.clustersRebuilt++;
+	}
+	stbcc_update_batch_end(m_Grid);
+	m_SupportedValid = false;
+
+	for (uint32_t cluster : m_DirtyClusters) {
+		rebuildAnchors((int)cluster);
+		m_ClusterDirty[cluster] = 0;
+	}
+	m_DirtyClusters.clear();
+}
+
+void DebrisTracker::rebuildAnchors(int cluster) {
+	std::vector<uint32_t>& anchors = m_Anchors[cluster];
+	anchors.clear();
+
+	const int originX = (cluster % CLUSTER_COUNT) * CLUSTER_SIZE;
+	const int originY = (cluster / CLUSTER_COUNT) * CLUSTER_SIZE;
+	// clusters never straddle chunks
+	const Chunk* chunk = m_World.getChunkAt(m_OriginX + originX, m_OriginY + originY);
+	const int localX = World::toLocalCoord(m_OriginX + originX);
+	const int localY = World::toLocalCoord(m_OriginY + originY);
+
+	// flood fill every clump of the cluster, keeping the first anchor found in each
+	bool visited[CLUSTER_CELLS] = {};
+	uint16_t stack[CLUSTER_CELLS];
+	for (int start = 0; start < CLUSTER_CELLS; start++) {
+		if (visited[start] || !isOpen(originX + (start & (CLUSTER_SIZE - 1)), originY + (start >> CLUSTER_SIZE_LOG2))) continue;
+
+		uint32_t anchor = NO_ANCHOR;
+		int top = 0;
+		stack[top++] = (uint16_t)start;
+		visited[start] = true;
+		while (top > 0) {
+			const int cell = stack[--top];
+			const int x = cell & (CLUSTER_SIZE - 1);
+			const int y = cell >> CLUSTER_SIZE_LOG2;
+			const int gx = originX + x;
+			const int gy = originY + y;
+
+			if (anchor == NO_ANCHOR) {
+				const bool edge = gx == 0 || gy == 0 || gx == GRID_SIZE - 1 || gy == GRID_SIZE - 1;
+				if (edge || (chunk && (chunk->getFlags()[Chunk::index(localX + x, localY + y)] & CellStatic))) anchor = gridIndex(gx, gy);
+			}
+
+			for (const int* offset : OFFSETS) {
+				const int nx = x + offset[0];
+				const int ny = y + offset[1];
+				if ((unsigned)nx >= (unsigned)CLUSTER_SIZE || (unsigned)ny >= (unsigned)CLUSTER_SIZE) continue;
+				const int next = ny << CLUSTER_SIZE_LOG2 | nx;
+				if (visited[next] || !isOpen(originX + nx, originY + ny)) continue;
+				visited[next] = true;
+				stack[top++] = (uint16_t)next;
+			}
+		}
+		if (anchor != NO_ANCHOR) anchors.push_back(anchor);
+	}
+}
+
+void DebrisTracker::collectSupported() {
+	if (m_SupportedValid) return;
+	m_SupportedValid = true;
+	m_Supported.clear();
+	for (const std::vector<uint32_t>& anchors : m_Anchors) {
+		for (uint32_t anchor : anchors) m_Supported.push_back(stbcc_get_unique_id(m_Grid, anchor & GRID_MASK, anchor >> GRID_SIZE_LOG2));
+	}
+	std::sort(m_Supported.begin(), m_Supported.end());
+	m_Supported.erase(std::unique(m_Supported.begin(), m_Supported.end()), m_Supported.end());
+}
+
+void DebrisTracker::update() {
+	if (!m_Grid) return;
+	scanChanges();
+	syncClusters();
+	detachIslands();
+	syncClusters();
+	moveBodies();
+	syncClusters();
+}
+
+void DebrisTracker::scanChanges() {
+	for (const Chunk* chunk : m_World.getChunks()) {
+		if (!chunk->isAwake()) continue;
+		const int baseX = chunk->getChunkX() * CHUNK_SIZE - m_OriginX;
+		const int baseY = chunk->getChunkY() * CHUNK_SIZE - m_OriginY;
+		if (!inGrid(baseX, baseY)) continue;
+
+		for (int y = chunk->getDirtyMinY(); y < chunk->getDirtyMaxY(); y++) {
+			for (int x = chunk->getDirtyMinX(); x < chunk->getDirtyMaxX(); x++) {
+				const int gx = baseX + x;
+				const int gy = baseY + y;
+				const bool rigid = isRigid(chunk, Chunk::index(x, y));
+				if (rigid == isOpen(gx, gy)) continue;
+				markCluster(gx, gy);
+				m_Stats.cellsChanged++;
+
+				// a new cell may float on its own, a removed one may have cut its neighbours loose
+				if (rigid) {
+					m_Candidates.push_back(gridIndex(gx, gy));
+				} else {
+					for (const int* offset : OFFSETS) {
+						const int nx = gx + offset[0];
+						const int ny = gy + offset[1];
+						if (inGrid(nx, ny) && isOpen(nx, ny)) m_Candidates.push_back(gridIndex(nx, ny));
+					}
+				}
+			}
+		}
+		m_Stats.cellsScanned += (size_t)(chunk->getDirtyMaxX() - chunk->getDirtyMinX()) * (chunk->getDirtyMaxY() - chunk->getDirtyMinY());
+	}
+}
+
+void DebrisTracker::detachIslands() {
+	if (m_Candidates.empty()) return;
+	collectSupported();
+
+	// every island is found before any of them leaves the grid, stbcc can't be queried mid-batch
+	m_Checked.clear();
+	for (uint32_t candidate : m_Candidates) {
+		const int gx = candidate & GRID_MASK;
+		const int gy = candidate >> GRID_SIZE_LOG2;
+		if (m_Visited[candidate] || !isOpen(gx, gy)) continue;
+
+		const uint32_t id = stbcc_get_unique_id(m_Grid, gx, gy);
+		if (id == STBCC_NULL_UNIQUE_ID || std::binary_search(m_Supported.begin(), m_Supported.end(), id)) continue;
+		if (std::find(m_Checked.begin(), m_Checked.end(), id) != m_Checked.end()) continue;
+		m_Checked.push_back(id);
+
+		if (!floodIsland(candidate)) continue;
+		createBody();
+		m_Detached.insert(m_Detached.end(), m_Island.begin(), m_Island.end());
+	}
+	m_Candidates.clear();
+
+	// the cells are flagged CellDebris by now, so the next sync takes them out of the grid
+	for (uint32_t cell : m_Detached) {
+		markCluster((int)(cell & GRID_MASK), (int)(cell >> GRID_SIZE_LOG2));
+		m_Visited[cell] = 0;
+	}
+	m_Detached.clear();
+}
+
+bool DebrisTracker::floodIsland(uint32_t start) {
+	// cells of islands found earlier in this update stay marked visited until they leave the grid
+	m_Island.clear();
+	m_Stack.clear();
+	m_Stack.push_back(start);
+	m_Visited[start] = 1;
+
+	while (!m_Stack.empty()) {
+		const uint32_t cell = m_Stack.back();
+		m_Stack.pop_back();
+		m_Island.push_back(cell);
+		if (m_Island.size() > MAX_BODY_CELLS) break;
+
+		const int gx = cell & GRID_MASK;
+		const int gy = cell >> GRID_SIZE_LOG2;
+		for (const int* offset : OFFSETS) {
+			const int nx = gx + offset[0];
+			const int ny = gy + offset[1];
+			if (!inGrid(nx, ny) || !isOpen(nx, ny)) continue;
+			const uint32_t next = gridIndex(nx, ny);
+			if (m_Visited[next]) continue;
+			m_Visited[next] = 1;
+			m_Stack.push_back(next);
+		}
+	}
+
+	if (m_Island.size() <= MAX_BODY_CELLS) return true;
+
+	// too big to move as one, it stays where it is
+	for (uint32_t cell : m_Stack) m_Visited[cell] = 0;
+	for (uint32_t cell : m_Island) m_Visited[cell] = 0;
+	m_Island.clear();
+	return false;
+}
+
+void DebrisTracker::createBody() {
+	// column-major order turns the cells into vertical runs
+	std::sort(m_Island.begin(), m_Island.end(), [](uint32_t a, uint32_t b) {
+		return ((a & GRID_MASK) << GRID_SIZE_LOG2 | a >> GRID_SIZE_LOG2) < ((b & GRID_MASK) << GRID_SIZE_LOG2 | b >> GRID_SIZE_LOG2);
+	});
+
+	Body body;
+	body.firstRun = m_Runs.size();
+	body.cells = m_Island.size();
+	body.speed = 0;
+
+	ColumnCursor cursor(m_World);
+	for (uint32_t cell : m_Island) {
+		const int x = m_OriginX + (int)(cell & GRID_MASK);
+		const int y = m_OriginY + (int)(cell >> GRID_SIZE_LOG2);
+		if (m_Runs.size() > body.firstRun && m_Runs.back().x == x && m_Runs.back().top == y - 1) {
+			m_Runs.back().top = y;
+		} else {
+			m_Runs.push_back(Run{x, y, y});
+		}
+
+		int index;
+		if (Chunk* chunk = cursor.locate(x, y, index)) chunk->getFlags()[index] |= CellDebris;
+	}
+
+	body.runCount = m_Runs.size() - body.firstRun;
+
+	m_Stats.bodiesDetached++;
+	m_Stats.cellsDetached += body.cells;
+	m_Bodies.push_back(body);
+}
+
+int DebrisTracker::fallDistance(const Body& body, int speed) const {
+	const Run* runs = &m_Runs[body.firstRun];
+	int distance = speed;
+	for (size_t r = 0; r < body.runCount && distance > 0; r++) {
+		const Run& run = runs[r];
+		for (int s = 1; s <= distance; s++) {
+			const int y = run.bottom - s;
+
+			// lower runs of the same column move out of the way along with this one
+			bool own = false;
+			for (size_t o = r; o-- > 0 && runs[o].x == run.x;) {
+				if (y >= runs[o].bottom && y <= runs[o].top) {
+					own = true;
+					break;
+				}
+			}
+			if (!own && !isDisplaceable(run.x, y)) {
+				distance = s - 1;
+				break;
+			}
+		}
+	}
+	return distance;
+}
+
+void DebrisTracker::moveBody(Body& body, int distance) {
+	ColumnCursor cursor(m_World);
+	CellState displaced[Simulation::MAX_FALL_SPEED];
+
+	// runs go bottom up, so every run drops into space the one below it has already left
+	for (size_t r = body.firstRun; r < body.firstRun + body.runCount; r++) {
+		Run& run = m_Runs[r];
+		for (int s = 0; s < distance; s++) cursor.read(run.x, run.bottom - distance + s, displaced[s]);
+		for (int y = run.bottom; y <= run.top; y++) {
+			CellState cell;
+			if (cursor.read(run.x, y, cell)) cursor.write(run.x, y - distance, cell);
+		}
+		for (int s = 0; s < distance; s++) cursor.write(run.x, run.top - distance + 1 + s, displaced[s]);
+
+		run.bottom -= distance;
+		run.top -= distance;
+	}
+	m_Stats.cellsMoved += body.cells;
+}
+
+bool DebrisTracker::hasGround(const Body& body) {
+	collectSupported();
+	// runs are as long as they go, so the cell under one is never part of the body
+	for (size_t r = body.firstRun; r < body.firstRun + body.runCount; r++) {
+		const Run& run = m_Runs[r];
+		const int y = run.bottom - 1;
+		const Chunk* chunk = m_World.getChunkAt(run.x, y);
+		if (!chunk) return true; // unloaded space behaves like a wall
+		if (!isRigid(chunk, Chunk::index(World::toLocalCoord(run.x), World::toLocalCoord(y)))) continue;
+
+		// past the window is ground like its edge, inside it the cell has to be held up itself
+		const int gx = run.x - m_OriginX;
+		const int gy = y - m_OriginY;
+		if (!inGrid(gx, gy)) return true;
+		if (isOpen(gx, gy) && std::binary_search(m_Supported.begin(), m_Supported.end(), stbcc_get_unique_id(m_Grid, gx, gy))) return true;
+	}
+	return false;
+}
+
+void DebrisTracker::landBody(const Body& body) {
+	ColumnCursor cursor(m_World);
+	for (size_t r = body.firstRun; r < body.firstRun + body.runCount; r++) {
+		const Run& run = m_Runs[r];
+		for (int y = run.bottom; y <= run.top; y++) {
+			int index;
+			Chunk* chunk = cursor.locate(run.x, y, index);
+			if (!chunk) continue;
+			chunk->getFlags()[index] &= ~CellDebris;
+			// straight into the grid, not through the scan and the detach candidates
+			const int gx = run.x - m_OriginX;
+			const int gy = y - m_OriginY;
+			if (!inGrid(gx, gy)) continue;
+			markCluster(gx, gy);
+
+			// except around cells that stopped being rigid on the way down, they may have split the body
+			if (isRigid(chunk, index)) continue;
+			for (const int* offset : OFFSETS) {
+				if (inGrid(gx + offset[0], gy + offset[1])) m_Candidates.push_back(gridIndex(gx + offset[0], gy + offset[1]));
+			}
+		}
+	}
+	m_Stats.bodiesLanded++;
+	m_Stats.cellsLanded += body.cells;
+}
+
+void DebrisTracker::moveBodies() {
+	for (size_t i = 0; i < m_Bodies.size();) {
+		Body& body = m_Bodies[i];
+		const int distance = fallDistance(body, std::min(body.speed + 1, Simulation::MAX_FALL_SPEED));
+		if (distance > 0) {
+			moveBody(body, distance);
+			body.speed = distance;
+			i++;
+			continue;
+		}
+
+		body.speed = 0;
+		if (hasGround(body)) {
+			landBody(body);
+			removeBody(i);
+			continue;
+		}
+		// held up by powder, another body or loose rigid cells, it stays a body until it can fall again
+		i++;
+	}
+}
+
+void DebrisTracker::removeBody(size_t i) {
+	const Body body = m_Bodies[i];
+	m_Runs.erase(m_Runs.begin() + body.firstRun, m_Runs.begin() + body.firstRun + body.runCount);
+	for (Body& other : m_Bodies) {
+		if (other.firstRun > body.firstRun) other.firstRun -= body.runCount;
+	}
+	m_Bodies[i] = m_Bodies.back();
+	m_Bodies.pop_back();
+}
+
+bool DebrisTracker::isConnected(int x1, int y1, int x2, int y2) const {
+	if (!m_Grid) return false;
+	x1 -= m_OriginX;
+	y1 -= m_OriginY;
+	x2 -= m_OriginX;
+	y2 -= m_OriginY;
+	if (!inGrid(x1, y1) || !inGrid(x2, y2)) return false;
+	return stbcc_query_grid_node_connection(m_Grid, x1, y1, x2, y2) != 0;
+}
+
+bool DebrisTracker::isSupported(int x, int y) {
+	if (!m_Grid) return false;
+	const int gx = x - m_OriginX;
+	const int gy = y - m_OriginY;
+	if (!inGrid(gx, gy) || !isOpen(gx, gy)) return false;
+	collectSupported();
+	return std::binary_search(m_Supported.begin(), m_Supported.end(), stbcc_get_unique_id(m_Grid, gx, gy));
+}
@@ -0,0 +1,97 @@
+#include "DebugHud.h"
+
+#include <algorithm>
+#include <string>
+
+#include <spdlog/spdlog.h>
+
+#include "Profiler.h"
+
+namespace {
+	const uint32_t TEXT_COLOR = 0xffffffff;
+	const uint32_t DIM_COLOR = 0xb0b0b0ff;
+}
+
+DebugHud::DebugHud(const MaterialTable& materials) : m_Materials{materials}, m_Population(materials.getCount(), 0) {
+
+}
+
+void DebugHud::countPopulations(const WorldSnapshot& snapshot) {
+	PROFILE_SCOPE("hud populations");
+	m_Updates++;
+	m_Recounted = 0;
+	const size_t materialCount = m_Materials.getCount();
+
+	for (const ChunkSnapshot* chunk : snapshot.getChunks()) {
+		ChunkCounts& entry = m_Chunks[chunk->getSerial()];
+		entry.seen = m_Updates;
+		if (!entry.counts.empty() && entry.revision == chunk->getRevision()) continue;
+
+		if (entry.counts.empty()) entry.counts.assign(materialCount, 0);
+		// four histograms side by side, so a run of one material isn't one long chain of increments
+		// to the same counter
+		m_Histograms.assign(materialCount * 4, 0);
+		const MaterialID* materials = chunk->getMaterials();
+		for (int i = 0; i < CHUNK_CELLS; i += 4) {
+			m_Histograms[materials[i] * 4]++;
+			m_Histograms[materials[i + 1] * 4 + 1]++;
+			m_Histograms[materials[i + 2] * 4 + 2]++;
+			m_Histograms[materials[i + 3] * 4 + 3]++;
+		}
+		for (size_t m = 0; m < materialCount; m++) {
+			const uint32_t* histogram = m_Histograms.data() + m * 4;
+			const uint32_t count = histogram[0] + histogram[1] + histogram[2] + histogram[3];
+			m_Population[m] += count - (uint64_t)entry.counts[m];
+			entry.counts[m] = count;
+		}
+		entry.revision = chunk->getRevision();
+		m_Recounted++;
+	}
+
+	// chunks the world dropped
+	if (m_Chunks.size() == snapshot.getChunkCount()) return;
+	for (auto it = m_Chunks.begin(); it != m_Chunks.end();) {
+		if (it->second.seen == m_Updates) {
+			++it;
+			continue;
+		}
+		for (size_t m = 0; m < materialCount; m++) m_Population[m] -= it->second.counts[m];
+		it = m_Chunks.erase(it);
+	}
+}
+
+void DebugHud::build(TextOverlay& overlay, const HudStats& stats) {
+	overlay.setColor(0, TEXT_COLOR);
+	overlay.setColor(1, DIM_COLOR);
+	const float line = (float)overlay.getLineHeight();
+	float y = MARGIN;
+
+	std::string timing = fmt::format("tick {}", stats.tick);
+	if (stats.tickSeconds >= 0.0) timing += fmt::format("  {:.2f} ms/tick", stats.tickSeconds * 1000.0);
+	if (stats.frameSeconds >= 0.0) timing += fmt::format("  {:.2f} ms/frame", stats.frameSeconds * 1000.0);
+	overlay.addText(MARGIN, y, timing);
+	y += line;
+	overlay.addText(MARGIN, y, fmt::format("{} of {} chunks awake", stats.awakeChunks, stats.chunkCount), 1);
+	y += line * 1.5f;
+
+	// material 0 is empty space
+	m_Order.clear();
+	for (size_t m = 1; m < m_Materials.getCount(); m++) {
+		if (m_Population[m] > 0) m_Order.push_back((MaterialID)m);
+	}
+	const size_t lines = std::min<size_t>(m_Order.size(), MATERIAL_LINES);
+	std::partial_sort(m_Order.begin(), m_Order.begin() + lines, m_Order.end(), [this](MaterialID a, MaterialID b) {
+		return m_Population[a] != m_Population[b] ? m_Population[a] > m_Population[b] : a < b;
+	});
+
+	float nameWidth = 0.0f;
+	for (size_t i = 0; i < lines; i++) nameWidth = std::max(nameWidth, overlay.measure(m_Materials.getName(m_Order[i])));
+	for (size_t i = 0; i < lines; i++) {
+		// in the material's colour, made opaque so gases stay readable
+		const int color = 2 + (int)i;
+		overlay.setColor(color, m_Materials.getColor(m_Order[i]) | 0xff);
+		overlay.addText(MARGIN, y, m_Materials.getName(m_Order[i]), color);
+		overlay.addText(MARGIN + nameWidth + line, y, std::to_string(m_Population[m_Order[i]]), 1);
+		y += line;
+	}
+}
@@ -0,0 +1,65 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+
+FrameArena::FrameArena(size_t blockSize) {
+	addBlock(std::max<size_t>(blockSize, 64));
+}
+
+void FrameArena::addBlock(size_t size) {
+	m_Blocks.push_back(Block{std::unique_ptr<uint8_t[]>(new uint8_t[size]), size});
+	m_BlockAllocations++;
+}
+
+void* FrameArena::allocate(size_t size, size_t alignment) {
+	Block* block = &m_Blocks[m_Block];
+	uintptr_t address = reinterpret_cast<uintptr_t>(block->data.get()) + m_Offset;
+	size_t padding = (alignment - address % alignment) % alignment;
+
+	if (m_Offset + padding + size > block->size) {
+		// spill into a new block, the chain only lasts until reset() merges it
+		const size_t grown = std::max(block->size * 2, size + alignment);
+		addBlock(grown);
+		m_Block++;
+		block = &m_Blocks[m_Block];
+		m_Offset = 0;
+		address = reinterpret_cast<uintptr_t>(block->data.get());
+		padding = (alignment - address % alignment) % alignment;
+	}
+
+	m_Offset += padding + size;
+	m_Used += padding + size;
+
+	m_Allocations++;
+	m_BytesAllocated += size;
+	m_PeakBytes = std::max(m_PeakBytes, m_Used);
+	return reinterpret_cast<void*>(address + padding);
+}
+
+void FrameArena::reset() {
+	if (m_Block > 0) {
+		const size_t capacity = getCapacity();
+		m_Blocks.clear();
+		addBlock(capacity);
+	}
+	m_Block = 0;
+	m_Offset = 0;
+	m_Used = 0;
+}
+
+FrameArenaStats FrameArena::getStats() const {
+	return FrameArenaStats{m_Allocations, m_BytesAllocated, m_PeakBytes, m_BlockAllocations};
+}
+
+void FrameArena::resetStats() {
+	m_Allocations = 0;
+	m_BytesAllocated = 0;
+	m_PeakBytes = m_Used;
+	m_BlockAllocations = 0;
+}
+
+size_t FrameArena::getCapacity() const {
+	size_t capacity = 0;
+	for (const Block& block : m_Blocks) capacity += block.size;
+	return capacity;
+}
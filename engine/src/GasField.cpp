@@ -0,0 +1,366 @@
+#include "GasField.h"
+
+#include <algorithm>
+
+#include <spdlog/spdlog.h>
+
+#include "Profiler.h"
+
+namespace {
+	constexpr int PADDED_SIZE = GAS_SIZE + 2; // a chunk's gas cells plus one of each neighbour around them
+	constexpr int PADDED_CELLS = PADDED_SIZE * PADDED_SIZE;
+
+	inline uint32_t nextRandom(uint32_t& state) {
+		// xorshift32, same as the Simulation
+		uint32_t x = state;
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		return state = x;
+	}
+
+	inline int gasIndex(int x, int y) {
+		return (y >> GAS_SCALE_LOG2) * GAS_SIZE + (x >> GAS_SCALE_LOG2);
+	}
+
+	// the neighbour's gas cells along the shared edge, copied into the padding
+	struct Padding {
+		float amount[GAS_SPECIES][PADDED_CELLS];
+		float total[PADDED_CELLS];
+		float capacity[PADDED_CELLS];
+		float temperature[PADDED_CELLS];
+		float loaded[PADDED_CELLS]; // 0 where the neighbour chunk is missing
+
+		void load(const Chunk* chunk, int species, int gx, int gy, int px, int py) {
+			const int g = gy * GAS_SIZE + gx;
+			const int p = py * PADDED_SIZE + px;
+			float sum = 0.0f;
+			for (int s = 0; s < species; s++) {
+				amount[s][p] = chunk->getGas(s)[g];
+				sum += amount[s][p];
+			}
+			total[p] = sum;
+			capacity[p] = chunk->getGasCapacities()[g];
+			temperature[p] = chunk->getGasTemperatures()[g];
+			loaded[p] = 1.0f;
+		}
+	};
+}
+
+GasField::GasField(World& world, const MaterialTable& materials, uint32_t seed, ThreadPool* pool)
+	: m_World{world}, m_Materials{materials}, m_Pool{pool}, m_Seed{seed}, m_SpeciesOf(materials.getCount(), -1) {
+	for (size_t m = 0; m < materials.getCount(); m++) {
+		if (!materials.isFieldGas((MaterialID)m)) continue;
+		if (m_SpeciesCount == GAS_SPECIES) {
+			spdlog::warn("Gas field holds at most {} gases, '{}' stays cells", GAS_SPECIES, materials.getName((MaterialID)m));
+			continue;
+		}
+		m_SpeciesOf[m] = (int8_t)m_SpeciesCount;
+		m_SpeciesMaterial[m_SpeciesCount++] = (MaterialID)m;
+	}
+}
+
+uint32_t GasField::chunkSeed(const Chunk* chunk) const {
+	// murmur3 finaliser over the seed, step and chunk position
+	uint32_t h = m_Seed ^ (uint32_t)m_Step * 0x9E3779B9u;
+	h ^= (uint32_t)chunk->getChunkX() * 0x85EBCA6Bu;
+	h ^= (uint32_t)chunk->getChunkY() * 0xC2B2AE35u;
+	h ^= h >> 16;
+	h *= 0x85EBCA6Bu;
+	h ^= h >> 13;
+	h *= 0xC2B2AE35u;
+	h ^= h >> 16;
+	return h ? h : 1;
+}
+
+float GasField::absorb(Chunk& chunk, int x, int y, int species, float temperature) {
+	const int g = gasIndex(x, y);
+	float total = 0.0f;
+	for (int s = 0; s < m_SpeciesCount; s++) total += chunk.getGas(s)[g];
+
+	float& gasTemperature = chunk.getGasTemperatures()[g];
+	gasTemperature = (gasTemperature * total + temperature) / (total + 1.0f);
+	chunk.getGas(species)[g] += 1.0f;
+
+	chunk.setHasGas(true);
+	chunk.touchGas();
+	m_Absorbed.fetch_add(1, std::memory_order_relaxed);
+	return chunk.getGasAmbient()[g];
+}
+
+void GasField::addChunk(Chunk* chunk) {
+	if (!chunk || chunk->getGasStep() == m_Step) return;
+	// capacities only go stale where cells moved, temperatures changed, or the field wasn't looking
+	m_Recount.push_back(chunk->isAwake() || chunk->isThermallyActive() || chunk->getGasStep() != m_Step - 1);
+	chunk->setGasStep(m_Step);
+	m_Chunks.push_back(chunk);
+}
+
+void GasField::step() {
+	PROFILE_SCOPE("GasField::step");
+	m_Step++;
+	m_Chunks.clear();
+	m_Recount.clear();
+	if (m_SpeciesCount == 0) return;
+
+	for (Chunk* chunk : m_World.getChunks()) {
+		if (!chunk->hasGas()) continue;
+		addChunk(chunk);
+		addChunk(chunk->getNeighbour(NeighbourLeft));
+		addChunk(chunk->getNeighbour(NeighbourRight));
+		addChunk(chunk->getNeighbour(NeighbourDown));
+		addChunk(chunk->getNeighbour(NeighbourUp));
+	}
+	m_ChunksStepped = m_Chunks.size();
+
+	{
+		PROFILE_SCOPE("gas react");
+		forEachChunk([this](size_t i) {
+			if (m_Recount[i]) countCapacity(m_Chunks[i]);
+			if (m_Chunks[i]->hasGas()) reactChunk(m_Chunks[i]);
+		});
+	}
+	{
+		PROFILE_SCOPE("gas transport");
+		forEachChunk([this](size_t i) { transportChunk(m_Chunks[i]); });
+	}
+	for (Chunk* chunk : m_Chunks) chunk->flipGas();
+}
+
+void GasField::countCapacity(Chunk* chunk) const {
+	const MaterialID* materials = chunk->getMaterials();
+	const float* temperatures = chunk->getTemperatures();
+	uint8_t* capacity = chunk->getGasCapacities();
+	float* ambient = chunk->getGasAmbient();
+
+	// summed a row at a time with no branches, so the inner loop vectorises
+	for (int gy = 0; gy < GAS_SIZE; gy++) {
+		int open[CHUNK_SIZE] = {};
+		float sum[CHUNK_SIZE] = {};
+		for (int y = gy * GAS_SCALE; y < (gy + 1) * GAS_SCALE; y++) {
+			const MaterialID* row = materials + Chunk::index(0, y);
+			const float* rowTemperatures = temperatures + Chunk::index(0, y);
+			for (int x = 0; x < CHUNK_SIZE; x++) {
+				const int empty = row[x] == 0;
+				open[x] += empty;
+				sum[x] += empty ? rowTemperatures[x] : 0.0f;
+			}
+		}
+		for (int gx = 0; gx < GAS_SIZE; gx++) {
+			int cellOpen = 0;
+			float cellSum = 0.0f;
+			for (int x = gx * GAS_SCALE; x < (gx + 1) * GAS_SCALE; x++) {
+				cellOpen += open[x];
+				cellSum += sum[x];
+			}
+			const int g = gy * GAS_SIZE + gx;
+			capacity[g] = (uint8_t)cellOpen;
+			if (cellOpen > 0) ambient[g] = cellSum / (float)cellOpen; // a filled gas cell keeps the last air it saw
+		}
+	}
+}
+
+void GasField::reactChunk(Chunk* chunk) {
+	const MaterialID* materials = chunk->getMaterials();
+	const float* temperatures = chunk->getTemperatures();
+	const uint8_t* capacity = chunk->getGasCapacities();
+	const float* ambient = chunk->getGasAmbient();
+	float* gasTemperatures = chunk->getGasTemperatures();
+	uint32_t random = chunkSeed(chunk);
+
+	for (int g = 0; g < GAS_CELLS; g++) {
+		float total = 0.0f;
+		for (int s = 0; s < m_SpeciesCount; s++) total += chunk->getGas(s)[g];
+		if (total <= 0.0f) continue;
+
+		// heat goes to the air sharing the gas cell, a cell full of gas keeps it
+		float& temperature = gasTemperatures[g];
+		const float air = capacity[g] > 0 ? std::max(0.0f, 1.0f - total / (float)capacity[g]) : 0.0f;
+		temperature += (ambient[g] - temperature) * m_Cooling * air;
+
+		for (int s = 0; s < m_SpeciesCount; s++) {
+			float& amount = chunk->getGas(s)[g];
+			if (amount <= 0.0f) continue;
+			const MaterialID material = m_SpeciesMaterial[s];
+
+			// the share of the cells that would have decayed this tick
+			const uint16_t decay = m_Materials.getDecayChance(material);
+			if (decay != 0) convert(chunk, g, amount, amount * (float)decay / 65536.0f, m_Materials.getDecaysTo(material), temperature, random);
+
+			const MaterialID changed = m_Materials.getPhaseChange(material, temperature, (uint16_t)nextRandom(random));
+			if (changed != material) convert(chunk, g, amount, amount, changed, temperature, random);
+
+			// one cell under the gas cell gets to react with a cell's worth of the gas
+			if (amount < 1.0f) continue;
+			const uint32_t r = nextRandom(random);
+			const int x = (g % GAS_SIZE) * GAS_SCALE + (int)(r & (GAS_SCALE - 1));
+			const int y = (g / GAS_SIZE) * GAS_SCALE + (int)((r >> GAS_SCALE_LOG2) & (GAS_SCALE - 1));
+			const int i = Chunk::index(x, y);
+			const Reaction& reaction = m_Materials.getReaction(material, materials[i]);
+			if (reaction.chance == 0 || (uint16_t)(r >> 16) >= reaction.chance) continue;
+
+			const float before = amount;
+			convert(chunk, g, amount, 1.0f, reaction.productA, temperature, random);
+			if (amount == before) continue; // no room for the product
+			setCell(chunk, i, reaction.productB, temperatures[i]);
+		}
+	}
+}
+
+void GasField::convert(Chunk* chunk, int cell, float& amount, float share, MaterialID material, float temperature, uint32_t& random) {
+	if (share <= 0.0f) return;
+	if (material == 0) { // turns into air, nothing to put anywhere
+		amount -= share;
+		return;
+	}
+
+	const int species = m_SpeciesOf[material];
+	if (species >= 0) {
+		chunk->getGas(species)[cell] += share;
+		amount -= share;
+		return;
+	}
+
+	// Anything else comes back as whole cells, the fraction of one by chance, and takes a whole
+	// cell's worth each. Never more than the gas cell holds, so a leftover below one cell stays
+	// gas rather than getting another chance at rounding up every tick.
+	int cells = (int)share;
+	if ((float)(nextRandom(random) & 0xFFFF) < (share - (float)cells) * 65536.0f) cells++;
+	cells = std::min(cells, (int)amount);
+	int placed = 0;
+	while (placed < cells && emit(chunk, cell, material, temperature, random)) placed++;
+	amount -= (float)placed;
+}
+
+bool GasField::emit(Chunk* chunk, int cell, MaterialID material, float temperature, uint32_t& random) {
+	uint8_t& capacity = chunk->getGasCapacities()[cell];
+	if (capacity == 0) return false;
+
+	const MaterialID* materials = chunk->getMaterials();
+	const int originX = (cell % GAS_SIZE) * GAS_SCALE;
+	const int originY = (cell / GAS_SIZE) * GAS_SCALE;
+	const int start = (int)(nextRandom(random) % GAS_CELL_AREA);
+
+	for (int n = 0; n < GAS_CELL_AREA; n++) {
+		const int k = (start + n) % GAS_CELL_AREA;
+		const int i = Chunk::index(originX + (k & (GAS_SCALE - 1)), originY + (k >> GAS_SCALE_LOG2));
+		if (materials[i] != 0) continue;
+
+		setCell(chunk, i, material, temperature);
+		capacity--;
+		m_Emitted.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+	capacity = 0;
+	return false;
+}
+
+void GasField::setCell(Chunk* chunk, int index, MaterialID material, float temperature) {
+	chunk->getMaterials()[index] = material;
+	chunk->getTemperatures()[index] = m_Materials.hasSpawnTemperature(material) ? m_Materials.getSpawnTemperature(material) : temperature;
+	chunk->getVelocitiesX()[index] = 0;
+	chunk->getVelocitiesY()[index] = 0;
+	chunk->getFlags()[index] = 0;
+	chunk->markDirty(index & (CHUNK_SIZE - 1), index >> CHUNK_SIZE_LOG2);
+	chunk->wakeThermal();
+}
+
+void GasField::transportChunk(Chunk* chunk) {
+	Padding p;
+	std::fill_n(&p.amount[0][0], GAS_SPECIES * PADDED_CELLS, 0.0f);
+	std::fill_n(p.total, PADDED_CELLS, 0.0f);
+	std::fill_n(p.capacity, PADDED_CELLS, 0.0f); // missing neighbours are walls
+	std::fill_n(p.temperature, PADDED_CELLS, 0.0f);
+	std::fill_n(p.loaded, PADDED_CELLS, 0.0f);
+
+	const int species = m_SpeciesCount;
+	for (int gy = 0; gy < GAS_SIZE; gy++) {
+		for (int gx = 0; gx < GAS_SIZE; gx++) p.load(chunk, species, gx, gy, gx + 1, gy + 1);
+	}
+	if (const Chunk* left = chunk->getNeighbour(NeighbourLeft)) {
+		for (int gy = 0; gy < GAS_SIZE; gy++) p.load(left, species, GAS_SIZE - 1, gy, 0, gy + 1);
+	}
+	if (const Chunk* right = chunk->getNeighbour(NeighbourRight)) {
+		for (int gy = 0; gy < GAS_SIZE; gy++) p.load(right, species, 0, gy, PADDED_SIZE - 1, gy + 1);
+	}
+	if (const Chunk* down = chunk->getNeighbour(NeighbourDown)) {
+		for (int gx = 0; gx < GAS_SIZE; gx++) p.load(down, species, gx, GAS_SIZE - 1, gx + 1, 0);
+	}
+	if (const Chunk* up = chunk->getNeighbour(NeighbourUp)) {
+		for (int gx = 0; gx < GAS_SIZE; gx++) p.load(up, species, gx, 0, gx + 1, PADDED_SIZE - 1);
+	}
+
+	// Share of each gas cell's gas rising into the one above per tick: as much as there is room
+	// for up there, or, for gas in a cell that filled up under it (water poured over a cloud),
+	// the part that no longer fits, which bubbles up whatever is above until it finds room.
+	float lift[PADDED_CELLS] = {};
+	for (int i = 0; i < PADDED_CELLS - PADDED_SIZE; i++) {
+		const int u = i + PADDED_SIZE;
+		const float room = std::max(0.0f, p.capacity[u] - p.total[u]) / (float)GAS_CELL_AREA;
+		const float excess = p.total[i] > p.capacity[i] ? (p.total[i] - p.capacity[i]) / p.total[i] : 0.0f;
+		lift[i] = m_Rise * std::max(room, excess) * p.loaded[u];
+	}
+
+	// Per face, diffusion moves k * (a * capacity_b - b * capacity_a) from a to b, which is zero
+	// at equal concentrations and antisymmetric, so what one side loses the other gains.
+	const float k = m_Diffusion / (float)GAS_CELL_AREA;
+
+	float next[GAS_SPECIES][GAS_CELLS];
+	for (int s = 0; s < species; s++) {
+		const float* a = p.amount[s];
+		for (int gy = 0; gy < GAS_SIZE; gy++) {
+			for (int gx = 0; gx < GAS_SIZE; gx++) {
+				const int c = (gy + 1) * PADDED_SIZE + gx + 1;
+				const float neighbours = a[c - 1] + a[c + 1] + a[c - PADDED_SIZE] + a[c + PADDED_SIZE];
+				const float open = p.capacity[c - 1] + p.capacity[c + 1] + p.capacity[c - PADDED_SIZE] + p.capacity[c + PADDED_SIZE];
+				const float diffuse = k * (neighbours * p.capacity[c] - a[c] * open);
+				const float rise = a[c - PADDED_SIZE] * lift[c - PADDED_SIZE] - a[c] * lift[c];
+				next[s][gy * GAS_SIZE + gx] = a[c] + diffuse + rise;
+			}
+		}
+	}
+
+	// heat moves with the gas, at the temperature of the side it leaves
+	float* nextTemperatures = chunk->getNextGasTemperatures();
+	const float* ambient = chunk->getGasAmbient();
+	bool any = false;
+	for (int gy = 0; gy < GAS_SIZE; gy++) {
+		for (int gx = 0; gx < GAS_SIZE; gx++) {
+			const int c = (gy + 1) * PADDED_SIZE + gx + 1;
+			const int g = gy * GAS_SIZE + gx;
+
+			float total = 0.0f;
+			for (int s = 0; s < species; s++) {
+				if (next[s][g] < MIN_AMOUNT) next[s][g] = 0.0f;
+				total += next[s][g];
+			}
+			if (total <= 0.0f) {
+				nextTemperatures[g] = ambient[g];
+				continue;
+			}
+			any = true;
+
+			float heat = p.total[c] * p.temperature[c];
+			for (const int n : {c - 1, c + 1, c - PADDED_SIZE, c + PADDED_SIZE}) {
+				const float flux = k * (p.total[c] * p.capacity[n] - p.total[n] * p.capacity[c]);
+				heat -= flux * (flux > 0.0f ? p.temperature[c] : p.temperature[n]);
+			}
+			heat += p.total[c - PADDED_SIZE] * lift[c - PADDED_SIZE] * p.temperature[c - PADDED_SIZE] - p.total[c] * lift[c] * p.temperature[c];
+			nextTemperatures[g] = heat / total;
+		}
+	}
+
+	for (int s = 0; s < species; s++) std::copy_n(next[s], GAS_CELLS, chunk->getNextGas(s));
+	if (any || chunk->hasGas()) chunk->touchGas();
+	chunk->setHasGas(any);
+}
+
+double GasField::getTotalAmount(int species) const {
+	double total = 0.0;
+	for (const Chunk* chunk : m_World.getChunks()) {
+		if (!chunk->hasGas()) continue;
+		const float* amounts = chunk->getGas(species);
+		for (int g = 0; g < GAS_CELLS; g++) total += amounts[g];
+	}
+	return total;
+}
@@ -0,0 +1,189 @@
+#include "GlStub.h"
+
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+	std::unordered_map<GLuint, std::vector<uint8_t>> s_Buffers;
+	std::vector<GlStub::Upload> s_Uploads;
+	GLuint s_NextName = 1;
+	GLuint s_ArrayBuffer = 0;
+	GLuint s_ElementBuffer = 0;
+	int s_Fence; // every fence is this one, already signalled
+
+	std::vector<uint8_t>* find(GLuint buffer) {
+		auto it = s_Buffers.find(buffer);
+		return it != s_Buffers.end() ? &it->second : nullptr;
+	}
+
+	GLuint bound(GLenum target) {
+		return target == GL_ELEMENT_ARRAY_BUFFER ? s_ElementBuffer : s_ArrayBuffer;
+	}
+
+	void store(GLenum target, GLuint buffer, GLsizeiptr size, const void* data) {
+		std::vector<uint8_t>* bytes = find(buffer);
+		if (!bytes) return;
+		bytes->resize((size_t)size);
+		if (data && size > 0) std::memcpy(bytes->data(), data, (size_t)size);
+		s_Uploads.push_back(GlStub::Upload{target, buffer, 0, (size_t)size, true});
+	}
+
+	void storeRange(GLenum target, GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data) {
+		std::vector<uint8_t>* bytes = find(buffer);
+		if (!bytes || offset < 0 || (size_t)(offset + size) > bytes->size()) return;
+		std::memcpy(bytes->data() + offset, data, (size_t)size);
+		s_Uploads.push_back(GlStub::Upload{target, buffer, (size_t)offset, (size_t)size, false});
+	}
+
+	void APIENTRY genBuffers(GLsizei n, GLuint* buffers) {
+		for (GLsizei i = 0; i < n; i++) {
+			buffers[i] = s_NextName++;
+			s_Buffers[buffers[i]];
+		}
+	}
+
+	void APIENTRY deleteBuffers(GLsizei n, const GLuint* buffers) {
+		for (GLsizei i = 0; i < n; i++) s_Buffers.erase(buffers[i]);
+	}
+
+	void APIENTRY bindBuffer(GLenum target, GLuint buffer) {
+		(target == GL_ELEMENT_ARRAY_BUFFER ? s_ElementBuffer : s_ArrayBuffer) = buffer;
+	}
+
+	void APIENTRY bufferData(GLenum target, GLsizeiptr size, const void* data, GLenum) {
+		store(target, bound(target), size, data);
+	}
+
+	void APIENTRY bufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) {
+		storeRange(target, bound(target), offset, size, data);
+	}
+
+	void APIENTRY namedBufferData(GLuint buffer, GLsizeiptr size, const void* data, GLenum) {
+		store(0, buffer, size, data);
+	}
+
+	void APIENTRY namedBufferSubData(GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data) {
+		storeRange(0, buffer, offset, size, data);
+	}
+
+	// immutable storage isn't an upload, it is only recorded once data is written to it
+	void APIENTRY namedBufferStorage(GLuint buffer, GLsizeiptr size, const void* data, GLbitfield) {
+		std::vector<uint8_t>* bytes = find(buffer);
+		if (!bytes) return;
+		bytes->assign((size_t)size, 0);
+		if (data && size > 0) std::memcpy(bytes->data(), data, (size_t)size);
+	}
+
+	void* APIENTRY mapNamedBufferRange(GLuint buffer, GLintptr offset, GLsizeiptr length, GLbitfield) {
+		std::vector<uint8_t>* bytes = find(buffer);
+		if (!bytes || offset < 0 || (size_t)(offset + length) > bytes->size()) return nullptr;
+		return bytes->data() + offset;
+	}
+
+	GLboolean APIENTRY unmapNamedBuffer(GLuint) {
+		return GL_TRUE;
+	}
+
+	GLsync APIENTRY fenceSync(GLenum, GLbitfield) {
+		return reinterpret_cast<GLsync>(&s_Fence);
+	}
+
+	GLenum APIENTRY clientWaitSync(GLsync, GLbitfield, GLuint64) {
+		return GL_ALREADY_SIGNALED;
+	}
+
+	void APIENTRY deleteSync(GLsync) {
+
+	}
+
+	void APIENTRY createVertexArrays(GLsizei n, GLuint* arrays) {
+		for (GLsizei i = 0; i < n; i++) arrays[i] = s_NextName++;
+	}
+
+	void APIENTRY deleteVertexArrays(GLsizei, const GLuint*) {
+
+	}
+
+	void APIENTRY bindVertexArray(GLuint) {
+
+	}
+
+	void APIENTRY vertexAttribPointer(GLuint, GLint, GLenum, GLboolean, GLsizei, const void*) {
+
+	}
+
+	void APIENTRY enableVertexArrayAttrib(GLuint, GLuint) {
+
+	}
+
+	void APIENTRY vertexArrayBindingDivisor(GLuint, GLuint, GLuint) {
+
+	}
+
+	void APIENTRY vertexArrayElementBuffer(GLuint, GLuint) {
+
+	}
+
+	void APIENTRY vertexArrayVertexBuffer(GLuint, GLuint, GLuint, GLintptr, GLsizei) {
+
+	}
+
+	void APIENTRY vertexArrayAttribFormat(GLuint, GLuint, GLint, GLenum, GLboolean, GLuint) {
+
+	}
+
+	void APIENTRY vertexArrayAttribBinding(GLuint, GLuint, GLuint) {
+
+	}
+}
+
+void GlStub::install() {
+	glad_glGenBuffers = genBuffers;
+	glad_glCreateBuffers = genBuffers;
+	glad_glDeleteBuffers = deleteBuffers;
+	glad_glBindBuffer = bindBuffer;
+	glad_glBufferData = bufferData;
+	glad_glBufferSubData = bufferSubData;
+	glad_glNamedBufferData = namedBufferData;
+	glad_glNamedBufferSubData = namedBufferSubData;
+	glad_glNamedBufferStorage = namedBufferStorage;
+	glad_glMapNamedBufferRange = mapNamedBufferRange;
+	glad_glUnmapNamedBuffer = unmapNamedBuffer;
+	glad_glFenceSync = fenceSync;
+	glad_glClientWaitSync = clientWaitSync;
+	glad_glDeleteSync = deleteSync;
+	glad_glCreateVertexArrays = createVertexArrays;
+	glad_glDeleteVertexArrays = deleteVertexArrays;
+	glad_glBindVertexArray = bindVertexArray;
+	glad_glVertexAttribPointer = vertexAttribPointer;
+	glad_glEnableVertexArrayAttrib = enableVertexArrayAttrib;
+	glad_glVertexArrayBindingDivisor = vertexArrayBindingDivisor;
+	glad_glVertexArrayElementBuffer = vertexArrayElementBuffer;
+	glad_glVertexArrayVertexBuffer = vertexArrayVertexBuffer;
+	glad_glVertexArrayAttribFormat = vertexArrayAttribFormat;
+	glad_glVertexArrayAttribBinding = vertexArrayAttribBinding;
+}
+
+void GlStub::reset() {
+	s_Buffers.clear();
+	s_Uploads.clear();
+	s_NextName = 1;
+	s_ArrayBuffer = 0;
+	s_ElementBuffer = 0;
+}
+
+const std::vector<GlStub::Upload>& GlStub::getUploads() {
+	return s_Uploads;
+}
+
+void GlStub::clearUploads() {
+	s_Uploads.clear();
+}
+
+const std::vector<uint8_t>* GlStub::getBufferData(GLuint buffer) {
+	return find(buffer);
+}
+
+size_t GlStub::getLiveBufferCount() {
+	return s_Buffers.size();
+}
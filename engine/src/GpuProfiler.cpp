@@ -0,0 +1,55 @@
+#include "GpuProfiler.h"
+
+GpuProfiler::GpuProfiler() : m_Track{Profiler::createTrack("GPU")} {
+
+}
+
+GpuProfiler::~GpuProfiler() {
+	for (Frame& frame : m_Frames) {
+		for (const Query& query : frame.queries) glDeleteQueries(1, &query.id);
+	}
+}
+
+void GpuProfiler::collect(Frame& frame) {
+	for (size_t i = 0; i < frame.used; i++) {
+		const Query& query = frame.queries[i];
+		GLint available = 0;
+		glGetQueryObjectiv(query.id, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) {
+			m_Dropped++;
+			continue;
+		}
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(query.id, GL_QUERY_RESULT, &elapsed);
+		Profiler::record(m_Track, query.name, query.issued, query.issued + elapsed);
+	}
+	frame.used = 0;
+}
+
+void GpuProfiler::beginFrame() {
+	m_Frame++;
+	collect(m_Frames[m_Frame % FRAMES_IN_FLIGHT]);
+}
+
+bool GpuProfiler::begin(const char* name) {
+	if (!Profiler::isEnabled() || m_Open) return false;
+
+	Frame& frame = m_Frames[m_Frame % FRAMES_IN_FLIGHT];
+	if (frame.used == frame.queries.size()) {
+		GLuint id;
+		glCreateQueries(GL_TIME_ELAPSED, 1, &id);
+		frame.queries.push_back(Query{id, nullptr, 0});
+	}
+	Query& query = frame.queries[frame.used++];
+	query.name = name;
+	query.issued = Profiler::now();
+
+	glBeginQuery(GL_TIME_ELAPSED, query.id);
+	m_Open = true;
+	return true;
+}
+
+void GpuProfiler::end() {
+	glEndQuery(GL_TIME_ELAPSED);
+	m_Open = false;
+}
@@ -0,0 +1,231 @@
+#include "HeatKernel.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define CHEM_HEAT_X86
+	#include <immintrin.h>
+	#if defined(_MSC_VER) && !defined(__clang__)
+		#include <intrin.h>
+		#define CHEM_TARGET_AVX2
+	#else
+		#define CHEM_TARGET_AVX2 __attribute__((target("avx2")))
+	#endif
+#endif
+
+namespace {
+	typedef float (*DiffuseRowFn)(const float* below, const float* centre, const float* above, float* out, float rate);
+	typedef int (*FlagRowFn)(const float* temperature, const MaterialID* material, uint8_t* flags, const float* upper, const float* lower);
+
+	// centre[-1] and centre[CHUNK_SIZE] hold the left and right halo values
+	float diffuseRowScalar(const float* below, const float* centre, const float* above, float* out, float rate) {
+		float maxDelta = 0.0f;
+		for (int x = 0; x < CHUNK_SIZE; x++) {
+			const float c = centre[x];
+			const float sum = (centre[x - 1] + centre[x + 1]) + (below[x] + above[x]);
+			const float next = c + rate * (sum - c * 4.0f);
+			out[x] = next;
+			const float delta = std::fabs(next - c);
+			maxDelta = delta > maxDelta ? delta : maxDelta;
+		}
+		return maxDelta;
+	}
+
+	int flagRowScalar(const float* temperature, const MaterialID* material, uint8_t* flags, const float* upper, const float* lower) {
+		int flagged = 0;
+		for (int x = 0; x < CHUNK_SIZE; x++) {
+			const float t = temperature[x];
+			const MaterialID m = material[x];
+			if (t >= upper[m] || t <= lower[m]) {
+				flags[x] |= CellPhaseChange;
+				flagged++;
+			}
+		}
+		return flagged;
+	}
+
+#ifdef CHEM_HEAT_X86
+	float diffuseRowSSE2(const float* below, const float* centre, const float* above, float* out, float rate) {
+		const __m128 r = _mm_set1_ps(rate);
+		const __m128 four = _mm_set1_ps(4.0f);
+		const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+		__m128 maxDelta = _mm_setzero_ps();
+
+		for (int x = 0; x < CHUNK_SIZE; x += 4) {
+			const __m128 c = _mm_loadu_ps(centre + x);
+			const __m128 horizontal = _mm_add_ps(_mm_loadu_ps(centre + x - 1), _mm_loadu_ps(centre + x + 1));
+			const __m128 vertical = _mm_add_ps(_mm_loadu_ps(below + x), _mm_loadu_ps(above + x));
+			const __m128 sum = _mm_add_ps(horizontal, vertical);
+			const __m128 next = _mm_add_ps(c, _mm_mul_ps(r, _mm_sub_ps(sum, _mm_mul_ps(c, four))));
+			_mm_storeu_ps(out + x, next);
+			maxDelta = _mm_max_ps(maxDelta, _mm_and_ps(_mm_sub_ps(next, c), absMask));
+		}
+
+		maxDelta = _mm_max_ps(maxDelta, _mm_shuffle_ps(maxDelta, maxDelta, _MM_SHUFFLE(1, 0, 3, 2)));
+		maxDelta = _mm_max_ps(maxDelta, _mm_shuffle_ps(maxDelta, maxDelta, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_cvtss_f32(maxDelta);
+	}
+
+	// no gather before AVX2, the thresholds are loaded a lane at a time and compared four at once
+	int flagRowSSE2(const float* temperature, const MaterialID* material, uint8_t* flags, const float* upper, const float* lower) {
+		int flagged = 0;
+		for (int x = 0; x < CHUNK_SIZE; x += 4) {
+			const MaterialID* m = material + x;
+			const __m128 t = _mm_loadu_ps(temperature + x);
+			const __m128 hot = _mm_cmpge_ps(t, _mm_setr_ps(upper[m[0]], upper[m[1]], upper[m[2]], upper[m[3]]));
+			const __m128 cold = _mm_cmple_ps(t, _mm_setr_ps(lower[m[0]], lower[m[1]], lower[m[2]], lower[m[3]]));
+
+			int mask = _mm_movemask_ps(_mm_or_ps(hot, cold));
+			for (int lane = 0; mask != 0; lane++, mask >>= 1) {
+				if (mask & 1) {
+					flags[x + lane] |= CellPhaseChange;
+					flagged++;
+				}
+			}
+		}
+		return flagged;
+	}
+
+	CHEM_TARGET_AVX2 float diffuseRowAVX2(const float* below, const float* centre, const float* above, float* out, float rate) {
+		const __m256 r = _mm256_set1_ps(rate);
+		const __m256 four = _mm256_set1_ps(4.0f);
+		const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+		__m256 maxDelta = _mm256_setzero_ps();
+
+		for (int x = 0; x < CHUNK_SIZE; x += 8) {
+			const __m256 c = _mm256_loadu_ps(centre + x);
+			const __m256 horizontal = _mm256_add_ps(_mm256_loadu_ps(centre + x - 1), _mm256_loadu_ps(centre + x + 1));
+			const __m256 vertical = _mm256_add_ps(_mm256_loadu_ps(below + x), _mm256_loadu_ps(above + x));
+			const __m256 sum = _mm256_add_ps(horizontal, vertical);
+			const __m256 next = _mm256_add_ps(c, _mm256_mul_ps(r, _mm256_sub_ps(sum, _mm256_mul_ps(c, four))));
+			_mm256_storeu_ps(out + x, next);
+			maxDelta = _mm256_max_ps(maxDelta, _mm256_and_ps(_mm256_sub_ps(next, c), absMask));
+		}
+
+		__m128 reduced = _mm_max_ps(_mm256_castps256_ps128(maxDelta), _mm256_extractf128_ps(maxDelta, 1));
+		reduced = _mm_max_ps(reduced, _mm_shuffle_ps(reduced, reduced, _MM_SHUFFLE(1, 0, 3, 2)));
+		reduced = _mm_max_ps(reduced, _mm_shuffle_ps(reduced, reduced, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_cvtss_f32(reduced);
+	}
+
+	CHEM_TARGET_AVX2 int flagRowAVX2(const float* temperature, const MaterialID* material, uint8_t* flags, const float* upper, const float* lower) {
+		int flagged = 0;
+		for (int x = 0; x < CHUNK_SIZE; x += 8) {
+			const __m256i ids = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(material + x)));
+			const __m256 t = _mm256_loadu_ps(temperature + x);
+			const __m256 hot = _mm256_cmp_ps(t, _mm256_i32gather_ps(upper, ids, 4), _CMP_GE_OQ);
+			const __m256 cold = _mm256_cmp_ps(t, _mm256_i32gather_ps(lower, ids, 4), _CMP_LE_OQ);
+
+			int mask = _mm256_movemask_ps(_mm256_or_ps(hot, cold));
+			for (int lane = 0; mask != 0; lane++, mask >>= 1) {
+				if (mask & 1) {
+					flags[x + lane] |= CellPhaseChange;
+					flagged++;
+				}
+			}
+		}
+		return flagged;
+	}
+#endif
+}
+
+HeatKernel::HeatKernel() : m_ISA{detectISA()} {
+
+}
+
+HeatKernel::HeatKernel(HeatKernelISA isa) : m_ISA{isSupported(isa) ? isa : HeatKernelScalar} {
+
+}
+
+bool HeatKernel::isSupported(HeatKernelISA isa) {
+	switch (isa) {
+		case HeatKernelScalar:
+			return true;
+#ifdef CHEM_HEAT_X86
+	#if defined(_MSC_VER) && !defined(__clang__)
+		case HeatKernelSSE2:
+			return true;
+		case HeatKernelAVX2: {
+			int info[4];
+			__cpuid(info, 0);
+			if (info[0] < 7) return false;
+			__cpuid(info, 1);
+			const bool osxsave = (info[2] & (1 << 27)) != 0;
+			if (!osxsave || (_xgetbv(0) & 0x6) != 0x6) return false;
+			__cpuidex(info, 7, 0);
+			return (info[1] & (1 << 5)) != 0;
+		}
+	#else
+		case HeatKernelSSE2:
+			return __builtin_cpu_supports("sse2");
+		case HeatKernelAVX2:
+			return __builtin_cpu_supports("avx2");
+	#endif
+#endif
+		default:
+			return false;
+	}
+}
+
+HeatKernelISA HeatKernel::detectISA() {
+	if (isSupported(HeatKernelAVX2)) return HeatKernelAVX2;
+	if (isSupported(HeatKernelSSE2)) return HeatKernelSSE2;
+	return HeatKernelScalar;
+}
+
+const char* HeatKernel::getISAName(HeatKernelISA isa) {
+	switch (isa) {
+		case HeatKernelScalar: return "scalar";
+		case HeatKernelSSE2: return "sse2";
+		case HeatKernelAVX2: return "avx2";
+		default: return "unknown";
+	}
+}
+
+HeatStepResult HeatKernel::step(float* temperature, const MaterialID* material, uint8_t* flags, const HeatHalo& halo,
+	const float* upperThreshold, const float* lowerThreshold, float rate) const {
+
+	DiffuseRowFn diffuse = diffuseRowScalar;
+	FlagRowFn flag = flagRowScalar;
+#ifdef CHEM_HEAT_X86
+	if (m_ISA == HeatKernelSSE2) {
+		diffuse = diffuseRowSSE2;
+		flag = flagRowSSE2;
+	} else if (m_ISA == HeatKernelAVX2) {
+		diffuse = diffuseRowAVX2;
+		flag = flagRowAVX2;
+	}
+#endif
+
+	// The plane is updated in place, so the old values of the current row are copied (with the
+	// left and right halo on either side) before it is overwritten, and that copy is what the
+	// next row reads as "below". The row above has not been written yet.
+	alignas(32) float padded[2][CHUNK_SIZE + 16];
+
+	HeatStepResult result{0.0f, 0, CHUNK_SIZE, 0};
+	const float* below = halo.down;
+
+	for (int y = 0; y < CHUNK_SIZE; y++) {
+		float* row = temperature + y * CHUNK_SIZE;
+		float* centre = padded[y & 1] + 8;
+		std::copy(row, row + CHUNK_SIZE, centre);
+		centre[-1] = halo.left[y];
+		centre[CHUNK_SIZE] = halo.right[y];
+
+		const float* above = y + 1 < CHUNK_SIZE ? row + CHUNK_SIZE : halo.up;
+		result.maxDelta = std::max(result.maxDelta, diffuse(below, centre, above, row, rate));
+
+		const int flagged = flag(row, material + y * CHUNK_SIZE, flags + y * CHUNK_SIZE, upperThreshold, lowerThreshold);
+		if (flagged != 0) {
+			result.flagged += flagged;
+			result.minRow = std::min(result.minRow, y);
+			result.maxRow = y + 1;
+		}
+
+		below = centre;
+	}
+
+	if (result.flagged == 0) result.minRow = 0;
+	return result;
+}
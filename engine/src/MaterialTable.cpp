@@ -0,0 +1,389 @@
+#include "MaterialTable.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <unordered_map>
+
+#include <spdlog/spdlog.h>
+
+// the CLEX_ token names only exist in the implementation half of stb_c_lexer,
+// so the lexer is compiled here rather than in the stb target
+#define STB_C_LEXER_IMPLEMENTATION
+#include <stb_c_lexer.h>
+
+namespace {
+	constexpr size_t TABLE_ALIGNMENT = 64;
+
+	inline size_t alignUp(size_t value) {
+		return (value + TABLE_ALIGNMENT - 1) & ~(TABLE_ALIGNMENT - 1);
+	}
+
+	inline uint16_t toChance(float probability) {
+		return (uint16_t)(std::min(std::max(probability, 0.0f), 1.0f) * 65535.0f + 0.5f);
+	}
+
+	struct MaterialDef {
+		std::string name;
+		MaterialPhase phase = PhaseSolid;
+		float density = 0.0f;
+		float flammability = 0.0f;
+		float temperature = AMBIENT_TEMPERATURE;
+		bool hasTemperature = false;
+		uint32_t color = 0xFF00FFFF;
+		std::string texture;
+		bool field = false;
+
+		float melt = FLT_MAX, boil = FLT_MAX, ignite = FLT_MAX;
+		float freeze = -FLT_MAX, condense = -FLT_MAX;
+		std::string meltsTo, boilsTo, burnsTo, freezesTo, condensesTo, decaysTo;
+		float decay = 0.0f;
+	};
+
+	struct ReactionDef {
+		std::string a, b, productA, productB;
+		float chance = 1.0f;
+	};
+}
+
+// Recursive-descent parser over stb_c_lexer tokens, fills MaterialDef/ReactionDef lists that
+// MaterialTable then resolves into flat arrays.
+class MaterialParser {
+private:
+	stb_lexer m_Lexer;
+	std::vector<char> m_StringStore;
+	const std::string& m_Name;
+	bool m_Failed = false;
+
+	bool next() {
+		stb_c_lexer_get_token(&m_Lexer);
+		if (m_Lexer.token == CLEX_parse_error) return error("invalid token");
+		return true;
+	}
+
+	bool error(const std::string& message) {
+		if (!m_Failed) {
+			stb_lex_location location;
+			stb_c_lexer_get_location(&m_Lexer, m_Lexer.where_firstchar, &location);
+			spdlog::error("{}:{}:{}: {}", m_Name, location.line_number, location.line_offset + 1, message);
+		}
+		m_Failed = true;
+		return false;
+	}
+
+	bool isIdentifier(const char* word) const {
+		return m_Lexer.token == CLEX_id && std::string(m_Lexer.string) == word;
+	}
+
+	bool expect(long token, const char* what) {
+		if (m_Lexer.token != token) return error(std::string("expected ") + what);
+		return next();
+	}
+
+	bool identifier(std::string& out) {
+		if (m_Lexer.token != CLEX_id) return error("expected a name");
+		out = m_Lexer.string;
+		return next();
+	}
+
+	bool number(float& out) {
+		bool negative = false;
+		if (m_Lexer.token == '-') {
+			negative = true;
+			if (!next()) return false;
+		}
+		if (m_Lexer.token == CLEX_intlit) out = (float)m_Lexer.int_number;
+		else if (m_Lexer.token == CLEX_floatlit) out = (float)m_Lexer.real_number;
+		else return error("expected a number");
+		if (negative) out = -out;
+		return next();
+	}
+
+	// <temperature> -> <material>
+	bool transition(float& point, std::string& product) {
+		return number(point) && expect(CLEX_arrow, "'->'") && identifier(product);
+	}
+
+	bool text(std::string& out) {
+		if (m_Lexer.token != CLEX_dqstring) return error("expected a quoted string");
+		out = m_Lexer.string;
+		return next();
+	}
+
+	bool phase(MaterialPhase& out) {
+		static const std::pair<const char*, MaterialPhase> PHASES[] = {
+			{"empty", PhaseEmpty}, {"gas", PhaseGas}, {"liquid", PhaseLiquid}, {"powder", PhasePowder}, {"solid", PhaseSolid}
+		};
+		for (const auto& p : PHASES) {
+			if (isIdentifier(p.first)) {
+				out = p.second;
+				return next();
+			}
+		}
+		return error("expected one of empty, gas, liquid, powder, solid");
+	}
+
+	bool color(uint32_t& out) {
+		float rgba[4];
+		for (float& c : rgba) {
+			if (!number(c)) return false;
+		}
+		out = 0;
+		for (float c : rgba) out = (out << 8) | (uint32_t)std::min(std::max(c, 0.0f), 255.0f);
+		return true;
+	}
+
+	bool material(MaterialDef& def) {
+		if (!identifier(def.name) || !expect('{', "'{'")) return false;
+
+		while (m_Lexer.token != '}') {
+			if (m_Lexer.token == CLEX_eof) return error("unterminated material block");
+
+			std::string property;
+			if (!identifier(property)) return false;
+
+			bool ok;
+			if (property == "phase") ok = phase(def.phase);
+			else if (property == "density") ok = number(def.density);
+			else if (property == "flammability") ok = number(def.flammability);
+			else if (property == "temperature") ok = def.hasTemperature = number(def.temperature);
+			else if (property == "color") ok = color(def.color);
+			else if (property == "texture") ok = text(def.texture);
+			else if (property == "field") ok = def.field = true;
+			else if (property == "melt") ok = transition(def.melt, def.meltsTo);
+			else if (property == "boil") ok = transition(def.boil, def.boilsTo);
+			else if (property == "ignite") ok = transition(def.ignite, def.burnsTo);
+			else if (property == "freeze") ok = transition(def.freeze, def.freezesTo);
+			else if (property == "condense") ok = transition(def.condense, def.condensesTo);
+			else if (property == "decay") ok = transition(def.decay, def.decaysTo);
+			else ok = error("unknown material property '" + property + "'");
+
+			if (!ok || !expect(';', "';'")) return false;
+		}
+		return next();
+	}
+
+	bool reaction(ReactionDef& def) {
+		return identifier(def.a) && expect('+', "'+'") && identifier(def.b) && expect(CLEX_arrow, "'->'")
+			&& identifier(def.productA) && expect('+', "'+'") && identifier(def.productB)
+			&& (m_Lexer.token == ';' || number(def.chance)) && expect(';', "';'");
+	}
+public:
+	MaterialParser(const std::string& source, const std::string& name) : m_StringStore(1024), m_Name{name} {
+		stb_c_lexer_init(&m_Lexer, source.data(), source.data() + source.size(), m_StringStore.data(), (int)m_StringStore.size());
+	}
+
+	bool parse(std::vector<MaterialDef>& materials, std::vector<ReactionDef>& reactions) {
+		if (!next()) return false;
+		while (m_Lexer.token != CLEX_eof) {
+			if (isIdentifier("material")) {
+				materials.emplace_back();
+				if (!next() || !material(materials.back())) return false;
+			} else if (isIdentifier("reaction")) {
+				reactions.emplace_back();
+				if (!next() || !reaction(reactions.back())) return false;
+			} else {
+				return error("expected 'material' or 'reaction'");
+			}
+		}
+		return true;
+	}
+};
+
+MaterialTable::MaterialTable() {
+
+}
+
+MaterialTable::~MaterialTable() {
+	release();
+}
+
+void MaterialTable::release() {
+	if (m_Block) ::operator delete(m_Block, std::align_val_t(TABLE_ALIGNMENT));
+	m_Block = nullptr;
+	m_BlockSize = 0;
+	m_Count = 0;
+	m_Names.clear();
+	m_Textures.clear();
+}
+
+void MaterialTable::allocate(size_t count) {
+	release();
+	m_Count = count;
+
+	const size_t n = count;
+	const size_t sizes[] = {
+		n * sizeof(MaterialPhase), n * sizeof(float), n * sizeof(float), n * sizeof(float), n * sizeof(uint8_t),
+		n * sizeof(float), n * sizeof(float),
+		n * sizeof(float), n * sizeof(float), n * sizeof(float), n * sizeof(float), n * sizeof(float),
+		n * sizeof(MaterialID), n * sizeof(MaterialID), n * sizeof(MaterialID), n * sizeof(MaterialID), n * sizeof(MaterialID), n * sizeof(MaterialID),
+		n * sizeof(uint16_t), n * sizeof(uint8_t), n * sizeof(uint32_t), n * n * sizeof(Reaction)
+	};
+	for (size_t size : sizes) m_BlockSize += alignUp(size);
+
+	m_Block = ::operator new(m_BlockSize, std::align_val_t(TABLE_ALIGNMENT));
+	std::fill_n((char*)m_Block, m_BlockSize, 0);
+
+	// every array starts on its own cache line
+	char* cursor = (char*)m_Block;
+	size_t i = 0;
+	auto carve = [&](auto*& out) {
+		out = reinterpret_cast<std::remove_reference_t<decltype(out)>>(cursor);
+		cursor += alignUp(sizes[i++]);
+	};
+	carve(m_Phase);
+	carve(m_Density);
+	carve(m_Flammability);
+	carve(m_SpawnTemperature);
+	carve(m_HasSpawnTemperature);
+	carve(m_UpperThreshold);
+	carve(m_LowerThreshold);
+	carve(m_MeltPoint);
+	carve(m_BoilPoint);
+	carve(m_IgnitePoint);
+	carve(m_FreezePoint);
+	carve(m_CondensePoint);
+	carve(m_MeltsTo);
+	carve(m_BoilsTo);
+	carve(m_BurnsTo);
+	carve(m_FreezesTo);
+	carve(m_CondensesTo);
+	carve(m_DecaysTo);
+	carve(m_DecayChance);
+	carve(m_FieldGas);
+	carve(m_Color);
+	carve(m_Reactions);
+}
+
+bool MaterialTable::loadFromFile(const std::string& path) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		spdlog::error("Could not open material file {}", path);
+		return false;
+	}
+	std::stringstream contents;
+	contents << file.rdbuf();
+	return loadFromString(contents.str(), path);
+}
+
+bool MaterialTable::loadFromString(const std::string& source, const std::string& name) {
+	const auto start = std::chrono::steady_clock::now();
+
+	std::vector<MaterialDef> materials;
+	std::vector<ReactionDef> reactions;
+	if (!MaterialParser(source, name).parse(materials, reactions)) return false;
+
+	if (materials.empty() || materials[0].phase != PhaseEmpty) {
+		spdlog::error("{}: the first material must have phase empty", name);
+		return false;
+	}
+	if (materials.size() > 0xFFFF) {
+		spdlog::error("{}: too many materials ({})", name, materials.size());
+		return false;
+	}
+
+	std::unordered_map<std::string, MaterialID> ids;
+	for (size_t i = 0; i < materials.size(); i++) {
+		if (materials[i].field && materials[i].phase != PhaseGas) {
+			spdlog::error("{}: material '{}' is in the gas field but not a gas", name, materials[i].name);
+			return false;
+		}
+		if (!ids.emplace(materials[i].name, (MaterialID)i).second) {
+			spdlog::error("{}: material '{}' is defined twice", name, materials[i].name);
+			return false;
+		}
+	}
+
+	bool resolved = true;
+	auto resolve = [&](const std::string& material, MaterialID self) -> MaterialID {
+		if (material.empty()) return self;
+		auto it = ids.find(material);
+		if (it == ids.end()) {
+			spdlog::error("{}: unknown material '{}'", name, material);
+			resolved = false;
+			return self;
+		}
+		return it->second;
+	};
+
+	allocate(materials.size());
+
+	for (size_t i = 0; i < materials.size(); i++) {
+		const MaterialDef& def = materials[i];
+		const MaterialID id = (MaterialID)i;
+
+		m_Names.push_back(def.name);
+		m_Textures.push_back(def.texture);
+		m_Phase[i] = def.phase;
+		m_Density[i] = def.density;
+		m_Flammability[i] = def.flammability;
+		m_SpawnTemperature[i] = def.temperature;
+		m_HasSpawnTemperature[i] = def.hasTemperature;
+		m_Color[i] = def.color;
+
+		m_MeltPoint[i] = def.melt;
+		m_BoilPoint[i] = def.boil;
+		m_IgnitePoint[i] = def.ignite;
+		m_FreezePoint[i] = def.freeze;
+		m_CondensePoint[i] = def.condense;
+		m_UpperThreshold[i] = std::min(def.melt, std::min(def.boil, def.ignite));
+		m_LowerThreshold[i] = std::max(def.freeze, def.condense);
+
+		m_MeltsTo[i] = resolve(def.meltsTo, id);
+		m_BoilsTo[i] = resolve(def.boilsTo, id);
+		m_BurnsTo[i] = resolve(def.burnsTo, id);
+		m_FreezesTo[i] = resolve(def.freezesTo, id);
+		m_CondensesTo[i] = resolve(def.condensesTo, id);
+		m_DecaysTo[i] = resolve(def.decaysTo, id);
+		m_DecayChance[i] = def.decaysTo.empty() ? 0 : toChance(def.decay);
+		m_FieldGas[i] = def.field;
+	}
+
+	for (const ReactionDef& def : reactions) {
+		MaterialID a = resolve(def.a, 0), b = resolve(def.b, 0);
+		Reaction forward{resolve(def.productA, 0), resolve(def.productB, 0), toChance(def.chance), 0};
+		Reaction backward{forward.productB, forward.productA, forward.chance, 0};
+		m_Reactions[a * m_Count + b] = forward;
+		m_Reactions[b * m_Count + a] = backward;
+	}
+
+	if (!resolved) {
+		release();
+		return false;
+	}
+
+	const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	spdlog::info("Loaded {} materials and {} reactions from {} in {:.3f} ms, tables use {} bytes",
+		m_Count, reactions.size(), name, ms, m_BlockSize);
+	return true;
+}
+
+MaterialID MaterialTable::getPhaseChange(MaterialID material, float temperature, uint16_t roll) const {
+	if (temperature >= m_UpperThreshold[material]) {
+		if (temperature >= m_MeltPoint[material]) return m_MeltsTo[material];
+		if (temperature >= m_BoilPoint[material]) return m_BoilsTo[material];
+		if (temperature >= m_IgnitePoint[material] && roll < toChance(m_Flammability[material])) return m_BurnsTo[material];
+	} else if (temperature <= m_LowerThreshold[material]) {
+		if (temperature <= m_FreezePoint[material]) return m_FreezesTo[material];
+		if (temperature <= m_CondensePoint[material]) return m_CondensesTo[material];
+	}
+	return material;
+}
+
+const std::string& MaterialTable::getName(MaterialID m) const {
+	return m_Names[m];
+}
+
+const std::string& MaterialTable::getTexture(MaterialID m) const {
+	return m_Textures[m];
+}
+
+bool MaterialTable::findMaterial(const std::string& name, MaterialID& out) const {
+	auto it = std::find(m_Names.begin(), m_Names.end(), name);
+	if (it == m_Names.end()) return false;
+	out = (MaterialID)(it - m_Names.begin());
+	return true;
+}
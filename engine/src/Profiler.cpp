@@ -0,0 +1,187 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+struct ProfileEvent {
+	const char* name;
+	uint64_t start;
+	uint64_t end;
+};
+
+struct ProfileTrack {
+	std::string name;
+	uint32_t id;
+	std::unique_ptr<ProfileEvent[]> events; // allocated by the first record, so naming a thread costs nothing
+	std::atomic<uint64_t> head{0};          // events ever recorded, the next one goes to head % RING_CAPACITY
+};
+
+namespace {
+	constexpr uint64_t RING_MASK = Profiler::RING_CAPACITY - 1;
+
+	// only taken to add a track or to walk them, never to record
+	std::mutex s_TracksMutex;
+	std::vector<std::unique_ptr<ProfileTrack>> s_Tracks;
+
+	thread_local ProfileTrack* t_Track = nullptr;
+
+	ProfileTrack* addTrack(const std::string& name) {
+		std::lock_guard<std::mutex> lock(s_TracksMutex);
+		s_Tracks.emplace_back(new ProfileTrack());
+		ProfileTrack* track = s_Tracks.back().get();
+		track->id = (uint32_t)s_Tracks.size();
+		track->name = name.empty() ? "thread " + std::to_string(track->id) : name;
+		return track;
+	}
+
+	inline ProfileTrack* threadTrack() {
+		if (!t_Track) t_Track = addTrack("");
+		return t_Track;
+	}
+
+	// appends the events of the track that ended at or after since, oldest first
+	void copyEvents(const ProfileTrack& track, uint64_t since, std::vector<ProfileEvent>& out) {
+		const uint64_t head = track.head.load(std::memory_order_acquire);
+		if (head == 0) return;
+		const uint64_t first = head > Profiler::RING_CAPACITY ? head - Profiler::RING_CAPACITY : 0;
+		const size_t begin = out.size();
+		for (uint64_t i = first; i < head; i++) out.push_back(track.events[i & RING_MASK]);
+
+		// the writer may have lapped the oldest events while they were copied, and may be in
+		// the middle of overwriting the one after those
+		const uint64_t lapped = track.head.load(std::memory_order_acquire);
+		const uint64_t valid = lapped >= Profiler::RING_CAPACITY ? lapped - Profiler::RING_CAPACITY + 1 : 0;
+		if (valid > first) out.erase(out.begin() + begin, out.begin() + begin + (size_t)std::min(valid - first, head - first));
+
+		out.erase(std::remove_if(out.begin() + begin, out.end(), [since](const ProfileEvent& e) { return e.end < since; }), out.end());
+	}
+
+	std::string escape(const char* text) {
+		std::string escaped;
+		for (const char* c = text; *c; c++) {
+			if (*c == '"' || *c == '\\') escaped += '\\';
+			if ((unsigned char)*c >= 0x20) escaped += *c;
+		}
+		return escaped;
+	}
+}
+
+std::atomic<bool> Profiler::s_Enabled{false};
+const Profiler::Clock::time_point Profiler::s_Epoch = Profiler::Clock::now();
+
+void Profiler::setEnabled(bool enabled) {
+	s_Enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void Profiler::setThreadName(const std::string& name) {
+	if (t_Track) {
+		std::lock_guard<std::mutex> lock(s_TracksMutex);
+		t_Track->name = name;
+	} else {
+		t_Track = addTrack(name);
+	}
+}
+
+ProfileTrack* Profiler::createTrack(const std::string& name) {
+	return addTrack(name);
+}
+
+void Profiler::record(const char* name, uint64_t start, uint64_t end) {
+	record(threadTrack(), name, start, end);
+}
+
+void Profiler::record(ProfileTrack* track, const char* name, uint64_t start, uint64_t end) {
+	const uint64_t head = track->head.load(std::memory_order_relaxed);
+	if (head == 0) track->events.reset(new ProfileEvent[RING_CAPACITY]);
+	track->events[head & RING_MASK] = ProfileEvent{name, start, end};
+	track->head.store(head + 1, std::memory_order_release);
+}
+
+bool Profiler::writeChromeTrace(const std::string& path) {
+	FILE* file = std::fopen(path.c_str(), "w");
+	if (!file) {
+		spdlog::error("Could not open {} for writing", path);
+		return false;
+	}
+
+	std::vector<ProfileEvent> events;
+	size_t written = 0;
+	std::fputs("{\"traceEvents\": [\n", file);
+	{
+		std::lock_guard<std::mutex> lock(s_TracksMutex);
+		for (const std::unique_ptr<ProfileTrack>& track : s_Tracks) {
+			std::fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"%s\"}}",
+				written++ > 0 ? ",\n" : "", track->id, escape(track->name.c_str()).c_str());
+
+			events.clear();
+			copyEvents(*track, 0, events);
+			for (const ProfileEvent& e : events) {
+				// microseconds, as the format wants
+				std::fprintf(file, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}",
+					escape(e.name).c_str(), track->id, e.start / 1000.0, (e.end - e.start) / 1000.0);
+				written++;
+			}
+		}
+	}
+	std::fputs("\n]}\n", file);
+
+	const bool ok = std::ferror(file) == 0;
+	std::fclose(file);
+	if (!ok) {
+		spdlog::error("Could not write the trace to {}", path);
+		return false;
+	}
+	spdlog::info("Wrote {} profile events to {}", written, path);
+	return true;
+}
+
+void Profiler::logSummary(double windowSeconds) {
+	const uint64_t end = now();
+	const uint64_t window = (uint64_t)(windowSeconds * 1e9);
+	const uint64_t since = end > window ? end - window : 0;
+
+	std::vector<ProfileEvent> events;
+	{
+		std::lock_guard<std::mutex> lock(s_TracksMutex);
+		for (const std::unique_ptr<ProfileTrack>& track : s_Tracks) copyEvents(*track, since, events);
+	}
+	if (events.empty()) return;
+
+	// the same name can come from different literals, so scopes are told apart by their text
+	std::map<std::string, std::vector<uint64_t>> durations;
+	for (const ProfileEvent& e : events) durations[e.name].push_back(e.end - e.start);
+
+	struct ScopeSummary {
+		const std::string* name;
+		size_t calls;
+		uint64_t p50, p99, max, total;
+	};
+	std::vector<ScopeSummary> summaries;
+	for (auto& scope : durations) {
+		std::vector<uint64_t>& d = scope.second;
+		std::sort(d.begin(), d.end());
+		uint64_t total = 0;
+		for (uint64_t duration : d) total += duration;
+		summaries.push_back(ScopeSummary{&scope.first, d.size(), d[d.size() / 2], d[std::min(d.size() - 1, d.size() * 99 / 100)], d.back(), total});
+	}
+	std::sort(summaries.begin(), summaries.end(), [](const ScopeSummary& a, const ScopeSummary& b) { return a.total > b.total; });
+
+	spdlog::info("Profile of the last {:.1f} s:", (end - since) / 1e9);
+	for (const ScopeSummary& s : summaries) {
+		spdlog::info("  {:<28} {:>7} calls  p50 {:>8.3f} ms  p99 {:>8.3f} ms  max {:>8.3f} ms  total {:>9.1f} ms",
+			*s.name, s.calls, s.p50 / 1e6, s.p99 / 1e6, s.max / 1e6, s.total / 1e6);
+	}
+}
+
+size_t Profiler::getEventCount() {
+	std::lock_guard<std::mutex> lock(s_TracksMutex);
+	size_t count = 0;
+	for (const std::unique_ptr<ProfileTrack>& track : s_Tracks) count += (size_t)track->head.load(std::memory_order_relaxed);
+	return count;
+}
@@ -0,0 +1,293 @@
+#include "RegionStats.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "Profiler.h"
+
+namespace {
+	constexpr float NO_TEMPERATURE_MIN = std::numeric_limits<float>::infinity();
+	constexpr float NO_TEMPERATURE_MAX = -std::numeric_limits<float>::infinity();
+}
+
+RegionStats::RegionStats(const World& world, const MaterialTable& materials, ThreadPool* pool)
+	: m_World{world}, m_MaterialCount{materials.getCount()}, m_Pool{pool} {
+
+}
+
+void RegionStats::update() {
+	PROFILE_SCOPE("region stats");
+	m_Updates++;
+	m_Jobs.clear();
+	m_CountedBlocks = 0;
+
+	for (const Chunk* chunk : m_World.getChunks()) {
+		const uint64_t key = World::chunkKey(chunk->getChunkX(), chunk->getChunkY());
+		auto found = m_Entries.find(key);
+		const bool created = found == m_Entries.end();
+		if (created) {
+			found = m_Entries.emplace(key, Entry{}).first;
+			found->second.counts.assign(m_MaterialCount, 0);
+			found->second.blockCounts.assign(m_MaterialCount * BLOCK_COUNT, 0);
+		}
+		Entry& entry = found->second;
+		entry.seen = m_Updates;
+
+		Job job{chunk, &entry, 0, 0, 0, 0, 0, 0, 0, 0};
+		if (created || entry.serial != chunk->getSerial()) {
+			// every block is recounted and replaces what the entry held, so a reused entry needs no clearing
+			job.materialMaxX = job.materialMaxY = BLOCKS_PER_SIDE;
+			job.heatMaxX = job.heatMaxY = BLOCKS_PER_SIDE;
+		} else {
+			// every write of the tick went into the chunk's next dirty rectangle, which is now the current one
+			if (entry.revision != chunk->getRevision() && chunk->isAwake()) {
+				job.materialMinX = chunk->getDirtyMinX() >> BLOCK_SIZE_LOG2;
+				job.materialMinY = chunk->getDirtyMinY() >> BLOCK_SIZE_LOG2;
+				job.materialMaxX = (chunk->getDirtyMaxX() + BLOCK_SIZE - 1) >> BLOCK_SIZE_LOG2;
+				job.materialMaxY = (chunk->getDirtyMaxY() + BLOCK_SIZE - 1) >> BLOCK_SIZE_LOG2;
+			}
+			// the heat step changes temperatures all over the chunk without marking anything
+			if (entry.active) {
+				job.heatMaxX = job.heatMaxY = BLOCKS_PER_SIDE;
+			} else {
+				job.heatMinX = job.materialMinX;
+				job.heatMinY = job.materialMinY;
+				job.heatMaxX = job.materialMaxX;
+				job.heatMaxY = job.materialMaxY;
+			}
+		}
+		entry.serial = chunk->getSerial();
+		entry.revision = chunk->getRevision();
+		entry.active = chunk->isAwake() || chunk->isThermallyActive();
+
+		// the heat area always holds the material one
+		if (job.heatMinX >= job.heatMaxX || job.heatMinY >= job.heatMaxY) continue;
+		m_CountedBlocks += (size_t)(job.materialMaxX - job.materialMinX) * (job.materialMaxY - job.materialMinY);
+		m_Jobs.push_back(job);
+	}
+
+	m_UpdatedChunks = m_Jobs.size();
+	if (m_Pool) {
+		m_Pool->parallelFor(m_Jobs.size(), [this](size_t i) { runJob(m_Jobs[i]); });
+	} else {
+		for (const Job& job : m_Jobs) runJob(job);
+	}
+
+	// chunks the world dropped
+	if (m_Entries.size() == m_World.getChunkCount()) return;
+	for (auto it = m_Entries.begin(); it != m_Entries.end();) {
+		if (it->second.seen == m_Updates) ++it;
+		else it = m_Entries.erase(it);
+	}
+}
+
+void RegionStats::runJob(const Job& job) const {
+	Entry& entry = *job.entry;
+	const MaterialID* materials = job.chunk->getMaterials();
+	const float* temperatures = job.chunk->getTemperatures();
+
+	for (int by = job.materialMinY; by < job.materialMaxY; by++) {
+		for (int bx = job.materialMinX; bx < job.materialMaxX; bx++) {
+			uint8_t* counts = entry.blockCounts.data() + (size_t)(by * BLOCKS_PER_SIDE + bx) * m_MaterialCount;
+			for (size_t m = 0; m < m_MaterialCount; m++) entry.counts[m] -= counts[m];
+			std::fill_n(counts, m_MaterialCount, 0);
+			for (int y = 0; y < BLOCK_SIZE; y++) {
+				const MaterialID* row = materials + Chunk::index(bx * BLOCK_SIZE, by * BLOCK_SIZE + y);
+				for (int x = 0; x < BLOCK_SIZE; x++) counts[row[x]]++;
+			}
+			for (size_t m = 0; m < m_MaterialCount; m++) entry.counts[m] += counts[m];
+		}
+	}
+
+	for (int by = job.heatMinY; by < job.heatMaxY; by++) {
+		for (int bx = job.heatMinX; bx < job.heatMaxX; bx++) {
+			// a column per lane, folded at the end, so the rows go through in vectors
+			const float* first = temperatures + Chunk::index(bx * BLOCK_SIZE, by * BLOCK_SIZE);
+			float lowest[BLOCK_SIZE], highest[BLOCK_SIZE], sums[BLOCK_SIZE];
+			for (int x = 0; x < BLOCK_SIZE; x++) lowest[x] = highest[x] = sums[x] = first[x];
+			for (int y = 1; y < BLOCK_SIZE; y++) {
+				const float* row = first + Chunk::index(0, y);
+				for (int x = 0; x < BLOCK_SIZE; x++) {
+					lowest[x] = std::min(lowest[x], row[x]);
+					highest[x] = std::max(highest[x], row[x]);
+					sums[x] += row[x];
+				}
+			}
+			const int block = by * BLOCKS_PER_SIDE + bx;
+			entry.blockMin[block] = *std::min_element(lowest, lowest + BLOCK_SIZE);
+			entry.blockMax[block] = *std::max_element(highest, highest + BLOCK_SIZE);
+			float sum = 0.0f;
+			for (int x = 0; x < BLOCK_SIZE; x++) sum += sums[x];
+			entry.blockSum[block] = sum;
+		}
+	}
+
+	entry.minTemperature = *std::min_element(entry.blockMin, entry.blockMin + BLOCK_COUNT);
+	entry.maxTemperature = *std::max_element(entry.blockMax, entry.blockMax + BLOCK_COUNT);
+	entry.temperatureSum = 0.0;
+	for (int block = 0; block < BLOCK_COUNT; block++) entry.temperatureSum += entry.blockSum[block];
+}
+
+const RegionStats::Entry* RegionStats::findEntry(const Chunk* chunk) const {
+	auto it = m_Entries.find(World::chunkKey(chunk->getChunkX(), chunk->getChunkY()));
+	if (it == m_Entries.end() || it->second.serial != chunk->getSerial()) return nullptr;
+	return &it->second;
+}
+
+template<typename V> void RegionStats::visit(int x0, int y0, int x1, int y1, V& visitor) const {
+	if (x0 >= x1 || y0 >= y1) return;
+	for (int cy = World::toChunkCoord(y0); cy <= World::toChunkCoord(y1 - 1); cy++) {
+		const int ly0 = std::max(y0 - cy * CHUNK_SIZE, 0);
+		const int ly1 = std::min(y1 - cy * CHUNK_SIZE, CHUNK_SIZE);
+		for (int cx = World::toChunkCoord(x0); cx <= World::toChunkCoord(x1 - 1); cx++) {
+			const Chunk* chunk = m_World.getChunk(cx, cy);
+			if (!chunk) continue;
+			const int lx0 = std::max(x0 - cx * CHUNK_SIZE, 0);
+			const int lx1 = std::min(x1 - cx * CHUNK_SIZE, CHUNK_SIZE);
+
+			const Entry* entry = findEntry(chunk);
+			if (!entry) {
+				visitor.cells(chunk, lx0, ly0, lx1, ly1);
+				continue;
+			}
+			if (lx0 == 0 && ly0 == 0 && lx1 == CHUNK_SIZE && ly1 == CHUNK_SIZE) {
+				visitor.chunk(chunk, *entry);
+				continue;
+			}
+
+			// the blocks covered whole, then the strips around them cut by the rectangle's edges
+			const int bx0 = (lx0 + BLOCK_SIZE - 1) >> BLOCK_SIZE_LOG2;
+			const int by0 = (ly0 + BLOCK_SIZE - 1) >> BLOCK_SIZE_LOG2;
+			const int bx1 = lx1 >> BLOCK_SIZE_LOG2;
+			const int by1 = ly1 >> BLOCK_SIZE_LOG2;
+			if (bx0 >= bx1 || by0 >= by1) {
+				visitor.cells(chunk, lx0, ly0, lx1, ly1);
+				continue;
+			}
+			for (int by = by0; by < by1; by++) {
+				for (int bx = bx0; bx < bx1; bx++) visitor.block(chunk, *entry, by * BLOCKS_PER_SIDE + bx);
+			}
+			const int innerX0 = bx0 * BLOCK_SIZE;
+			const int innerY0 = by0 * BLOCK_SIZE;
+			const int innerX1 = bx1 * BLOCK_SIZE;
+			const int innerY1 = by1 * BLOCK_SIZE;
+			if (ly0 < innerY0) visitor.cells(chunk, lx0, ly0, lx1, innerY0);
+			if (lx0 < innerX0) visitor.cells(chunk, lx0, innerY0, innerX0, innerY1);
+			if (innerX1 < lx1) visitor.cells(chunk, innerX1, innerY0, lx1, innerY1);
+			if (innerY1 < ly1) visitor.cells(chunk, lx0, innerY1, lx1, ly1);
+		}
+	}
+}
+
+void RegionStats::summarise(int x0, int y0, int x1, int y1, RegionSummary& out) const {
+	struct Visitor {
+		RegionSummary& out;
+		size_t materialCount;
+
+		void chunk(const Chunk*, const Entry& entry) {
+			out.cells += CHUNK_CELLS;
+			out.minTemperature = std::min(out.minTemperature, entry.minTemperature);
+			out.maxTemperature = std::max(out.maxTemperature, entry.maxTemperature);
+			out.temperatureSum += entry.temperatureSum;
+			for (size_t m = 0; m < materialCount; m++) out.counts[m] += entry.counts[m];
+		}
+		void block(const Chunk*, const Entry& entry, int block) {
+			out.cells += BLOCK_SIZE * BLOCK_SIZE;
+			out.minTemperature = std::min(out.minTemperature, entry.blockMin[block]);
+			out.maxTemperature = std::max(out.maxTemperature, entry.blockMax[block]);
+			out.temperatureSum += entry.blockSum[block];
+			const uint8_t* counts = entry.blockCounts.data() + (size_t)block * materialCount;
+			for (size_t m = 0; m < materialCount; m++) out.counts[m] += counts[m];
+		}
+		void cells(const Chunk* chunk, int cx0, int cy0, int cx1, int cy1) {
+			out.cells += (uint64_t)(cx1 - cx0) * (cy1 - cy0);
+			for (int y = cy0; y < cy1; y++) {
+				const MaterialID* materials = chunk->getMaterials() + Chunk::index(0, y);
+				const float* temperatures = chunk->getTemperatures() + Chunk::index(0, y);
+				double sum = 0.0;
+				for (int x = cx0; x < cx1; x++) {
+					out.counts[materials[x]]++;
+					out.minTemperature = std::min(out.minTemperature, temperatures[x]);
+					out.maxTemperature = std::max(out.maxTemperature, temperatures[x]);
+					sum += temperatures[x];
+				}
+				out.temperatureSum += sum;
+			}
+		}
+	};
+
+	out.cells = 0;
+	out.minTemperature = NO_TEMPERATURE_MIN;
+	out.maxTemperature = NO_TEMPERATURE_MAX;
+	out.temperatureSum = 0.0;
+	out.counts.assign(m_MaterialCount, 0);
+	Visitor visitor{out, m_MaterialCount};
+	visit(x0, y0, x1, y1, visitor);
+	if (out.cells == 0) out.minTemperature = out.maxTemperature = 0.0f;
+}
+
+uint64_t RegionStats::countMaterial(int x0, int y0, int x1, int y1, MaterialID material) const {
+	struct Visitor {
+		MaterialID material;
+		size_t materialCount;
+		uint64_t count;
+
+		void chunk(const Chunk*, const Entry& entry) {
+			count += entry.counts[material];
+		}
+		void block(const Chunk*, const Entry& entry, int block) {
+			count += entry.blockCounts[(size_t)block * materialCount + material];
+		}
+		void cells(const Chunk* chunk, int cx0, int cy0, int cx1, int cy1) {
+			for (int y = cy0; y < cy1; y++) {
+				const MaterialID* materials = chunk->getMaterials() + Chunk::index(0, y);
+				for (int x = cx0; x < cx1; x++) count += materials[x] == material;
+			}
+		}
+	};
+
+	if (material >= m_MaterialCount) return 0;
+	Visitor visitor{material, m_MaterialCount, 0};
+	visit(x0, y0, x1, y1, visitor);
+	return visitor.count;
+}
+
+bool RegionStats::findHottest(int x0, int y0, int x1, int y1, int& x, int& y, float& temperature) const {
+	// a chunk or block whose maximum is no hotter than the best cell so far is skipped without a read
+	struct Visitor {
+		bool found;
+		int x, y;
+		float temperature;
+
+		void chunk(const Chunk* chunk, const Entry& entry) {
+			if (found && entry.maxTemperature <= temperature) return;
+			for (int block = 0; block < BLOCK_COUNT; block++) this->block(chunk, entry, block);
+		}
+		void block(const Chunk* chunk, const Entry& entry, int block) {
+			if (found && entry.blockMax[block] <= temperature) return;
+			const int bx = (block % BLOCKS_PER_SIDE) * BLOCK_SIZE;
+			const int by = (block / BLOCKS_PER_SIDE) * BLOCK_SIZE;
+			cells(chunk, bx, by, bx + BLOCK_SIZE, by + BLOCK_SIZE);
+		}
+		void cells(const Chunk* chunk, int cx0, int cy0, int cx1, int cy1) {
+			for (int cy = cy0; cy < cy1; cy++) {
+				const float* temperatures = chunk->getTemperatures() + Chunk::index(0, cy);
+				for (int cx = cx0; cx < cx1; cx++) {
+					if (found && temperatures[cx] <= temperature) continue;
+					found = true;
+					x = chunk->getChunkX() * CHUNK_SIZE + cx;
+					y = chunk->getChunkY() * CHUNK_SIZE + cy;
+					temperature = temperatures[cx];
+				}
+			}
+		}
+	};
+
+	Visitor visitor{false, 0, 0, 0.0f};
+	visit(x0, y0, x1, y1, visitor);
+	if (!visitor.found) return false;
+	x = visitor.x;
+	y = visitor.y;
+	temperature = visitor.temperature;
+	return true;
+}
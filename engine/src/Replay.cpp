@@ -0,0 +1,176 @@
+#include "Replay.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include <spdlog/spdlog.h>
+
+#include "Simulation.h"
+#include "World.h"
+
+namespace {
+	struct FileHeader {
+		char magic[4];
+		uint32_t version;
+		ReplaySettings settings;
+	};
+
+	const char MAGIC[4] = {'C', 'H', 'R', 'P'};
+
+	bool readFile(const std::string& path, std::vector<uint8_t>& out) {
+		std::ifstream file(path, std::ios::binary);
+		if (!file) return false;
+		out.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		return !file.bad();
+	}
+}
+
+ReplayRecorder::ReplayRecorder() {
+
+}
+
+ReplayRecorder::~ReplayRecorder() {
+	close();
+}
+
+bool ReplayRecorder::open(const std::string& path, const ReplaySettings& settings) {
+	close();
+	m_File = std::fopen(path.c_str(), "wb");
+	if (!m_File) {
+		spdlog::error("Could not create the replay file {}", path);
+		return false;
+	}
+
+	const FileHeader header{{MAGIC[0], MAGIC[1], MAGIC[2], MAGIC[3]}, VERSION, settings};
+	if (std::fwrite(&header, sizeof(header), 1, m_File) != 1) {
+		spdlog::error("Could not write the replay file {}", path);
+		close();
+		return false;
+	}
+	m_Events.clear();
+	m_Ticks = 0;
+	m_EventCount = 0;
+	return true;
+}
+
+void ReplayRecorder::close() {
+	if (m_File) std::fclose(m_File);
+	m_File = nullptr;
+}
+
+void ReplayRecorder::endTick(uint64_t tick, uint64_t checkHash) {
+	if (!m_File) {
+		m_Events.clear();
+		return;
+	}
+
+	struct {
+		uint64_t tick;
+		uint64_t checkHash;
+		uint32_t eventCount;
+		uint32_t reserved;
+	} record{tick, checkHash, (uint32_t)m_Events.size(), 0};
+
+	bool ok = std::fwrite(&record, sizeof(record), 1, m_File) == 1;
+	if (ok && !m_Events.empty()) ok = std::fwrite(m_Events.data(), sizeof(ReplayEvent), m_Events.size(), m_File) == m_Events.size();
+	if (!ok) {
+		spdlog::error("Could not write to the replay file, stopping the recording");
+		close();
+	}
+	m_Ticks++;
+	m_EventCount += m_Events.size();
+	m_Events.clear();
+}
+
+void ReplayRecorder::recordWorld(const World& world) {
+	std::vector<ReplayEvent> chunks;
+	chunks.reserve(world.getChunkCount());
+	for (const Chunk* chunk : world.getChunks()) chunks.push_back(ReplayEvent{ReplayChunk, chunk->getChunkX(), chunk->getChunkY(), 0});
+	m_Events.insert(m_Events.begin(), chunks.begin(), chunks.end());
+}
+
+uint64_t ReplayRecorder::hashMaterialFile(const std::string& path) {
+	std::vector<uint8_t> bytes;
+	if (!readFile(path, bytes)) return 0;
+	uint64_t value = 0xcbf29ce484222325ull;
+	for (uint8_t byte : bytes) value = (value ^ byte) * 0x100000001b3ull;
+	return value;
+}
+
+ReplayPlayer::ReplayPlayer() {
+
+}
+
+bool ReplayPlayer::readRecord(TickRecord& record, size_t at) const {
+	if (at + sizeof(record) > m_Data.size()) return false;
+	std::memcpy(&record, m_Data.data() + at, sizeof(record));
+	return at + sizeof(record) + (size_t)record.eventCount * sizeof(ReplayEvent) <= m_Data.size();
+}
+
+bool ReplayPlayer::open(const std::string& path) {
+	m_Data.clear();
+	if (!readFile(path, m_Data)) {
+		spdlog::error("Could not read the replay file {}", path);
+		return false;
+	}
+
+	FileHeader header;
+	if (m_Data.size() < sizeof(header)) {
+		spdlog::error("{} is not a replay file", path);
+		m_Data.clear();
+		return false;
+	}
+	std::memcpy(&header, m_Data.data(), sizeof(header));
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != ReplayRecorder::VERSION) {
+		spdlog::error("{} is not a replay file, or one from another version", path);
+		m_Data.clear();
+		return false;
+	}
+	m_Settings = header.settings;
+	m_At = sizeof(header);
+	m_Applied = 0;
+	m_Desynced = false;
+	m_Checked = 0;
+
+	// the last whole record, a recording cut short by a crash still plays up to there
+	TickRecord record;
+	m_HasTicks = false;
+	for (size_t at = m_At; readRecord(record, at); at += sizeof(record) + (size_t)record.eventCount * sizeof(ReplayEvent)) {
+		m_LastTick = record.tick;
+		m_HasTicks = true;
+	}
+	return true;
+}
+
+bool ReplayPlayer::beginTick(uint64_t tick, Simulation& simulation) {
+	if (!m_HasTicks || tick > m_LastTick) return false;
+
+	TickRecord record;
+	if (!readRecord(record, m_At) || record.tick != tick || m_Applied == m_At) return true; // nothing (more) to do before this tick
+	m_Applied = m_At;
+
+	const uint8_t* events = m_Data.data() + m_At + sizeof(record);
+	for (uint32_t i = 0; i < record.eventCount; i++) {
+		ReplayEvent event;
+		std::memcpy(&event, events + i * sizeof(ReplayEvent), sizeof(event));
+		if (event.type == ReplayPaint) simulation.paint(event.x, event.y, (MaterialID)event.value);
+		else if (event.type == ReplayChunk) simulation.getWorld().getOrCreateChunk(event.x, event.y);
+	}
+	return true;
+}
+
+bool ReplayPlayer::endTick(uint64_t tick, uint64_t checkHash) {
+	TickRecord record;
+	if (!readRecord(record, m_At) || record.tick != tick) return !m_Desynced;
+	m_At += sizeof(record) + (size_t)record.eventCount * sizeof(ReplayEvent);
+
+	if (record.checkHash == 0 || checkHash == 0) return !m_Desynced;
+	m_Checked++;
+	if (record.checkHash != checkHash && !m_Desynced) {
+		spdlog::error("Replay went out of step on tick {}", tick);
+		m_Desynced = true;
+		m_DesyncTick = tick;
+	}
+	return !m_Desynced;
+}
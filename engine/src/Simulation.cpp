@@ -0,0 +1,359 @@
+#include "Simulation.h"
+
+#include <algorithm>
+
+#include "DebrisTracker.h"
+#include "GasField.h"
+#include "Profiler.h"
+#include "RegionStats.h"
+#include "Replay.h"
+
+Simulation::Simulation(World& world, const MaterialTable& materials, uint32_t seed, ThreadPool* pool)
+	: m_World{world}, m_Materials{materials}, m_Pool{pool}, m_Seed{seed} {
+	const unsigned threads = m_Pool ? m_Pool->getThreadCount() : 1;
+	for (unsigned i = 0; i < threads; i++) m_Arenas.emplace_back(new FrameArena());
+}
+
+FrameArena& Simulation::getFrameArena() {
+	return *m_Arenas[m_Pool ? m_Pool->getCurrentThread() : 0];
+}
+
+FrameArenaStats Simulation::getFrameArenaStats() const {
+	FrameArenaStats total = {};
+	for (const std::unique_ptr<FrameArena>& arena : m_Arenas) {
+		const FrameArenaStats stats = arena->getStats();
+		total.allocations += stats.allocations;
+		total.bytesAllocated += stats.bytesAllocated;
+		total.peakBytes += stats.peakBytes;
+		total.blockAllocations += stats.blockAllocations;
+	}
+	return total;
+}
+
+void Simulation::resetFrameArenaStats() {
+	for (std::unique_ptr<FrameArena>& arena : m_Arenas) arena->resetStats();
+}
+
+uint32_t Simulation::nextRandom(uint32_t& state) {
+	// xorshift32
+	uint32_t x = state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return state = x;
+}
+
+uint32_t Simulation::chunkSeed(const Chunk* chunk) const {
+	// murmur3 finaliser over the seed, tick and chunk position
+	uint32_t h = m_Seed ^ (uint32_t)m_Tick * 0x9E3779B9u;
+	h ^= (uint32_t)chunk->getChunkX() * 0x85EBCA6Bu;
+	h ^= (uint32_t)chunk->getChunkY() * 0xC2B2AE35u;
+	h ^= h >> 16;
+	h *= 0x85EBCA6Bu;
+	h ^= h >> 13;
+	h *= 0xC2B2AE35u;
+	h ^= h >> 16;
+	return h ? h : 1;
+}
+
+bool Simulation::resolve(Chunk* chunk, int x, int y, CellRef& out) {
+	if (Chunk::inBounds(x, y)) {
+		out.chunk = chunk;
+		out.x = x;
+		out.y = y;
+		out.index = Chunk::index(x, y);
+		return true;
+	}
+
+	int dx = x < 0 ? -1 : (x >= CHUNK_SIZE ? 1 : 0);
+	int dy = y < 0 ? -1 : (y >= CHUNK_SIZE ? 1 : 0);
+
+	Chunk* target = chunk->getNeighbour(dx, dy);
+	if (!target) return false; // unloaded space behaves like a wall
+
+	out.chunk = target;
+	out.x = x - dx * CHUNK_SIZE;
+	out.y = y - dy * CHUNK_SIZE;
+	out.index = Chunk::index(out.x, out.y);
+	return true;
+}
+
+void Simulation::paint(int x, int y, MaterialID material) {
+	if (m_Recorder) m_Recorder->record(ReplayEvent{ReplayPaint, x, y, material});
+	Chunk* chunk = m_World.getOrCreateChunk(World::toChunkCoord(x), World::toChunkCoord(y));
+	const int lx = World::toLocalCoord(x);
+	const int ly = World::toLocalCoord(y);
+	chunk->setMaterial(lx, ly, material);
+	chunk->setTemperature(lx, ly, m_Materials.hasSpawnTemperature(material) ? m_Materials.getSpawnTemperature(material) : AMBIENT_TEMPERATURE);
+}
+
+void Simulation::stepHeat() {
+	PROFILE_SCOPE("heat");
+	const std::vector<Chunk*>& chunks = m_World.getChunks();
+	m_HeatChunks = ChunkList{m_Arenas[0]->allocateArray<Chunk*>(chunks.size()), 0};
+	for (Chunk* chunk : chunks) {
+		if (chunk->isAwake() || chunk->isThermallyActive()) m_HeatChunks.chunks[m_HeatChunks.count++] = chunk;
+	}
+
+	// every edge is cached before any chunk is diffused in place, so the order chunks run in doesn't matter
+	forEachChunk(m_HeatChunks, [](Chunk* chunk) { chunk->beginHeatPass(); });
+	forEachChunk(m_HeatChunks, [this](Chunk* chunk) { diffuseChunk(chunk); });
+	for (size_t i = 0; i < m_HeatChunks.count; i++) m_HeatChunks.chunks[i]->endHeatPass();
+}
+
+void Simulation::diffuseChunk(Chunk* chunk) {
+	static constexpr ChunkNeighbour ACROSS[EdgeCount] = {NeighbourLeft, NeighbourRight, NeighbourDown, NeighbourUp};
+	static constexpr ChunkEdge FACING[EdgeCount] = {EdgeRight, EdgeLeft, EdgeUp, EdgeDown};
+
+	float gathered[EdgeCount][CHUNK_SIZE];
+	const float* halo[EdgeCount];
+
+	for (int edge = 0; edge < EdgeCount; edge++) {
+		const Chunk* neighbour = chunk->getNeighbour(ACROSS[edge]);
+		if (!neighbour) {
+			halo[edge] = chunk->getHeatEdge((ChunkEdge)edge); // unloaded space is insulating
+		} else if (neighbour->inHeatPass()) {
+			halo[edge] = neighbour->getHeatEdge(FACING[edge]);
+		} else {
+			neighbour->copyHeatEdge(FACING[edge], gathered[edge]);
+			halo[edge] = gathered[edge];
+		}
+	}
+
+	const HeatStepResult result = m_Heat.step(chunk->getTemperatures(), chunk->getMaterials(), chunk->getFlags(),
+		HeatHalo{halo[EdgeLeft], halo[EdgeRight], halo[EdgeDown], halo[EdgeUp]},
+		m_Materials.getUpperThresholds(), m_Materials.getLowerThresholds(), m_HeatRate);
+
+	if (result.maxDelta > THERMAL_EPSILON) {
+		chunk->wakeThermal();
+		for (int edge = 0; edge < EdgeCount; edge++) {
+			if (Chunk* neighbour = chunk->getNeighbour(ACROSS[edge])) neighbour->wakeThermal();
+		}
+	}
+	if (result.flagged != 0) chunk->markRowsDirty(result.minRow, result.maxRow);
+}
+
+void Simulation::step() {
+	PROFILE_SCOPE("Simulation::step");
+	for (std::unique_ptr<FrameArena>& arena : m_Arenas) arena->reset();
+
+	// sees the writes of the last tick through the dirty rectangles, so it goes before anything moves
+	if (m_Debris) {
+		PROFILE_SCOPE("debris");
+		m_Debris->update();
+	}
+
+	stepHeat();
+	if (m_Gas) m_Gas->step();
+
+	// sized exactly, so the arena only has to hold what the tick really uses
+	size_t passSizes[4] = {};
+	for (Chunk* chunk : m_World.getChunks()) {
+		if (chunk->isAwake()) passSizes[chunk->getCheckerboardPass()]++;
+	}
+	for (int pass = 0; pass < 4; pass++) m_Passes[pass] = ChunkList{m_Arenas[0]->allocateArray<Chunk*>(passSizes[pass]), 0};
+	for (Chunk* chunk : m_World.getChunks()) {
+		if (!chunk->isAwake()) continue;
+		ChunkList& pass = m_Passes[chunk->getCheckerboardPass()];
+		pass.chunks[pass.count++] = chunk;
+	}
+
+	{
+		PROFILE_SCOPE("cell passes");
+		for (const ChunkList& pass : m_Passes) forEachChunk(pass, [this](Chunk* chunk) { updateChunk(chunk); });
+	}
+
+	{
+		PROFILE_SCOPE("swapDirtyRects");
+		m_World.swapDirtyRects();
+	}
+	// goes by the dirty rectangles the tick left behind
+	if (m_RegionStats) m_RegionStats->update();
+	m_Tick++;
+}
+
+void Simulation::updateChunk(Chunk* chunk) {
+	const uint8_t parity = (m_Tick & 1) ? CellParity : 0;
+	const MaterialID* materials = chunk->getMaterials();
+	uint8_t* flags = chunk->getFlags();
+
+	const int minX = chunk->getDirtyMinX();
+	const int maxX = chunk->getDirtyMaxX();
+	const bool reverse = (m_Tick & 2) != 0; // alternate sweep direction so nothing drifts to one side
+	uint32_t random = chunkSeed(chunk);
+
+	for (int y = chunk->getDirtyMinY(); y < chunk->getDirtyMaxY(); y++) {
+		for (int i = minX; i < maxX; i++) {
+			const int x = reverse ? maxX - 1 - (i - minX) : i;
+			const int id = Chunk::index(x, y);
+
+			uint8_t f = flags[id];
+			if (f & CellUpdated) {
+				if ((f & CellParity) == parity) continue; // already moved this tick
+				flags[id] = f &= ~CellUpdated;
+			}
+			if (f & (CellStatic | CellDebris)) continue; // debris is moved by the DebrisTracker
+
+			const MaterialID material = materials[id];
+			if (material == 0) continue;
+
+			CellRef cell{chunk, x, y, id};
+
+			if (f & CellPhaseChange) {
+				flags[id] = f &= ~CellPhaseChange;
+				const MaterialID changed = m_Materials.getPhaseChange(material, chunk->getTemperatures()[id], (uint16_t)nextRandom(random));
+				if (changed != material) {
+					replaceCell(cell, changed);
+					continue;
+				}
+			}
+
+			if (react(cell, material, random)) continue;
+
+			const float density = m_Materials.getDensity(material);
+			switch (m_Materials.getPhase(material)) {
+				case PhasePowder:
+					if (!fall(cell, density, -1)) slide(cell, density, -1, 1, random);
+					break;
+				case PhaseLiquid:
+					if (!fall(cell, density, -1) && !slide(cell, density, -1, 1, random)) slide(cell, density, 0, 3, random);
+					break;
+				case PhaseGas:
+					if (m_Gas) {
+						const int species = m_Gas->getSpecies(material);
+						if (species >= 0) {
+							float& temperature = chunk->getTemperatures()[id];
+							const float air = m_Gas->absorb(*chunk, x, y, species, temperature);
+							replaceCell(cell, 0);
+							temperature = air;
+							break;
+						}
+					}
+					if (!fall(cell, density, 1) && !slide(cell, density, 1, 1, random)) slide(cell, density, 0, 2, random);
+					break;
+				default:
+					break;
+			}
+		}
+	}
+}
+
+bool Simulation::canDisplace(float density, const CellRef& target) const {
+	if (target.chunk->getFlags()[target.index] & (CellStatic | CellDebris)) return false;
+	const MaterialID other = target.chunk->getMaterials()[target.index];
+	return m_Materials.getPhase(other) != PhaseSolid && m_Materials.getDensity(other) < density;
+}
+
+bool Simulation::react(const CellRef& cell, MaterialID material, uint32_t& random) {
+	static constexpr int OFFSETS[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+
+	const uint32_t r = nextRandom(random);
+	const uint16_t roll = (uint16_t)(r >> 16);
+	bool pending = false;
+
+	// one random orthogonal neighbour per tick
+	const int* offset = OFFSETS[r & 3];
+	CellRef other;
+	if (resolve(cell.chunk, cell.x + offset[0], cell.y + offset[1], other)) {
+		const Reaction& reaction = m_Materials.getReaction(material, other.chunk->getMaterials()[other.index]);
+		if (reaction.chance != 0) {
+			if (roll < reaction.chance) {
+				replaceCell(cell, reaction.productA);
+				replaceCell(other, reaction.productB);
+				return true;
+			}
+			pending = true;
+		}
+	}
+
+	const uint16_t decay = m_Materials.getDecayChance(material);
+	if (decay != 0) {
+		if ((uint16_t)r < decay) {
+			replaceCell(cell, m_Materials.getDecaysTo(material));
+			return true;
+		}
+		pending = true;
+	}
+
+	// a reaction that could still happen keeps the chunk awake
+	if (pending) cell.chunk->markDirty(cell.x, cell.y);
+	return false;
+}
+
+bool Simulation::fall(const CellRef& cell, float density, int direction) {
+	int8_t& velocity = cell.chunk->getVelocitiesY()[cell.index];
+	const int speed = std::min(std::abs((int)velocity) + 1, MAX_FALL_SPEED);
+
+	CellRef target;
+	int moved = 0;
+	for (int s = 1; s <= speed; s++) {
+		CellRef next;
+		if (!resolve(cell.chunk, cell.x, cell.y + s * direction, next) || !canDisplace(density, next)) break;
+		target = next;
+		moved = s;
+	}
+
+	if (moved == 0) {
+		velocity = 0;
+		return false;
+	}
+
+	velocity = (int8_t)(speed * direction);
+	swapCells(cell, target);
+	return true;
+}
+
+bool Simulation::slide(const CellRef& cell, float density, int dy, int reach, uint32_t& random) {
+	const int first = (nextRandom(random) & 1) ? 1 : -1;
+
+	for (int side = 0; side < 2; side++) {
+		const int dx = side == 0 ? first : -first;
+
+		CellRef target;
+		int moved = 0;
+		for (int s = 1; s <= reach; s++) {
+			CellRef next;
+			if (!resolve(cell.chunk, cell.x + s * dx, cell.y + dy, next) || !canDisplace(density, next)) break;
+			target = next;
+			moved = s;
+		}
+
+		if (moved > 0) {
+			swapCells(cell, target);
+			return true;
+		}
+	}
+	return false;
+}
+
+void Simulation::swapCells(const CellRef& a, const CellRef& b) {
+	const uint8_t parity = (m_Tick & 1) ? CellParity : 0;
+
+	std::swap(a.chunk->getMaterials()[a.index], b.chunk->getMaterials()[b.index]);
+	std::swap(a.chunk->getTemperatures()[a.index], b.chunk->getTemperatures()[b.index]);
+	std::swap(a.chunk->getVelocitiesX()[a.index], b.chunk->getVelocitiesX()[b.index]);
+	std::swap(a.chunk->getVelocitiesY()[a.index], b.chunk->getVelocitiesY()[b.index]);
+
+	uint8_t& fa = a.chunk->getFlags()[a.index];
+	uint8_t& fb = b.chunk->getFlags()[b.index];
+	std::swap(fa, fb);
+	fa = (fa & ~CellParity) | CellUpdated | parity;
+	fb = (fb & ~CellParity) | CellUpdated | parity;
+
+	a.chunk->markDirty(a.x, a.y);
+	b.chunk->markDirty(b.x, b.y);
+}
+
+void Simulation::replaceCell(const CellRef& cell, MaterialID material) {
+	const uint8_t parity = (m_Tick & 1) ? CellParity : 0;
+
+	cell.chunk->getMaterials()[cell.index] = material;
+	if (m_Materials.hasSpawnTemperature(material)) cell.chunk->getTemperatures()[cell.index] = m_Materials.getSpawnTemperature(material);
+	cell.chunk->getVelocitiesX()[cell.index] = 0;
+	cell.chunk->getVelocitiesY()[cell.index] = 0;
+
+	uint8_t& flags = cell.chunk->getFlags()[cell.index];
+	flags = (flags & ~(CellParity | CellStatic | CellPhaseChange)) | CellUpdated | parity;
+
+	cell.chunk->markDirty(cell.x, cell.y);
+}
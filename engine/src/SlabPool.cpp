@@ -0,0 +1,62 @@
+#include "SlabPool.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+namespace {
+	inline size_t roundUp(size_t value, size_t multiple) {
+		return (value + multiple - 1) / multiple * multiple;
+	}
+}
+
+SlabPool::SlabPool(size_t objectSize, size_t alignment, size_t objectsPerSlab)
+	: m_Alignment{std::max(alignment, alignof(FreeObject))}, m_ObjectSize{roundUp(std::max(objectSize, sizeof(FreeObject)), m_Alignment)},
+	m_ObjectsPerSlab{std::max<size_t>(objectsPerSlab, 1)} {
+
+}
+
+SlabPool::~SlabPool() {
+	for (void* slab : m_Slabs) ::operator delete(slab, std::align_val_t(m_Alignment));
+}
+
+void SlabPool::grow() {
+	uint8_t* slab = static_cast<uint8_t*>(::operator new(m_ObjectSize * m_ObjectsPerSlab, std::align_val_t(m_Alignment)));
+	m_Slabs.push_back(slab);
+
+	// threaded back to front so objects are handed out in address order
+	for (size_t i = m_ObjectsPerSlab; i-- > 0;) {
+		FreeObject* object = reinterpret_cast<FreeObject*>(slab + i * m_ObjectSize);
+		object->next = m_Free;
+		m_Free = object;
+	}
+}
+
+void* SlabPool::allocate() {
+	if (!m_Free) grow();
+	FreeObject* object = m_Free;
+	m_Free = object->next;
+
+	m_Allocations++;
+	m_InUse++;
+	m_PeakInUse = std::max(m_PeakInUse, m_InUse);
+	return object;
+}
+
+void SlabPool::release(void* object) {
+	if (!object) return;
+	FreeObject* freed = static_cast<FreeObject*>(object);
+	freed->next = m_Free;
+	m_Free = freed;
+
+	m_Frees++;
+	m_InUse--;
+}
+
+void SlabPool::reserve(size_t count) {
+	while (getCapacity() < count) grow();
+}
+
+SlabPoolStats SlabPool::getStats() const {
+	return SlabPoolStats{m_Allocations, m_Frees, m_Slabs.size(), m_InUse, m_PeakInUse, getCapacity()};
+}
@@ -0,0 +1,258 @@
+#include "TextOverlay.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+
+#include <spdlog/spdlog.h>
+#include <stb_easy_font.h>
+#include <stb_image_write.h>
+#include <stb_rect_pack.h>
+#include <stb_truetype.h>
+
+TextOverlay::TextOverlay() : m_Colors(MAX_COLORS, 0xffffffff) {
+
+}
+
+void TextOverlay::load(const std::string& fontPath, float pixelHeight, int builtinScale) {
+	m_Layouts.clear();
+	m_Vertices.clear();
+	m_Previous.clear();
+	m_Generation++;
+	if (!fontPath.empty() && bakeTrueType(fontPath, pixelHeight)) return;
+	bakeBuiltin(std::max(builtinScale, 1));
+}
+
+bool TextOverlay::bakeTrueType(const std::string& path, float pixelHeight) {
+	std::ifstream file(path, std::ios::binary);
+	const std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	stbtt_fontinfo font;
+	if (bytes.empty() || !stbtt_InitFont(&font, bytes.data(), stbtt_GetFontOffsetForIndex(bytes.data(), 0))) {
+		spdlog::error("Could not read the font {}, using the built-in one", path);
+		return false;
+	}
+
+	int ascent, descent, lineGap;
+	stbtt_GetFontVMetrics(&font, &ascent, &descent, &lineGap);
+	const float scale = stbtt_ScaleForPixelHeight(&font, pixelHeight);
+
+	stbtt_packedchar packed[GLYPH_COUNT];
+	for (int size = 128; size <= MAX_ATLAS_SIZE; size *= 2) {
+		std::vector<uint8_t> pixels((size_t)size * size);
+		stbtt_pack_context context;
+		if (!stbtt_PackBegin(&context, pixels.data(), size, size, 0, 1, nullptr)) break;
+		const bool fits = stbtt_PackFontRange(&context, bytes.data(), 0, pixelHeight, FIRST_CHAR, GLYPH_COUNT, packed) != 0;
+		stbtt_PackEnd(&context);
+		if (!fits) continue;
+
+		// the pen sits at the top of the line, stb_truetype's offsets are from the baseline
+		const float baseline = std::round(ascent * scale);
+		for (int i = 0; i < GLYPH_COUNT; i++) {
+			const stbtt_packedchar& glyph = packed[i];
+			m_Glyphs[i] = Glyph{glyph.x0, glyph.y0, (uint16_t)(glyph.x1 - glyph.x0), (uint16_t)(glyph.y1 - glyph.y0),
+				(int16_t)std::lround(glyph.xoff), (int16_t)std::lround(baseline + glyph.yoff), glyph.xadvance};
+		}
+		m_Atlas.swap(pixels);
+		m_AtlasWidth = size;
+		m_AtlasHeight = size;
+		m_LineHeight = (int)std::ceil((ascent - descent + lineGap) * scale);
+		spdlog::info("Baked {} at {} px into a {}x{} glyph atlas", path, pixelHeight, size, size);
+		return true;
+	}
+	spdlog::error("{} at {} px doesn't fit a {} px glyph atlas, using the built-in font", path, pixelHeight, MAX_ATLAS_SIZE);
+	return false;
+}
+
+bool TextOverlay::bakeBuiltin(int scale) {
+	struct Quad {
+		int x0, y0, x1, y1;
+	};
+
+	// stb_easy_font draws a character as a few axis-aligned quads on a 12 pixel line
+	std::vector<Quad> quads[GLYPH_COUNT];
+	stbrp_rect rects[GLYPH_COUNT];
+	for (int i = 0; i < GLYPH_COUNT; i++) {
+		char text[2] = {(char)(FIRST_CHAR + i), 0};
+		struct Vertex {
+			float x, y, z;
+			uint8_t color[4];
+		} vertices[256];
+		const int count = stb_easy_font_print(0.0f, 0.0f, text, nullptr, vertices, sizeof(vertices));
+
+		Quad bounds{INT32_MAX, INT32_MAX, INT32_MIN, INT32_MIN};
+		for (int q = 0; q < count; q++) {
+			const Vertex* corner = vertices + q * 4;
+			const Quad quad{(int)std::min(corner[0].x, corner[2].x), (int)std::min(corner[0].y, corner[2].y),
+				(int)std::max(corner[0].x, corner[2].x), (int)std::max(corner[0].y, corner[2].y)};
+			quads[i].push_back(quad);
+			bounds = Quad{std::min(bounds.x0, quad.x0), std::min(bounds.y0, quad.y0), std::max(bounds.x1, quad.x1), std::max(bounds.y1, quad.y1)};
+		}
+		if (count == 0) bounds = Quad{0, 0, 0, 0};
+
+		m_Glyphs[i] = Glyph{0, 0, (uint16_t)((bounds.x1 - bounds.x0) * scale), (uint16_t)((bounds.y1 - bounds.y0) * scale),
+			(int16_t)(bounds.x0 * scale), (int16_t)(bounds.y0 * scale), (float)(stb_easy_font_width(text) * scale)};
+		for (Quad& quad : quads[i]) quad = Quad{quad.x0 - bounds.x0, quad.y0 - bounds.y0, quad.x1 - bounds.x0, quad.y1 - bounds.y0};
+		// a texel apart, so nothing bleeds between glyphs
+		rects[i] = stbrp_rect{i, (stbrp_coord)(m_Glyphs[i].width + 1), (stbrp_coord)(m_Glyphs[i].height + 1), 0, 0, 0};
+	}
+
+	for (int size = 64; size <= MAX_ATLAS_SIZE; size *= 2) {
+		std::vector<stbrp_node> nodes(size);
+		stbrp_context context;
+		stbrp_init_target(&context, size, size, nodes.data(), (int)nodes.size());
+		if (!stbrp_pack_rects(&context, rects, GLYPH_COUNT)) continue;
+
+		m_Atlas.assign((size_t)size * size, 0);
+		m_AtlasWidth = size;
+		m_AtlasHeight = size;
+		m_LineHeight = 12 * scale;
+		for (int i = 0; i < GLYPH_COUNT; i++) {
+			Glyph& glyph = m_Glyphs[i];
+			glyph.x = (uint16_t)rects[i].x;
+			glyph.y = (uint16_t)rects[i].y;
+			for (const Quad& quad : quads[i]) {
+				for (int y = quad.y0 * scale; y < quad.y1 * scale; y++) {
+					uint8_t* row = m_Atlas.data() + (size_t)(glyph.y + y) * size + glyph.x;
+					std::fill(row + quad.x0 * scale, row + quad.x1 * scale, 255);
+				}
+			}
+		}
+		return true;
+	}
+	spdlog::error("The built-in font at scale {} doesn't fit a {} px glyph atlas", scale, MAX_ATLAS_SIZE);
+	m_Atlas.clear();
+	m_AtlasWidth = 0;
+	m_AtlasHeight = 0;
+	return false;
+}
+
+void TextOverlay::setColor(int index, uint32_t color) {
+	if (index < 0 || index >= MAX_COLORS) return;
+	m_Colors[index] = color;
+}
+
+const TextOverlay::Layout& TextOverlay::layout(const std::string& text) {
+	auto it = m_Layouts.find(text);
+	if (it != m_Layouts.end()) {
+		it->second.lastUsed = m_Frame;
+		m_Stats.layoutHits++;
+		return it->second;
+	}
+	m_Stats.layoutMisses++;
+
+	Layout& entry = m_Layouts[text];
+	entry.width = 0.0f;
+	entry.lastUsed = m_Frame;
+	float pen = 0.0f;
+	float line = 0.0f;
+	for (char c : text) {
+		if (c == '\n') {
+			pen = 0.0f;
+			line += m_LineHeight;
+			continue;
+		}
+		int index = (unsigned char)c - FIRST_CHAR;
+		if (index < 0 || index >= GLYPH_COUNT) index = '?' - FIRST_CHAR;
+		const Glyph& glyph = m_Glyphs[index];
+		if (glyph.width != 0 && glyph.height != 0) {
+			// whole pixels, so each texel lands on exactly one
+			const float x0 = std::floor(pen + 0.5f) + glyph.offsetX;
+			const float y0 = line + glyph.offsetY;
+			const float x1 = x0 + glyph.width;
+			const float y1 = y0 + glyph.height;
+			const float u0 = glyph.x;
+			const float v0 = glyph.y;
+			const float u1 = u0 + glyph.width;
+			const float v1 = v0 + glyph.height;
+			entry.vertices.insert(entry.vertices.end(), {x0, y0, u0, v0, x1, y0, u1, v0, x1, y1, u1, v1, x0, y1, u0, v1});
+		}
+		pen += glyph.advance;
+		entry.width = std::max(entry.width, pen);
+	}
+	return entry;
+}
+
+void TextOverlay::begin() {
+	m_Frame++;
+	m_Previous.swap(m_Vertices);
+	m_Vertices.clear();
+	m_Stats.layoutHits = 0;
+	m_Stats.layoutMisses = 0;
+}
+
+void TextOverlay::addText(float x, float y, const std::string& text, int color) {
+	if (m_AtlasHeight == 0) return;
+	const Layout& entry = layout(text);
+	const float originX = std::floor(x + 0.5f);
+	const float originY = std::floor(y + 0.5f);
+	const float colorOffset = (float)(std::clamp(color, 0, MAX_COLORS - 1) * getColorStride());
+
+	const size_t start = m_Vertices.size();
+	m_Vertices.resize(start + entry.vertices.size());
+	float* out = m_Vertices.data() + start;
+	for (size_t i = 0; i < entry.vertices.size(); i += VERTEX_FLOATS) {
+		out[i] = entry.vertices[i] + originX;
+		out[i + 1] = entry.vertices[i + 1] + originY;
+		out[i + 2] = entry.vertices[i + 2];
+		out[i + 3] = entry.vertices[i + 3] + colorOffset;
+	}
+}
+
+void TextOverlay::end() {
+	if (m_Vertices != m_Previous) m_Generation++;
+	if (m_Frame % EVICT_FRAMES == 0) {
+		for (auto it = m_Layouts.begin(); it != m_Layouts.end();) {
+			if (it->second.lastUsed + EVICT_FRAMES < m_Frame) it = m_Layouts.erase(it);
+			else ++it;
+		}
+	}
+	m_Stats.quads = getQuadCount();
+	m_Stats.cachedLayouts = m_Layouts.size();
+}
+
+float TextOverlay::measure(const std::string& text) {
+	return m_AtlasHeight == 0 ? 0.0f : layout(text).width;
+}
+
+void TextOverlay::rasterise(uint8_t* rgba, int width, int height) const {
+	const int stride = getColorStride();
+	for (size_t i = 0; i < m_Vertices.size(); i += 4 * VERTEX_FLOATS) {
+		// corners 0 and 2 are the top left and bottom right
+		const float* quad = m_Vertices.data() + i;
+		const int x0 = (int)quad[0];
+		const int y0 = (int)quad[1];
+		const int x1 = (int)quad[8];
+		const int y1 = (int)quad[9];
+		const int color = (int)quad[3] / stride;
+		const int u0 = (int)quad[2];
+		const int v0 = (int)quad[3] - color * stride;
+
+		const uint32_t packed = m_Colors[color];
+		const int red = packed >> 24;
+		const int green = (packed >> 16) & 0xff;
+		const int blue = (packed >> 8) & 0xff;
+		const int alpha = packed & 0xff;
+		for (int y = std::max(y0, 0); y < std::min(y1, height); y++) {
+			const uint8_t* coverage = m_Atlas.data() + (size_t)(v0 + y - y0) * m_AtlasWidth + u0 - x0;
+			uint8_t* pixel = rgba + ((size_t)y * width) * 4;
+			for (int x = std::max(x0, 0); x < std::min(x1, width); x++) {
+				const int a = coverage[x] * alpha / 255;
+				if (a == 0) continue;
+				uint8_t* out = pixel + x * 4;
+				out[0] = (uint8_t)((red * a + out[0] * (255 - a) + 127) / 255);
+				out[1] = (uint8_t)((green * a + out[1] * (255 - a) + 127) / 255);
+				out[2] = (uint8_t)((blue * a + out[2] * (255 - a) + 127) / 255);
+				out[3] = (uint8_t)std::max<int>(out[3], a);
+			}
+		}
+	}
+}
+
+bool TextOverlay::writePng(const std::string& path, const uint8_t* rgba, int width, int height) {
+	if (!stbi_write_png(path.c_str(), width, height, 4, rgba, width * 4)) {
+		spdlog::error("Could not write the image {}", path);
+		return false;
+	}
+	return true;
+}
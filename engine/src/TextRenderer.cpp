@@ -0,0 +1,170 @@
+#include "TextRenderer.h"
+
+#include <string>
+
+#include <spdlog/spdlog.h>
+
+namespace {
+	const char* VERTEX_SHADER = R"(
+		layout(location = 0) in vec4 a_Vertex; // x, y from the top left, u, v + color * stride
+
+		uniform vec2 u_Screen; // 2 / width, 2 / height
+		uniform float u_ColorStride;
+
+		out vec2 v_Texel;
+		flat out int v_Color;
+
+		void main() {
+			float color = floor(a_Vertex.w / u_ColorStride);
+			v_Texel = vec2(a_Vertex.z, a_Vertex.w - color * u_ColorStride);
+			v_Color = int(color);
+			gl_Position = vec4(a_Vertex.x * u_Screen.x - 1.0, 1.0 - a_Vertex.y * u_Screen.y, 0.0, 1.0);
+		}
+	)";
+
+	const char* FRAGMENT_SHADER = R"(
+		uniform sampler2D u_Glyphs;
+		uniform vec4 u_Colors[MAX_COLORS];
+
+		in vec2 v_Texel;
+		flat in int v_Color;
+
+		out vec4 o_Color;
+
+		void main() {
+			// quads are one texel per pixel, the pixel centre falls inside its texel
+			float coverage = texelFetch(u_Glyphs, ivec2(v_Texel), 0).r;
+			vec4 color = u_Colors[v_Color];
+			o_Color = vec4(color.rgb, color.a * coverage);
+		}
+	)";
+
+	GLuint compileShader(GLenum type, const char* body) {
+		const std::string source = "#version 450 core\n#define MAX_COLORS " + std::to_string(TextOverlay::MAX_COLORS) + "\n" + body;
+		const char* text = source.c_str();
+
+		GLuint shader = glCreateShader(type);
+		glShaderSource(shader, 1, &text, nullptr);
+		glCompileShader(shader);
+
+		GLint ok = GL_FALSE;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+		if (!ok) {
+			char log[1024];
+			glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+			spdlog::error("Text renderer shader failed to compile: {}", log);
+			glDeleteShader(shader);
+			return 0;
+		}
+		return shader;
+	}
+
+	GLuint linkProgram() {
+		GLuint vertex = compileShader(GL_VERTEX_SHADER, VERTEX_SHADER);
+		GLuint fragment = compileShader(GL_FRAGMENT_SHADER, FRAGMENT_SHADER);
+		if (!vertex || !fragment) {
+			glDeleteShader(vertex);
+			glDeleteShader(fragment);
+			return 0;
+		}
+
+		GLuint program = glCreateProgram();
+		glAttachShader(program, vertex);
+		glAttachShader(program, fragment);
+		glLinkProgram(program);
+		glDeleteShader(vertex);
+		glDeleteShader(fragment);
+
+		GLint ok = GL_FALSE;
+		glGetProgramiv(program, GL_LINK_STATUS, &ok);
+		if (!ok) {
+			char log[1024];
+			glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+			spdlog::error("Text renderer program failed to link: {}", log);
+			glDeleteProgram(program);
+			return 0;
+		}
+		return program;
+	}
+}
+
+TextRenderer::TextRenderer() : m_Vertices{TextOverlay::VERTEX_FLOATS}, m_Indices{GL_DYNAMIC_DRAW} {
+	m_Program = linkProgram();
+	if (m_Program) {
+		m_ScreenLocation = glGetUniformLocation(m_Program, "u_Screen");
+		m_ColorStrideLocation = glGetUniformLocation(m_Program, "u_ColorStride");
+		m_ColorsLocation = glGetUniformLocation(m_Program, "u_Colors");
+		glProgramUniform1i(m_Program, glGetUniformLocation(m_Program, "u_Glyphs"), 0);
+	}
+
+	m_VAO.attachBuffer(&m_Vertices, 0);
+	m_VAO.enableAttribute(0);
+	m_VAO.bindElementArray(&m_Indices);
+}
+
+TextRenderer::~TextRenderer() {
+	glDeleteTextures(1, &m_AtlasTexture);
+	glDeleteProgram(m_Program);
+}
+
+void TextRenderer::setAtlas(const TextOverlay& overlay) {
+	glDeleteTextures(1, &m_AtlasTexture);
+	m_AtlasTexture = 0;
+	if (overlay.getAtlasWidth() == 0) return;
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &m_AtlasTexture);
+	glTextureStorage2D(m_AtlasTexture, 1, GL_R8, overlay.getAtlasWidth(), overlay.getAtlasHeight());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTextureSubImage2D(m_AtlasTexture, 0, 0, 0, overlay.getAtlasWidth(), overlay.getAtlasHeight(), GL_RED, GL_UNSIGNED_BYTE, overlay.getAtlas());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTextureParameteri(m_AtlasTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(m_AtlasTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	m_Generation = UINT64_MAX;
+}
+
+void TextRenderer::render(const TextOverlay& overlay, int viewportWidth, int viewportHeight) {
+	if (!isValid() || m_AtlasTexture == 0 || overlay.getQuadCount() == 0) return;
+	PROFILE_SCOPE("text");
+
+	if (overlay.getGeneration() != m_Generation) {
+		const std::vector<float>& vertices = overlay.getVertices();
+		m_Vertices.clear();
+		for (size_t i = 0; i < vertices.size(); i += TextOverlay::VERTEX_FLOATS) {
+			m_Vertices.pushVertex(vertices[i], vertices[i + 1], vertices[i + 2], vertices[i + 3]);
+		}
+		m_Quads = overlay.getQuadCount();
+		for (; m_IndexedQuads < m_Quads; m_IndexedQuads++) {
+			const unsigned int first = (unsigned int)m_IndexedQuads * 4;
+			unsigned int triangles[2][3] = {{first, first + 1, first + 2}, {first + 2, first + 3, first}};
+			m_Indices.pushPrimitive(triangles[0]);
+			m_Indices.pushPrimitive(triangles[1]);
+		}
+
+		m_Vertices.resetUploadStats();
+		m_Indices.resetUploadStats();
+		m_Vertices.pushToBuffer(true);
+		m_Indices.pushToBuffer(true);
+		m_BytesUploaded += m_Vertices.getUploadStats().bytesUploaded + m_Indices.getUploadStats().bytesUploaded;
+		m_Generation = overlay.getGeneration();
+	}
+
+	float colors[TextOverlay::MAX_COLORS * 4];
+	for (int i = 0; i < TextOverlay::MAX_COLORS; i++) {
+		const uint32_t color = overlay.getColor(i);
+		for (int c = 0; c < 4; c++) colors[i * 4 + c] = ((color >> (24 - c * 8)) & 0xff) / 255.0f;
+	}
+
+	glUseProgram(m_Program);
+	glProgramUniform2f(m_Program, m_ScreenLocation, 2.0f / viewportWidth, 2.0f / viewportHeight);
+	glProgramUniform1f(m_Program, m_ColorStrideLocation, (float)overlay.getColorStride());
+	glProgramUniform4fv(m_Program, m_ColorsLocation, TextOverlay::MAX_COLORS, colors);
+
+	glViewport(0, 0, viewportWidth, viewportHeight);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glBindTextureUnit(0, m_AtlasTexture);
+
+	m_VAO.bind();
+	glDrawElements(GL_TRIANGLES, (GLsizei)(m_Quads * 6), GL_UNSIGNED_INT, nullptr);
+	m_VAO.unbind();
+}
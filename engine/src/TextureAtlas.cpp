@@ -0,0 +1,353 @@
+#include "TextureAtlas.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include <spdlog/spdlog.h>
+#include <stb_dxt.h>
+#include <stb_image.h>
+#include <stb_rect_pack.h>
+
+#include "Profiler.h"
+
+namespace {
+	struct CacheHeader {
+		char magic[4];
+		uint32_t version;
+		uint64_t key;
+		uint32_t width;
+		uint32_t height;
+		uint32_t format;
+		uint32_t regionCount;
+		uint32_t textureCount;
+		uint32_t reserved;
+		uint64_t pixelBytes;
+	};
+
+	const char MAGIC[4] = {'C', 'H', 'M', 'A'};
+	constexpr size_t BC3_BLOCK_BYTES = 16;
+
+	// FNV-1a, the cache only has to notice that something changed
+	class Hash {
+	private:
+		uint64_t m_Value = 0xcbf29ce484222325ull;
+	public:
+		inline void add(const void* data, size_t size) {
+			const uint8_t* bytes = (const uint8_t*)data;
+			for (size_t i = 0; i < size; i++) m_Value = (m_Value ^ bytes[i]) * 0x100000001b3ull;
+		}
+		inline void add(uint64_t value) { add(&value, sizeof(value)); }
+		inline void add(const std::string& text) {
+			add(text.size());
+			add(text.data(), text.size());
+		}
+		inline uint64_t get() const { return m_Value; }
+	};
+
+	inline int roundUpToBlock(int value) {
+		return (value + TextureAtlas::BLOCK_SIZE - 1) & ~(TextureAtlas::BLOCK_SIZE - 1);
+	}
+
+	bool readFile(const std::string& path, std::vector<uint8_t>& out) {
+		std::ifstream file(path, std::ios::binary);
+		if (!file) return false;
+		out.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		return !file.bad();
+	}
+
+	const char* getFormatName(AtlasFormat format) {
+		return format == AtlasBC3 ? "BC3" : "RGBA8";
+	}
+}
+
+TextureAtlas::TextureAtlas() {
+
+}
+
+TextureAtlas::~TextureAtlas() {
+
+}
+
+void TextureAtlas::clear() {
+	m_Width = 0;
+	m_Height = 0;
+	m_Format = AtlasRGBA8;
+	m_Pixels.clear();
+	m_Regions.clear();
+	m_TextureCount = 0;
+	m_FromCache = false;
+	m_BuildSeconds = 0.0;
+}
+
+bool TextureAtlas::build(const MaterialTable& materials, const std::string& directory, ThreadPool* pool, const AtlasSettings& settings) {
+	PROFILE_SCOPE("TextureAtlas::build");
+	const auto start = std::chrono::steady_clock::now();
+	clear();
+	m_Regions.assign(materials.getCount(), AtlasRegion{0, 0, 0, 0});
+
+	// one source per distinct file, materials may share a texture
+	std::vector<Source> sources;
+	std::vector<int> sourceOf(materials.getCount(), -1);
+	for (size_t m = 0; m < materials.getCount(); m++) {
+		const std::string& texture = materials.getTexture((MaterialID)m);
+		if (texture.empty()) continue;
+		const std::string path = directory.empty() ? texture : directory + "/" + texture;
+		auto found = std::find_if(sources.begin(), sources.end(), [&](const Source& s) { return s.path == path; });
+		sourceOf[m] = (int)(found - sources.begin());
+		if (found == sources.end()) sources.push_back(Source{path, {}, nullptr, 0, 0, 0, 0, 0, 0});
+	}
+	if (sources.empty()) return true;
+
+	auto read = [&](size_t i) { readFile(sources[i].path, sources[i].bytes); };
+	if (pool) {
+		pool->parallelFor(sources.size(), read);
+	} else {
+		for (size_t i = 0; i < sources.size(); i++) read(i);
+	}
+
+	// everything the packed result depends on, so the cache is rebuilt whenever any of it changes
+	Hash hash;
+	hash.add(VERSION);
+	hash.add(settings.compress ? 1 : 0);
+	hash.add((uint64_t)settings.maxSize);
+	hash.add(materials.getCount());
+	for (int source : sourceOf) hash.add((uint64_t)(int64_t)source);
+	for (const Source& source : sources) {
+		hash.add(source.path);
+		hash.add(source.bytes.size());
+		hash.add(source.bytes.data(), source.bytes.size());
+	}
+	const uint64_t key = hash.get();
+
+	if (!settings.cachePath.empty() && loadCache(settings.cachePath, key)) {
+		m_FromCache = true;
+		m_BuildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		spdlog::info("Loaded a {}x{} {} texture atlas of {} textures from {} in {:.3f} ms",
+			m_Width, m_Height, getFormatName(m_Format), m_TextureCount, settings.cachePath, m_BuildSeconds * 1000.0);
+		return true;
+	}
+
+	{
+		PROFILE_SCOPE("decode");
+		auto decode = [&](size_t i) {
+			Source& source = sources[i];
+			if (source.bytes.empty()) return;
+			int channels;
+			source.pixels = stbi_load_from_memory(source.bytes.data(), (int)source.bytes.size(), &source.width, &source.height, &channels, 4);
+			source.packedWidth = roundUpToBlock(source.width);
+			source.packedHeight = roundUpToBlock(source.height);
+		};
+		if (pool) {
+			pool->parallelFor(sources.size(), decode);
+		} else {
+			for (size_t i = 0; i < sources.size(); i++) decode(i);
+		}
+	}
+
+	for (Source& source : sources) {
+		if (source.bytes.empty()) {
+			spdlog::error("Could not read texture {}", source.path);
+		} else if (!source.pixels) {
+			spdlog::error("Could not decode texture {}", source.path);
+		} else if (source.width > settings.maxSize || source.height > settings.maxSize) {
+			spdlog::error("Texture {} is {}x{}, larger than the atlas can be", source.path, source.width, source.height);
+			stbi_image_free(source.pixels);
+			source.pixels = nullptr;
+		}
+	}
+
+	const bool packed = pack(sources, settings.maxSize);
+	if (packed) {
+		// rows flipped to run bottom to top, and the padding up to whole blocks wraps around
+		// so the texture stays tileable into it
+		m_Pixels.assign((size_t)m_Width * m_Height * 4, 0);
+		for (const Source& source : sources) {
+			if (!source.pixels) continue;
+			for (int y = 0; y < source.packedHeight; y++) {
+				const uint8_t* row = source.pixels + (size_t)(source.height - 1 - y % source.height) * source.width * 4;
+				uint8_t* out = m_Pixels.data() + ((size_t)(source.y + y) * m_Width + source.x) * 4;
+				for (int x = 0; x < source.packedWidth; x++) std::memcpy(out + x * 4, row + (x % source.width) * 4, 4);
+			}
+		}
+		for (size_t m = 0; m < sourceOf.size(); m++) {
+			if (sourceOf[m] < 0) continue;
+			const Source& source = sources[sourceOf[m]];
+			if (!source.pixels) continue;
+			m_Regions[m] = AtlasRegion{(uint16_t)source.x, (uint16_t)source.y, (uint16_t)source.width, (uint16_t)source.height};
+		}
+	} else {
+		spdlog::error("The material textures don't fit in a {}x{} atlas", settings.maxSize, settings.maxSize);
+	}
+	for (Source& source : sources) stbi_image_free(source.pixels);
+
+	if (!packed) {
+		clear();
+		return false;
+	}
+	if (m_TextureCount == 0) {
+		clear();
+		m_Regions.assign(materials.getCount(), AtlasRegion{0, 0, 0, 0});
+		return true;
+	}
+
+	if (settings.compress) compress(pool);
+	if (!settings.cachePath.empty()) saveCache(settings.cachePath, key);
+
+	m_BuildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	spdlog::info("Built a {}x{} {} texture atlas of {} textures in {:.3f} ms",
+		m_Width, m_Height, getFormatName(m_Format), m_TextureCount, m_BuildSeconds * 1000.0);
+	return true;
+}
+
+// Packs in whole blocks, so every texture lands on a block boundary. The atlas starts at the
+// smallest power of two square that could hold them all and doubles its shorter side until
+// they fit.
+bool TextureAtlas::pack(std::vector<Source>& sources, int maxSize) {
+	std::vector<stbrp_rect> rects;
+	size_t area = 0;
+	int width = BLOCK_SIZE, height = BLOCK_SIZE;
+	for (size_t i = 0; i < sources.size(); i++) {
+		const Source& source = sources[i];
+		if (!source.pixels) continue;
+		stbrp_rect rect = {};
+		rect.id = (int)i;
+		rect.w = (stbrp_coord)(source.packedWidth / BLOCK_SIZE);
+		rect.h = (stbrp_coord)(source.packedHeight / BLOCK_SIZE);
+		rects.push_back(rect);
+		area += (size_t)source.packedWidth * source.packedHeight;
+		while (width < source.packedWidth) width *= 2;
+		while (height < source.packedHeight) height *= 2;
+	}
+	m_TextureCount = rects.size();
+	if (rects.empty()) return true;
+	while ((size_t)width * height < area) {
+		if (width <= height) width *= 2;
+		else height *= 2;
+	}
+
+	std::vector<stbrp_node> nodes;
+	for (;;) {
+		if (width > maxSize || height > maxSize) return false;
+		const int columns = width / BLOCK_SIZE;
+		nodes.resize(columns);
+		stbrp_context context;
+		stbrp_init_target(&context, columns, height / BLOCK_SIZE, nodes.data(), columns);
+		if (stbrp_pack_rects(&context, rects.data(), (int)rects.size())) break;
+		if (width <= height) width *= 2;
+		else height *= 2;
+	}
+
+	for (const stbrp_rect& rect : rects) {
+		sources[rect.id].x = rect.x * BLOCK_SIZE;
+		sources[rect.id].y = rect.y * BLOCK_SIZE;
+	}
+	m_Width = width;
+	m_Height = height;
+	return true;
+}
+
+void TextureAtlas::compress(ThreadPool* pool) {
+	PROFILE_SCOPE("compress");
+	const int columns = m_Width / BLOCK_SIZE;
+	const int rows = m_Height / BLOCK_SIZE;
+	std::vector<uint8_t> blocks((size_t)columns * rows * BC3_BLOCK_BYTES);
+
+	auto compressRow = [&](size_t row) {
+		uint8_t block[BLOCK_SIZE * BLOCK_SIZE * 4];
+		for (int column = 0; column < columns; column++) {
+			for (int y = 0; y < BLOCK_SIZE; y++) {
+				std::memcpy(block + y * BLOCK_SIZE * 4, m_Pixels.data() + (((size_t)row * BLOCK_SIZE + y) * m_Width + (size_t)column * BLOCK_SIZE) * 4, BLOCK_SIZE * 4);
+			}
+			stb_compress_dxt_block(blocks.data() + (row * columns + column) * BC3_BLOCK_BYTES, block, 1, STB_DXT_HIGHQUAL);
+		}
+	};
+
+	// stb_dxt fills its tables on first use without a lock, so the first row goes before the rest
+	compressRow(0);
+	if (pool) {
+		pool->parallelFor((size_t)rows - 1, [&](size_t row) { compressRow(row + 1); });
+	} else {
+		for (int row = 1; row < rows; row++) compressRow((size_t)row);
+	}
+
+	m_Pixels.swap(blocks);
+	m_Format = AtlasBC3;
+}
+
+bool TextureAtlas::loadCache(const std::string& path, uint64_t key) {
+	FILE* file = std::fopen(path.c_str(), "rb");
+	if (!file) return false;
+
+	CacheHeader header;
+	bool ok = std::fread(&header, sizeof(header), 1, file) == 1
+		&& std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0
+		&& header.version == VERSION && header.key == key
+		&& header.regionCount == m_Regions.size()
+		&& header.width > 0 && header.height > 0 && header.format <= AtlasBC3;
+	if (ok) {
+		const uint64_t pixels = header.format == AtlasBC3
+			? (uint64_t)(header.width / BLOCK_SIZE) * (header.height / BLOCK_SIZE) * BC3_BLOCK_BYTES
+			: (uint64_t)header.width * header.height * 4;
+		ok = header.pixelBytes == pixels;
+	}
+	if (ok) {
+		m_Pixels.resize((size_t)header.pixelBytes);
+		ok = std::fread(m_Regions.data(), sizeof(AtlasRegion), m_Regions.size(), file) == m_Regions.size()
+			&& std::fread(m_Pixels.data(), 1, m_Pixels.size(), file) == m_Pixels.size();
+	}
+	std::fclose(file);
+
+	if (!ok) {
+		// stale or damaged, rebuilt and overwritten
+		m_Pixels.clear();
+		std::fill(m_Regions.begin(), m_Regions.end(), AtlasRegion{0, 0, 0, 0});
+		return false;
+	}
+	m_Width = (int)header.width;
+	m_Height = (int)header.height;
+	m_Format = (AtlasFormat)header.format;
+	m_TextureCount = header.textureCount;
+	return true;
+}
+
+bool TextureAtlas::saveCache(const std::string& path, uint64_t key) const {
+	const std::string temporary = path + ".tmp";
+	FILE* file = std::fopen(temporary.c_str(), "wb");
+	if (!file) {
+		spdlog::error("Could not open {} for writing", temporary);
+		return false;
+	}
+
+	CacheHeader header;
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.key = key;
+	header.width = (uint32_t)m_Width;
+	header.height = (uint32_t)m_Height;
+	header.format = m_Format;
+	header.regionCount = (uint32_t)m_Regions.size();
+	header.textureCount = (uint32_t)m_TextureCount;
+	header.reserved = 0;
+	header.pixelBytes = m_Pixels.size();
+
+	bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1
+		&& std::fwrite(m_Regions.data(), sizeof(AtlasRegion), m_Regions.size(), file) == m_Regions.size()
+		&& std::fwrite(m_Pixels.data(), 1, m_Pixels.size(), file) == m_Pixels.size();
+	ok = (std::fclose(file) == 0) && ok;
+
+	if (ok && std::rename(temporary.c_str(), path.c_str()) != 0) {
+		// windows won't rename over an existing file
+		std::remove(path.c_str());
+		ok = std::rename(temporary.c_str(), path.c_str()) == 0;
+	}
+	if (!ok) {
+		spdlog::error("Could not write the texture atlas cache {}", path);
+		std::remove(temporary.c_str());
+		return false;
+	}
+	return true;
+}
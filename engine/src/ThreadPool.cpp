@@ -0,0 +1,171 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <string>
+
+#include "Profiler.h"
+
+namespace {
+	thread_local const ThreadPool* t_Pool = nullptr;
+	thread_local unsigned t_QueueIndex = 0;
+}
+
+void ThreadPool::WorkQueue::pushBack(const Task& task) {
+	if (count == tasks.size()) {
+		std::vector<Task> grown(std::max<size_t>(16, tasks.size() * 2));
+		for (size_t i = 0; i < count; i++) grown[i] = tasks[(head + i) % tasks.size()];
+		tasks.swap(grown);
+		head = 0;
+	}
+	tasks[(head + count) % tasks.size()] = task;
+	count++;
+}
+
+bool ThreadPool::WorkQueue::popBack(Task& out) {
+	if (count == 0) return false;
+	count--;
+	out = tasks[(head + count) % tasks.size()];
+	return true;
+}
+
+bool ThreadPool::WorkQueue::popFront(Task& out) {
+	if (count == 0) return false;
+	out = tasks[head];
+	head = (head + 1) % tasks.size();
+	count--;
+	return true;
+}
+
+ThreadPool::ThreadPool(unsigned threads) {
+	threads = std::max(threads, 1u);
+	for (unsigned i = 0; i < threads; i++) m_Queues.emplace_back(new WorkQueue);
+	for (unsigned i = 1; i < threads; i++) m_Threads.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+	waitIdle();
+	{
+		std::lock_guard<std::mutex> lock(m_SleepMutex);
+		m_Stopping = true;
+	}
+	m_WakeCondition.notify_all();
+	for (std::thread& thread : m_Threads) thread.join();
+}
+
+void ThreadPool::workerLoop(unsigned index) {
+	t_Pool = this;
+	t_QueueIndex = index;
+	PROFILE_THREAD("worker " + std::to_string(index));
+
+	while (true) {
+		if (tryRunTask(index)) continue;
+
+		std::unique_lock<std::mutex> lock(m_SleepMutex);
+		m_Sleepers.fetch_add(1);
+		m_WakeCondition.wait(lock, [this] { return m_Stopping || m_Queued.load() > 0; });
+		m_Sleepers.fetch_sub(1);
+		if (m_Stopping && m_Queued.load() == 0) return;
+	}
+}
+
+unsigned ThreadPool::currentQueue() const {
+	return t_Pool == this ? t_QueueIndex : 0;
+}
+
+void ThreadPool::push(unsigned queue, const Task& task) {
+	m_Unfinished.fetch_add(1, std::memory_order_relaxed);
+	{
+		WorkQueue& q = *m_Queues[queue];
+		std::lock_guard<std::mutex> lock(q.mutex);
+		q.pushBack(task);
+	}
+	m_Queued.fetch_add(1);
+}
+
+void ThreadPool::wake(bool all) {
+	if (m_Sleepers.load() == 0) return;
+	// a worker between checking m_Queued and waiting holds the mutex, so this waits it out
+	{
+		std::lock_guard<std::mutex> lock(m_SleepMutex);
+	}
+	if (all) m_WakeCondition.notify_all();
+	else m_WakeCondition.notify_one();
+}
+
+bool ThreadPool::tryRunTask(unsigned self) {
+	Task task;
+	bool found = false;
+	{
+		WorkQueue& own = *m_Queues[self];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		found = own.popBack(task);
+	}
+	for (size_t i = 1; !found && i < m_Queues.size(); i++) {
+		WorkQueue& victim = *m_Queues[(self + i) % m_Queues.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		found = victim.popFront(task);
+	}
+	if (!found) return false;
+
+	m_Queued.fetch_sub(1, std::memory_order_relaxed);
+	runTask(task);
+	return true;
+}
+
+void ThreadPool::runTask(const Task& task) {
+	PROFILE_SCOPE("ThreadPool task");
+	task.run(task.context, task.begin, task.end);
+	if (task.remaining) task.remaining->fetch_sub(1, std::memory_order_release);
+	m_Unfinished.fetch_sub(1, std::memory_order_release);
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+	Task t;
+	t.run = [](void* context, size_t, size_t) {
+		std::unique_ptr<std::function<void()>> fn(static_cast<std::function<void()>*>(context));
+		(*fn)();
+	};
+	t.context = new std::function<void()>(std::move(task));
+	t.begin = 0;
+	t.end = 0;
+	t.remaining = nullptr;
+
+	unsigned queue = t_Pool == this ? t_QueueIndex : m_NextQueue.fetch_add(1, std::memory_order_relaxed) % m_Queues.size();
+	push(queue, t);
+	wake(false);
+}
+
+void ThreadPool::dispatch(size_t count, void (*run)(void*, size_t, size_t), void* context) {
+	if (count == 0) return;
+	if (m_Queues.size() == 1 || count == 1) {
+		run(context, 0, count);
+		return;
+	}
+
+	// a few batches per thread so stealing can even out uneven items
+	const size_t batches = std::min(count, m_Queues.size() * 4);
+	std::atomic<size_t> remaining{batches};
+
+	const unsigned self = currentQueue();
+	for (size_t b = 0; b < batches; b++) {
+		Task task;
+		task.run = run;
+		task.context = context;
+		task.begin = count * b / batches;
+		task.end = count * (b + 1) / batches;
+		task.remaining = &remaining;
+		push((unsigned)((self + b) % m_Queues.size()), task);
+	}
+	wake(true);
+
+	while (remaining.load(std::memory_order_acquire) > 0) {
+		if (!tryRunTask(self)) std::this_thread::yield();
+	}
+}
+
+void ThreadPool::waitIdle() {
+	const unsigned self = currentQueue();
+	while (m_Unfinished.load(std::memory_order_acquire) > 0) {
+		if (!tryRunTask(self)) std::this_thread::yield();
+	}
+}
@@ -0,0 +1,106 @@
+#include "World.h"
+
+#include <algorithm>
+
+namespace {
+	constexpr int NEIGHBOUR_OFFSETS[NeighbourCount][2] = {
+		{-1, 0}, {1, 0}, {0, -1}, {0, 1},
+		{-1, -1}, {1, -1}, {-1, 1}, {1, 1}
+	};
+
+	// index of the link pointing back at us from the neighbour in direction n
+	constexpr ChunkNeighbour OPPOSITE[NeighbourCount] = {
+		NeighbourRight, NeighbourLeft, NeighbourUp, NeighbourDown,
+		NeighbourUpRight, NeighbourUpLeft, NeighbourDownRight, NeighbourDownLeft
+	};
+}
+
+World::World() {
+
+}
+
+World::~World() {
+	clear();
+}
+
+Chunk* World::getChunk(int chunkX, int chunkY) const {
+	auto it = m_Chunks.find(chunkKey(chunkX, chunkY));
+	return it == m_Chunks.end() ? nullptr : it->second.get();
+}
+
+Chunk* World::getOrCreateChunk(int chunkX, int chunkY) {
+	std::unique_ptr<Chunk>& slot = m_Chunks[chunkKey(chunkX, chunkY)];
+	if (!slot) {
+		slot.reset(new Chunk(chunkX, chunkY, m_CellPool));
+		slot->m_Serial = m_NextSerial++;
+		m_ChunkList.push_back(slot.get());
+		linkNeighbours(slot.get());
+		m_AwakeChunks++;
+		if (m_Loader) m_Loader->loadChunk(*slot);
+	}
+	return slot.get();
+}
+
+void World::removeChunk(int chunkX, int chunkY) {
+	auto it = m_Chunks.find(chunkKey(chunkX, chunkY));
+	if (it == m_Chunks.end()) return;
+
+	Chunk* chunk = it->second.get();
+	if (chunk->isAwake()) m_AwakeChunks--;
+	unlinkNeighbours(chunk);
+	m_ChunkList.erase(std::find(m_ChunkList.begin(), m_ChunkList.end(), chunk));
+	m_Chunks.erase(it);
+}
+
+void World::clear() {
+	m_ChunkList.clear();
+	m_Chunks.clear();
+	m_AwakeChunks = 0;
+}
+
+void World::linkNeighbours(Chunk* chunk) {
+	for (int n = 0; n < NeighbourCount; n++) {
+		Chunk* other = getChunk(chunk->m_ChunkX + NEIGHBOUR_OFFSETS[n][0], chunk->m_ChunkY + NEIGHBOUR_OFFSETS[n][1]);
+		chunk->m_Neighbours[n] = other;
+		if (other) other->m_Neighbours[OPPOSITE[n]] = chunk;
+	}
+}
+
+void World::unlinkNeighbours(Chunk* chunk) {
+	for (int n = 0; n < NeighbourCount; n++) {
+		Chunk* other = chunk->m_Neighbours[n];
+		if (other) other->m_Neighbours[OPPOSITE[n]] = nullptr;
+		chunk->m_Neighbours[n] = nullptr;
+	}
+}
+
+MaterialID World::getMaterial(int x, int y) const {
+	Chunk* chunk = getChunkAt(x, y);
+	return chunk ? chunk->getMaterial(toLocalCoord(x), toLocalCoord(y)) : 0;
+}
+
+float World::getTemperature(int x, int y) const {
+	Chunk* chunk = getChunkAt(x, y);
+	return chunk ? chunk->getTemperature(toLocalCoord(x), toLocalCoord(y)) : AMBIENT_TEMPERATURE;
+}
+
+void World::setMaterial(int x, int y, MaterialID material) {
+	getOrCreateChunk(toChunkCoord(x), toChunkCoord(y))->setMaterial(toLocalCoord(x), toLocalCoord(y), material);
+}
+
+void World::setTemperature(int x, int y, float temperature) {
+	getOrCreateChunk(toChunkCoord(x), toChunkCoord(y))->setTemperature(toLocalCoord(x), toLocalCoord(y), temperature);
+}
+
+size_t World::swapDirtyRects() {
+	size_t awake = 0;
+	for (Chunk* chunk : m_ChunkList) {
+		if (chunk->swapDirty()) awake++;
+	}
+	m_AwakeChunks = awake;
+	return awake;
+}
+
+size_t World::getMemoryUsage() const {
+	return m_ChunkList.size() * sizeof(Chunk) + m_CellPool.getMemoryUsage();
+}
@@ -0,0 +1,467 @@
+#include "WorldFile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace {
+	struct FileHeader {
+		char magic[4];
+		uint32_t version;
+		uint32_t chunkSize;
+		uint32_t chunkCount;
+	};
+
+	enum PlaneEncoding : uint8_t {
+		EncodingRaw = 0,
+		EncodingRuns,    // (uint16 length, value) pairs
+		EncodingPalette  // uint16 palette size, the palette, then 1, 2, 4 or 8 bit indices
+	};
+
+	struct ChunkHeader {
+		uint8_t encoding[3]; // material, temperature, flags
+		uint8_t reserved;
+		uint32_t size[3];
+	};
+
+	const char MAGIC[4] = {'C', 'H', 'M', 'W'};
+
+	// only the anchoring flag outlives a tick, the rest is rebuilt by the simulation
+	constexpr uint8_t SAVED_FLAGS = CellStatic;
+
+	template<typename T> void append(std::vector<uint8_t>& out, const T& value) {
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+		out.insert(out.end(), bytes, bytes + sizeof(T));
+	}
+
+	template<typename T> void encodeRuns(const T* plane, std::vector<uint8_t>& out) {
+		int i = 0;
+		while (i < CHUNK_CELLS) {
+			int end = i + 1;
+			while (end < CHUNK_CELLS && std::memcmp(&plane[end], &plane[i], sizeof(T)) == 0) end++;
+			append(out, (uint16_t)(end - i));
+			append(out, plane[i]);
+			i = end;
+		}
+	}
+
+	template<typename T> bool decodeRuns(const uint8_t* data, size_t size, T* plane) {
+		int cell = 0;
+		size_t at = 0;
+		while (cell < CHUNK_CELLS) {
+			if (at + sizeof(uint16_t) + sizeof(T) > size) return false;
+			uint16_t length;
+			T value;
+			std::memcpy(&length, data + at, sizeof(length));
+			std::memcpy(&value, data + at + sizeof(length), sizeof(T));
+			at += sizeof(length) + sizeof(T);
+			if (length == 0 || cell + length > CHUNK_CELLS) return false;
+			std::fill_n(plane + cell, length, value);
+			cell += length;
+		}
+		return at == size;
+	}
+
+	bool encodePalette(const MaterialID* plane, std::vector<uint8_t>& out) {
+		std::vector<MaterialID> palette(plane, plane + CHUNK_CELLS);
+		std::sort(palette.begin(), palette.end());
+		palette.erase(std::unique(palette.begin(), palette.end()), palette.end());
+		if (palette.size() > 256) return false;
+
+		int bits = 1;
+		while ((1u << bits) < palette.size()) bits *= 2;
+
+		append(out, (uint16_t)palette.size());
+		for (MaterialID material : palette) append(out, material);
+
+		const size_t start = out.size();
+		out.resize(start + CHUNK_CELLS * bits / 8, 0);
+		for (int i = 0; i < CHUNK_CELLS; i++) {
+			const size_t index = std::lower_bound(palette.begin(), palette.end(), plane[i]) - palette.begin();
+			const int bit = i * bits;
+			out[start + bit / 8] |= (uint8_t)(index << (bit % 8));
+		}
+		return true;
+	}
+
+	bool decodePalette(const uint8_t* data, size_t size, MaterialID* plane) {
+		uint16_t count;
+		if (size < sizeof(count)) return false;
+		std::memcpy(&count, data, sizeof(count));
+		if (count == 0 || count > 256) return false;
+
+		int bits = 1;
+		while ((1u << bits) < count) bits *= 2;
+
+		MaterialID palette[256];
+		const size_t paletteBytes = count * sizeof(MaterialID);
+		if (size != sizeof(count) + paletteBytes + CHUNK_CELLS * bits / 8) return false;
+		std::memcpy(palette, data + sizeof(count), paletteBytes);
+
+		const uint8_t* indices = data + sizeof(count) + paletteBytes;
+		const unsigned mask = (1u << bits) - 1;
+		for (int i = 0; i < CHUNK_CELLS; i++) {
+			const int bit = i * bits;
+			const unsigned index = (indices[bit / 8] >> (bit % 8)) & mask;
+			if (index >= count) return false;
+			plane[i] = palette[index];
+		}
+		return true;
+	}
+
+	// picks the smallest of the encodings tried
+	template<typename T> uint8_t encodePlane(const T* plane, std::vector<uint8_t>& out, std::vector<uint8_t>& scratch, bool tryPalette) {
+		const size_t start = out.size();
+		uint8_t encoding = EncodingRuns;
+		encodeRuns(plane, out);
+
+		if constexpr (sizeof(T) == sizeof(MaterialID)) {
+			scratch.clear();
+			if (tryPalette && encodePalette(reinterpret_cast<const MaterialID*>(plane), scratch) && scratch.size() < out.size() - start) {
+				out.resize(start);
+				out.insert(out.end(), scratch.begin(), scratch.end());
+				encoding = EncodingPalette;
+			}
+		}
+
+		if (out.size() - start > CHUNK_CELLS * sizeof(T)) {
+			out.resize(start);
+			const uint8_t* bytes = reinterpret_cast<const uint8_t*>(plane);
+			out.insert(out.end(), bytes, bytes + CHUNK_CELLS * sizeof(T));
+			encoding = EncodingRaw;
+		}
+		return encoding;
+	}
+
+	template<typename T> bool decodePlane(uint8_t encoding, const uint8_t* data, size_t size, T* plane) {
+		switch (encoding) {
+			case EncodingRaw:
+				if (size != CHUNK_CELLS * sizeof(T)) return false;
+				std::memcpy(plane, data, size);
+				return true;
+			case EncodingRuns:
+				return decodeRuns(data, size, plane);
+			case EncodingPalette:
+				if constexpr (sizeof(T) == sizeof(MaterialID)) return decodePalette(data, size, reinterpret_cast<MaterialID*>(plane));
+				return false;
+			default:
+				return false;
+		}
+	}
+
+	void encodeChunk(const Chunk& chunk, std::vector<uint8_t>& out, std::vector<uint8_t>& scratch) {
+		uint8_t flags[CHUNK_CELLS];
+		for (int i = 0; i < CHUNK_CELLS; i++) flags[i] = chunk.getFlags()[i] & SAVED_FLAGS;
+
+		out.clear();
+		out.resize(sizeof(ChunkHeader));
+		ChunkHeader header = {};
+
+		size_t start = out.size();
+		header.encoding[0] = encodePlane(chunk.getMaterials(), out, scratch, true);
+		header.size[0] = (uint32_t)(out.size() - start);
+
+		start = out.size();
+		header.encoding[1] = encodePlane(chunk.getTemperatures(), out, scratch, false);
+		header.size[1] = (uint32_t)(out.size() - start);
+
+		start = out.size();
+		header.encoding[2] = encodePlane(flags, out, scratch, false);
+		header.size[2] = (uint32_t)(out.size() - start);
+
+		std::memcpy(out.data(), &header, sizeof(header));
+	}
+}
+
+WorldFile::WorldFile() {
+
+}
+
+WorldFile::~WorldFile() {
+	close();
+}
+
+bool WorldFile::save(const World& world, const std::string& path, const WorldFile* source) {
+	std::vector<uint64_t> keys;
+	keys.reserve(world.getChunkCount() + (source ? source->getChunkCount() : 0));
+	for (const Chunk* chunk : world.getChunks()) keys.push_back(World::chunkKey(chunk->getChunkX(), chunk->getChunkY()));
+	if (source && source->isOpen()) {
+		for (uint32_t i = 0; i < source->m_ChunkCount; i++) keys.push_back(source->m_Index[i].key);
+	}
+	std::sort(keys.begin(), keys.end());
+	keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+	const std::string temporary = path + ".tmp";
+	FILE* file = std::fopen(temporary.c_str(), "wb");
+	if (!file) {
+		spdlog::error("Could not open {} for writing", temporary);
+		return false;
+	}
+
+	FileHeader header;
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.chunkSize = CHUNK_SIZE;
+	header.chunkCount = (uint32_t)keys.size();
+
+	// the index is written again once the offsets are known
+	std::vector<IndexEntry> index(keys.size());
+	bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+	ok = ok && (index.empty() || std::fwrite(index.data(), sizeof(IndexEntry), index.size(), file) == index.size());
+
+	uint64_t offset = sizeof(header) + index.size() * sizeof(IndexEntry);
+	std::vector<uint8_t> encoded;
+	std::vector<uint8_t> scratch;
+	for (size_t i = 0; ok && i < keys.size(); i++) {
+		const Chunk* chunk = world.getChunk((int)(uint32_t)(keys[i] >> 32), (int)(uint32_t)keys[i]);
+		const uint8_t* data;
+		size_t size;
+		if (chunk) {
+			encodeChunk(*chunk, encoded, scratch);
+			data = encoded.data();
+			size = encoded.size();
+		} else {
+			const IndexEntry* entry = source->find(keys[i]);
+			data = source->m_Data + entry->offset;
+			size = entry->size;
+		}
+
+		index[i] = IndexEntry{keys[i], offset, (uint32_t)size, 0};
+		ok = std::fwrite(data, 1, size, file) == size;
+		offset += size;
+	}
+
+	ok = ok && std::fseek(file, sizeof(header), SEEK_SET) == 0;
+	ok = ok && (index.empty() || std::fwrite(index.data(), sizeof(IndexEntry), index.size(), file) == index.size());
+	ok = (std::fclose(file) == 0) && ok;
+
+	if (ok && std::rename(temporary.c_str(), path.c_str()) != 0) {
+		// windows won't rename over an existing file
+		std::remove(path.c_str());
+		ok = std::rename(temporary.c_str(), path.c_str()) == 0;
+	}
+	if (!ok) {
+		spdlog::error("Could not write world file {}", path);
+		std::remove(temporary.c_str());
+		return false;
+	}
+
+	spdlog::info("Saved {} chunks to {}, {} bytes", keys.size(), path, offset);
+	return true;
+}
+
+bool WorldFile::open(const std::string& path) {
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		spdlog::error("Could not open world file {}", path);
+		return false;
+	}
+	LARGE_INTEGER size;
+	HANDLE mapping = NULL;
+	if (GetFileSizeEx(file, &size) && size.QuadPart > 0) mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	const void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (!data) {
+		if (mapping) CloseHandle(mapping);
+		CloseHandle(file);
+		spdlog::error("Could not map world file {}", path);
+		return false;
+	}
+	m_FileHandle = file;
+	m_MappingHandle = mapping;
+	m_Size = (size_t)size.QuadPart;
+#else
+	const int file = ::open(path.c_str(), O_RDONLY);
+	if (file < 0) {
+		spdlog::error("Could not open world file {}", path);
+		return false;
+	}
+	struct stat info;
+	void* data = MAP_FAILED;
+	if (fstat(file, &info) == 0 && info.st_size > 0) data = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	::close(file); // the mapping keeps the file alive
+	if (data == MAP_FAILED) {
+		spdlog::error("Could not map world file {}", path);
+		return false;
+	}
+	m_Size = (size_t)info.st_size;
+#endif
+	m_Data = static_cast<const uint8_t*>(data);
+	m_Path = path;
+
+	FileHeader header;
+	if (m_Size < sizeof(header)) {
+		spdlog::error("{} is not a world file", path);
+		close();
+		return false;
+	}
+	std::memcpy(&header, m_Data, sizeof(header));
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION || header.chunkSize != (uint32_t)CHUNK_SIZE) {
+		spdlog::error("{} is not a version {} world file with {} cell chunks", path, VERSION, CHUNK_SIZE);
+		close();
+		return false;
+	}
+	if (m_Size < sizeof(header) + (uint64_t)header.chunkCount * sizeof(IndexEntry)) {
+		spdlog::error("{} is truncated", path);
+		close();
+		return false;
+	}
+
+	m_Index = reinterpret_cast<const IndexEntry*>(m_Data + sizeof(header));
+	m_ChunkCount = header.chunkCount;
+	return true;
+}
+
+void WorldFile::close() {
+	if (m_Data) {
+#ifdef _WIN32
+		UnmapViewOfFile(m_Data);
+		CloseHandle(m_MappingHandle);
+		CloseHandle(m_FileHandle);
+		m_MappingHandle = nullptr;
+		m_FileHandle = nullptr;
+#else
+		munmap(const_cast<uint8_t*>(m_Data), m_Size);
+#endif
+	}
+	m_Data = nullptr;
+	m_Size = 0;
+	m_Index = nullptr;
+	m_ChunkCount = 0;
+	m_Loaded.clear();
+	m_Path.clear();
+}
+
+const WorldFile::IndexEntry* WorldFile::find(uint64_t key) const {
+	const IndexEntry* end = m_Index + m_ChunkCount;
+	const IndexEntry* entry = std::lower_bound(m_Index, end, key, [](const IndexEntry& e, uint64_t k) { return e.key < k; });
+	return entry != end && entry->key == key ? entry : nullptr;
+}
+
+bool WorldFile::contains(int chunkX, int chunkY) const {
+	return isOpen() && find(World::chunkKey(chunkX, chunkY)) != nullptr;
+}
+
+bool WorldFile::decode(const IndexEntry& entry, MaterialID* materials, float* temperatures, uint8_t* flags) const {
+	ChunkHeader header;
+	if (entry.offset + entry.size > m_Size || entry.size < sizeof(header)) return false;
+	const uint8_t* data = m_Data + entry.offset;
+	std::memcpy(&header, data, sizeof(header));
+	if ((uint64_t)sizeof(header) + header.size[0] + header.size[1] + header.size[2] != entry.size) return false;
+
+	const uint8_t* material = data + sizeof(header);
+	const uint8_t* temperature = material + header.size[0];
+	const uint8_t* flag = temperature + header.size[1];
+	return decodePlane(header.encoding[0], material, header.size[0], materials)
+		&& decodePlane(header.encoding[1], temperature, header.size[1], temperatures)
+		&& decodePlane(header.encoding[2], flag, header.size[2], flags);
+}
+
+bool WorldFile::matchesFile(const IndexEntry& entry, const Chunk& chunk) {
+	m_FileMaterials.resize(CHUNK_CELLS);
+	m_FileTemperatures.resize(CHUNK_CELLS);
+	m_FileFlags.resize(CHUNK_CELLS);
+	if (!decode(entry, m_FileMaterials.data(), m_FileTemperatures.data(), m_FileFlags.data())) return false;
+
+	if (std::memcmp(m_FileMaterials.data(), chunk.getMaterials(), CHUNK_CELLS * sizeof(MaterialID)) != 0) return false;
+	if (std::memcmp(m_FileTemperatures.data(), chunk.getTemperatures(), CHUNK_CELLS * sizeof(float)) != 0) return false;
+	for (int i = 0; i < CHUNK_CELLS; i++) {
+		if (m_FileFlags[i] != (chunk.getFlags()[i] & SAVED_FLAGS)) return false;
+	}
+	return true;
+}
+
+bool WorldFile::loadChunk(Chunk& chunk) {
+	if (!isOpen()) return false;
+	const uint64_t key = World::chunkKey(chunk.getChunkX(), chunk.getChunkY());
+	const IndexEntry* entry = find(key);
+	if (!entry) return false;
+
+	if (!decode(*entry, chunk.getMaterials(), chunk.getTemperatures(), chunk.getFlags())) {
+		spdlog::error("{}: chunk {}, {} is corrupt", m_Path, chunk.getChunkX(), chunk.getChunkY());
+		chunk.clear(0, AMBIENT_TEMPERATURE);
+		return false;
+	}
+	std::fill_n(chunk.getVelocitiesX(), CHUNK_CELLS, 0);
+	std::fill_n(chunk.getVelocitiesY(), CHUNK_CELLS, 0);
+
+	// wake the chunk and, through its border cells, whatever settled against it while it was
+	// missing (a missing chunk acts as a wall)
+	chunk.markAllDirty();
+	for (int i = 0; i < CHUNK_SIZE; i++) {
+		chunk.markDirty(0, i);
+		chunk.markDirty(CHUNK_SIZE - 1, i);
+		chunk.markDirty(i, 0);
+		chunk.markDirty(i, CHUNK_SIZE - 1);
+	}
+	chunk.wakeThermal();
+
+	// the wake-up above bumps the revision once, the chunk is as stored until it moves further
+	m_Loaded[key] = LoadedChunk{chunk.getSerial(), chunk.getRevision() + 1, false};
+	return true;
+}
+
+size_t WorldFile::loadRegion(World& world, int minChunkX, int minChunkY, int maxChunkX, int maxChunkY) {
+	if (!isOpen()) return 0;
+
+	size_t loaded = 0;
+	for (int cy = minChunkY; cy <= maxChunkY; cy++) {
+		for (int cx = minChunkX; cx <= maxChunkX; cx++) {
+			if (world.getChunk(cx, cy) || !find(World::chunkKey(cx, cy))) continue;
+			Chunk* chunk = world.getOrCreateChunk(cx, cy);
+			if (world.getChunkLoader() != this) loadChunk(*chunk);
+			loaded++;
+		}
+	}
+	return loaded;
+}
+
+size_t WorldFile::unloadOutside(World& world, int minChunkX, int minChunkY, int maxChunkX, int maxChunkY) {
+	std::vector<const Chunk*> outside;
+	for (const Chunk* chunk : world.getChunks()) {
+		if (chunk->getChunkX() >= minChunkX && chunk->getChunkX() <= maxChunkX && chunk->getChunkY() >= minChunkY && chunk->getChunkY() <= maxChunkY) continue;
+		outside.push_back(chunk);
+	}
+
+	size_t unloaded = 0;
+	for (const Chunk* chunk : outside) {
+		const uint64_t key = World::chunkKey(chunk->getChunkX(), chunk->getChunkY());
+		auto loaded = m_Loaded.find(key);
+		if (loaded == m_Loaded.end()) continue;
+		if (loaded->second.serial != chunk->getSerial()) {
+			m_Loaded.erase(loaded);
+			continue;
+		}
+		// still moving or still exchanging heat
+		if (chunk->isAwake() || chunk->isThermallyActive()) continue;
+
+		// woken since the last look, only cells that differ from the file keep it
+		LoadedChunk& state = loaded->second;
+		if (chunk->getRevision() != state.revision) {
+			const IndexEntry* entry = find(key);
+			state.revision = chunk->getRevision();
+			state.changed = !entry || !matchesFile(*entry, *chunk);
+		}
+		if (state.changed) continue;
+
+		m_Loaded.erase(loaded);
+		world.removeChunk(chunk->getChunkX(), chunk->getChunkY());
+		unloaded++;
+	}
+	return unloaded;
+}
@@ -0,0 +1,332 @@
+#include "WorldGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include <stb_herringbone_wang_tile.h>
+#include <stb_perlin.h>
+#include <spdlog/spdlog.h>
+
+#include "Profiler.h"
+
+// defined next to the stbhw implementation in vendor/stb/src/stb_herringbone_wang_tile.c
+extern "C" void stbhw_seed_random(unsigned int seed);
+
+namespace {
+	constexpr int CAVE_COLORS = 2;         // per corner: rock or open
+	constexpr int CAVE_TILE_VARIANTS = 2;  // tiles per corner combination, picked at random
+	constexpr float CAVE_TILE_BULGE = 0.4f;
+	constexpr int CAVE_FADE_DEPTH = 48;    // cells over which caves open up below caveDepth
+
+	uint32_t mix(uint32_t a, uint32_t b) {
+		uint32_t h = a * 0x9e3779b9u ^ b;
+		h ^= h >> 16;
+		h *= 0x85ebca6bu;
+		h ^= h >> 13;
+		h *= 0xc2b2ae35u;
+		h ^= h >> 16;
+		return h;
+	}
+
+	// a perlin field placed somewhere of its own for every seed and layer
+	struct NoiseLayer {
+		float frequencyX;
+		float frequencyY;
+		float offsetX;
+		float offsetY;
+		float z;
+		int seed;
+
+		NoiseLayer(uint32_t worldSeed, uint32_t layer, float frequencyX, float frequencyY) : frequencyX{frequencyX}, frequencyY{frequencyY} {
+			const uint32_t h = mix(worldSeed, layer);
+			offsetX = (float)(h & 0xfff);
+			offsetY = (float)(h >> 12 & 0xfff);
+			z = (float)(mix(h, layer) & 0xff) / 256.0f + 0.5f;
+			seed = (int)(h >> 24);
+		}
+
+		// roughly -1 to 1
+		inline float sample(float x, float y) const {
+			return stb_perlin_noise3_seed(x * frequencyX + offsetX, y * frequencyY + offsetY, z, 0, 0, 0, seed);
+		}
+
+		float fractal(float x, float y, int octaves) const {
+			float sum = 0.0f;
+			float amplitude = 0.5f;
+			float scale = 1.0f;
+			for (int i = 0; i < octaves; i++) {
+				sum += sample(x * scale, y * scale) * amplitude;
+				amplitude *= 0.5f;
+				scale *= 2.0f;
+			}
+			return sum * 2.0f;
+		}
+	};
+
+	enum GeneratorLayer : uint32_t {
+		LayerSurface = 1,
+		LayerSoil,
+		LayerBands,
+		LayerPockets,
+		LayerPocketKind,
+		LayerCaveEdge
+	};
+
+	// Corner-coloured tile, openness 0-1 interpolated from the corners of each of its two
+	// squares so tiles that share corners meet without a seam, plus a bulge in the middle of
+	// each square that tells the variants apart.
+	stbhw_tile* makeCaveTile(bool horizontal, const int* corners, uint32_t& random) {
+		const int n = WorldGenerator::CAVE_TILE_SIZE;
+		stbhw_tile* tile = (stbhw_tile*)std::malloc(sizeof(stbhw_tile) - 1 + 3 * 2 * n * n);
+		tile->a = (signed char)corners[0];
+		tile->b = (signed char)corners[1];
+		tile->c = (signed char)corners[2];
+		tile->d = (signed char)corners[3];
+		tile->e = (signed char)corners[4];
+		tile->f = (signed char)corners[5];
+
+		// per square: top left, top right, bottom left, bottom right (see the stbhw diagrams)
+		const int h[2][4] = {{corners[0], corners[1], corners[3], corners[4]}, {corners[1], corners[2], corners[4], corners[5]}};
+		const int v[2][4] = {{corners[0], corners[3], corners[1], corners[4]}, {corners[1], corners[4], corners[2], corners[5]}};
+		const int width = horizontal ? 2 * n : n;
+
+		for (int square = 0; square < 2; square++) {
+			const int* c = horizontal ? h[square] : v[square];
+			random ^= random << 13;
+			random ^= random >> 17;
+			random ^= random << 5;
+			const float bulge = ((float)(random & 0xffff) / 65535.0f * 2.0f - 1.0f) * CAVE_TILE_BULGE;
+
+			for (int j = 0; j < n; j++) {
+				for (int i = 0; i < n; i++) {
+					const float u = (i + 0.5f) / n;
+					const float w = (j + 0.5f) / n;
+					float value = (c[0] * (1.0f - u) + c[1] * u) * (1.0f - w) + (c[2] * (1.0f - u) + c[3] * u) * w;
+					value += bulge * std::sin(3.14159265f * u) * std::sin(3.14159265f * w);
+					const unsigned char byte = (unsigned char)(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+
+					const int x = horizontal ? i + square * n : i;
+					const int y = horizontal ? j : j + square * n;
+					unsigned char* pixel = &tile->pixels[(y * width + x) * 3];
+					pixel[0] = pixel[1] = pixel[2] = byte;
+				}
+			}
+		}
+		return tile;
+	}
+}
+
+WorldGenerator::WorldGenerator(const MaterialTable& materials, uint32_t seed, const WorldGeneratorSettings& settings)
+	: m_Materials{materials}, m_Seed{seed}, m_Settings{settings} {
+
+	if (!m_Materials.findMaterial("stone", m_Stone)) {
+		spdlog::error("WorldGenerator needs a material called stone");
+		return;
+	}
+	// anything else missing is built from stone instead
+	if (!m_Materials.findMaterial("sand", m_Sand)) m_Sand = m_Stone;
+	if (!m_Materials.findMaterial("water", m_Water)) m_Water = m_Stone;
+	if (!m_Materials.findMaterial("lava", m_Lava)) m_Lava = m_Stone;
+	if (!m_Materials.findMaterial("oil", m_Oil)) m_Oil = m_Water;
+
+	buildTileset();
+	m_Valid = true;
+}
+
+WorldGenerator::~WorldGenerator() {
+	if (m_Tileset) stbhw_free_tileset(m_Tileset.get());
+}
+
+void WorldGenerator::buildTileset() {
+	// every combination of the six corner colours in both orientations, so any layout the
+	// generator picks has a tile
+	constexpr int COMBINATIONS = CAVE_COLORS * CAVE_COLORS * CAVE_COLORS * CAVE_COLORS * CAVE_COLORS * CAVE_COLORS;
+	constexpr int TILES = COMBINATIONS * CAVE_TILE_VARIANTS;
+
+	m_Tileset.reset(new stbhw_tileset());
+	stbhw_tileset& tileset = *m_Tileset;
+	tileset.is_corner = 1;
+	for (int i = 0; i < 4; i++) tileset.num_color[i] = CAVE_COLORS;
+	tileset.short_side_len = CAVE_TILE_SIZE;
+	// malloc, the tileset is released by stbhw_free_tileset()
+	tileset.h_tiles = (stbhw_tile**)std::malloc(sizeof(stbhw_tile*) * TILES);
+	tileset.v_tiles = (stbhw_tile**)std::malloc(sizeof(stbhw_tile*) * TILES);
+	tileset.max_h_tiles = tileset.max_v_tiles = TILES;
+
+	// the tiles themselves are the same for every seed, only their layout changes
+	uint32_t random = 0x2545f491u;
+	for (int combination = 0; combination < COMBINATIONS; combination++) {
+		int corners[6];
+		for (int i = 0, rest = combination; i < 6; i++, rest /= CAVE_COLORS) corners[i] = rest % CAVE_COLORS;
+
+		for (int variant = 0; variant < CAVE_TILE_VARIANTS; variant++) {
+			tileset.h_tiles[tileset.num_h_tiles++] = makeCaveTile(true, corners, random);
+			tileset.v_tiles[tileset.num_v_tiles++] = makeCaveTile(false, corners, random);
+		}
+	}
+}
+
+const uint8_t* WorldGenerator::getCaves(int regionX, int regionY) {
+	const uint64_t key = World::chunkKey(regionX, regionY);
+	auto found = m_Caves.find(key);
+	if (found != m_Caves.end()) return found->second.get();
+
+	std::unique_ptr<uint8_t[]> caves(new uint8_t[CAVE_REGION_SIZE * CAVE_REGION_SIZE]);
+	m_CaveImage.resize((size_t)CAVE_REGION_SIZE * CAVE_REGION_SIZE * 3);
+
+	stbhw_seed_random(mix(mix(m_Seed, (uint32_t)regionX), (uint32_t)regionY));
+	if (stbhw_generate_image(m_Tileset.get(), nullptr, m_CaveImage.data(), CAVE_REGION_SIZE * 3, CAVE_REGION_SIZE, CAVE_REGION_SIZE)) {
+		for (int i = 0; i < CAVE_REGION_SIZE * CAVE_REGION_SIZE; i++) caves[i] = m_CaveImage[i * 3];
+	} else {
+		spdlog::error("Could not lay out the caves of region {}, {}: {}", regionX, regionY, stbhw_get_last_error());
+		std::memset(caves.get(), 0, CAVE_REGION_SIZE * CAVE_REGION_SIZE);
+	}
+
+	const uint8_t* result = caves.get();
+	m_Caves.emplace(key, std::move(caves));
+	return result;
+}
+
+void WorldGenerator::fillChunk(Chunk& chunk, const uint8_t* caves) const {
+	const WorldGeneratorSettings& s = m_Settings;
+	const NoiseLayer surface(m_Seed, LayerSurface, 1.0f / 1024.0f, 1.0f);
+	const NoiseLayer soil(m_Seed, LayerSoil, 1.0f / 96.0f, 1.0f);
+	const NoiseLayer bands(m_Seed, LayerBands, 1.0f / 512.0f, 1.0f / 20.0f);
+	const NoiseLayer pockets(m_Seed, LayerPockets, 1.0f / 40.0f, 1.0f / 28.0f);
+	const NoiseLayer pocketKind(m_Seed, LayerPocketKind, 1.0f / 300.0f, 1.0f / 300.0f);
+	const NoiseLayer caveEdge(m_Seed, LayerCaveEdge, 1.0f / 14.0f, 1.0f / 14.0f);
+
+	const int baseX = chunk.getChunkX() * CHUNK_SIZE;
+	const int baseY = chunk.getChunkY() * CHUNK_SIZE;
+	MaterialID* materials = chunk.getMaterials();
+	float* temperatures = chunk.getTemperatures();
+	uint8_t* flags = chunk.getFlags();
+
+	const float threshold = 1.0f - s.caveOpenness;
+	const float slope = s.surfaceAmplitude / 4.0f;
+
+	for (int x = 0; x < CHUNK_SIZE; x++) {
+		const int worldX = baseX + x;
+		const float height = surface.fractal((float)worldX, 0.0f, 5);
+		const int ground = s.surfaceHeight + (int)(height * s.surfaceAmplitude);
+		// valleys collect more sand than hilltops
+		const int soilDepth = std::max(0, (int)(s.soilDepth * (1.0f - height * 0.75f) + soil.sample((float)worldX, 0.0f) * s.soilDepth * 0.5f));
+		const int caveX = worldX & (CAVE_REGION_SIZE - 1);
+		const int edgeX = std::min(caveX, CAVE_REGION_SIZE - 1 - caveX);
+
+		for (int y = 0; y < CHUNK_SIZE; y++) {
+			const int worldY = baseY + y;
+			const int depth = ground - worldY;
+			const int i = Chunk::index(x, y);
+			MaterialID material = 0;
+			uint8_t flag = 0;
+
+			if (worldY < s.bedrockHeight) {
+				material = m_Stone;
+				flag = CellStatic;
+			} else if (depth <= 0) {
+				material = 0;
+			} else if (depth <= soilDepth) {
+				material = m_Sand;
+			} else {
+				material = m_Stone;
+				bool open = false;
+				if (depth > s.caveDepth && worldY >= s.bedrockHeight + CAVE_TILE_SIZE / 4) {
+					const int caveY = worldY & (CAVE_REGION_SIZE - 1);
+					const int edge = std::min(edgeX, std::min(caveY, CAVE_REGION_SIZE - 1 - caveY));
+					float openness = caves[caveY * CAVE_REGION_SIZE + caveX] / 255.0f;
+					openness *= std::min(1.0f, (float)edge / (CAVE_TILE_SIZE / 2));
+					openness *= std::min(1.0f, (float)(depth - s.caveDepth) / CAVE_FADE_DEPTH);
+					open = openness + caveEdge.sample((float)worldX, (float)worldY) * 0.2f > threshold;
+				}
+
+				if (open) {
+					material = worldY < s.lavaHeight ? m_Lava : 0;
+				} else if (depth > s.caveDepth && pockets.sample((float)worldX, (float)worldY) > 0.55f) {
+					material = pocketKind.sample((float)worldX, (float)worldY) > 0.0f ? m_Oil : m_Water;
+				} else if (bands.sample((float)worldX, (float)worldY + slope * height) > 0.4f) {
+					// sediment follows the lie of the land above it
+					material = m_Sand;
+				}
+			}
+
+			materials[i] = material;
+			temperatures[i] = m_Materials.hasSpawnTemperature(material) ? m_Materials.getSpawnTemperature(material) : AMBIENT_TEMPERATURE;
+			flags[i] = flag;
+		}
+	}
+
+	std::fill_n(chunk.getVelocitiesX(), CHUNK_CELLS, 0);
+	std::fill_n(chunk.getVelocitiesY(), CHUNK_CELLS, 0);
+}
+
+void WorldGenerator::wakeChunk(Chunk& chunk) {
+	// as for a chunk read from a file: wake it and whatever settled against it while it was missing
+	chunk.markAllDirty();
+	for (int i = 0; i < CHUNK_SIZE; i++) {
+		chunk.markDirty(0, i);
+		chunk.markDirty(CHUNK_SIZE - 1, i);
+		chunk.markDirty(i, 0);
+		chunk.markDirty(i, CHUNK_SIZE - 1);
+	}
+	chunk.wakeThermal();
+}
+
+bool WorldGenerator::loadChunk(Chunk& chunk) {
+	if (!m_Valid) return false;
+	fillChunk(chunk, getChunkCaves(chunk.getChunkX(), chunk.getChunkY()));
+	wakeChunk(chunk);
+	m_ChunksGenerated++;
+	return true;
+}
+
+size_t WorldGenerator::generate(World& world, ThreadPool* pool, int minChunkX, int minChunkY, int maxChunkX, int maxChunkY,
+	int focusX, int focusY, size_t maxChunks) {
+
+	if (!m_Valid || maxChunks == 0) return 0;
+	PROFILE_SCOPE("WorldGenerator::generate");
+
+	const Area area{minChunkX, minChunkY, maxChunkX, maxChunkY, focusX, focusY};
+	if (area.minChunkX != m_OrderArea.minChunkX || area.minChunkY != m_OrderArea.minChunkY || area.maxChunkX != m_OrderArea.maxChunkX
+		|| area.maxChunkY != m_OrderArea.maxChunkY || area.focusX != m_OrderArea.focusX || area.focusY != m_OrderArea.focusY || m_Order.empty()) {
+
+		m_OrderArea = area;
+		m_Order.clear();
+		for (int cy = minChunkY; cy <= maxChunkY; cy++) {
+			for (int cx = minChunkX; cx <= maxChunkX; cx++) m_Order.emplace_back(cx, cy);
+		}
+		auto distance = [&](const std::pair<int, int>& c) {
+			const int64_t dx = (int64_t)c.first * CHUNK_SIZE + CHUNK_SIZE / 2 - focusX;
+			const int64_t dy = (int64_t)c.second * CHUNK_SIZE + CHUNK_SIZE / 2 - focusY;
+			return dx * dx + dy * dy;
+		};
+		std::stable_sort(m_Order.begin(), m_Order.end(), [&](const std::pair<int, int>& a, const std::pair<int, int>& b) {
+			return distance(a) < distance(b);
+		});
+	}
+
+	// the chunks are created up front and filled afterwards, the World itself is not thread-safe
+	ChunkLoader* loader = world.getChunkLoader();
+	world.setChunkLoader(nullptr);
+	m_Pending.clear();
+	for (const std::pair<int, int>& c : m_Order) {
+		if (m_Pending.size() >= maxChunks) break;
+		if (world.getChunk(c.first, c.second)) continue;
+		m_Pending.push_back(PendingChunk{world.getOrCreateChunk(c.first, c.second), getChunkCaves(c.first, c.second)});
+	}
+	world.setChunkLoader(loader);
+
+	auto fill = [this](size_t i) { fillChunk(*m_Pending[i].chunk, m_Pending[i].caves); };
+	if (pool) {
+		pool->parallelFor(m_Pending.size(), fill);
+	} else {
+		for (size_t i = 0; i < m_Pending.size(); i++) fill(i);
+	}
+
+	// waking touches the neighbours, so it stays on this thread
+	for (const PendingChunk& pending : m_Pending) wakeChunk(*pending.chunk);
+	m_ChunksGenerated += m_Pending.size();
+	return m_Pending.size();
+}
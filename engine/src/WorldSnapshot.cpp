@@ -0,0 +1,58 @@
+#include "WorldSnapshot.h"
+
+#include <algorithm>
+
+#include "Profiler.h"
+
+namespace {
+	constexpr float GAS_DENSITY_SCALE = 255.0f / (GAS_SCALE * GAS_SCALE);
+}
+
+WorldSnapshot::WorldSnapshot() {
+
+}
+
+size_t WorldSnapshot::capture(const World& world, uint64_t tick) {
+	PROFILE_SCOPE("WorldSnapshot::capture");
+	m_Tick = tick;
+	m_Captures++;
+
+	size_t copied = 0;
+	for (const Chunk* chunk : world.getChunks()) {
+		std::unique_ptr<ChunkSnapshot>& slot = m_Chunks[World::chunkKey(chunk->getChunkX(), chunk->getChunkY())];
+		if (!slot) {
+			slot.reset(new ChunkSnapshot);
+			slot->chunkX = chunk->getChunkX();
+			slot->chunkY = chunk->getChunkY();
+			slot->serial = 0;
+			slot->revision = 0;
+		}
+		slot->captured = m_Captures;
+
+		if (slot->serial != chunk->getSerial() || slot->revision != chunk->getRevision()) {
+			slot->serial = chunk->getSerial();
+			slot->revision = chunk->getRevision();
+			std::copy_n(chunk->getMaterials(), CHUNK_CELLS, slot->materials);
+			for (int s = 0; s < GAS_SPECIES; s++) {
+				const float* amounts = chunk->getGas(s);
+				for (int g = 0; g < GAS_CELLS; g++) slot->gas[g][s] = (uint8_t)std::min(amounts[g] * GAS_DENSITY_SCALE + 0.5f, 255.0f);
+			}
+			copied++;
+		}
+	}
+
+	// anything not seen above has been removed from the world
+	if (m_Chunks.size() != world.getChunkCount()) {
+		for (auto it = m_Chunks.begin(); it != m_Chunks.end();) {
+			if (it->second->captured != m_Captures) {
+				it = m_Chunks.erase(it);
+			} else {
+				it++;
+			}
+		}
+	}
+
+	m_ChunkList.clear();
+	for (const auto& entry : m_Chunks) m_ChunkList.push_back(entry.second.get());
+	return copied;
+}
@@ -1,92 +1,78 @@
-#include <iostream>
-
-#include <glad/glad.h>
-#include <GLFW/glfw3.h>
-
-void APIENTRY glDebugOutput(GLenum source, 
-                            GLenum type, 
-                            unsigned int id, 
-                            GLenum severity, 
-                            GLsizei length, 
-                            const char *message, 
-                            const void *userParam)
-{
-    // ignore non-significant error/warning codes
-    if(id == 131169 || id == 131185 || id == 131218 || id == 131204) return; 
-
-    std::cout << "---------------" << std::endl;
-    std::cout << "Debug message (" << id << "): " <<  message << std::endl;
-
-    switch (source)
-    {
-        case GL_DEBUG_SOURCE_API:             std::cout << "Source: API"; break;
-        case GL_DEBUG_SOURCE_WINDOW_SYSTEM:   std::cout << "Source: Window System"; break;
-        case GL_DEBUG_SOURCE_SHADER_COMPILER: std::cout << "Source: Shader Compiler"; break;
-        case GL_DEBUG_SOURCE_THIRD_PARTY:     std::cout << "Source: Third Party"; break;
-        case GL_DEBUG_SOURCE_APPLICATION:     std::cout << "Source: Application"; break;
-        case GL_DEBUG_SOURCE_OTHER:           std::cout << "Source: Other"; break;
-    } std::cout << std::endl;
-
-    switch (type)
-    {
-        case GL_DEBUG_TYPE_ERROR:               std::cout << "Type: Error"; break;
-        case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: std::cout << "Type: Deprecated Behaviour"; break;
-        case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:  std::cout << "Type: Undefined Behaviour"; break; 
-        case GL_DEBUG_TYPE_PORTABILITY:         std::cout << "Type: Portability"; break;
-        case GL_DEBUG_TYPE_PERFORMANCE:         std::cout << "Type: Performance"; break;
-        case GL_DEBUG_TYPE_MARKER:              std::cout << "Type: Marker"; break;
-        case GL_DEBUG_TYPE_PUSH_GROUP:          std::cout << "Type: Push Group"; break;
-        case GL_DEBUG_TYPE_POP_GROUP:           std::cout << "Type: Pop Group"; break;
-        case GL_DEBUG_TYPE_OTHER:               std::cout << "Type: Other"; break;
-    } std::cout << std::endl;
- 
-    switch (severity)
-    {
-        case GL_DEBUG_SEVERITY_HIGH:         std::cout << "Severity: high"; break;
-        case GL_DEBUG_SEVERITY_MEDIUM:       std::cout << "Severity: medium"; break;
-        case GL_DEBUG_SEVERITY_LOW:          std::cout << "Severity: low"; break;
-        case GL_DEBUG_SEVERITY_NOTIFICATION: std::cout << "Severity: notification"; break;
-    } std::cout << std::endl;
-    std::cout << std::endl;
-}
-
-
-int main() {
-
-    if (!glfwInit()) {
-        std::cerr << "cry :(((";
-        return -1;
+#include <cstdlib>
+#include <cstring>
+
+#include <Application.h>
+#include <spdlog/spdlog.h>
+
+namespace {
+    void fill(Simulation& simulation, const MaterialTable& materials, const char* name, int x0, int y0, int x1, int y1) {
+        MaterialID material;
+        if (!materials.findMaterial(name, material)) return;
+        for (int y = y0; y < y1; y++) {
+            for (int x = x0; x < x1; x++) simulation.paint(x, y, material);
+        }
     }
 
-    GLFWwindow *window;
-
-    window = glfwCreateWindow(900,900, "The Cumsocket 2", NULL, NULL);
-
-    if (!window) {
-        std::cerr << "even more cry :((((((";
-        glfwTerminate();
-        return -1;
+    // a floor with a few piles of things on it, enough to keep every system busy for a while
+    void buildScene(Application& app) {
+        const ApplicationConfig& config = app.getConfig();
+        World& world = app.getWorld();
+        Simulation& simulation = app.getSimulation();
+        const MaterialTable& materials = app.getMaterials();
+
+        const int width = config.worldWidth;
+        const int height = config.worldHeight;
+        for (int cy = 0; cy < World::toChunkCoord(height - 1) + 1; cy++) {
+            for (int cx = 0; cx < World::toChunkCoord(width - 1) + 1; cx++) world.getOrCreateChunk(cx, cy);
+        }
+
+        fill(simulation, materials, "stone", 0, 0, width, height / 32);
+        fill(simulation, materials, "sand", width / 8, height / 2, width * 3 / 8, height * 3 / 4);
+        fill(simulation, materials, "water", width * 5 / 8, height / 2, width * 7 / 8, height * 3 / 4);
+        fill(simulation, materials, "wood", width * 7 / 16, height / 32, width * 9 / 16, height / 8);
+        fill(simulation, materials, "lava", width * 15 / 32, height * 3 / 4, width * 17 / 32, height * 13 / 16);
+
+        // a stone slab on the wood pillar, it comes down once the pillar burns through
+        fill(simulation, materials, "stone", width * 13 / 32, height / 8, width * 19 / 32, height * 9 / 64);
+        fill(simulation, materials, "fire", width * 7 / 16 - 2, height / 16, width * 7 / 16, height / 16 + 4);
     }
+}
 
-    glfwMakeContextCurrent(window);
-
-    // int flags; glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
-    // if (flags & GL_CONTEXT_FLAG_DEBUG_BIT)
-    // {
-    //     glEnable(GL_DEBUG_OUTPUT);
-    //     glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS); 
-    //     glDebugMessageCallback(glDebugOutput, nullptr);
-    //     glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
-    // }
-
-
-    while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
-
-        glfwSwapBuffers(window);
+int main(int argc, char** argv) {
+    ApplicationConfig config;
+    config.title = "The Cumsocket 2";
+
+    for (int i = 1; i < argc; i++) {
+        const bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--headless") == 0) config.headless = true;
+        else if (std::strcmp(argv[i], "--hidden") == 0) config.visible = false;
+        else if (std::strcmp(argv[i], "--points") == 0) config.renderMode = RenderPoints;
+        else if (std::strcmp(argv[i], "--generate") == 0) config.generateWorld = true;
+        else if (std::strcmp(argv[i], "--no-textures") == 0) config.textures = false;
+        else if (std::strcmp(argv[i], "--no-gas-field") == 0) config.gasField = false;
+        else if (std::strcmp(argv[i], "--region-stats") == 0) config.regionStats = true;
+        else if (std::strcmp(argv[i], "--compress-textures") == 0) config.compressTextures = true;
+        else if (std::strcmp(argv[i], "--no-hud") == 0) config.hud = false;
+        else if (std::strcmp(argv[i], "--no-hud-timings") == 0) config.hudTimings = false;
+        else if (std::strcmp(argv[i], "--profile") == 0) config.profile = true;
+        else if (std::strcmp(argv[i], "--profile-trace") == 0 && hasValue) config.profileTracePath = argv[++i];
+        else if (std::strcmp(argv[i], "--ticks") == 0 && hasValue) config.maxTicks = std::strtoull(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--threads") == 0 && hasValue) config.threads = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--seed") == 0 && hasValue) config.seed = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--upload-budget") == 0 && hasValue) config.uploadBudget = std::strtoull(argv[++i], nullptr, 10) * 1024;
+        else if (std::strcmp(argv[i], "--record") == 0 && hasValue) config.recordPath = argv[++i];
+        else if (std::strcmp(argv[i], "--replay") == 0 && hasValue) config.replayPath = argv[++i];
+        else if (std::strcmp(argv[i], "--deltas") == 0 && hasValue) config.deltaPath = argv[++i];
+        else if (std::strcmp(argv[i], "--hud-font") == 0 && hasValue) config.hudFontPath = argv[++i];
+        else if (std::strcmp(argv[i], "--hud-image") == 0 && hasValue) config.hudImagePath = argv[++i];
+        else {
+            spdlog::error("Unknown option {}. Options: --headless --hidden --points --generate --no-textures --no-gas-field --region-stats --compress-textures --no-hud --no-hud-timings --profile --profile-trace PATH --ticks N --threads N --seed N --upload-budget KiB --record PATH --replay PATH --deltas PATH|unix:PATH --hud-font PATH --hud-image PATH", argv[i]);
+            return -1;
+        }
     }
 
-    glfwTerminate();
-
-    return 0;
-}
\ No newline at end of file
+    Application app(config);
+    if (!app.init()) return -1;
+    if (!app.isReplaying() && !app.getConfig().generateWorld) buildScene(app);
+    return app.run();
+}
@@ -0,0 +1,224 @@
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <Buffer.h>
+#include <GlStub.h>
+
+#include <spdlog/spdlog.h>
+
+namespace {
+    int failures = 0;
+
+    #define CHECK(condition) \
+        do { \
+            if (!(condition)) { \
+                spdlog::error("{}:{}: check '{}' failed", __FILE__, __LINE__, #condition); \
+                failures++; \
+            } \
+        } while (false)
+
+    bool isUpload(const GlStub::Upload& upload, GLenum target, size_t offset, size_t size, bool whole) {
+        return upload.target == target && upload.offset == offset && upload.size == size && upload.whole == whole;
+    }
+
+    template<typename V>
+    bool storeMatches(GLuint buffer, const std::vector<V>& expected) {
+        const std::vector<uint8_t>* bytes = GlStub::getBufferData(buffer);
+        return bytes && bytes->size() == expected.size() * sizeof(V) && std::memcmp(bytes->data(), expected.data(), bytes->size()) == 0;
+    }
+
+    void testDirtyRangeSet() {
+        DirtyRangeSet set;
+        CHECK(set.empty());
+        set.add(5, 5); // empty ranges are ignored
+        CHECK(set.empty());
+
+        // overlapping and touching ranges join as they come in, disjoint ones stay apart
+        set.add(10, 20);
+        set.add(15, 25);
+        set.add(25, 30);
+        set.add(40, 50);
+        set.add(0, 2);
+        CHECK(set.getRanges().size() == 3);
+        CHECK(set.getRanges()[0].start == 0 && set.getRanges()[0].end == 2);
+        CHECK(set.getRanges()[1].start == 10 && set.getRanges()[1].end == 30);
+        CHECK(set.getRanges()[2].start == 40 && set.getRanges()[2].end == 50);
+        CHECK(set.getDirtyCount() == 2 + 20 + 10);
+
+        // one range swallowing several
+        set.add(1, 45);
+        CHECK(set.getRanges().size() == 1);
+        CHECK(set.getDirtyCount() == 50);
+        set.clear();
+        CHECK(set.empty());
+
+        // flush joins ranges at most the merge gap apart and no further
+        set.setMergeGap(8);
+        set.add(0, 4);
+        set.add(12, 16);  // gap of 8, joined
+        set.add(25, 30);  // gap of 9, not joined
+        set.add(100, 101);
+        std::vector<DirtyRangeSet::Range> flushed;
+        set.flush([&](size_t start, size_t end) { flushed.push_back(DirtyRangeSet::Range{start, end}); });
+        CHECK(set.empty());
+        CHECK(flushed.size() == 3);
+        CHECK(flushed.size() == 3 && flushed[0].start == 0 && flushed[0].end == 16);
+        CHECK(flushed.size() == 3 && flushed[1].start == 25 && flushed[1].end == 30);
+        CHECK(flushed.size() == 3 && flushed[2].start == 100 && flushed[2].end == 101);
+
+        // a gap of 0 only joins what add() already would have
+        set.setMergeGap(0);
+        set.add(0, 4);
+        set.add(5, 6);
+        size_t uploads = 0;
+        set.flush([&](size_t, size_t) { uploads++; });
+        CHECK(uploads == 2);
+    }
+
+    void testVertexUploads() {
+        GlStub::reset();
+        VertexDataBuffer<Position, Draw, Dynamic> buffer;
+        const GLuint id = 1; // the first name after a reset
+
+        std::vector<float> expected;
+        for (int i = 0; i < 100; i++) {
+            buffer.pushVertex((float)i, (float)i * 2.0f, (float)i * 3.0f);
+            expected.insert(expected.end(), {(float)i, (float)i * 2.0f, (float)i * 3.0f});
+        }
+        GlStub::clearUploads();
+        buffer.pushToBuffer(true);
+        const std::vector<GlStub::Upload>& uploads = GlStub::getUploads();
+        CHECK(uploads.size() == 1 && isUpload(uploads[0], GL_ARRAY_BUFFER, 0, 300 * sizeof(GLfloat), true));
+        CHECK(storeMatches(id, expected));
+
+        // floats 0-2 and 30-32, 27 apart, go up as one range under the default gap of 64
+        GlStub::clearUploads();
+        buffer.editVertex(0, -1.0f, -2.0f, -3.0f);
+        buffer.editVertex(10, -4.0f, -5.0f, -6.0f);
+        buffer.pushToBuffer(true);
+        CHECK(uploads.size() == 1 && isUpload(uploads[0], GL_ARRAY_BUFFER, 0, 33 * sizeof(GLfloat), false));
+        expected[0] = -1.0f; expected[1] = -2.0f; expected[2] = -3.0f;
+        expected[30] = -4.0f; expected[31] = -5.0f; expected[32] = -6.0f;
+        CHECK(storeMatches(id, expected));
+        CHECK(buffer.getUploadStats().bytesChanged == 300 * sizeof(GLfloat) + 6 * sizeof(GLfloat));
+
+        // 267 floats apart, two uploads
+        GlStub::clearUploads();
+        buffer.editVertex(1, 7.0f, 8.0f, 9.0f);
+        buffer.editVertex(90, 10.0f, 11.0f, 12.0f);
+        buffer.pushToBuffer(true);
+        CHECK(uploads.size() == 2);
+        CHECK(uploads.size() == 2 && isUpload(uploads[0], GL_ARRAY_BUFFER, 3 * sizeof(GLfloat), 3 * sizeof(GLfloat), false));
+        CHECK(uploads.size() == 2 && isUpload(uploads[1], GL_ARRAY_BUFFER, 270 * sizeof(GLfloat), 3 * sizeof(GLfloat), false));
+        expected[3] = 7.0f; expected[4] = 8.0f; expected[5] = 9.0f;
+        expected[270] = 10.0f; expected[271] = 11.0f; expected[272] = 12.0f;
+        CHECK(storeMatches(id, expected));
+
+        // nothing dirty, nothing sent
+        GlStub::clearUploads();
+        buffer.pushToBuffer(true);
+        CHECK(uploads.empty());
+    }
+
+    void testIndexUploads() {
+        GlStub::reset();
+        IndexBuffer<Triangles> buffer(GL_DYNAMIC_DRAW);
+        const GLuint id = 1;
+
+        std::vector<GLuint> expected = {0, 1, 2, 2, 3, 0, 4, 5, 6};
+        buffer.pushIndicies(expected.data(), (unsigned int)expected.size());
+        GlStub::clearUploads();
+        buffer.pushToBuffer(true);
+        const std::vector<GlStub::Upload>& uploads = GlStub::getUploads();
+        CHECK(uploads.size() == 1 && isUpload(uploads[0], GL_ELEMENT_ARRAY_BUFFER, 0, 9 * sizeof(GLuint), true));
+        CHECK(storeMatches(id, expected));
+
+        // offsets and sizes go by sizeof(GLuint) per index, not sizeof(GLfloat) or bytes
+        GlStub::clearUploads();
+        buffer.editIndex(4, 7);
+        buffer.pushToBuffer(true);
+        CHECK(uploads.size() == 1 && isUpload(uploads[0], GL_ELEMENT_ARRAY_BUFFER, 4 * sizeof(GLuint), sizeof(GLuint), false));
+        expected[4] = 7;
+
+        GlStub::clearUploads();
+        unsigned int primitive[3] = {9, 8, 7};
+        buffer.editPrimitive(6, primitive);
+        buffer.pushToBuffer(true);
+        CHECK(uploads.size() == 1 && isUpload(uploads[0], GL_ELEMENT_ARRAY_BUFFER, 6 * sizeof(GLuint), 3 * sizeof(GLuint), false));
+        expected[6] = 9; expected[7] = 8; expected[8] = 7;
+        CHECK(storeMatches(id, expected));
+        CHECK(buffer.getUploadStats().bytesUploaded == (9 + 1 + 3) * sizeof(GLuint));
+    }
+
+    void testIndexBufferRelease() {
+        GlStub::reset();
+        {
+            IndexBuffer<Triangles> buffer(GL_DYNAMIC_DRAW);
+            CHECK(GlStub::getLiveBufferCount() == 1);
+        }
+        CHECK(GlStub::getLiveBufferCount() == 0);
+    }
+
+    void testInterleavedUploads() {
+        GlStub::reset();
+        InterleavedBuffer<VertexLayout<Position, Color>, Draw, Dynamic> buffer;
+        const GLuint id = 1;
+
+        for (int i = 0; i < 20; i++) buffer.pushVertex(i, 0, 0, 1, 1, 1, 1);
+        GlStub::clearUploads();
+        buffer.pushToBuffer();
+        const std::vector<GlStub::Upload>& uploads = GlStub::getUploads();
+        CHECK(uploads.size() == 1 && isUpload(uploads[0], 0, 0, 20 * 7 * sizeof(GLfloat), true));
+
+        // just the color of vertex 3: floats 24-27
+        GlStub::clearUploads();
+        buffer.editAttribute<1>(3, 0.5f, 0.5f, 0.5f, 0.5f);
+        buffer.pushToBuffer();
+        CHECK(uploads.size() == 1 && isUpload(uploads[0], 0, 24 * sizeof(GLfloat), 4 * sizeof(GLfloat), false));
+        const std::vector<uint8_t>* bytes = GlStub::getBufferData(id);
+        CHECK(bytes && reinterpret_cast<const float*>(bytes->data())[24] == 0.5f);
+    }
+
+    void testStreamRing() {
+        GlStub::reset();
+        VertexDataBuffer<Color, Draw, Stream> buffer;
+        const GLuint id = 1;
+        buffer.reserveStream(4);
+        const size_t segmentBytes = 4 * 4 * sizeof(GLfloat);
+        CHECK(GlStub::getBufferData(id) && GlStub::getBufferData(id)->size() == 3 * segmentBytes);
+
+        // a push that fits lands in the current segment
+        for (int i = 0; i < 4; i++) buffer.pushVertex((float)i + 1.0f, 0.0f, 0.0f, 0.0f);
+        buffer.pushToBuffer(true);
+        CHECK(reinterpret_cast<const float*>(GlStub::getBufferData(id)->data())[12] == 4.0f);
+        buffer.fenceStream();
+        CHECK(buffer.getStreamFirstVertex() == 4);
+
+        // one that doesn't is dropped, the buffer object and the ring stay as they were
+        buffer.pushVertex(5.0f, 0.0f, 0.0f, 0.0f);
+        buffer.pushToBuffer(true);
+        CHECK(GlStub::getLiveBufferCount() == 1);
+        CHECK(GlStub::getBufferData(id) && GlStub::getBufferData(id)->size() == 3 * segmentBytes);
+        CHECK(reinterpret_cast<const float*>(GlStub::getBufferData(id)->data())[16] == 0.0f);
+        CHECK(!buffer.isDirty());
+    }
+}
+
+int main() {
+    GlStub::install();
+
+    testDirtyRangeSet();
+    testVertexUploads();
+    testIndexUploads();
+    testIndexBufferRelease();
+    testInterleavedUploads();
+    testStreamRing();
+
+    if (failures != 0) {
+        spdlog::error("{} buffer checks failed", failures);
+        return 1;
+    }
+    spdlog::info("buffer checks passed");
+    return 0;
+}
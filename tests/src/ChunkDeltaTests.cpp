@@ -0,0 +1,143 @@
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <ChunkDelta.h>
+#include <World.h>
+
+#include <spdlog/spdlog.h>
+
+namespace {
+    int failures = 0;
+
+    #define CHECK(condition) \
+        do { \
+            if (!(condition)) { \
+                spdlog::error("{}:{}: check '{}' failed", __FILE__, __LINE__, #condition); \
+                failures++; \
+            } \
+        } while (false)
+
+    // the same chunks in both, holding the same state
+    bool mirrors(const World& source, const World& mirror) {
+        if (source.getChunkCount() != mirror.getChunkCount()) return false;
+        std::vector<uint8_t> a(ChunkDeltaEncoder::STATE_SIZE), b(ChunkDeltaEncoder::STATE_SIZE);
+        for (const Chunk* chunk : source.getChunks()) {
+            const Chunk* other = mirror.getChunk(chunk->getChunkX(), chunk->getChunkY());
+            if (!other) return false;
+            ChunkDeltaEncoder::readState(*chunk, a.data());
+            ChunkDeltaEncoder::readState(*other, b.data());
+            if (std::memcmp(a.data(), b.data(), a.size()) != 0) return false;
+        }
+        return true;
+    }
+
+    bool roundTrip(ChunkDeltaEncoder& encoder, ChunkDeltaDecoder& decoder, World& source, World& mirror, uint64_t tick) {
+        source.swapDirtyRects();
+        const std::vector<uint8_t>& frame = encoder.encode(source, tick);
+        return decoder.apply(mirror, frame.data(), frame.size()) && decoder.getTick() == tick;
+    }
+
+    void testRoundTrip() {
+        World source, mirror;
+        ChunkDeltaEncoder encoder;
+        ChunkDeltaDecoder decoder;
+
+        source.setMaterial(3, 4, 3);
+        source.setMaterial(40, 200, 2);
+        source.setTemperature(41, 200, 500.0f);
+        CHECK(roundTrip(encoder, decoder, source, mirror, 1));
+        CHECK(mirrors(source, mirror));
+
+        source.setMaterial(3, 4, 0);
+        source.setMaterial(3, 5, 3);
+        CHECK(roundTrip(encoder, decoder, source, mirror, 2));
+        CHECK(mirrors(source, mirror));
+        CHECK(mirror.getMaterial(3, 5) == 3 && mirror.getMaterial(3, 4) == 0);
+
+        // nothing moved, nothing sent
+        CHECK(roundTrip(encoder, decoder, source, mirror, 3));
+        CHECK(roundTrip(encoder, decoder, source, mirror, 4));
+        CHECK(encoder.getFrame().size() == encoder.getStats().lastFrameBytes);
+        CHECK(encoder.getStats().chunksEncoded == 2 + 1);
+    }
+
+    void testRemovedChunk() {
+        World source, mirror;
+        ChunkDeltaEncoder encoder;
+        ChunkDeltaDecoder decoder;
+
+        source.getOrCreateChunk(0, 0);
+        source.setMaterial(1, 1, 3);
+        CHECK(roundTrip(encoder, decoder, source, mirror, 1));
+        CHECK(mirrors(source, mirror));
+
+        source.removeChunk(0, 0);
+        CHECK(roundTrip(encoder, decoder, source, mirror, 2));
+        CHECK(mirror.getChunkCount() == 0);
+
+        // back under the same coordinates, sent whole rather than against the old state
+        source.getOrCreateChunk(0, 0);
+        source.setMaterial(1, 1, 3);
+        CHECK(roundTrip(encoder, decoder, source, mirror, 3));
+        CHECK(mirror.getMaterial(1, 1) == 3);
+        CHECK(mirrors(source, mirror));
+
+        // one chunk leaving while another arrives keeps the count the same
+        source.removeChunk(0, 0);
+        source.setMaterial(CHUNK_SIZE + 2, 2, 2);
+        CHECK(roundTrip(encoder, decoder, source, mirror, 4));
+        CHECK(mirror.getChunk(0, 0) == nullptr);
+        CHECK(mirrors(source, mirror));
+    }
+
+    void testReset() {
+        World source, mirror;
+        ChunkDeltaEncoder encoder;
+        ChunkDeltaDecoder decoder;
+
+        source.setMaterial(5, 5, 3);
+        source.setMaterial(CHUNK_SIZE * 3, 0, 2);
+        CHECK(roundTrip(encoder, decoder, source, mirror, 1));
+
+        // after a reset every chunk is sent whole, the decoder must not XOR it onto what it holds
+        encoder.reset();
+        source.setMaterial(5, 5, 2);
+        CHECK(roundTrip(encoder, decoder, source, mirror, 2));
+        CHECK(encoder.getStats().chunksEncoded == 2 + 2);
+        CHECK(mirrors(source, mirror));
+
+        // and the references survive it, so removals still reach the mirror
+        encoder.reset();
+        source.removeChunk(3, 0);
+        CHECK(roundTrip(encoder, decoder, source, mirror, 3));
+        CHECK(mirrors(source, mirror));
+    }
+
+    void testMalformed() {
+        World source, mirror;
+        ChunkDeltaEncoder encoder;
+        ChunkDeltaDecoder decoder;
+
+        source.setMaterial(0, 0, 3);
+        source.swapDirtyRects();
+        std::vector<uint8_t> frame = encoder.encode(source, 1);
+        CHECK(!decoder.apply(mirror, frame.data(), frame.size() - 1));
+        frame[0] = 'X';
+        CHECK(!decoder.apply(mirror, frame.data(), frame.size()));
+    }
+}
+
+int main() {
+    testRoundTrip();
+    testRemovedChunk();
+    testReset();
+    testMalformed();
+
+    if (failures != 0) {
+        spdlog::error("{} chunk delta checks failed", failures);
+        return 1;
+    }
+    spdlog::info("chunk delta checks passed");
+    return 0;
+}
@@ -0,0 +1,141 @@
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include <HeatKernel.h>
+
+#include <spdlog/spdlog.h>
+
+namespace {
+    int failures = 0;
+
+    #define CHECK(condition) \
+        do { \
+            if (!(condition)) { \
+                spdlog::error("{}:{}: check '{}' failed", __FILE__, __LINE__, #condition); \
+                failures++; \
+            } \
+        } while (false)
+
+    constexpr float INF = std::numeric_limits<float>::infinity();
+    constexpr float RATE = 0.2f;
+
+    // no phase change, water-like, lava-like and one that only freezes
+    const float UPPER[] = {INF, 100.0f, INF, INF};
+    const float LOWER[] = {-INF, 0.0f, 700.0f, -10.0f};
+    constexpr int MATERIAL_COUNT = 4;
+
+    struct Plane {
+        std::vector<float> temperature = std::vector<float>(CHUNK_CELLS);
+        std::vector<MaterialID> material = std::vector<MaterialID>(CHUNK_CELLS);
+        std::vector<uint8_t> flags = std::vector<uint8_t>(CHUNK_CELLS);
+        std::vector<float> halo[4];
+
+        HeatHalo getHalo() const { return HeatHalo{halo[0].data(), halo[1].data(), halo[2].data(), halo[3].data()}; }
+    };
+
+    uint32_t nextRandom(uint32_t& state) {
+        state = state * 1664525u + 1013904223u;
+        return state >> 8;
+    }
+
+    float randomTemperature(uint32_t& state) {
+        return -50.0f + (float)(nextRandom(state) % 155000) * 0.01f;
+    }
+
+    Plane makeRandomPlane(uint32_t seed) {
+        Plane plane;
+        uint32_t state = seed;
+        for (int i = 0; i < CHUNK_CELLS; i++) {
+            plane.temperature[i] = randomTemperature(state);
+            plane.material[i] = (MaterialID)(nextRandom(state) % MATERIAL_COUNT);
+            plane.flags[i] = (uint8_t)(nextRandom(state) & CellStatic);
+        }
+        for (std::vector<float>& side : plane.halo) {
+            side.resize(CHUNK_SIZE);
+            for (float& t : side) t = randomTemperature(state);
+        }
+        return plane;
+    }
+
+    // Steps copies of the plane with every kernel this CPU runs and compares each one against
+    // the scalar kernel, bit for bit, after every step.
+    void checkKernelsAgree(const Plane& start, int steps) {
+        Plane scalar = start;
+        const HeatKernel reference(HeatKernelScalar);
+
+        for (int isa = HeatKernelSSE2; isa < HeatKernelISACount; isa++) {
+            if (!HeatKernel::isSupported((HeatKernelISA)isa)) {
+                spdlog::info("{} is not supported here, not checked", HeatKernel::getISAName((HeatKernelISA)isa));
+                continue;
+            }
+            const HeatKernel kernel((HeatKernelISA)isa);
+            CHECK(kernel.getISA() == isa);
+
+            Plane plane = start;
+            scalar = start;
+            for (int step = 0; step < steps; step++) {
+                const HeatStepResult expected = reference.step(scalar.temperature.data(), scalar.material.data(), scalar.flags.data(),
+                    scalar.getHalo(), UPPER, LOWER, RATE);
+                const HeatStepResult result = kernel.step(plane.temperature.data(), plane.material.data(), plane.flags.data(),
+                    plane.getHalo(), UPPER, LOWER, RATE);
+
+                CHECK(std::memcmp(plane.temperature.data(), scalar.temperature.data(), CHUNK_CELLS * sizeof(float)) == 0);
+                CHECK(plane.flags == scalar.flags);
+                CHECK(std::memcmp(&result.maxDelta, &expected.maxDelta, sizeof(float)) == 0);
+                CHECK(result.flagged == expected.flagged);
+                CHECK(result.minRow == expected.minRow && result.maxRow == expected.maxRow);
+            }
+        }
+    }
+
+    void testRandomPlanes() {
+        for (uint32_t seed : {1u, 2u, 3u}) checkKernelsAgree(makeRandomPlane(seed), 16);
+    }
+
+    // a uniform plane doesn't change, every cell sits exactly on its threshold and is flagged
+    void testOnThreshold() {
+        Plane plane;
+        for (int i = 0; i < CHUNK_CELLS; i++) {
+            plane.temperature[i] = 100.0f;
+            plane.material[i] = 1;
+        }
+        for (std::vector<float>& side : plane.halo) side.assign(CHUNK_SIZE, 100.0f);
+        checkKernelsAgree(plane, 2);
+
+        const HeatStepResult result = HeatKernel(HeatKernelScalar).step(plane.temperature.data(), plane.material.data(), plane.flags.data(),
+            plane.getHalo(), UPPER, LOWER, RATE);
+        CHECK(result.maxDelta == 0.0f);
+        CHECK(result.flagged == CHUNK_CELLS && result.minRow == 0 && result.maxRow == CHUNK_SIZE);
+    }
+
+    // cells flagged in only some rows, so the row range and the lanes inside a vector matter
+    void testSparseFlags() {
+        Plane plane;
+        for (int i = 0; i < CHUNK_CELLS; i++) plane.temperature[i] = 20.0f;
+        for (std::vector<float>& side : plane.halo) side.assign(CHUNK_SIZE, 20.0f);
+        for (int x : {0, 3, 5, 13, CHUNK_SIZE - 1}) {
+            plane.material[Chunk::index(x, 7)] = 1;
+            plane.temperature[Chunk::index(x, 7)] = 150.0f;
+            plane.material[Chunk::index(x, 40)] = 2;
+            plane.temperature[Chunk::index(x, 40)] = 300.0f;
+        }
+        checkKernelsAgree(plane, 4);
+    }
+}
+
+int main() {
+    spdlog::info("heat kernel detected: {}", HeatKernel::getISAName(HeatKernel::detectISA()));
+
+    testRandomPlanes();
+    testOnThreshold();
+    testSparseFlags();
+
+    if (failures != 0) {
+        spdlog::error("{} heat kernel checks failed", failures);
+        return 1;
+    }
+    spdlog::info("heat kernel checks passed");
+    return 0;
+}
@@ -0,0 +1,165 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <MaterialTable.h>
+#include <Simulation.h>
+#include <World.h>
+#include <WorldFile.h>
+
+#include <spdlog/spdlog.h>
+
+namespace {
+    int failures = 0;
+
+    #define CHECK(condition) \
+        do { \
+            if (!(condition)) { \
+                spdlog::error("{}:{}: check '{}' failed", __FILE__, __LINE__, #condition); \
+                failures++; \
+            } \
+        } while (false)
+
+    const std::string PATH = "WorldFileTests.chmw";
+    const std::string COPY_PATH = "WorldFileTests.copy.chmw";
+
+    MaterialID findMaterial(const MaterialTable& materials, const std::string& name) {
+        MaterialID id = 0;
+        if (!materials.findMaterial(name, id)) spdlog::error("materials.txt has no {}", name);
+        return id;
+    }
+
+    // what a save keeps of a chunk: materials, temperatures and the static flag
+    bool sameCells(const Chunk& a, const Chunk& b) {
+        if (std::memcmp(a.getMaterials(), b.getMaterials(), CHUNK_CELLS * sizeof(MaterialID)) != 0) return false;
+        if (std::memcmp(a.getTemperatures(), b.getTemperatures(), CHUNK_CELLS * sizeof(float)) != 0) return false;
+        for (int i = 0; i < CHUNK_CELLS; i++) {
+            if ((a.getFlags()[i] & CellStatic) != (b.getFlags()[i] & CellStatic)) return false;
+        }
+        return true;
+    }
+
+    void settle(Simulation& simulation, int ticks) {
+        for (int i = 0; i < ticks; i++) simulation.step();
+    }
+
+    void testRoundTrip(const MaterialTable& materials) {
+        const MaterialID stone = findMaterial(materials, "stone");
+        const MaterialID sand = findMaterial(materials, "sand");
+
+        World source;
+        // a palette plane, a run plane and chunks on the negative side of both axes
+        for (int x = 0; x < CHUNK_SIZE; x++) source.setMaterial(x, 3, stone);
+        for (int i = 0; i < CHUNK_CELLS; i++) source.setMaterial(-CHUNK_SIZE + i % CHUNK_SIZE, -1 - i / CHUNK_SIZE, (MaterialID)(i % 7 == 0 ? sand : 0));
+        source.setTemperature(5, 5, 321.5f);
+        source.setMaterial(CHUNK_SIZE * 5 + 1, CHUNK_SIZE * 2, stone);
+        source.getChunk(0, 0)->getFlags()[3 * CHUNK_SIZE] |= CellStatic;
+        CHECK(WorldFile::save(source, PATH));
+
+        WorldFile file;
+        CHECK(file.open(PATH));
+        CHECK(file.getChunkCount() == source.getChunkCount());
+        CHECK(file.contains(-1, -1) && file.contains(5, 2) && !file.contains(1, 0));
+        CHECK(file.getLoadedCount() == 0);
+
+        World loaded;
+        loaded.setChunkLoader(&file);
+        CHECK(file.loadRegion(loaded, -1, -1, 5, 2) == source.getChunkCount());
+        CHECK(loaded.getChunkCount() == source.getChunkCount());
+        for (const Chunk* chunk : source.getChunks()) {
+            const Chunk* other = loaded.getChunk(chunk->getChunkX(), chunk->getChunkY());
+            CHECK(other && sameCells(*chunk, *other));
+        }
+        // already there, nothing to load
+        CHECK(file.loadRegion(loaded, -1, -1, 5, 2) == 0);
+
+        // chunks that were never loaded are copied over from the source file
+        loaded.removeChunk(5, 2);
+        CHECK(WorldFile::save(loaded, COPY_PATH, &file));
+        WorldFile copy;
+        CHECK(copy.open(COPY_PATH));
+        CHECK(copy.getChunkCount() == source.getChunkCount());
+        World again;
+        again.setChunkLoader(&copy);
+        CHECK(copy.loadRegion(again, 5, 2, 5, 2) == 1);
+        CHECK(again.getMaterial(CHUNK_SIZE * 5 + 1, CHUNK_SIZE * 2) == stone);
+    }
+
+    // Chunks streamed in over several ticks wake each other up as they link, which moves their
+    // revisions without changing a cell. They must still unload once settled.
+    void testUnloadStreamed(const MaterialTable& materials) {
+        World source;
+        for (int cx = 0; cx < 3; cx++) source.getOrCreateChunk(cx, 0);
+        CHECK(WorldFile::save(source, PATH));
+
+        for (int spacing : {0, 5}) {
+            WorldFile file;
+            CHECK(file.open(PATH));
+            World world;
+            world.setChunkLoader(&file);
+            Simulation simulation(world, materials, 1);
+
+            for (int cx = 0; cx < 3; cx++) {
+                CHECK(file.loadRegion(world, cx, 0, cx, 0) == 1);
+                settle(simulation, spacing);
+            }
+            settle(simulation, 100);
+            CHECK(world.getAwakeChunkCount() == 0);
+            CHECK(file.unloadOutside(world, 10, 10, 12, 12) == 3);
+            CHECK(world.getChunkCount() == 0 && file.getLoadedCount() == 0);
+        }
+    }
+
+    // a chunk whose cells differ from the file stays until it is saved
+    void testChangedChunkStays(const MaterialTable& materials) {
+        const MaterialID stone = findMaterial(materials, "stone");
+
+        World source;
+        for (int cx = 0; cx < 2; cx++) source.getOrCreateChunk(cx, 0);
+        CHECK(WorldFile::save(source, PATH));
+
+        WorldFile file;
+        CHECK(file.open(PATH));
+        World world;
+        world.setChunkLoader(&file);
+        Simulation simulation(world, materials, 1);
+        CHECK(file.loadRegion(world, 0, 0, 1, 0) == 2);
+        settle(simulation, 20);
+
+        simulation.paint(CHUNK_SIZE + 10, 10, stone);
+        settle(simulation, 100);
+        CHECK(file.unloadOutside(world, 10, 10, 12, 12) == 1);
+        CHECK(world.getChunk(0, 0) == nullptr);
+        CHECK(world.getChunk(1, 0) != nullptr);
+        // asked again, it still holds the change
+        CHECK(file.unloadOutside(world, 10, 10, 12, 12) == 0);
+
+        CHECK(WorldFile::save(world, COPY_PATH, &file));
+        WorldFile saved;
+        CHECK(saved.open(COPY_PATH));
+        CHECK(saved.getChunkCount() == 2);
+        World reloaded;
+        reloaded.setChunkLoader(&saved);
+        CHECK(saved.loadRegion(reloaded, 0, 0, 1, 0) == 2);
+        CHECK(reloaded.getMaterial(CHUNK_SIZE + 10, 10) == stone);
+    }
+}
+
+int main(int argc, char** argv) {
+    MaterialTable materials;
+    if (!materials.loadFromFile(argc > 1 ? argv[1] : "res/materials.txt")) return 1;
+
+    testRoundTrip(materials);
+    testUnloadStreamed(materials);
+    testChangedChunkStays(materials);
+
+    std::remove(PATH.c_str());
+    std::remove(COPY_PATH.c_str());
+
+    if (failures != 0) {
+        spdlog::error("{} world file checks failed", failures);
+        return 1;
+    }
+    spdlog::info("world file checks passed");
+    return 0;
+}